@@ -0,0 +1,247 @@
+// Offline replay of CALL_TRACE captures. The caller audio of every trace is
+// fed back through a StreamingVadProcessor, in the order it was captured but as fast as it will go, and the
+// VAD events it raises are checked against the ones the call saw. The
+// recorded backend timings and WebSocket messages are then laid out on the
+// same timeline per turn, and the replay's CPU time is reported against the
+// audio's length.
+//
+// usage: sip_gateway_call_replay <silero_vad.onnx> [--timeline] <trace.sgtrace>...
+//
+// VAD settings come from the environment, as for the gateway, when
+// BACKEND_URL is set (to anything); otherwise the defaults are used.
+// Exits with 1 when any trace's replayed events differ from the captured
+// ones by kind, count or more than 50 ms.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "sip_gateway/config.hpp"
+#include "sip_gateway/sip/call_trace.hpp"
+#include "sip_gateway/vad/model.hpp"
+#include "sip_gateway/vad/processor.hpp"
+
+namespace {
+
+using sip_gateway::CallTraceReader;
+using sip_gateway::CallTraceRecord;
+using sip_gateway::vad::StreamingVadProcessor;
+using VadEvent = sip_gateway::CallTraceRecord::VadEvent;
+
+constexpr double kEventTolerance = 0.05;
+
+struct Event {
+    VadEvent kind;
+    double start;
+    double duration;
+};
+
+struct Replay {
+    std::vector<Event> captured;
+    std::vector<Event> replayed;
+    std::vector<CallTraceRecord> timeline; // Everything but audio, in order.
+    double audio_sec = 0.0;
+    double cpu_sec = 0.0;
+};
+
+Replay replay(const std::shared_ptr<sip_gateway::vad::VadModel>& model,
+              const sip_gateway::Config& config,
+              const std::string& path) {
+    CallTraceReader reader(path);
+    Replay result;
+    StreamingVadProcessor processor(
+        model,
+        static_cast<int>(reader.sample_rate()),
+        static_cast<float>(config.vad_threshold),
+        config.vad_min_speech_duration_ms,
+        config.vad_min_silence_duration_ms,
+        config.vad_speech_pad_ms,
+        config.short_pause_offset_ms,
+        config.long_pause_offset_ms,
+        config.user_silence_timeout_ms,
+        config.vad_max_utterance_ms,
+        config.vad_speech_prob_window,
+        config.vad_use_dynamic_corrections,
+        false,
+        config.vad_correction_enter_thres,
+        config.vad_correction_exit_thres);
+    auto record = [&result](VadEvent kind) {
+        return [&result, kind](const sip_gateway::audio::AudioSegment&, double start,
+                               double duration) {
+            result.replayed.push_back({kind, start, duration});
+        };
+    };
+    processor.set_on_speech_start(record(VadEvent::SpeechStart));
+    processor.set_on_speech_end(record(VadEvent::SpeechEnd));
+    processor.set_on_short_pause(record(VadEvent::ShortPause));
+    processor.set_on_long_pause(record(VadEvent::LongPause));
+    processor.set_on_user_silence_timeout([&result](double current_time) {
+        result.replayed.push_back({VadEvent::SilenceTimeout, current_time, 0.0});
+    });
+
+    size_t samples = 0;
+    CallTraceRecord entry;
+    while (reader.next(entry)) {
+        if (entry.kind == CallTraceRecord::Kind::Audio) {
+            const auto started = std::chrono::steady_clock::now();
+            processor.process_samples(entry.samples.data(), entry.samples.size());
+            result.cpu_sec += std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - started).count();
+            samples += entry.samples.size();
+            continue;
+        }
+        if (entry.kind == CallTraceRecord::Kind::Vad) {
+            result.captured.push_back({entry.vad, entry.start_sec, entry.duration_sec});
+        }
+        result.timeline.push_back(entry);
+    }
+    processor.finalize();
+    result.audio_sec = reader.sample_rate()
+                           ? static_cast<double>(samples) / reader.sample_rate()
+                           : 0.0;
+    return result;
+}
+
+// Index of the first event that differs, or the common length when one
+// list is a prefix of the other.
+size_t first_difference(const std::vector<Event>& a, const std::vector<Event>& b) {
+    const size_t common = std::min(a.size(), b.size());
+    for (size_t i = 0; i < common; ++i) {
+        if (a[i].kind != b[i].kind || std::abs(a[i].start - b[i].start) > kEventTolerance) {
+            return i;
+        }
+    }
+    return common;
+}
+
+void print_timeline(const std::vector<CallTraceRecord>& timeline) {
+    std::printf("  %9s  %s\n", "wall s", "record");
+    for (const auto& entry : timeline) {
+        switch (entry.kind) {
+            case CallTraceRecord::Kind::Vad:
+                std::printf("  %9.3f  vad %s at %.3f s (%.3f s)\n", entry.wall_sec,
+                            CallTraceRecord::vad_event_name(entry.vad), entry.start_sec,
+                            entry.duration_sec);
+                break;
+            case CallTraceRecord::Kind::Backend:
+                std::printf("  %9.3f  %s %.0f ms%s\n", entry.wall_sec, entry.text.c_str(),
+                            entry.duration_sec * 1000.0, entry.ok ? "" : " FAILED");
+                break;
+            case CallTraceRecord::Kind::WsMessage:
+                std::printf("  %9.3f  ws %.*s\n", entry.wall_sec, 100, entry.text.c_str());
+                break;
+            case CallTraceRecord::Kind::Audio:
+                break;
+        }
+    }
+}
+
+// Per turn: long pause to first WebSocket message and the backend time in
+// between, from the capture's wall clock.
+void print_turns(const std::vector<CallTraceRecord>& timeline) {
+    std::map<std::string, std::vector<double>> backend_ms;
+    std::vector<double> reply_ms;
+    std::optional<double> pause_at;
+    for (const auto& entry : timeline) {
+        if (entry.kind == CallTraceRecord::Kind::Backend) {
+            backend_ms[entry.text].push_back(entry.duration_sec * 1000.0);
+        } else if (entry.kind == CallTraceRecord::Kind::Vad &&
+                   entry.vad == VadEvent::LongPause) {
+            pause_at = entry.wall_sec;
+        } else if (entry.kind == CallTraceRecord::Kind::WsMessage && pause_at) {
+            reply_ms.push_back((entry.wall_sec - *pause_at) * 1000.0);
+            pause_at.reset();
+        }
+    }
+    auto summary = [](const char* name, std::vector<double> values) {
+        if (values.empty()) {
+            return;
+        }
+        std::sort(values.begin(), values.end());
+        std::printf("  %-28s %5zu %8.0f %8.0f\n", name, values.size(),
+                    values[values.size() / 2], values.back());
+    };
+    std::printf("  %-28s %5s %8s %8s\n", "captured", "n", "p50 ms", "max ms");
+    summary("long pause to first message", reply_ms);
+    for (const auto& [endpoint, values] : backend_ms) {
+        summary(endpoint.c_str(), values);
+    }
+}
+
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::fprintf(stderr, "usage: %s <silero_vad.onnx> [--timeline] <trace.sgtrace>...\n",
+                     argv[0]);
+        return 2;
+    }
+    bool timeline = false;
+    std::vector<std::string> paths;
+    for (int i = 2; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--timeline") {
+            timeline = true;
+        } else {
+            paths.push_back(arg);
+        }
+    }
+
+    const auto config = std::getenv("BACKEND_URL") ? sip_gateway::Config::load()
+                                                   : sip_gateway::Config{};
+    auto model = std::make_shared<sip_gateway::vad::VadModel>(argv[1], 16000);
+    int status = 0;
+    double total_audio = 0.0;
+    double total_cpu = 0.0;
+    for (const auto& path : paths) {
+        Replay result;
+        try {
+            result = replay(model, config, path);
+        } catch (const std::exception& ex) {
+            std::fprintf(stderr, "%s: %s\n", path.c_str(), ex.what());
+            status = 1;
+            continue;
+        }
+        total_audio += result.audio_sec;
+        total_cpu += result.cpu_sec;
+        const size_t diff = first_difference(result.captured, result.replayed);
+        const bool same = diff == result.captured.size() && diff == result.replayed.size();
+        std::printf("%s: %.1f s of audio in %.3f s (%.0fx), %zu captured / %zu replayed events%s\n",
+                    path.c_str(), result.audio_sec, result.cpu_sec,
+                    result.cpu_sec > 0.0 ? result.audio_sec / result.cpu_sec : 0.0,
+                    result.captured.size(), result.replayed.size(), same ? "" : ", DIFFERENT");
+        if (!same) {
+            status = 1;
+            auto describe = [](const std::vector<Event>& events, size_t index) {
+                if (index >= events.size()) {
+                    return std::string("none");
+                }
+                char text[64];
+                std::snprintf(text, sizeof(text), "%s at %.3f s",
+                              CallTraceRecord::vad_event_name(events[index].kind),
+                              events[index].start);
+                return std::string(text);
+            };
+            std::printf("  event %zu: captured %s, replayed %s\n", diff,
+                        describe(result.captured, diff).c_str(),
+                        describe(result.replayed, diff).c_str());
+        }
+        print_turns(result.timeline);
+        if (timeline) {
+            print_timeline(result.timeline);
+        }
+    }
+    if (paths.size() > 1 && total_cpu > 0.0) {
+        std::printf("total: %.1f s of audio in %.3f s (%.0fx real time)\n", total_audio, total_cpu,
+                    total_audio / total_cpu);
+    }
+    return status;
+}
@@ -0,0 +1,125 @@
+// Per-window cost of the VAD DSP kernels at every SIMD level this CPU
+// supports, with each level's output checked against the scalar kernels.
+//
+// usage: sip_gateway_dsp_bench [iterations] [window_size]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "sip_gateway/vad/dsp.hpp"
+
+namespace {
+
+using sip_gateway::vad::DspKernels;
+using sip_gateway::vad::SimdLevel;
+
+// Keeps results alive so the optimizer cannot drop the measured loop.
+volatile double sink = 0.0;
+
+template <typename Fn>
+double ns_per_call(size_t iterations, Fn&& fn) {
+    for (size_t i = 0; i < iterations / 16 + 1; ++i) {
+        fn();
+    }
+    const auto started = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        fn();
+    }
+    return std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - started).count() / static_cast<double>(iterations);
+}
+
+// Largest difference from the scalar kernels; sum_squares is relative.
+double max_error(const DspKernels& kernels,
+                 const std::vector<int16_t>& pcm,
+                 const std::vector<float>& samples) {
+    const auto& scalar = sip_gateway::vad::dsp_kernels(SimdLevel::Scalar);
+    std::vector<float> expected(samples.size());
+    std::vector<float> actual(samples.size());
+    scalar.pcm16_to_float(pcm.data(), expected.data(), pcm.size());
+    kernels.pcm16_to_float(pcm.data(), actual.data(), pcm.size());
+    double error = 0.0;
+    for (size_t i = 0; i < samples.size(); ++i) {
+        error = std::max(error, static_cast<double>(std::abs(expected[i] - actual[i])));
+    }
+    error = std::max(error, static_cast<double>(std::abs(
+        scalar.peak_abs(samples.data(), samples.size()) -
+        kernels.peak_abs(samples.data(), samples.size()))));
+    expected = samples;
+    actual = samples;
+    scalar.divide(expected.data(), expected.size(), 0.37f);
+    kernels.divide(actual.data(), actual.size(), 0.37f);
+    for (size_t i = 0; i < samples.size(); ++i) {
+        error = std::max(error, static_cast<double>(std::abs(expected[i] - actual[i])));
+    }
+    const double sum = scalar.sum_squares(samples.data(), samples.size());
+    if (sum > 0.0) {
+        error = std::max(error,
+                         std::abs(sum - kernels.sum_squares(samples.data(), samples.size())) / sum);
+    }
+    return error;
+}
+
+}
+
+int main(int argc, char** argv) {
+    const size_t iterations = argc > 1 ? std::stoul(argv[1]) : 200000;
+    const size_t window_size = argc > 2 ? std::stoul(argv[2]) : 512;
+
+    std::vector<int16_t> pcm(window_size);
+    std::vector<float> samples(window_size);
+    for (size_t i = 0; i < window_size; ++i) {
+        const double value = 0.3 * std::sin(2.0 * 3.14159265358979323846 * 220.0 * i / 16000.0);
+        samples[i] = static_cast<float>(value);
+        pcm[i] = static_cast<int16_t>(value * 32767.0);
+    }
+    std::vector<float> out(window_size);
+
+    std::printf("%zu iterations over %zu-sample windows, active level %s\n",
+                iterations, window_size,
+                sip_gateway::vad::simd_level_name(sip_gateway::vad::active_simd_level()));
+    std::printf("%-8s %10s %10s %10s %10s %12s\n",
+                "level", "convert", "peak", "divide", "sumsq", "max error");
+    for (const auto level : sip_gateway::vad::supported_simd_levels()) {
+        const auto& kernels = sip_gateway::vad::dsp_kernels(level);
+        const double convert = ns_per_call(iterations, [&]() {
+            kernels.pcm16_to_float(pcm.data(), out.data(), pcm.size());
+            sink = out[0];
+        });
+        const double peak = ns_per_call(iterations, [&]() {
+            sink = kernels.peak_abs(samples.data(), samples.size());
+        });
+        const double divide = ns_per_call(iterations, [&]() {
+            std::copy(samples.begin(), samples.end(), out.begin());
+            kernels.divide(out.data(), out.size(), 0.37f);
+            sink = out[0];
+        });
+        const double sum_squares = ns_per_call(iterations, [&]() {
+            sink = kernels.sum_squares(samples.data(), samples.size());
+        });
+        std::printf("%-8s %8.1fns %8.1fns %8.1fns %8.1fns %12.3g\n",
+                    sip_gateway::vad::simd_level_name(level),
+                    convert, peak, divide, sum_squares,
+                    max_error(kernels, pcm, samples));
+    }
+
+    const auto sine_fade = ns_per_call(iterations / 16 + 1, [&]() {
+        const size_t length = samples.size();
+        for (size_t i = 0; i < length; ++i) {
+            const float ratio = static_cast<float>(i) / static_cast<float>(length - 1);
+            out[i] = samples[i] * std::sin(ratio * 1.57079632679f);
+        }
+        sink = out[length / 2];
+    });
+    const auto table_fade = ns_per_call(iterations / 16 + 1, [&]() {
+        sip_gateway::vad::apply_fade(samples.data(), out.data(), samples.size(), true);
+        sink = out[samples.size() / 2];
+    });
+    std::printf("fade     std::sin %8.1fns  table %8.1fns\n", sine_fade, table_fade);
+    return 0;
+}
@@ -0,0 +1,567 @@
+// Concurrent-call load generator for a running gateway, usually one whose
+// BACKEND_URL points at sip_gateway_mock_backend. Calls ramp up in steps of
+// --step every --step-sec seconds until --calls are up, and a finished call
+// is replaced right away. Each call waits out the greeting, then speaks the
+// utterances in order and listens to each reply. From the audio it gets back
+// it measures:
+// - turn latency: end of an utterance to the first loud frame of the reply;
+// - barge-in latency: with --barge-in-ms the caller starts the next
+//   utterance that far into each reply, and this is the time until the reply
+//   goes quiet;
+// - RTP loss and jitter-buffer underruns, from the stream stats at hangup.
+// With --gateway-pid the gateway's CPU and RSS are sampled every step and
+// divided by the calls up. Running it at a few SIP_MAX_CALLS and
+// SIP_MEDIA_THREAD_CNT settings shows where latency starts to climb.
+//
+// usage: sip_gateway_load_test <sip:gateway-uri> [--calls N] [--step N]
+//            [--step-sec S] [--barge-in-ms MS] [--gateway-pid PID]
+//            [--threads N] <utterance.wav>...
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#include <pjsua2.hpp>
+
+#include "sip_gateway/audio/pcm_stream.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr unsigned kClockRate = 16000;
+constexpr unsigned kFrameUsec = 20000;
+// How long the reply must stay quiet to count as over, and as stopped by a
+// barge-in.
+constexpr auto kReplyGap = std::chrono::milliseconds(700);
+constexpr auto kBargeQuiet = std::chrono::milliseconds(60);
+constexpr auto kTurnTimeout = std::chrono::seconds(15);
+
+struct Options {
+    std::string uri;
+    size_t calls = 10;
+    size_t step = 2;
+    double step_sec = 30.0;
+    long barge_in_ms = 0;
+    int gateway_pid = 0;
+    unsigned threads = 1;
+    // Frame RMS above which the gateway counts as talking.
+    double speech_rms = 500.0;
+};
+
+using Script = std::vector<std::vector<int16_t>>;
+
+double ms_since(Clock::time_point start, Clock::time_point end) {
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+double percentile(std::vector<double> values, double quantile) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    const auto index = std::min(values.size() - 1,
+                                static_cast<size_t>(quantile * static_cast<double>(values.size())));
+    std::nth_element(values.begin(), values.begin() + static_cast<long>(index), values.end());
+    return values[index];
+}
+
+// What the calls reported since the last take().
+struct Window {
+    std::vector<double> turn_ms;
+    std::vector<double> barge_ms;
+    uint64_t timeouts = 0;
+    uint64_t barge_missed = 0;
+    uint64_t calls_done = 0;
+    uint64_t calls_failed = 0;
+    uint64_t rtp_lost = 0;
+    uint64_t jbuf_empty = 0;
+};
+
+class Results {
+public:
+    void turn(double ms) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        window_.turn_ms.push_back(ms);
+    }
+    void barge_in(double ms) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        window_.barge_ms.push_back(ms);
+    }
+    void timeout() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++window_.timeouts;
+    }
+    void barge_missed() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++window_.barge_missed;
+    }
+    void call_ended(bool completed, unsigned rtp_lost, unsigned jbuf_empty) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++(completed ? window_.calls_done : window_.calls_failed);
+        window_.rtp_lost += rtp_lost;
+        window_.jbuf_empty += jbuf_empty;
+    }
+    Window take() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return std::exchange(window_, Window{});
+    }
+
+private:
+    std::mutex mutex_;
+    Window window_;
+};
+
+// Plays the script into the call and follows the reply audio. Both
+// callbacks run on the conference clock thread.
+class CallerPort : public pj::AudioMediaPort {
+public:
+    CallerPort(const Script& script, const Options& options, Results& results)
+        : script_(script), options_(options), results_(results), since_(Clock::now()) {}
+
+    bool done() const {
+        return done_.load(std::memory_order_acquire);
+    }
+
+    void onFrameRequested(pj::MediaFrame& frame) override {
+        const size_t samples = frame.size / sizeof(int16_t);
+        frame.type = PJMEDIA_FRAME_TYPE_AUDIO;
+        frame.buf.assign(frame.size, 0);
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (state_ != State::Speaking) {
+            return;
+        }
+        const auto& utterance = script_[turn_];
+        const size_t count = std::min(samples, utterance.size() - offset_);
+        std::memcpy(frame.buf.data(), utterance.data() + offset_, count * sizeof(int16_t));
+        offset_ += count;
+        if (offset_ < utterance.size()) {
+            return;
+        }
+        if (barging_ && !barge_done_) {
+            results_.barge_missed();
+        }
+        ++turn_;
+        enter(State::Waiting, Clock::now());
+    }
+
+    void onFrameReceived(pj::MediaFrame& frame) override {
+        const auto now = Clock::now();
+        const bool loud = rms(frame) > options_.speech_rms;
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (loud) {
+            last_loud_ = now;
+        }
+        switch (state_) {
+            case State::Waiting:
+                if (loud) {
+                    // The greeting is not a turn.
+                    if (turn_ > 0) {
+                        results_.turn(ms_since(since_, now));
+                    }
+                    enter(State::Listening, now);
+                } else if (now - since_ > kTurnTimeout) {
+                    if (turn_ > 0) {
+                        results_.timeout();
+                    }
+                    next_turn(now, false);
+                }
+                break;
+            case State::Listening:
+                if (options_.barge_in_ms > 0 && turn_ < script_.size() &&
+                    now - since_ >= std::chrono::milliseconds(options_.barge_in_ms)) {
+                    next_turn(now, true);
+                } else if (now - last_loud_ >= kReplyGap) {
+                    next_turn(now, false);
+                }
+                break;
+            case State::Speaking:
+                if (barging_ && !barge_done_ && !loud && now - last_loud_ >= kBargeQuiet) {
+                    results_.barge_in(std::max(0.0, ms_since(since_, last_loud_)));
+                    barge_done_ = true;
+                }
+                break;
+            case State::Done:
+                break;
+        }
+    }
+
+private:
+    enum class State { Waiting, Listening, Speaking, Done };
+
+    static double rms(const pj::MediaFrame& frame) {
+        if (frame.type != PJMEDIA_FRAME_TYPE_AUDIO || frame.size < sizeof(int16_t)) {
+            return 0.0;
+        }
+        const auto* samples = reinterpret_cast<const int16_t*>(frame.buf.data());
+        const size_t count = frame.size / sizeof(int16_t);
+        double sum = 0.0;
+        for (size_t i = 0; i < count; ++i) {
+            sum += static_cast<double>(samples[i]) * samples[i];
+        }
+        return std::sqrt(sum / static_cast<double>(count));
+    }
+
+    void enter(State state, Clock::time_point now) {
+        state_ = state;
+        since_ = now;
+    }
+
+    void next_turn(Clock::time_point now, bool barge_in) {
+        if (turn_ >= script_.size()) {
+            enter(State::Done, now);
+            done_.store(true, std::memory_order_release);
+            return;
+        }
+        offset_ = 0;
+        barging_ = barge_in;
+        barge_done_ = false;
+        enter(State::Speaking, now);
+    }
+
+    const Script& script_;
+    const Options& options_;
+    Results& results_;
+    std::mutex mutex_;
+    State state_ = State::Waiting;
+    // Utterance being spoken, or the number spoken so far.
+    size_t turn_ = 0;
+    size_t offset_ = 0;
+    bool barging_ = false;
+    bool barge_done_ = false;
+    // When the current state began.
+    Clock::time_point since_;
+    Clock::time_point last_loud_;
+    std::atomic<bool> done_{false};
+};
+
+class LoadCall : public pj::Call {
+public:
+    LoadCall(pj::Account& account, const Script& script, const Options& options, Results& results)
+        : pj::Call(account), script_(script), options_(options), results_(results) {}
+
+    ~LoadCall() override {
+        port_.reset();
+    }
+
+    bool disconnected() const {
+        return disconnected_.load(std::memory_order_acquire);
+    }
+
+    bool finished() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return port_ && port_->done();
+    }
+
+    // Called once, from the main thread, while media is still up.
+    void hang_up() {
+        if (hung_up_.exchange(true)) {
+            return;
+        }
+        unsigned rtp_lost = 0;
+        unsigned jbuf_empty = 0;
+        bool completed = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            completed = port_ && port_->done();
+            if (media_index_ >= 0) {
+                try {
+                    const auto stat = getStreamStat(static_cast<unsigned>(media_index_));
+                    rtp_lost = stat.rtcp.rxStat.loss;
+                    jbuf_empty = stat.jbuf.empty;
+                } catch (const pj::Error&) {
+                }
+            }
+        }
+        results_.call_ended(completed, rtp_lost, jbuf_empty);
+        try {
+            pj::CallOpParam prm;
+            prm.statusCode = PJSIP_SC_OK;
+            hangup(prm);
+        } catch (const pj::Error&) {
+            disconnected_.store(true, std::memory_order_release);
+        }
+    }
+
+    void onCallState(pj::OnCallStateParam&) override {
+        if (getInfo().state != PJSIP_INV_STATE_DISCONNECTED) {
+            return;
+        }
+        if (!hung_up_.exchange(true)) {
+            // The gateway ended it, or it never connected.
+            results_.call_ended(finished(), 0, 0);
+        }
+        disconnected_.store(true, std::memory_order_release);
+    }
+
+    void onCallMediaState(pj::OnCallMediaStateParam&) override {
+        const auto info = getInfo();
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& media : info.media) {
+            if (media.type != PJMEDIA_TYPE_AUDIO || media.status != PJSUA_CALL_MEDIA_ACTIVE ||
+                port_) {
+                continue;
+            }
+            pj::MediaFormatAudio format;
+            format.type = PJMEDIA_TYPE_AUDIO;
+            format.clockRate = kClockRate;
+            format.channelCount = 1;
+            format.bitsPerSample = 16;
+            format.frameTimeUsec = kFrameUsec;
+            port_ = std::make_unique<CallerPort>(script_, options_, results_);
+            port_->createPort("loadtest/" + std::to_string(getId()), format);
+            const auto audio = getAudioMedia(static_cast<int>(media.index));
+            audio.startTransmit(*port_);
+            port_->startTransmit(audio);
+            media_index_ = static_cast<int>(media.index);
+        }
+    }
+
+private:
+    const Script& script_;
+    const Options& options_;
+    Results& results_;
+    mutable std::mutex mutex_;
+    std::unique_ptr<CallerPort> port_;
+    int media_index_ = -1;
+    std::atomic<bool> hung_up_{false};
+    std::atomic<bool> disconnected_{false};
+};
+
+bool read_wav(const std::string& path, std::vector<int16_t>& samples, unsigned& sample_rate) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    const std::string bytes{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    sip_gateway::audio::PcmStream stream(std::chrono::milliseconds(0));
+    stream.write(bytes.data(), bytes.size());
+    stream.finish();
+    if (stream.failed()) {
+        return false;
+    }
+    samples.resize(stream.total_samples());
+    samples.resize(stream.read(samples.data(), samples.size()));
+    sample_rate = stream.sample_rate();
+    return true;
+}
+
+struct ProcessSample {
+    double cpu_sec = 0.0;
+    double rss_mb = 0.0;
+};
+
+std::optional<ProcessSample> sample_process(int pid) {
+    if (pid <= 0) {
+        return std::nullopt;
+    }
+    const auto proc = "/proc/" + std::to_string(pid);
+    std::ifstream stat_file(proc + "/stat");
+    const std::string stat{std::istreambuf_iterator<char>(stat_file),
+                           std::istreambuf_iterator<char>()};
+    const auto comm_end = stat.rfind(')');
+    if (comm_end == std::string::npos) {
+        return std::nullopt;
+    }
+    // utime and stime are fields 14 and 15; the first after comm is 3.
+    std::istringstream fields(stat.substr(comm_end + 1));
+    std::string field;
+    double ticks = 0.0;
+    for (int i = 3; i <= 15 && fields >> field; ++i) {
+        if (i >= 14) {
+            ticks += std::atof(field.c_str());
+        }
+    }
+    ProcessSample sample;
+    sample.cpu_sec = ticks / static_cast<double>(sysconf(_SC_CLK_TCK));
+    std::ifstream status(proc + "/status");
+    for (std::string line; std::getline(status, line);) {
+        if (line.rfind("VmRSS:", 0) == 0) {
+            sample.rss_mb = std::atof(line.c_str() + 6) / 1024.0;
+        }
+    }
+    return sample;
+}
+
+void print_header(bool process) {
+    std::printf("%6s %6s %8s %8s %8s %8s %8s %8s %6s %6s %6s %8s", "calls", "turns", "turn p50",
+                "p95", "p99", "barge 50", "p95", "missed", "t/out", "failed", "lost", "jb empty");
+    if (process) {
+        std::printf(" %7s %9s %8s %8s", "cpu %", "cpu%/call", "rss MB", "MB/call");
+    }
+    std::printf("\n");
+}
+
+void print_row(size_t calls, const Window& window, const std::optional<ProcessSample>& before,
+               const std::optional<ProcessSample>& after, double baseline_rss, double wall_sec) {
+    std::printf("%6zu %6zu %8.0f %8.0f %8.0f %8.0f %8.0f %8llu %6llu %6llu %6llu %8llu", calls,
+                window.turn_ms.size(), percentile(window.turn_ms, 0.50),
+                percentile(window.turn_ms, 0.95), percentile(window.turn_ms, 0.99),
+                percentile(window.barge_ms, 0.50), percentile(window.barge_ms, 0.95),
+                static_cast<unsigned long long>(window.barge_missed),
+                static_cast<unsigned long long>(window.timeouts),
+                static_cast<unsigned long long>(window.calls_failed),
+                static_cast<unsigned long long>(window.rtp_lost),
+                static_cast<unsigned long long>(window.jbuf_empty));
+    if (before && after) {
+        const double cpu = 100.0 * (after->cpu_sec - before->cpu_sec) / wall_sec;
+        const double rss = after->rss_mb;
+        std::printf(" %7.1f %9.2f %8.1f %8.2f", cpu, cpu / static_cast<double>(calls), rss,
+                    (rss - baseline_rss) / static_cast<double>(calls));
+    }
+    std::printf("\n");
+    std::fflush(stdout);
+}
+
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::fprintf(stderr,
+                     "usage: %s <sip:gateway-uri> [--calls N] [--step N] [--step-sec S] "
+                     "[--barge-in-ms MS] [--gateway-pid PID] [--threads N] <utterance.wav>...\n",
+                     argv[0]);
+        return 2;
+    }
+    Options options;
+    options.uri = argv[1];
+    Script script;
+    for (int i = 2; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--calls" && has_value) {
+            options.calls = std::max<size_t>(1, std::stoul(argv[++i]));
+        } else if (arg == "--step" && has_value) {
+            options.step = std::max<size_t>(1, std::stoul(argv[++i]));
+        } else if (arg == "--step-sec" && has_value) {
+            options.step_sec = std::max(1.0, std::atof(argv[++i]));
+        } else if (arg == "--barge-in-ms" && has_value) {
+            options.barge_in_ms = std::atol(argv[++i]);
+        } else if (arg == "--gateway-pid" && has_value) {
+            options.gateway_pid = std::atoi(argv[++i]);
+        } else if (arg == "--threads" && has_value) {
+            options.threads = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+        } else {
+            std::vector<int16_t> samples;
+            unsigned sample_rate = 0;
+            if (!read_wav(arg, samples, sample_rate) || sample_rate != kClockRate) {
+                std::fprintf(stderr, "%s: not a mono PCM16 WAV at 16 kHz\n", argv[i]);
+                return 1;
+            }
+            script.push_back(std::move(samples));
+        }
+    }
+    if (script.empty()) {
+        std::fprintf(stderr, "no utterances given\n");
+        return 2;
+    }
+
+    pj::Endpoint endpoint;
+    endpoint.libCreate();
+    pj::EpConfig ep_cfg;
+    ep_cfg.uaConfig.maxCalls = static_cast<unsigned>(options.calls);
+    ep_cfg.medConfig.clockRate = kClockRate;
+    ep_cfg.medConfig.sndClockRate = kClockRate;
+    ep_cfg.medConfig.threadCnt = options.threads;
+    ep_cfg.medConfig.ecTailLen = 0;
+    ep_cfg.medConfig.noVad = true;
+    ep_cfg.logConfig.level = 1;
+    ep_cfg.logConfig.consoleLevel = 1;
+    endpoint.libInit(ep_cfg);
+    endpoint.audDevManager().setNullDev();
+    pj::TransportConfig tp_cfg;
+    tp_cfg.port = 0;
+    endpoint.transportCreate(PJSIP_TRANSPORT_UDP, tp_cfg);
+    endpoint.libStart();
+
+    pj::Account account;
+    pj::AccountConfig account_cfg;
+    account_cfg.idUri = "sip:loadtest@127.0.0.1";
+    account.create(account_cfg);
+
+    Results results;
+    std::list<std::unique_ptr<LoadCall>> calls;
+    const bool sample = options.gateway_pid > 0;
+    const auto baseline = sample_process(options.gateway_pid);
+    if (sample && !baseline) {
+        std::fprintf(stderr, "cannot read /proc/%d\n", options.gateway_pid);
+        return 1;
+    }
+    print_header(sample);
+
+    size_t target = std::min(options.step, options.calls);
+    auto step_start = Clock::now();
+    auto step_sample = baseline;
+    bool last_step = target == options.calls;
+    while (true) {
+        for (auto it = calls.begin(); it != calls.end();) {
+            auto& call = **it;
+            if (call.disconnected()) {
+                it = calls.erase(it);
+                continue;
+            }
+            if (call.finished()) {
+                call.hang_up();
+            }
+            ++it;
+        }
+        while (calls.size() < target) {
+            auto call = std::make_unique<LoadCall>(account, script, options, results);
+            try {
+                pj::CallOpParam prm(true);
+                call->makeCall(options.uri, prm);
+                calls.push_back(std::move(call));
+            } catch (const pj::Error& ex) {
+                std::fprintf(stderr, "makeCall failed: %s\n", ex.info().c_str());
+                results.call_ended(false, 0, 0);
+                break;
+            }
+        }
+
+        const auto now = Clock::now();
+        const double elapsed = std::chrono::duration<double>(now - step_start).count();
+        if (elapsed >= options.step_sec) {
+            const auto now_sample = sample_process(options.gateway_pid);
+            print_row(target, results.take(), step_sample, now_sample,
+                      baseline ? baseline->rss_mb : 0.0, elapsed);
+            if (last_step) {
+                break;
+            }
+            target = std::min(target + options.step, options.calls);
+            // One full step at the top before stopping.
+            last_step = target == options.calls;
+            step_start = now;
+            step_sample = now_sample;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+
+    for (auto& call : calls) {
+        call->hang_up();
+    }
+    const auto deadline = Clock::now() + std::chrono::seconds(5);
+    while (Clock::now() < deadline &&
+           std::any_of(calls.begin(), calls.end(),
+                       [](const std::unique_ptr<LoadCall>& call) { return !call->disconnected(); })) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    calls.clear();
+    account.shutdown();
+    endpoint.libDestroy();
+    return 0;
+}
@@ -0,0 +1,435 @@
+// Stand-in bot backend for load tests. It serves the parts of
+// docs/backend_api.md the gateway uses: sessions, /transcribe, /synthesize,
+// /start, /commit, /rollback and the per-session WebSocket. HTTP and
+// WebSocket share one port, as they do on the real backend, and every
+// endpoint answers after a delay drawn from its own latency distribution.
+//
+// usage: sip_gateway_mock_backend [--port 8000] [--threads 4]
+//            [--latency ENDPOINT=SPEC]... [--greeting TEXT] [--reply TEXT]
+//            [--transcript TEXT] [--reply-parts N] [--ms-per-char N]
+//
+// ENDPOINT is session, transcribe, synthesize, start, commit, rollback,
+// first_message (from /start to the first WebSocket message) or
+// next_message (between the parts of a streamed reply). SPEC is MS for a
+// fixed delay, LOW-HIGH for a uniform one or MEDIAN:P99 for a log-normal
+// one, all in milliseconds. /synthesize returns a tone lasting MS_PER_CHAR
+// per character of text.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+#include <websocketpp/config/asio_no_tls.hpp>
+#include <websocketpp/server.hpp>
+
+#include "sip_gateway/audio/wav.hpp"
+
+namespace {
+
+using Server = websocketpp::server<websocketpp::config::asio>;
+
+constexpr uint32_t kSampleRate = 16000;
+constexpr double kPi = 3.14159265358979323846;
+constexpr double kToneHz = 440.0;
+
+class Latency {
+public:
+    Latency() = default;
+
+    // MS, LOW-HIGH or MEDIAN:P99.
+    static bool parse(const std::string& spec, Latency& latency) {
+        char* end = nullptr;
+        const double first = std::strtod(spec.c_str(), &end);
+        if (end == spec.c_str() || first < 0.0) {
+            return false;
+        }
+        if (*end == '\0') {
+            latency = Latency{Kind::Fixed, first, first};
+            return true;
+        }
+        const char separator = *end;
+        const char* rest = end + 1;
+        const double second = std::strtod(rest, &end);
+        if (end == rest || *end != '\0' || second < first) {
+            return false;
+        }
+        if (separator == '-') {
+            latency = Latency{Kind::Uniform, first, second};
+            return true;
+        }
+        if (separator == ':' && first > 0.0) {
+            latency = Latency{Kind::LogNormal, first, second};
+            return true;
+        }
+        return false;
+    }
+
+    long sample_ms() const {
+        thread_local std::mt19937 rng{std::random_device{}()};
+        switch (kind_) {
+            case Kind::Fixed:
+                return std::lround(low_);
+            case Kind::Uniform:
+                return std::lround(std::uniform_real_distribution<double>(low_, high_)(rng));
+            case Kind::LogNormal: {
+                // 2.326 is the standard normal's 99th percentile.
+                const double sigma = std::log(high_ / low_) / 2.326;
+                return std::lround(std::lognormal_distribution<double>(std::log(low_), sigma)(rng));
+            }
+        }
+        return 0;
+    }
+
+private:
+    enum class Kind { Fixed, Uniform, LogNormal };
+
+    Latency(Kind kind, double low, double high) : kind_(kind), low_(low), high_(high) {}
+
+    Kind kind_ = Kind::Fixed;
+    double low_ = 0.0;
+    double high_ = 0.0;
+};
+
+struct Options {
+    uint16_t port = 8000;
+    size_t threads = 4;
+    std::map<std::string, Latency> latency;
+    std::string greeting = "Hello, how can I help you today?";
+    std::string reply = "Thanks, I have noted that. Is there anything else I can help you with?";
+    std::string transcript = "I would like to check my appointment";
+    size_t reply_parts = 2;
+    unsigned ms_per_char = 60;
+};
+
+// Query values are URL-encoded; a %XX escape is one character.
+size_t decoded_length(const std::string& value) {
+    size_t length = 0;
+    for (size_t i = 0; i < value.size(); ++i, ++length) {
+        if (value[i] == '%' && i + 2 < value.size()) {
+            i += 2;
+        }
+    }
+    return length;
+}
+
+std::string query_value(const std::string& query, const std::string& key) {
+    std::istringstream in(query);
+    std::string pair;
+    while (std::getline(in, pair, '&')) {
+        if (pair.compare(0, key.size() + 1, key + "=") == 0) {
+            return pair.substr(key.size() + 1);
+        }
+    }
+    return "";
+}
+
+std::vector<std::string> split_words(const std::string& text, size_t parts) {
+    std::vector<std::string> words;
+    std::istringstream in(text);
+    for (std::string word; in >> word;) {
+        words.push_back(word);
+    }
+    parts = std::max<size_t>(1, std::min(parts, words.size()));
+    std::vector<std::string> result(parts);
+    for (size_t i = 0; i < words.size(); ++i) {
+        auto& part = result[i * parts / words.size()];
+        part += part.empty() ? words[i] : " " + words[i];
+    }
+    return result;
+}
+
+class MockBackend {
+public:
+    explicit MockBackend(Options options)
+        : options_(std::move(options)),
+          reply_parts_(split_words(options_.reply, options_.reply_parts)) {
+        server_.clear_access_channels(websocketpp::log::alevel::all);
+        server_.clear_error_channels(websocketpp::log::elevel::all);
+        server_.init_asio();
+        server_.set_reuse_addr(true);
+        server_.set_http_handler([this](websocketpp::connection_hdl hdl) { on_http(hdl); });
+        server_.set_open_handler([this](websocketpp::connection_hdl hdl) { on_ws(hdl, true); });
+        server_.set_close_handler([this](websocketpp::connection_hdl hdl) { on_ws(hdl, false); });
+    }
+
+    void run() {
+        server_.listen(options_.port);
+        server_.start_accept();
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < options_.threads; ++i) {
+            threads.emplace_back([this]() { server_.run(); });
+        }
+        server_.run();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+private:
+    struct Session {
+        websocketpp::connection_hdl ws;
+        // Bumped by /start and /rollback; a streamed reply stops once its
+        // generation is stale.
+        uint64_t generation = 0;
+    };
+
+    void on_http(websocketpp::connection_hdl hdl) {
+        auto con = server_.get_con_from_hdl(hdl);
+        const auto& resource = con->get_resource();
+        const auto query_start = resource.find('?');
+        const auto path = resource.substr(0, query_start);
+        const auto query = query_start == std::string::npos ? "" : resource.substr(query_start + 1);
+        const auto& method = con->get_request().get_method();
+
+        std::vector<std::string> parts;
+        std::istringstream in(path);
+        for (std::string part; std::getline(in, part, '/');) {
+            if (!part.empty()) {
+                parts.push_back(part);
+            }
+        }
+        const auto is = [&parts](std::initializer_list<const char*> expected) {
+            if (parts.size() != expected.size()) {
+                return false;
+            }
+            size_t i = 0;
+            for (const char* part : expected) {
+                if (part && parts[i] != part) {
+                    return false;
+                }
+                ++i;
+            }
+            return true;
+        };
+
+        if (method == "POST" && (is({"session_v2"}) || is({"session"}))) {
+            const auto session_id = "mock-" + std::to_string(++next_session_);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                sessions_[session_id];
+            }
+            nlohmann::json body{{"session", {{"session_id", session_id}}}};
+            if (!options_.greeting.empty()) {
+                body["greeting"] = options_.greeting;
+            }
+            respond(con, "session", body.dump());
+        } else if (method == "DELETE" && is({"session", nullptr})) {
+            websocketpp::connection_hdl ws;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto it = sessions_.find(parts[1]);
+                if (it != sessions_.end()) {
+                    ws = it->second.ws;
+                    sessions_.erase(it);
+                }
+            }
+            if (!ws.expired()) {
+                websocketpp::lib::error_code ec;
+                server_.close(ws, websocketpp::close::status::going_away, "session closed", ec);
+            }
+            respond(con, "", "{}");
+        } else if (method == "POST" && is({"session", nullptr, "start"})) {
+            const auto generation = bump_generation(parts[1]);
+            respond(con, "start", "{}");
+            schedule_reply(parts[1], generation, 0, latency("first_message"));
+        } else if (method == "POST" && is({"session", nullptr, "commit"})) {
+            respond(con, "commit", nlohmann::json{{"response", options_.reply}}.dump());
+        } else if (method == "POST" && is({"session", nullptr, "rollback"})) {
+            bump_generation(parts[1]);
+            respond(con, "rollback", "{}");
+        } else if (method == "GET" && (is({"synthesize"}) || is({"session", nullptr, "synthesize"}))) {
+            respond(con, "synthesize", tone(decoded_length(query_value(query, "text"))), "audio/wav");
+        } else if (method == "POST" && is({"transcribe"})) {
+            respond(con, "transcribe", nlohmann::json{{"text", options_.transcript}}.dump());
+        } else if (method == "GET" && is({"capabilities"})) {
+            respond(con, "", "{}");
+        } else if (method == "PUT" && is({"cluster", "nodes", nullptr})) {
+            auto record = nlohmann::json::parse(con->get_request_body(), nullptr, false);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (record.is_object()) {
+                    cluster_nodes_[parts[2]] = std::move(record);
+                }
+            }
+            respond(con, "", "{}");
+        } else if (method == "DELETE" && is({"cluster", "nodes", nullptr})) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                cluster_nodes_.erase(parts[2]);
+            }
+            respond(con, "", "{}");
+        } else if (method == "GET" && is({"cluster", "sessions", nullptr})) {
+            // Record TTLs are not enforced; a gateway that stops cleanly
+            // removes its node.
+            nlohmann::json owner;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                for (const auto& [node_id, record] : cluster_nodes_) {
+                    const auto& node_sessions = record.value("sessions", nlohmann::json::array());
+                    if (std::find(node_sessions.begin(), node_sessions.end(), parts[2]) !=
+                        node_sessions.end()) {
+                        owner = {{"node_id", node_id}, {"url", record.value("url", "")}};
+                        break;
+                    }
+                }
+            }
+            if (owner.is_null()) {
+                owner = {{"node_id", nullptr}};
+            }
+            respond(con, "", owner.dump());
+        } else if (method == "POST" || method == "PUT") {
+            // run, command, waiting_message and the rest are not measured.
+            respond(con, "", "{}");
+        } else {
+            respond(con, "", nlohmann::json{{"message", "not found"}}.dump(), "application/json",
+                    websocketpp::http::status_code::not_found);
+        }
+    }
+
+    void on_ws(websocketpp::connection_hdl hdl, bool open) {
+        const auto& resource = server_.get_con_from_hdl(hdl)->get_resource();
+        if (resource.compare(0, 4, "/ws/") != 0) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = sessions_.find(resource.substr(4));
+        if (it != sessions_.end()) {
+            it->second.ws = open ? hdl : websocketpp::connection_hdl{};
+        }
+    }
+
+    long latency(const std::string& endpoint) const {
+        auto it = options_.latency.find(endpoint);
+        return it == options_.latency.end() ? 0 : it->second.sample_ms();
+    }
+
+    void respond(const Server::connection_ptr& con,
+                 const std::string& endpoint,
+                 std::string body,
+                 const std::string& content_type = "application/json",
+                 websocketpp::http::status_code::value status = websocketpp::http::status_code::ok) {
+        con->defer_http_response();
+        server_.set_timer(latency(endpoint), [con, body = std::move(body), content_type, status](
+                                                 const websocketpp::lib::error_code&) {
+            con->set_status(status);
+            con->append_header("Content-Type", content_type);
+            con->set_body(body);
+            websocketpp::lib::error_code ec;
+            con->send_http_response(ec);
+        });
+    }
+
+    uint64_t bump_generation(const std::string& session_id) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = sessions_.find(session_id);
+        return it == sessions_.end() ? 0 : ++it->second.generation;
+    }
+
+    // Sends reply part `index` after delay_ms, then schedules the next one,
+    // and ends the stream with eos.
+    void schedule_reply(const std::string& session_id, uint64_t generation, size_t index,
+                        long delay_ms) {
+        server_.set_timer(delay_ms, [this, session_id, generation, index](
+                                        const websocketpp::lib::error_code& error) {
+            if (error) {
+                return;
+            }
+            websocketpp::connection_hdl ws;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto it = sessions_.find(session_id);
+                if (it == sessions_.end() || it->second.generation != generation) {
+                    return;
+                }
+                ws = it->second.ws;
+            }
+            const bool last = index >= reply_parts_.size();
+            const auto frame = last ? nlohmann::json{{"type", "eos"}}
+                                    : nlohmann::json{{"type", "message"},
+                                                     {"message", reply_parts_[index]}};
+            websocketpp::lib::error_code ec;
+            server_.send(ws, frame.dump(), websocketpp::frame::opcode::text, ec);
+            if (!last && !ec) {
+                schedule_reply(session_id, generation, index + 1, latency("next_message"));
+            }
+        });
+    }
+
+    std::string tone(size_t characters) const {
+        const size_t samples = std::max<size_t>(
+            kSampleRate / 5, characters * options_.ms_per_char * kSampleRate / 1000);
+        const size_t fade = kSampleRate / 100;
+        std::vector<float> audio(samples);
+        for (size_t i = 0; i < samples; ++i) {
+            const double ramp = std::min({1.0, static_cast<double>(i) / fade,
+                                          static_cast<double>(samples - i) / fade});
+            audio[i] = static_cast<float>(
+                0.3 * ramp * std::sin(2.0 * kPi * kToneHz * static_cast<double>(i) / kSampleRate));
+        }
+        return sip_gateway::audio::encode_wav(audio, kSampleRate);
+    }
+
+    Options options_;
+    std::vector<std::string> reply_parts_;
+    Server server_;
+    std::mutex mutex_;
+    std::unordered_map<std::string, Session> sessions_;
+    // Cluster node records by node id (PUT /cluster/nodes/<id>).
+    std::unordered_map<std::string, nlohmann::json> cluster_nodes_;
+    std::atomic<uint64_t> next_session_{0};
+};
+
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::fprintf(stderr, "%s: missing value\n", arg.c_str());
+            return 2;
+        }
+        const std::string value = argv[++i];
+        if (arg == "--port") {
+            options.port = static_cast<uint16_t>(std::stoul(value));
+        } else if (arg == "--threads") {
+            options.threads = std::max<size_t>(1, std::stoul(value));
+        } else if (arg == "--latency") {
+            const auto eq = value.find('=');
+            Latency latency;
+            if (eq == std::string::npos || !Latency::parse(value.substr(eq + 1), latency)) {
+                std::fprintf(stderr, "--latency %s: expected ENDPOINT=SPEC\n", value.c_str());
+                return 2;
+            }
+            options.latency[value.substr(0, eq)] = latency;
+        } else if (arg == "--greeting") {
+            options.greeting = value;
+        } else if (arg == "--reply") {
+            options.reply = value;
+        } else if (arg == "--transcript") {
+            options.transcript = value;
+        } else if (arg == "--reply-parts") {
+            options.reply_parts = std::stoul(value);
+        } else if (arg == "--ms-per-char") {
+            options.ms_per_char = static_cast<unsigned>(std::stoul(value));
+        } else {
+            std::fprintf(stderr, "unknown option %s\n", arg.c_str());
+            return 2;
+        }
+    }
+    std::printf("mock backend on port %u\n", options.port);
+    std::fflush(stdout);
+    MockBackend(std::move(options)).run();
+    return 0;
+}
@@ -0,0 +1,396 @@
+// Offline benchmark of the VAD path. Every WAV file is streamed through a
+// StreamingVadProcessor as fast as it will go, one VAD window per call, and
+// the run reports the real-time factor, per-window latency, allocations per
+// window and the events raised. With --calls N, N threads stream the corpus
+// at once through one shared VadModel, as concurrent calls do. Finally it
+// times the smaller per-frame and per-turn helpers.
+//
+// usage: sip_gateway_pipeline_bench <silero_vad.onnx> [--calls N]
+//            [--baseline FILE | --write-baseline FILE] <mono16.wav>...
+//
+// A baseline stores the real-time factor and every file's events. Against
+// one, the run fails when the real-time factor is more than 25% worse or
+// any file's events changed by more than 50 ms.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sip_gateway/audio/pcm_stream.hpp"
+#include "sip_gateway/audio/wav.hpp"
+#include "sip_gateway/config.hpp"
+#include "sip_gateway/utils/text.hpp"
+#include "sip_gateway/vad/correction.hpp"
+#include "sip_gateway/vad/model.hpp"
+#include "sip_gateway/vad/processor.hpp"
+
+namespace {
+
+using sip_gateway::vad::StreamingVadProcessor;
+using sip_gateway::vad::VadModel;
+
+constexpr double kRtfTolerance = 1.25;
+constexpr double kEventTolerance = 0.05;
+
+std::atomic<uint64_t> allocation_count{0};
+
+// Keeps results alive so the optimizer cannot drop the measured loop.
+volatile double sink = 0.0;
+
+struct Event {
+    char kind; // S(peech start), E(nd), s(hort pause), L(ong pause)
+    double start;
+    double end;
+};
+
+struct File {
+    std::string name;
+    std::vector<int16_t> samples;
+    unsigned sample_rate = 0;
+};
+
+struct Run {
+    std::map<std::string, std::vector<Event>> events;
+    std::vector<double> latencies_us;
+    double audio_sec = 0.0;
+    double busy_sec = 0.0;
+    uint64_t windows = 0;
+    uint64_t allocations = 0;
+};
+
+struct Baseline {
+    double rtf = 0.0;
+    std::map<std::string, std::vector<Event>> events;
+};
+
+bool read_wav(const std::string& path, std::vector<int16_t>& samples, unsigned& sample_rate) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    const std::string bytes{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    sip_gateway::audio::PcmStream stream(std::chrono::milliseconds(0));
+    stream.write(bytes.data(), bytes.size());
+    stream.finish();
+    if (stream.failed()) {
+        return false;
+    }
+    samples.resize(stream.total_samples());
+    samples.resize(stream.read(samples.data(), samples.size()));
+    sample_rate = stream.sample_rate();
+    return true;
+}
+
+std::unique_ptr<StreamingVadProcessor> make_processor(
+    const std::shared_ptr<VadModel>& model, const sip_gateway::Config& config, int sample_rate) {
+    return std::make_unique<StreamingVadProcessor>(
+        model,
+        sample_rate,
+        static_cast<float>(config.vad_threshold),
+        config.vad_min_speech_duration_ms,
+        config.vad_min_silence_duration_ms,
+        config.vad_speech_pad_ms,
+        config.short_pause_offset_ms,
+        config.long_pause_offset_ms,
+        config.user_silence_timeout_ms,
+        config.vad_max_utterance_ms,
+        config.vad_speech_prob_window,
+        config.vad_use_dynamic_corrections,
+        false,
+        config.vad_correction_enter_thres,
+        config.vad_correction_exit_thres);
+}
+
+// One simulated call: the whole corpus in order.
+Run stream_corpus(const std::shared_ptr<VadModel>& model,
+                  const sip_gateway::Config& config,
+                  const std::vector<File>& files) {
+    Run run;
+    for (const auto& file : files) {
+        auto processor = make_processor(model, config, static_cast<int>(file.sample_rate));
+        auto& events = run.events[file.name];
+        auto record = [&events](char kind) {
+            return [&events, kind](const sip_gateway::audio::AudioSegment&, double start,
+                                   double duration) {
+                events.push_back({kind, start, start + duration});
+            };
+        };
+        processor->set_on_speech_start(record('S'));
+        processor->set_on_speech_end(record('E'));
+        processor->set_on_short_pause(record('s'));
+        processor->set_on_long_pause(record('L'));
+
+        const size_t window = VadModel::window_size_for(static_cast<int>(file.sample_rate));
+        const size_t windows = file.samples.size() / window;
+        run.latencies_us.reserve(run.latencies_us.size() + windows + 1);
+        const uint64_t allocations_before = allocation_count.load();
+        for (size_t offset = 0; offset < file.samples.size(); offset += window) {
+            const auto started = std::chrono::steady_clock::now();
+            processor->process_samples(file.samples.data() + offset,
+                                       std::min(window, file.samples.size() - offset));
+            const double elapsed = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - started).count();
+            run.latencies_us.push_back(elapsed * 1e6);
+            run.busy_sec += elapsed;
+        }
+        processor->finalize();
+        run.allocations += allocation_count.load() - allocations_before;
+        run.windows += windows;
+        run.audio_sec += static_cast<double>(file.samples.size()) / file.sample_rate;
+    }
+    return run;
+}
+
+double percentile(std::vector<double>& values, double quantile) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    const auto index = std::min(values.size() - 1,
+                                static_cast<size_t>(quantile * static_cast<double>(values.size())));
+    std::nth_element(values.begin(), values.begin() + static_cast<long>(index), values.end());
+    return values[index];
+}
+
+bool read_baseline(const std::string& path, Baseline& baseline) {
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream in(line);
+        std::string key;
+        in >> key;
+        if (key == "rtf") {
+            in >> baseline.rtf;
+        } else if (key == "event") {
+            std::string name;
+            Event event{};
+            in >> name >> event.kind >> event.start >> event.end;
+            baseline.events[name].push_back(event);
+        }
+    }
+    return baseline.rtf > 0.0;
+}
+
+bool write_baseline(const std::string& path, double rtf, const Run& run) {
+    std::ofstream file(path);
+    if (!file) {
+        return false;
+    }
+    file << "rtf " << rtf << "\n";
+    for (const auto& [name, events] : run.events) {
+        for (const auto& event : events) {
+            file << "event " << name << " " << event.kind << " " << event.start << " "
+                 << event.end << "\n";
+        }
+    }
+    return static_cast<bool>(file);
+}
+
+bool same_events(const std::vector<Event>& expected, const std::vector<Event>& actual) {
+    if (expected.size() != actual.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < expected.size(); ++i) {
+        if (expected[i].kind != actual[i].kind ||
+            std::abs(expected[i].start - actual[i].start) > kEventTolerance ||
+            std::abs(expected[i].end - actual[i].end) > kEventTolerance) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename Fn>
+double ns_per_call(size_t iterations, Fn&& fn) {
+    for (size_t i = 0; i < iterations / 16 + 1; ++i) {
+        fn(i);
+    }
+    const auto started = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        fn(i);
+    }
+    return std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - started).count() / static_cast<double>(iterations);
+}
+
+void run_microbenchmarks() {
+    std::vector<float> second(16000);
+    for (size_t i = 0; i < second.size(); ++i) {
+        second[i] = static_cast<float>(0.3 * std::sin(static_cast<double>(i) * 0.0863));
+    }
+    const std::string reply =
+        "Sure \xF0\x9F\x98\x80, your appointment is on Tuesday at 3:30 p.m. \xE2\x9C\x85 "
+        "Is there anything else I can help you with today?";
+    sip_gateway::vad::DynamicCorrection correction;
+    correction.start_early_detection();
+
+    std::printf("\n%-34s %12s\n", "microbenchmark", "ns/call");
+    std::printf("%-34s %12.0f\n", "encode_wav (1 s at 16 kHz)", ns_per_call(200, [&](size_t) {
+        sink = sink + static_cast<double>(sip_gateway::audio::encode_wav(second, 16000).size());
+    }));
+    std::printf("%-34s %12.0f\n", "utils::normalize_text", ns_per_call(20000, [&](size_t) {
+        sink = sink + static_cast<double>(sip_gateway::utils::normalize_text(reply).size());
+    }));
+    std::printf("%-34s %12.0f\n", "utils::remove_emojis", ns_per_call(20000, [&](size_t) {
+        sink = sink + static_cast<double>(sip_gateway::utils::remove_emojis(reply).size());
+    }));
+    std::printf("%-34s %12.0f\n", "DynamicCorrection::process_frame",
+                ns_per_call(200000, [&](size_t i) {
+                    // A slow speech/silence cycle with matching energy.
+                    const double phase = static_cast<double>(i % 200) / 200.0;
+                    const double prob = phase < 0.5 ? 0.8 : 0.1;
+                    sink = sink + (correction.process_frame(prob, prob * 0.05) ? 1.0 : 0.0);
+                }));
+}
+
+}
+
+void* operator new(size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr,
+                     "usage: %s <silero_vad.onnx> [--calls N] "
+                     "[--baseline FILE | --write-baseline FILE] <mono16.wav>...\n",
+                     argv[0]);
+        return 2;
+    }
+    size_t calls = 1;
+    std::string baseline_path;
+    std::string write_path;
+    std::vector<File> files;
+    for (int i = 2; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--calls" && i + 1 < argc) {
+            calls = std::max<size_t>(1, std::stoul(argv[++i]));
+        } else if (arg == "--baseline" && i + 1 < argc) {
+            baseline_path = argv[++i];
+        } else if (arg == "--write-baseline" && i + 1 < argc) {
+            write_path = argv[++i];
+        } else {
+            File file;
+            file.name = arg.substr(arg.find_last_of('/') + 1);
+            if (!read_wav(arg, file.samples, file.sample_rate) ||
+                !VadModel::supports_sampling_rate(static_cast<int>(file.sample_rate))) {
+                std::fprintf(stderr, "%s: not a mono PCM16 WAV at 8 or 16 kHz\n", argv[i]);
+                return 1;
+            }
+            files.push_back(std::move(file));
+        }
+    }
+
+    int status = 0;
+    if (!files.empty()) {
+        const sip_gateway::Config config;
+        // The per-call rate is passed to the processor, so one model serves
+        // both rates.
+        auto model = std::make_shared<VadModel>(argv[1], 16000);
+        std::vector<Run> runs(calls);
+        std::vector<std::thread> threads;
+        const auto started = std::chrono::steady_clock::now();
+        for (size_t c = 0; c < calls; ++c) {
+            threads.emplace_back([&, c]() { runs[c] = stream_corpus(model, config, files); });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        const double wall_sec =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+        Run total;
+        for (auto& run : runs) {
+            total.latencies_us.insert(total.latencies_us.end(), run.latencies_us.begin(),
+                                      run.latencies_us.end());
+            total.audio_sec += run.audio_sec;
+            total.busy_sec += run.busy_sec;
+            total.windows += run.windows;
+            total.allocations += run.allocations;
+        }
+        total.events = runs.front().events;
+        // Processing time per second of audio, for one call; below 1 keeps up.
+        const double rtf = total.busy_sec / total.audio_sec;
+
+        std::printf("%zu files, %.1f s of audio, %zu concurrent call(s)\n", files.size(),
+                    runs.front().audio_sec, calls);
+        std::printf("real-time factor %.4f per call, %.1fx real time across calls\n", rtf,
+                    total.audio_sec / wall_sec);
+        std::printf("per window p50 %.1f us  p95 %.1f us  p99 %.1f us  max %.1f us\n",
+                    percentile(total.latencies_us, 0.50), percentile(total.latencies_us, 0.95),
+                    percentile(total.latencies_us, 0.99), percentile(total.latencies_us, 1.0));
+        std::printf("allocations per window %.2f\n",
+                    total.windows ? static_cast<double>(total.allocations) / total.windows : 0.0);
+
+        std::printf("\n%-32s %6s %6s %6s %6s %10s\n", "file", "start", "end", "short", "long",
+                    "first end");
+        for (const auto& [name, events] : total.events) {
+            std::map<char, size_t> counts;
+            double first_end = -1.0;
+            for (const auto& event : events) {
+                ++counts[event.kind];
+                if (event.kind == 'E' && first_end < 0.0) {
+                    first_end = event.start;
+                }
+            }
+            std::printf("%-32s %6zu %6zu %6zu %6zu %9.3fs\n",
+                        name.substr(name.size() > 32 ? name.size() - 32 : 0).c_str(),
+                        counts['S'], counts['E'], counts['s'], counts['L'], first_end);
+        }
+
+        if (!write_path.empty()) {
+            if (!write_baseline(write_path, rtf, total)) {
+                std::fprintf(stderr, "%s: cannot write baseline\n", write_path.c_str());
+                return 1;
+            }
+            std::printf("\nbaseline written to %s\n", write_path.c_str());
+        } else if (!baseline_path.empty()) {
+            Baseline baseline;
+            if (!read_baseline(baseline_path, baseline)) {
+                std::fprintf(stderr, "%s: cannot read baseline\n", baseline_path.c_str());
+                return 1;
+            }
+            std::printf("\nbaseline real-time factor %.4f (%+.1f%%)\n", baseline.rtf,
+                        100.0 * (rtf / baseline.rtf - 1.0));
+            if (rtf > baseline.rtf * kRtfTolerance) {
+                std::printf("REGRESSION: real-time factor\n");
+                status = 1;
+            }
+            for (const auto& [name, events] : total.events) {
+                if (!same_events(baseline.events[name], events)) {
+                    std::printf("CHANGED: events of %s\n", name.c_str());
+                    status = 1;
+                }
+            }
+        }
+    }
+
+    run_microbenchmarks();
+    return status;
+}
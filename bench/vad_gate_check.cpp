@@ -0,0 +1,174 @@
+// Offline accuracy check for the VAD energy gate. It runs every WAV file
+// through two StreamingVadProcessors with the gateway's default settings,
+// one with the gate enabled, and compares the events they report.
+//
+// usage: sip_gateway_vad_gate_check <silero_vad.onnx> <mono16.wav>...
+//
+// VAD_ENERGY_GATE_RATIO, VAD_ENERGY_GATE_MAX_RMS, VAD_ENERGY_GATE_WINDOWS and
+// VAD_ENERGY_GATE_RESET override the gate settings.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "sip_gateway/audio/pcm_stream.hpp"
+#include "sip_gateway/config.hpp"
+#include "sip_gateway/vad/model.hpp"
+#include "sip_gateway/vad/processor.hpp"
+
+namespace {
+
+using sip_gateway::vad::StreamingVadProcessor;
+
+struct Event {
+    char kind; // S(peech start), E(nd), s(hort pause), L(ong pause)
+    double start;
+    double end;
+};
+
+struct Run {
+    std::vector<Event> events;
+    uint64_t windows = 0;
+    uint64_t skipped = 0;
+};
+
+double env_double(const char* name, double fallback) {
+    const char* value = std::getenv(name);
+    return value && *value ? std::atof(value) : fallback;
+}
+
+bool read_wav(const std::string& path, std::vector<int16_t>& samples, unsigned& sample_rate) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    const std::string bytes{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    sip_gateway::audio::PcmStream stream(std::chrono::milliseconds(0));
+    stream.write(bytes.data(), bytes.size());
+    stream.finish();
+    if (stream.failed()) {
+        return false;
+    }
+    samples.resize(stream.total_samples());
+    samples.resize(stream.read(samples.data(), samples.size()));
+    sample_rate = stream.sample_rate();
+    return true;
+}
+
+Run run(const std::shared_ptr<sip_gateway::vad::VadModel>& model,
+        const sip_gateway::Config& config,
+        const std::vector<int16_t>& samples,
+        const sip_gateway::vad::EnergyGateConfig* gate) {
+    StreamingVadProcessor processor(
+        model,
+        0,
+        static_cast<float>(config.vad_threshold),
+        config.vad_min_speech_duration_ms,
+        config.vad_min_silence_duration_ms,
+        config.vad_speech_pad_ms,
+        config.short_pause_offset_ms,
+        config.long_pause_offset_ms,
+        config.user_silence_timeout_ms,
+        config.vad_max_utterance_ms,
+        config.vad_speech_prob_window,
+        config.vad_use_dynamic_corrections,
+        false,
+        config.vad_correction_enter_thres,
+        config.vad_correction_exit_thres);
+    if (gate) {
+        processor.set_energy_gate(*gate);
+    }
+    Run result;
+    auto record = [&result](char kind) {
+        return [&result, kind](const sip_gateway::audio::AudioSegment&, double start, double duration) {
+            result.events.push_back({kind, start, start + duration});
+        };
+    };
+    processor.set_on_speech_start(record('S'));
+    processor.set_on_speech_end(record('E'));
+    processor.set_on_short_pause(record('s'));
+    processor.set_on_long_pause(record('L'));
+    // 20 ms frames, as PJSUA delivers them.
+    const size_t frame = static_cast<size_t>(model->sampling_rate()) / 50;
+    for (size_t offset = 0; offset < samples.size(); offset += frame) {
+        processor.process_samples(samples.data() + offset, std::min(frame, samples.size() - offset));
+    }
+    processor.finalize();
+    result.windows = samples.size() /
+                     sip_gateway::vad::VadModel::window_size_for(model->sampling_rate());
+    result.skipped = processor.skipped_windows();
+    return result;
+}
+
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::fprintf(stderr, "usage: %s <silero_vad.onnx> <mono16.wav>...\n", argv[0]);
+        return 2;
+    }
+    sip_gateway::Config config;
+    sip_gateway::vad::EnergyGateConfig gate;
+    gate.floor_ratio = env_double("VAD_ENERGY_GATE_RATIO", config.vad_energy_gate_ratio);
+    gate.max_rms = env_double("VAD_ENERGY_GATE_MAX_RMS", config.vad_energy_gate_max_rms);
+    gate.hold_windows = static_cast<int>(
+        env_double("VAD_ENERGY_GATE_WINDOWS", config.vad_energy_gate_windows));
+    gate.reset_on_resume = env_double("VAD_ENERGY_GATE_RESET", config.vad_energy_gate_reset ? 1 : 0) != 0;
+
+    std::shared_ptr<sip_gateway::vad::VadModel> model;
+    uint64_t total_windows = 0;
+    uint64_t total_skipped = 0;
+    size_t mismatched_files = 0;
+    std::printf("%-32s %8s %8s %8s %10s %10s\n",
+                "file", "windows", "skipped", "events", "max dstart", "max dend");
+    for (int i = 2; i < argc; ++i) {
+        std::vector<int16_t> samples;
+        unsigned sample_rate = 0;
+        if (!read_wav(argv[i], samples, sample_rate)) {
+            std::fprintf(stderr, "%s: not a mono PCM16 WAV\n", argv[i]);
+            return 1;
+        }
+        if (!model || model->sampling_rate() != static_cast<int>(sample_rate)) {
+            model = std::make_shared<sip_gateway::vad::VadModel>(argv[1], static_cast<int>(sample_rate));
+        }
+        const auto full = run(model, config, samples, nullptr);
+        const auto gated = run(model, config, samples, &gate);
+        total_windows += full.windows;
+        total_skipped += gated.skipped;
+
+        bool same = full.events.size() == gated.events.size();
+        double max_start = 0.0;
+        double max_end = 0.0;
+        for (size_t k = 0; same && k < full.events.size(); ++k) {
+            same = full.events[k].kind == gated.events[k].kind;
+            max_start = std::max(max_start, std::abs(full.events[k].start - gated.events[k].start));
+            max_end = std::max(max_end, std::abs(full.events[k].end - gated.events[k].end));
+        }
+        if (!same) {
+            ++mismatched_files;
+        }
+        const std::string name = argv[i];
+        std::printf("%-32s %8llu %7.1f%% %3zu/%-4zu",
+                    name.substr(name.size() > 32 ? name.size() - 32 : 0).c_str(),
+                    static_cast<unsigned long long>(full.windows),
+                    full.windows ? 100.0 * gated.skipped / full.windows : 0.0,
+                    gated.events.size(), full.events.size());
+        if (same) {
+            std::printf(" %9.3fs %9.3fs\n", max_start, max_end);
+        } else {
+            std::printf(" %10s %10s\n", "differ", "differ");
+        }
+    }
+    std::printf("skipped %.1f%% of %llu windows; %zu of %d files changed events\n",
+                total_windows ? 100.0 * total_skipped / total_windows : 0.0,
+                static_cast<unsigned long long>(total_windows),
+                mismatched_files, argc - 2);
+    return mismatched_files == 0 ? 0 : 1;
+}
@@ -0,0 +1,125 @@
+// Per-window cost of VadModel inference: the allocating get_speech_prob path
+// against the preallocated VadModel::Stream path.
+//
+// usage: sip_gateway_bench <silero_vad.onnx> [windows] [sampling_rate]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "sip_gateway/vad/model.hpp"
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+std::atomic<uint64_t> allocation_count{0};
+
+struct Result {
+    double p50_us = 0.0;
+    double p99_us = 0.0;
+    double mean_us = 0.0;
+    double allocations_per_window = 0.0;
+};
+
+std::vector<float> make_window(size_t window_size, size_t index, int sampling_rate) {
+    std::vector<float> window(window_size);
+    for (size_t i = 0; i < window_size; ++i) {
+        const double t = static_cast<double>(index * window_size + i) / sampling_rate;
+        window[i] = static_cast<float>(0.3 * std::sin(2.0 * kPi * 220.0 * t));
+    }
+    return window;
+}
+
+Result measure(size_t windows, const std::function<void(size_t)>& run) {
+    std::vector<double> latencies;
+    latencies.reserve(windows);
+    // Warm up ORT's arena so only steady-state allocations are counted.
+    for (size_t i = 0; i < 16; ++i) {
+        run(i);
+    }
+    const uint64_t allocations_before = allocation_count.load();
+    for (size_t i = 0; i < windows; ++i) {
+        const auto started = std::chrono::steady_clock::now();
+        run(i);
+        latencies.push_back(std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - started).count());
+    }
+    // latencies was reserved up front, so only the measured path allocates.
+    const uint64_t allocations = allocation_count.load() - allocations_before;
+    Result result;
+    std::sort(latencies.begin(), latencies.end());
+    result.p50_us = latencies[latencies.size() / 2];
+    result.p99_us = latencies[std::min(latencies.size() - 1, latencies.size() * 99 / 100)];
+    double total = 0.0;
+    for (double value : latencies) {
+        total += value;
+    }
+    result.mean_us = total / static_cast<double>(latencies.size());
+    result.allocations_per_window = static_cast<double>(allocations) / static_cast<double>(windows);
+    return result;
+}
+
+void print(const char* name, const Result& result) {
+    std::printf("%-10s p50 %8.1f us  p99 %8.1f us  mean %8.1f us  allocs/window %6.2f\n",
+                name, result.p50_us, result.p99_us, result.mean_us,
+                result.allocations_per_window);
+}
+
+}
+
+void* operator new(size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s <silero_vad.onnx> [windows] [sampling_rate]\n", argv[0]);
+        return 2;
+    }
+    const size_t windows = argc > 2 ? std::stoul(argv[2]) : 5000;
+    const int sampling_rate = argc > 3 ? std::stoi(argv[3]) : 16000;
+    const size_t window_size = sip_gateway::vad::VadModel::window_size_for(sampling_rate);
+
+    sip_gateway::vad::VadModel model(argv[1], sampling_rate);
+    std::vector<std::vector<float>> inputs;
+    inputs.reserve(64);
+    for (size_t i = 0; i < 64; ++i) {
+        inputs.push_back(make_window(window_size, i, sampling_rate));
+    }
+
+    auto state = model.initialize_state();
+    const auto legacy = measure(windows, [&](size_t i) {
+        model.get_speech_prob(inputs[i % inputs.size()], &state);
+    });
+
+    auto stream = model.create_stream(window_size);
+    const auto bound = measure(windows, [&](size_t i) {
+        const auto& window = inputs[i % inputs.size()];
+        stream->get_speech_prob(window.data(), window.size());
+    });
+
+    std::printf("%zu windows of %zu samples at %d Hz\n", windows, window_size, sampling_rate);
+    print("vector", legacy);
+    print("stream", bound);
+    return 0;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace sip_gateway {
+namespace audio {
+
+// Single-producer/single-consumer ring of fixed-size PCM frame slots. All
+// storage is allocated up front; push and pop never allocate or lock.
+class FrameRing {
+public:
+    FrameRing(size_t slots, size_t slot_samples);
+
+    FrameRing(const FrameRing&) = delete;
+    FrameRing& operator=(const FrameRing&) = delete;
+
+    size_t capacity() const;
+    size_t slot_samples() const;
+    size_t size() const;
+
+    // Producer side. Returns false when the ring is full or the frame does
+    // not fit in a slot.
+    bool push(const int16_t* samples, size_t count);
+
+    // Consumer side. The view stays valid until pop().
+    bool front(const int16_t*& samples, size_t& count) const;
+    void pop();
+
+private:
+    size_t slots_;
+    size_t slot_samples_;
+    std::vector<int16_t> storage_;
+    std::vector<size_t> lengths_;
+    alignas(64) std::atomic<size_t> head_{0}; // Next slot to read.
+    alignas(64) std::atomic<size_t> tail_{0}; // Next slot to write.
+};
+
+}
+}
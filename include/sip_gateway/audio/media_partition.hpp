@@ -0,0 +1,116 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <pjsua2.hpp>
+
+#include "sip_gateway/metrics.hpp"
+
+namespace sip_gateway {
+namespace audio {
+
+struct MediaPartitionOptions {
+    size_t partitions = 2;
+    unsigned clock_rate = 16000;
+    unsigned ptime_ms = 20;
+    // Bridge slots per partition.
+    unsigned max_ports = 256;
+    // VAD_NARROWBAND: as many partitions again clocked at 8 kHz, so an
+    // 8 kHz codec stream reaches the call's 8 kHz media port without being
+    // resampled up to clock_rate and back down.
+    bool narrowband = false;
+};
+
+// A conference bridge of its own, clocked by its own thread. Calls moved
+// here do not share a tick with calls on other partitions or on the pjsua
+// bridge. Ports are added by pointer and never registered with pjsua; their
+// onFrameReceived()/onFrameRequested() run on this partition's clock thread.
+// Slot numbers are this bridge's, not pjsua's. Methods throw
+// std::runtime_error when the bridge refuses; all are thread safe.
+class MediaPartition {
+public:
+    MediaPartition(size_t index, const MediaPartitionOptions& options);
+    ~MediaPartition();
+
+    MediaPartition(const MediaPartition&) = delete;
+    MediaPartition& operator=(const MediaPartition&) = delete;
+
+    size_t index() const;
+    size_t calls() const;
+    unsigned clock_rate() const;
+
+    // Moves a call's codec stream port here. Returns the silent stand-in to
+    // hand pjsua in its place; pjsua owns and destroys it.
+    pjmedia_port* add_stream(pjmedia_port* stream, const std::string& name, int& slot);
+    void remove_stream(int slot);
+
+    int add_port(pj::AudioMediaPort& port,
+                 const pj::MediaFormatAudio& format,
+                 const std::string& name);
+    // A port owned elsewhere, such as a pjsua file player.
+    int add_port(pjmedia_port* port, const std::string& name);
+    // Once this returns no frame reaches the port, which may be destroyed.
+    void remove_port(int slot);
+
+    void connect(int source, int sink);
+
+    // Stops the clock and the bridge. Later calls do nothing; pjsua must
+    // still be up.
+    void shutdown();
+
+private:
+    struct Port;
+
+    static pj_status_t clock_get_frame(pjmedia_port* port, pjmedia_frame* frame);
+    static pj_status_t clock_put_frame(pjmedia_port* port, pjmedia_frame* frame);
+
+    int add_locked(std::unique_ptr<Port> port);
+    // Ports leave the bridge on its next tick; they are freed after that.
+    void retire_locked(int slot);
+    void sweep_locked(std::chrono::steady_clock::time_point now);
+    void tick();
+
+    size_t index_;
+    MediaPartitionOptions options_;
+    mutable std::mutex mutex_;
+    bool stopped_ = false;
+    pj_pool_t* pool_ = nullptr;
+    pjmedia_conf* conf_ = nullptr;
+    pjmedia_master_port* master_ = nullptr;
+    pjmedia_port clock_port_{};
+    std::string clock_name_;
+    std::unordered_map<int, std::unique_ptr<Port>> ports_;
+    std::vector<std::unique_ptr<Port>> retired_;
+    size_t streams_ = 0;
+    int64_t last_tick_ns_ = 0; // Clock thread only.
+    int64_t frame_time_ns_;
+    Metrics::Histogram& lateness_;
+    Metrics::Gauge& calls_gauge_;
+};
+
+// The partitions of MEDIA_PARTITIONS. Started after the pjsua endpoint and
+// shut down before it.
+class MediaPartitionPool {
+public:
+    explicit MediaPartitionPool(const MediaPartitionOptions& options);
+
+    // The partition with the fewest calls among those clocked at
+    // clock_rate, or at the pool's clock rate when none is.
+    MediaPartition& assign(unsigned clock_rate);
+    size_t size() const;
+    void shutdown();
+
+private:
+    unsigned clock_rate_;
+    std::vector<std::unique_ptr<MediaPartition>> partitions_;
+};
+
+}
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace sip_gateway {
+namespace audio {
+
+// Streams interleaved PCM16 as Ogg/Opus (RFC 7845) in 20 ms packets. Only
+// whole pages are handed out by take(), so the bytes can be appended to a
+// file as they come.
+class OggOpusEncoder {
+public:
+    // Null when the build has no libopus or the rate is not one Opus accepts.
+    static std::unique_ptr<OggOpusEncoder> create(uint32_t sample_rate,
+                                                  unsigned channels,
+                                                  int bitrate);
+    static bool supported(uint32_t sample_rate);
+
+    ~OggOpusEncoder();
+    OggOpusEncoder(const OggOpusEncoder&) = delete;
+    OggOpusEncoder& operator=(const OggOpusEncoder&) = delete;
+
+    // frames counts samples per channel. Returns false once encoding failed.
+    bool write(const int16_t* samples, size_t frames);
+    // Pads the last packet with silence and ends the stream.
+    bool finish();
+    std::string take();
+
+private:
+    struct Impl;
+    explicit OggOpusEncoder(std::unique_ptr<Impl> impl);
+    std::unique_ptr<Impl> impl_;
+};
+
+}
+}
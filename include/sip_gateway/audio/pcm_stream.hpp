@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace sip_gateway {
+namespace audio {
+
+// Jitter buffer for a WAV body that arrives in chunks. The producer feeds raw
+// bytes as they are received; the consumer reads mono PCM16 samples once the
+// header is parsed and the prebuffer is filled.
+class PcmStream {
+public:
+    explicit PcmStream(std::chrono::milliseconds prebuffer);
+
+    PcmStream(const PcmStream&) = delete;
+    PcmStream& operator=(const PcmStream&) = delete;
+
+    // Producer side.
+    void write(const char* data, size_t size);
+    void finish();
+    void fail(const std::string& reason);
+
+    // Consumer side. Returns true once playback can start: the prebuffer is
+    // filled, or the body finished with at least one sample.
+    bool wait_ready(std::chrono::milliseconds timeout);
+    size_t read(int16_t* out, size_t max_samples);
+    // Finished and every sample has been read.
+    bool drained() const;
+
+    void cancel();
+    bool cancelled() const;
+    bool failed() const;
+    bool finished() const;
+
+    unsigned sample_rate() const;
+    size_t buffered_samples() const;
+    size_t total_samples() const;
+
+private:
+    bool ready_locked() const;
+    void parse_header_locked();
+    void append_pcm_locked(const char* data, size_t size);
+
+    std::chrono::milliseconds prebuffer_;
+    mutable std::mutex mutex_;
+    std::condition_variable ready_cv_;
+    std::string header_;
+    bool header_done_ = false;
+    unsigned sample_rate_ = 0;
+    bool has_odd_byte_ = false;
+    char odd_byte_ = 0;
+    std::vector<int16_t> samples_;
+    size_t read_pos_ = 0;
+    bool finished_ = false;
+    bool failed_ = false;
+    std::atomic<bool> cancelled_{false};
+};
+
+}
+}
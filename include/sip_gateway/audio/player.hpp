@@ -1,47 +1,111 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <deque>
 #include <filesystem>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <variant>
 
 #include <pjsua2.hpp>
 namespace sip_gateway {
 namespace audio {
 
-class SmartPlayer {
+class MediaPartition;
+class PcmStream;
+
+// Always shared: EOF is handled later on the media lane and holds only a
+// weak reference, so a player destroyed meanwhile is skipped.
+class SmartPlayer : public std::enable_shared_from_this<SmartPlayer> {
 public:
+    // A WAV file, or PCM held in memory (complete or still arriving).
+    using Source = std::variant<std::filesystem::path, std::shared_ptr<PcmStream>>;
+
+    using FirstFrameFn = std::function<void(std::chrono::steady_clock::time_point)>;
+
     struct AudioFile {
-        std::filesystem::path filename;
+        Source source;
         bool discard_after = false;
     };
 
+    // A partitioned call: each item plays from a port on the partition,
+    // sent to the call's stream slot and, when recording, the recorder's
+    // playback slot. Files are read into memory first.
+    struct PartitionTarget {
+        MediaPartition* partition = nullptr;
+        int call_slot = -1;
+        int recorder_slot = -1;
+    };
+
     explicit SmartPlayer(
         pj::AudioMedia& audio_media,
-        pj::AudioMediaRecorder* wav_recorder,
-        std::function<void()> on_stop_callback = nullptr
+        pj::AudioMedia* recorder,
+        std::function<void()> on_stop_callback = nullptr,
+        unsigned frame_time_usec = 20000
+    );
+    SmartPlayer(
+        PartitionTarget target,
+        std::function<void()> on_stop_callback = nullptr,
+        unsigned frame_time_usec = 20000
     );
+    ~SmartPlayer();
 
     void enqueue(const std::filesystem::path& filename, bool discard_after = false);
+    // Plays from memory, starting before the stream is finished if needed.
+    // The stream is cancelled if it is dropped from the queue or interrupted.
+    void enqueue(std::shared_ptr<PcmStream> stream);
     void play();
+    // Lock-free and safe from any thread: streamed audio turns to silence
+    // from the next conference frame. interrupt() tears down and unmutes.
+    void mute();
+    bool muted() const;
     void interrupt();
     bool is_active() const;
     void handle_eof();
+    // Called by the playback port for its first silenced frame; exports the
+    // mute-to-silence latency as barge_in_to_silence.
+    void handle_muted_frame();
+    // Set before playback starts. Receives, on the media lane, the time each
+    // item's first audio went out: its first non-empty frame when streamed,
+    // the start of transmission for a file.
+    void set_on_first_frame(FirstFrameFn on_first_frame);
+    void handle_first_frame();
+    // The call's stream was recreated on its partition.
+    void set_call_slot(int slot);
 
 private:
+    // Guards the queue, the current player and the slots against the
+    // threads that drive playback: the SIP thread, TTS workers and the media
+    // lane. The conference clock thread never takes it, and the stop
+    // callback runs after it is released.
+    mutable std::mutex mutex_;
     std::deque<AudioFile> queue_;
     std::function<void()> on_stop_callback_;
+    FirstFrameFn on_first_frame_;
     bool active_ = false;
     bool tearing_down_ = false;
+    std::atomic<bool> muted_{false};
+    std::atomic<bool> mute_reported_{false};
+    std::atomic<int64_t> muted_at_ns_{0};
     std::optional<AudioFile> current_audio_;
-    pj::AudioMedia& audio_media_;
-    pj::AudioMediaRecorder* wav_recorder_;
-    std::unique_ptr<pj::AudioMediaPlayer> current_player_;
+    pj::AudioMedia* audio_media_ = nullptr; // Null when partitioned.
+    pj::AudioMedia* recorder_ = nullptr;
+    PartitionTarget partition_;
+    int player_slot_ = -1; // The current player's partition slot.
+    unsigned frame_time_usec_;
+    std::unique_ptr<pj::AudioMedia> current_player_;
 
-    void play_next();
+    // Returns true when the queue ran out; the caller then notifies.
+    bool play_next();
+    void notify_stopped();
+    std::unique_ptr<pj::AudioMedia> create_player(const AudioFile& audio);
     void destroy_player();
     void discard_current();
+    static void discard(const AudioFile& audio);
 };
 
 }
@@ -1,25 +1,33 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <mutex>
-#include <thread>
-#include <condition_variable>
-#include <deque>
 #include <vector>
 
 #include <pjsua2.hpp>
+
+#include "sip_gateway/audio/frame_ring.hpp"
+
 namespace sip_gateway {
 namespace audio {
 
+class AudioShardPool;
+
 class AudioMediaPort : public pj::AudioMediaPort {
 public:
-    using FrameHandler = std::function<void(const std::vector<int16_t>&)>;
+    using FrameHandler = std::function<void(const int16_t* samples, size_t count)>;
     using FrameProvider = std::function<std::vector<int16_t>()>;
 
-    AudioMediaPort();
+    // Ports with the same shard key are drained by the same audio thread.
+    // frame_samples sizes the preallocated receive slots; frame_time_usec is
+    // the bridge tick the port reports lateness against.
+    AudioMediaPort(int shard_key, size_t frame_samples, unsigned frame_time_usec = 20000);
     ~AudioMediaPort() override;
 
+    // Must be installed once, before the port starts receiving media.
     void set_on_frame_received(FrameHandler handler);
     void set_on_frame_requested(FrameProvider handler);
 
@@ -27,24 +35,28 @@ public:
     void onFrameReceived(pj::MediaFrame& frame) override;
 
 private:
-    struct FrameTask {
-        FrameHandler handler;
-        std::vector<int16_t> data;
-    };
+    friend class AudioShardPool;
 
-    void worker_loop();
+    // Returns the number of frames that were queued.
+    size_t drain_frames();
 
     static constexpr size_t kMaxQueueSize = 64;
 
     FrameHandler on_frame_received_;
+    std::atomic<bool> handler_ready_{false};
     FrameProvider on_frame_requested_;
     std::mutex handler_mutex_;
 
-    std::mutex queue_mutex_;
-    std::condition_variable queue_cv_;
-    std::deque<FrameTask> frame_queue_;
-    std::thread worker_;
-    bool stop_worker_{false};
+    FrameRing frames_;
+    std::atomic<uint64_t> dropped_frames_{0};
+    std::atomic<bool> pending_{false};
+    // When the shard was last signalled; read by the shard to time the handoff.
+    std::atomic<int64_t> pending_since_ns_{0};
+    int64_t frame_time_ns_;
+    int64_t last_tick_ns_ = 0; // Clock thread only.
+    std::atomic<bool> detached_{false};
+    AudioShardPool& shard_pool_;
+    size_t shard_;
 };
 
 }
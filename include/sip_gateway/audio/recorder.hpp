@@ -4,30 +4,63 @@
 #include <memory>
 
 #include <pjsua2.hpp>
+
+#include "sip_gateway/audio/recording_file.hpp"
+
 namespace sip_gateway {
 namespace audio {
 
+class RecordingWriter;
+
+struct RecorderOptions {
+    RecordingFormat format = RecordingFormat::Wav;
+    // Caller on the left channel, playback on the right.
+    bool stereo = false;
+    unsigned sample_rate = 16000;
+    unsigned frame_time_usec = 20000;
+    int opus_bitrate = 24000;
+    // False when the inputs go on a media partition instead of the pjsua
+    // bridge.
+    bool register_ports = true;
+};
+
+// Records a call without touching the disk on the conference clock thread.
+// The recorder ports copy frames into preallocated rings, and one shared
+// writer thread drains them in batches, encodes and writes the file. In mono
+// the bridge mixes everything sent to either input into one channel.
 class CallRecorder {
 public:
     CallRecorder();
     ~CallRecorder();
 
-    void start_recording(
-        const std::filesystem::path& filename,
-        unsigned sample_rate = 16000,
-        unsigned channels = 1,
-        unsigned bits_per_sample = 16
-    );
+    CallRecorder(const CallRecorder&) = delete;
+    CallRecorder& operator=(const CallRecorder&) = delete;
+
+    // The extension follows the format written (.wav or .ogg). Throws
+    // std::runtime_error when the file or ports cannot be created.
+    void start_recording(const std::filesystem::path& filename,
+                         const RecorderOptions& options = {});
+    // Stop transmitting to the inputs first. The writer finishes the file
+    // in the background.
     void stop_recording();
     bool is_recording() const;
 
-    pj::AudioMediaRecorder* get_recorder();
+    // Null when not recording; the same port in mono.
+    pj::AudioMediaPort* caller_input();
+    pj::AudioMediaPort* playback_input();
 
 private:
-    std::unique_ptr<pj::AudioMediaRecorder> recorder_;
-    std::filesystem::path current_file_;
-    bool recording_ = false;
+    friend class RecordingWriter;
+    class Port;
+    struct Recording;
+
+    std::shared_ptr<Recording> recording_;
+    std::unique_ptr<Port> caller_port_;
+    std::unique_ptr<Port> playback_port_;
 };
 
+// Finishes every open recording and joins the writer thread.
+void shutdown_recording_writer();
+
 }
 }
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+
+namespace sip_gateway {
+namespace audio {
+
+class OggOpusEncoder;
+
+enum class RecordingFormat {
+    Wav,
+    Opus
+};
+
+// Accepts "wav" and "opus"; throws std::runtime_error otherwise.
+RecordingFormat parse_recording_format(const std::string& name);
+
+// Appends interleaved PCM16 to a WAV or Ogg/Opus file. Opus falls back to WAV
+// when it is unavailable for the rate, and the extension follows the format
+// actually written. WAV sizes are patched in on close(). Not thread-safe.
+class RecordingFile {
+public:
+    // Throws std::runtime_error when the file cannot be created.
+    RecordingFile(std::filesystem::path path,
+                  RecordingFormat format,
+                  uint32_t sample_rate,
+                  unsigned channels,
+                  int opus_bitrate = 24000);
+    ~RecordingFile();
+
+    RecordingFile(const RecordingFile&) = delete;
+    RecordingFile& operator=(const RecordingFile&) = delete;
+
+    const std::filesystem::path& path() const;
+    RecordingFormat format() const;
+    unsigned channels() const;
+    uint64_t bytes_written() const;
+
+    // frames counts samples per channel.
+    bool write(const int16_t* samples, size_t frames);
+    void close();
+
+private:
+    bool append(const std::string& bytes);
+
+    std::filesystem::path path_;
+    RecordingFormat format_;
+    uint32_t sample_rate_;
+    unsigned channels_;
+    std::unique_ptr<OggOpusEncoder> opus_;
+    std::ofstream out_;
+    uint64_t data_bytes_ = 0;
+    uint64_t bytes_written_ = 0;
+    bool closed_ = false;
+};
+
+}
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+namespace sip_gateway {
+namespace audio {
+
+// Float samples bounded at a fixed capacity; pushing past it overwrites the
+// oldest samples. Storage grows on demand up to the capacity and is then
+// reused, so a full ring never allocates or shifts samples. Not thread safe.
+class SampleRing {
+public:
+    struct Span {
+        const float* data = nullptr;
+        size_t size = 0;
+    };
+
+    explicit SampleRing(size_t capacity);
+
+    size_t capacity() const;
+    size_t size() const;
+    bool empty() const;
+    // Samples overwritten since the last clear().
+    size_t dropped() const;
+    // Samples of storage allocated so far; grows on demand toward capacity().
+    size_t allocated() const;
+
+    void push(const float* samples, size_t count);
+    void push(const SampleRing& other);
+    void clear();
+
+    // Samples [offset, offset + count) as at most two contiguous pieces.
+    std::array<Span, 2> view(size_t offset, size_t count) const;
+    // Appends samples [offset, offset + count) to out.
+    void copy_to(size_t offset, size_t count, std::vector<float>& out) const;
+
+private:
+    size_t capacity_;
+    std::vector<float> storage_;
+    size_t head_ = 0; // Oldest sample once the storage has wrapped.
+    size_t size_ = 0;
+    size_t dropped_ = 0;
+};
+
+}
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace sip_gateway {
+namespace audio {
+
+// Immutable, reference-counted float samples. Copying the handle shares the
+// samples, so consumers that keep audio retain the handle instead of a copy.
+class AudioSegment {
+public:
+    AudioSegment() = default;
+    explicit AudioSegment(std::vector<float> samples)
+        : samples_(std::make_shared<const std::vector<float>>(std::move(samples))) {}
+    // Adopts samples already shared, e.g. by utils::BufferPool::share().
+    explicit AudioSegment(std::shared_ptr<const std::vector<float>> samples)
+        : samples_(std::move(samples)) {}
+
+    const std::vector<float>& samples() const {
+        static const std::vector<float> empty;
+        return samples_ ? *samples_ : empty;
+    }
+    const float* data() const { return samples().data(); }
+    size_t size() const { return samples_ ? samples_->size() : 0; }
+    bool empty() const { return size() == 0; }
+
+private:
+    std::shared_ptr<const std::vector<float>> samples_;
+};
+
+}
+}
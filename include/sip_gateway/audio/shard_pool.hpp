@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sip_gateway {
+namespace audio {
+
+class AudioMediaPort;
+
+struct AudioShardPoolOptions {
+    size_t threads = 4;
+    bool pin_threads = false;
+};
+
+// Fixed set of audio threads shared by every call. A port always drains on
+// the same shard, so frames of one call are processed in order. notify() is
+// called from the media thread and never takes a lock; a missed wakeup is
+// caught by the shard's poll interval.
+class AudioShardPool {
+public:
+    explicit AudioShardPool(AudioShardPoolOptions options);
+    ~AudioShardPool();
+
+    AudioShardPool(const AudioShardPool&) = delete;
+    AudioShardPool& operator=(const AudioShardPool&) = delete;
+
+    size_t shard_for(int key) const;
+    void attach(size_t shard, AudioMediaPort* port);
+    // Removes the port from its shard and waits for an in-progress drain.
+    void detach(size_t shard, AudioMediaPort* port);
+    void notify(size_t shard);
+    void shutdown();
+
+    size_t shard_count() const;
+
+private:
+    struct Shard {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::condition_variable idle_cv;
+        std::vector<AudioMediaPort*> ports;
+        std::atomic<uint64_t> signals{0};
+        AudioMediaPort* running = nullptr;
+        bool stopping = false;
+        std::thread thread;
+    };
+
+    static constexpr std::chrono::milliseconds kPollInterval{10};
+
+    void shard_loop(size_t index);
+    void pin_thread(size_t index);
+
+    AudioShardPoolOptions options_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+void init_audio_shard_pool(const AudioShardPoolOptions& options);
+AudioShardPool& audio_shard_pool();
+void shutdown_audio_shard_pool();
+
+}
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace sip_gateway {
+namespace audio {
+
+struct TtsCacheOptions {
+    // Memory budget for cached WAV bodies; 0 disables the cache.
+    size_t max_bytes = 64 * 1024 * 1024;
+    // Larger bodies are never cached, so one long reply cannot flush the
+    // greetings and prompts the cache is for.
+    size_t max_entry_bytes = 2 * 1024 * 1024;
+    // Optional second tier that survives restarts. Empty disables it.
+    std::filesystem::path disk_dir;
+};
+
+// Process-wide cache of synthesized WAV bodies with LRU eviction.
+class TtsCache {
+public:
+    explicit TtsCache(TtsCacheOptions options);
+
+    TtsCache(const TtsCache&) = delete;
+    TtsCache& operator=(const TtsCache&) = delete;
+
+    // Texts that differ only in case and whitespace share an entry.
+    static std::string make_key(const std::string& text, const std::string& voice);
+
+    bool enabled() const;
+    std::shared_ptr<const std::string> get(const std::string& key);
+    void put(const std::string& key, std::string audio);
+
+    size_t size_bytes() const;
+    size_t entries() const;
+
+private:
+    struct Entry {
+        std::string key;
+        std::shared_ptr<const std::string> audio;
+    };
+
+    std::shared_ptr<const std::string> load_from_disk(const std::string& key) const;
+    void store_on_disk(const std::string& key, const std::string& audio) const;
+    std::filesystem::path disk_path(const std::string& key) const;
+    void insert_locked(const std::string& key, std::shared_ptr<const std::string> audio);
+    void publish_size_locked() const;
+
+    TtsCacheOptions options_;
+    mutable std::mutex mutex_;
+    std::list<Entry> lru_;
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+    size_t bytes_ = 0;
+};
+
+}
+}
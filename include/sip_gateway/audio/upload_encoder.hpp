@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sip_gateway {
+namespace audio {
+
+enum class UploadCodec {
+    Wav,
+    Opus
+};
+
+// Accepts "wav" and "opus"; throws std::runtime_error otherwise.
+UploadCodec parse_upload_codec(const std::string& name);
+
+struct UploadEncoderOptions {
+    UploadCodec codec = UploadCodec::Wav;
+    int opus_bitrate = 24000;
+    // Overrides the codec's default Content-Type when set.
+    std::string content_type;
+};
+
+struct EncodedAudio {
+    std::string bytes;
+    std::string content_type;
+    UploadCodec codec = UploadCodec::Wav;
+};
+
+// Opus output is Ogg-encapsulated (RFC 7845). It falls back to WAV when the
+// build has no libopus or the sample rate is not one Opus accepts. WAV is
+// written into scratch, so a caller that recycles the returned bytes avoids
+// a fresh allocation per upload.
+EncodedAudio encode_upload(const std::vector<float>& audio,
+                           uint32_t sample_rate,
+                           const UploadEncoderOptions& options,
+                           std::string scratch = {});
+
+}
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sip_gateway {
+namespace audio {
+
+// Clamps to [-1, 1] and scales to the int16 range.
+int16_t float_to_pcm16(float sample);
+
+// 44-byte PCM16 header for data_size bytes of interleaved samples.
+std::string wav_header(uint32_t sample_rate, uint16_t channels, uint32_t data_size);
+
+// Mono PCM16 WAV with a 44-byte header.
+std::string encode_wav(const std::vector<float>& audio, uint32_t sample_rate);
+// Same, into out, whose capacity is reused.
+void encode_wav(const std::vector<float>& audio, uint32_t sample_rate, std::string& out);
+
+}
+}
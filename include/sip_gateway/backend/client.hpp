@@ -1,13 +1,17 @@
 #pragma once
 
 #include <chrono>
+#include <functional>
 #include <httplib.h>
+#include <mutex>
 #include <optional>
 #include <stdexcept>
 #include <string>
 
 #include <nlohmann/json.hpp>
 
+#include "sip_gateway/backend/connection_pool.hpp"
+
 namespace sip_gateway {
 
 class BackendError : public std::runtime_error {
@@ -20,10 +24,45 @@ public:
     explicit BackendPermissionError(const std::string& message) : BackendError(message) {}
 };
 
+class BackendDeadlineError : public BackendError {
+public:
+    explicit BackendDeadlineError(const std::string& message) : BackendError(message) {}
+};
+
+// A request that has not answered by the running quantile of its latency
+// histogram is duplicated on a second pooled connection, and the first
+// response wins. Each hedgeable request earns budget_ratio tokens (up to
+// budget_burst) and each hedge spends one, so hedges stay a bounded fraction
+// of backend traffic.
+struct HedgeOptions {
+    bool enabled = false;
+    double quantile = 0.9;
+    uint64_t min_samples = 20;
+    std::chrono::milliseconds min_delay{50};
+    double budget_ratio = 0.1;
+    double budget_burst = 10.0;
+};
+
 struct BackendRequestOptions {
     std::chrono::seconds request_timeout{60};
     std::chrono::seconds connect_timeout{60};
     std::chrono::seconds sock_read_timeout{60};
+    ConnectionPoolOptions pool;
+    HedgeOptions hedge;
+    // Runs the task that launches the hedge and aborts attempts at the
+    // deadline, beside the attempt on the calling thread. The app passes the
+    // Backend worker-pool lane. Without one, calls never hedge and a deadline
+    // only shortens the socket timeouts.
+    std::function<void(std::function<void()>)> executor;
+};
+
+struct BackendCallPolicy {
+    // Metrics response_time method whose quantile sets the hedge delay, e.g.
+    // "transcribe". Empty disables hedging for the call.
+    std::string latency_method;
+    // Socket timeouts are cut to fit it, in-flight attempts are aborted and
+    // BackendDeadlineError is thrown once it passes.
+    std::optional<std::chrono::steady_clock::time_point> deadline;
 };
 
 class BackendClient {
@@ -33,7 +72,9 @@ public:
                   const BackendRequestOptions& options);
 
     nlohmann::json get_json(const std::string& path);
-    nlohmann::json post_json(const std::string& path, const nlohmann::json& body);
+    nlohmann::json post_json(const std::string& path,
+                             const nlohmann::json& body,
+                             const BackendCallPolicy& policy = {});
     nlohmann::json post_multipart_json(const std::string& path,
                                        const std::string& field_name,
                                        const nlohmann::json& body);
@@ -41,8 +82,16 @@ public:
     nlohmann::json delete_json(const std::string& path);
     nlohmann::json post_binary(const std::string& path,
                                const std::string& content_type,
-                               const std::string& payload);
-    std::string get_binary(const std::string& path, const std::string& query);
+                               const std::string& payload,
+                               const BackendCallPolicy& policy = {});
+    std::string get_binary(const std::string& path,
+                           const std::string& query,
+                           const BackendCallPolicy& policy = {});
+    // Delivers the body chunk by chunk as it is read off the socket. The
+    // receiver returns false to abort the transfer, which is not an error.
+    void get_binary_stream(const std::string& path,
+                           const std::string& query,
+                           const std::function<bool(const char*, size_t)>& receiver);
 
 private:
     std::string build_path(const std::string& path) const;
@@ -52,14 +101,25 @@ private:
         client.set_read_timeout(options_.sock_read_timeout.count(), 0);
         client.set_write_timeout(options_.request_timeout.count(), 0);
     }
-    httplib::Client* get_client();
-    httplib::SSLClient* get_ssl_client();
+    // The configured timeouts, each cut to the time left before deadline.
+    void apply_timeouts(httplib::Client& client,
+                        std::chrono::steady_clock::time_point deadline) const;
+    std::unique_ptr<httplib::Client> make_client() const;
+    using Request = std::function<httplib::Result(httplib::Client&)>;
+    httplib::Result execute(const Request& request);
+    httplib::Result execute(const Request& request, const BackendCallPolicy& policy);
+    httplib::Result send(BackendConnectionPool::Lease& lease, const Request& request);
+    std::optional<std::chrono::steady_clock::duration> hedge_delay(const std::string& method);
+    bool take_hedge_token();
     std::string scheme_;
     std::string host_;
     int port_;
     std::string base_path_;
     std::optional<std::string> authorization_token_;
     BackendRequestOptions options_;
+    BackendConnectionPool pool_;
+    std::mutex hedge_mutex_;
+    double hedge_tokens_ = 0.0;
 };
 
 }
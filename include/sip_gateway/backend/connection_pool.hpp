@@ -0,0 +1,66 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <httplib.h>
+#include <memory>
+#include <mutex>
+
+namespace sip_gateway {
+
+struct ConnectionPoolOptions {
+    // Idle connections kept for reuse. Leases are not capped; a release past
+    // this many closes the oldest idle connection.
+    size_t max_idle = 16;
+    std::chrono::seconds idle_timeout{60};
+};
+
+// Keep-alive httplib clients shared by every thread that talks to one backend
+// host. Idle clients are reused most-recent-first; clients idle for longer
+// than idle_timeout are closed. Acquiring never waits.
+class BackendConnectionPool {
+public:
+    using Factory = std::function<std::unique_ptr<httplib::Client>()>;
+
+    class Lease {
+    public:
+        Lease(BackendConnectionPool& pool, std::unique_ptr<httplib::Client> client);
+        Lease(Lease&& other) noexcept;
+        Lease& operator=(Lease&&) = delete;
+        ~Lease();
+
+        httplib::Client& operator*() const { return *client_; }
+        httplib::Client* operator->() const { return client_.get(); }
+        // Drop the connection instead of returning it, e.g. after an I/O error.
+        void discard();
+
+    private:
+        BackendConnectionPool* pool_;
+        std::unique_ptr<httplib::Client> client_;
+    };
+
+    BackendConnectionPool(Factory factory, ConnectionPoolOptions options);
+
+    Lease acquire();
+    size_t idle_count() const;
+
+private:
+    struct IdleClient {
+        std::unique_ptr<httplib::Client> client;
+        std::chrono::steady_clock::time_point idle_since;
+    };
+
+    void release(std::unique_ptr<httplib::Client> client, bool reusable);
+    void evict_idle_locked(std::chrono::steady_clock::time_point now);
+    void publish_locked() const;
+
+    Factory factory_;
+    ConnectionPoolOptions options_;
+    mutable std::mutex mutex_;
+    std::deque<IdleClient> idle_;
+    size_t leased_ = 0;
+};
+
+}
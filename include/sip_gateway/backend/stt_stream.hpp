@@ -0,0 +1,65 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace sip_gateway {
+
+// Streams one utterance at a time to the backend over the session WebSocket
+// and matches transcripts to finalize requests. See docs/backend_api.md.
+class SttStream {
+public:
+    using SendFn = std::function<void(const nlohmann::json&)>;
+
+    // history_samples is how much audio before speech start is sent with it:
+    // VAD confirms speech only after it has already been going for a while.
+    SttStream(SendFn send, unsigned sample_rate, size_t chunk_samples, size_t history_samples);
+
+    // Called for every received frame, before it is fed to VAD.
+    void push(const int16_t* samples, size_t count);
+    // Opens an utterance; no-op while one is already open.
+    void begin();
+    // Flushes buffered audio and asks for a transcript of the utterance so
+    // far. A final request also closes the utterance.
+    uint64_t request_transcript(bool final);
+    std::optional<std::string> wait_transcript(uint64_t request_id,
+                                               std::chrono::milliseconds timeout);
+    // Returns true when the message was a transcript for this stream.
+    bool handle_message(const nlohmann::json& message);
+    // Drops the open utterance and wakes every waiter.
+    void cancel();
+    // Rescales the chunk and history sizes to the call's negotiated rate and
+    // drops the history; call before audio flows.
+    void set_sample_rate(unsigned sample_rate);
+
+private:
+    void flush_locked();
+
+    SendFn send_;
+    unsigned sample_rate_;
+    size_t chunk_samples_;
+    size_t history_samples_;
+
+    std::mutex mutex_;
+    std::condition_variable transcript_cv_;
+    bool active_ = false;
+    bool cancelled_ = false;
+    uint64_t seq_ = 0;
+    uint64_t next_request_ = 1;
+    std::deque<int16_t> history_;
+    std::vector<int16_t> pending_;
+    std::map<uint64_t, std::string> transcripts_;
+};
+
+}
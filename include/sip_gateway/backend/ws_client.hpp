@@ -1,16 +1,21 @@
 #pragma once
 
-#include <atomic>
+#include <cstddef>
 #include <functional>
 #include <memory>
 #include <mutex>
 #include <string>
-#include <thread>
 
 #include <nlohmann/json.hpp>
 
 namespace sip_gateway {
 
+// Every BackendWsClient shares one websocketpp client and its asio threads.
+void init_ws_transport(size_t threads);
+void shutdown_ws_transport();
+// Routes sessions connected after this call over shared /ws_mux connections.
+void enable_ws_multiplex(const std::string& base_url, size_t connections);
+
 class BackendWsClient {
 public:
     using MessageHandler = std::function<void(const nlohmann::json&)>;
@@ -24,22 +29,20 @@ public:
                  EventHandler on_timeout,
                  EventHandler on_close);
     void send_json(const nlohmann::json& payload);
+    // No handler starts after stop() returns. One already running is not
+    // waited for, so handlers must keep alive what they use.
     void stop();
 
+    // Defined in ws_client.cpp; public only so the multiplexer can route to it.
+    struct WsState;
+
 private:
-    void run_loop();
     std::string make_ws_url(const std::string& session_id) const;
 
     std::string base_url_;
-    std::string session_id_;
-    MessageHandler on_message_;
-    EventHandler on_timeout_;
-    EventHandler on_close_;
-    std::atomic<bool> running_{false};
-    std::thread worker_;
+    // connect, send_json and stop run on different threads.
     std::mutex ws_mutex_;
-    struct WsState;
-    std::unique_ptr<WsState> ws_state_;
+    std::shared_ptr<WsState> ws_state_; // Guarded by ws_mutex_.
 };
 
 }
@@ -33,17 +33,37 @@ struct Config {
     int ec_tail_len = 200;
     bool ec_no_vad = false;
     int sip_media_thread_cnt = 1;
+    int media_partitions = 0;
     std::string log_level = "INFO";
     std::optional<std::string> log_filename;
     std::optional<std::filesystem::path> logs_dir;
+    std::string log_format = "text";
+    bool log_async = false;
+    int log_async_queue_size = 8192;
+    std::string log_async_overflow = "drop_oldest";
     int pjsip_log_level = 1;
     int pjsip_console_log_level = 1;
     int vad_sampling_rate = 16000;
+    bool vad_narrowband = false;
     double vad_threshold = 0.65;
     int vad_min_speech_duration_ms = 150;
     int vad_min_silence_duration_ms = 300;
     int vad_speech_pad_ms = 700;
     int vad_speech_prob_window = 3;
+    int vad_max_utterance_ms = 60000;
+    bool vad_energy_gate = false;
+    double vad_energy_gate_ratio = 2.0;
+    double vad_energy_gate_max_rms = 0.01;
+    int vad_energy_gate_windows = 8;
+    bool vad_energy_gate_reset = true;
+    int vad_batch_max = 1;
+    int vad_batch_wait_us = 250;
+    int vad_ort_intra_op_threads = 1;
+    int vad_ort_inter_op_threads = 1;
+    bool vad_ort_spinning = false;
+    std::string vad_ort_graph_optimization = "all";
+    bool vad_ort_global_threads = false;
+    std::string vad_ort_cache_dir;
     bool vad_correction_debug = false;
     double vad_correction_enter_thres = 0.6;
     double vad_correction_exit_thres = 0.4;
@@ -57,9 +77,13 @@ struct Config {
     std::string local_stt_url;
     std::string local_stt_lang = "en";
     double greeting_delay_sec = 0.0;
+    int greeting_answer_deadline_ms = 1000;
     std::map<std::string, int> codecs_priority;
     bool interruptions_are_allowed = true;
     bool record_audio_parts = false;
+    std::string record_audio_format = "wav";
+    bool record_audio_stereo = false;
+    int record_audio_opus_bitrate = 24000;
     std::optional<std::string> flametree_callback_url;
     int flametree_callback_port = 8088;
     std::string backend_url;
@@ -70,12 +94,66 @@ struct Config {
     double backend_request_timeout = 60.0;
     double backend_connect_timeout = 60.0;
     double backend_sock_read_timeout = 60.0;
+    int backend_pool_size = 16;
+    int backend_pool_idle_timeout = 60;
+    bool backend_hedge = false;
+    double backend_hedge_quantile = 0.9;
+    double backend_hedge_budget = 0.1;
+    int backend_turn_deadline_ms = 0;
     std::string session_type = "inbound";
     bool is_streaming = false;
     bool allow_inbound_calls = true;
+    bool admission_control = false;
+    double admission_vad_cpu_budget = 0.8;
+    int admission_max_backlog = 256;
+    int admission_backend_p95_ms = 3000;
+    int admission_retry_after_sec = 30;
+    double dial_calls_per_second = 5.0;
+    int dial_max_concurrent = 8;
+    int dial_queue_max = 1000;
+    int dial_history = 1000;
+    bool cluster_mode = false;
+    std::string cluster_node_id;
+    std::optional<std::string> cluster_advertise_url;
+    int cluster_heartbeat_sec = 5;
+    std::optional<std::string> cluster_secret;
+    std::vector<std::string> cluster_peers;
+    std::optional<std::string> cluster_ca_file;
     bool show_waiting_messages = false;
     std::string log_name = "sip_gateway";
     int tts_max_inflight = 2;
+    int tts_max_queued_kb = 0;
+    bool tts_clause_chunking = false;
+    int tts_clause_min_chars = 20;
+    int tts_clause_max_chars = 150;
+    bool tts_scheduler = false;
+    int tts_scheduler_min = 2;
+    int tts_scheduler_max = 64;
+    int tts_scheduler_initial = 8;
+    double tts_scheduler_tolerance = 2.0;
+    bool turn_trace = false;
+    int turn_trace_slow_ms = 1000;
+    bool call_trace = false;
+    std::filesystem::path call_trace_dir;
+    int worker_pool_threads = 32;
+    int worker_pool_media_threads = 2;
+    int worker_pool_queue_size = 1024;
+    int audio_worker_threads = 4;
+    bool audio_worker_affinity = false;
+    bool sip_event_driven_loop = false;
+    int ws_transport_threads = 2;
+    bool ws_multiplex = false;
+    int ws_multiplex_connections = 2;
+    bool tts_streaming = false;
+    int tts_prebuffer_ms = 200;
+    bool stt_streaming = false;
+    int stt_stream_chunk_ms = 100;
+    int stt_stream_timeout_ms = 2000;
+    std::string stt_upload_codec = "wav";
+    int stt_upload_opus_bitrate = 24000;
+    std::string stt_upload_content_type;
+    int tts_cache_mb = 64;
+    std::filesystem::path tts_cache_dir;
 
     static Config load();
     void validate() const;
@@ -4,6 +4,8 @@
 #include <memory>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <type_traits>
 
 #include "sip_gateway/config.hpp"
 #include "spdlog/logger.h"
@@ -11,80 +13,88 @@
 namespace sip_gateway {
 namespace logging {
 
-struct KeyValue {
-    std::string key;
-    std::string value;
-};
+namespace detail {
 
 template <typename T>
-inline KeyValue kv(const std::string& key, const T& value) {
-    std::ostringstream oss;
-    oss << value;
-    return {key, oss.str()};
+void append_value(std::string& out, const void* value) {
+    const auto& typed = *static_cast<const T*>(value);
+    if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+        out += std::string_view(typed);
+    } else if constexpr (std::is_integral_v<T> && !std::is_same_v<T, bool> &&
+                         !std::is_same_v<T, char>) {
+        out += std::to_string(typed);
+    } else {
+        std::ostringstream oss;
+        oss << typed;
+        out += oss.str();
+    }
 }
 
-inline std::string format_kv(std::initializer_list<KeyValue> items) {
-    std::string result;
-    for (const auto& item : items) {
-        if (!result.empty()) {
-            result += " ";
-        }
-        bool needs_quotes = item.value.find(' ') != std::string::npos;
-        result += item.key;
-        result += '=';
-        if (needs_quotes) {
-            result += '"';
-            result += item.value;
-            result += '"';
-        } else {
-            result += item.value;
-        }
-    }
-    return result;
 }
 
-inline std::string with_kv(const std::string& message,
-                           std::initializer_list<KeyValue> items) {
-    const auto context = format_kv(items);
-    if (context.empty()) {
-        return message;
-    }
-    return message + " [" + context + "]";
+// A log field that refers to its value and formats it only when the record
+// is written. Built by kv() inside a logging call; it must not outlive that
+// call.
+struct KeyValue {
+    std::string_view key;
+    const void* value;
+    void (*append)(std::string&, const void*);
+};
+
+template <typename T>
+inline KeyValue kv(std::string_view key, const T& value) {
+    return {key, &value, &detail::append_value<T>};
 }
 
 void init(const Config& config);
+// Flushes and stops the async log thread, if any.
+void shutdown();
 std::shared_ptr<spdlog::logger> get_logger();
 
+// The logger installed by init(), or spdlog's default before that. Cheap:
+// no registry lookup.
+spdlog::logger* current_logger();
+
+inline bool enabled(spdlog::level::level_enum level) {
+    const auto* logger = current_logger();
+    return logger && logger->should_log(level);
+}
+
+// Formats message and items for the log format chosen in init() and
+// writes the record. Callers check the level first.
+void write(spdlog::level::level_enum level,
+           std::string_view message,
+           std::initializer_list<KeyValue> items);
+
 inline void log(spdlog::level::level_enum level,
-                const std::string& message,
+                std::string_view message,
                 std::initializer_list<KeyValue> items = {}) {
-    auto logger = get_logger();
-    if (logger && logger->should_log(level)) {
-        logger->log(level, with_kv(message, items));
+    if (enabled(level)) {
+        write(level, message, items);
     }
 }
 
-inline void trace(const std::string& message,
+inline void trace(std::string_view message,
                   std::initializer_list<KeyValue> items = {}) {
     log(spdlog::level::trace, message, items);
 }
 
-inline void debug(const std::string& message,
+inline void debug(std::string_view message,
                   std::initializer_list<KeyValue> items = {}) {
     log(spdlog::level::debug, message, items);
 }
 
-inline void info(const std::string& message,
+inline void info(std::string_view message,
                  std::initializer_list<KeyValue> items = {}) {
     log(spdlog::level::info, message, items);
 }
 
-inline void warn(const std::string& message,
+inline void warn(std::string_view message,
                  std::initializer_list<KeyValue> items = {}) {
     log(spdlog::level::warn, message, items);
 }
 
-inline void error(const std::string& message,
+inline void error(std::string_view message,
                   std::initializer_list<KeyValue> items = {}) {
     log(spdlog::level::err, message, items);
 }
@@ -92,7 +102,6 @@ inline void error(const std::string& message,
 }
 
 using logging::kv;
-using logging::with_kv;
 using logging::debug;
 using logging::error;
 using logging::info;
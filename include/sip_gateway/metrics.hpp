@@ -1,44 +1,156 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
-#include <mutex>
+#include <map>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace sip_gateway {
 
+// Process-wide Prometheus registry. Series are registered on first use and
+// live for the process, so a handle returned by histogram(), counter() or
+// gauge() can be cached (typically in a function-local static) and updated
+// without any lookup or lock. Updates go to one of a few cache-line stripes
+// picked per thread and are summed at scrape time; the scrape reads the
+// atomics and never blocks an update.
 class Metrics {
 public:
+    using Labels = std::vector<std::pair<std::string, std::string>>;
+
+    static constexpr size_t kStripes = 8;
+
+    class Histogram {
+    public:
+        // Prometheus bucket bounds, in seconds.
+        static constexpr std::array<double, 14> kBounds = {
+            0.005, 0.01, 0.025, 0.05, 0.075, 0.1, 0.25, 0.5, 0.75, 1.0, 2.5, 5.0, 7.5, 10.0};
+
+        void observe(double seconds);
+
+        uint64_t count() const;
+        double sum() const;
+        // Cumulative, one per bound followed by +Inf.
+        std::array<uint64_t, kBounds.size() + 1> cumulative_buckets() const;
+        // Interpolated within the Prometheus bucket; nullopt until
+        // min_count observations exist or past the last finite bound.
+        std::optional<double> bucket_quantile(double quantile, uint64_t min_count = 1) const;
+        // From log-linear buckets (8 per octave, 61 us to 256 s), so within
+        // about 6% of the true value; nullopt when empty or out of range.
+        std::optional<double> quantile(double quantile) const;
+
+        static constexpr int kMinExponent = -13;
+        static constexpr int kMaxExponent = 8;
+        static constexpr size_t kSubBuckets = 8;
+        // Underflow, the octaves, overflow.
+        static constexpr size_t kFineBuckets =
+            2 + static_cast<size_t>(kMaxExponent - kMinExponent + 1) * kSubBuckets;
+        using FineCounts = std::array<uint64_t, kFineBuckets>;
+
+        // The log-linear bucket counts. The difference of two snapshots
+        // gives a window for quantile_of().
+        FineCounts fine_counts() const;
+        static std::optional<double> quantile_of(const FineCounts& counts, double quantile);
+
+    private:
+        friend class Metrics;
+
+        struct alignas(64) Stripe {
+            std::array<std::atomic<uint64_t>, kBounds.size() + 1> buckets{};
+            std::array<std::atomic<uint64_t>, kFineBuckets> fine{};
+            std::atomic<uint64_t> sum_ns{0};
+        };
+
+        Histogram() = default;
+        static size_t fine_index(double seconds);
+        static double fine_lower(size_t index);
+
+        std::array<Stripe, kStripes> stripes_;
+    };
+
+    class Counter {
+    public:
+        void increment(uint64_t delta = 1);
+        uint64_t value() const;
+
+    private:
+        friend class Metrics;
+
+        struct alignas(64) Stripe {
+            std::atomic<uint64_t> value{0};
+        };
+
+        Counter() = default;
+
+        std::array<Stripe, kStripes> stripes_;
+    };
+
+    class Gauge {
+    public:
+        void set(double value);
+        // Atomic, so concurrent adds never lose an update.
+        void add(double delta);
+        double value() const;
+
+    private:
+        friend class Metrics;
+
+        Gauge() = default;
+
+        std::atomic<double> value_{0.0};
+    };
+
     static Metrics& instance();
 
+    Histogram& histogram(const std::string& method);
+    // A histogram family of its own, exported as <name>_bucket, _count and
+    // _sum with these labels, rather than as a response_time method.
+    Histogram& named_histogram(const std::string& name, const Labels& labels = {});
+    Counter& counter(const std::string& name, const Labels& labels = {});
+    Gauge& gauge(const std::string& name, const Labels& labels = {});
+
+    // By-name forms of the handles above; each looks the series up.
     void increment_request();
     void observe_response_time(const std::string& method, double seconds);
     void observe_response_summary(const std::string& method, double seconds);
+    void set_gauge(const std::string& name, double value, const Labels& labels = {});
+    void increment_counter(const std::string& name,
+                           const Labels& labels = {},
+                           uint64_t delta = 1);
+    // Estimated from the response_time histogram by interpolating within the
+    // bucket; nullopt until min_count observations exist or when the quantile
+    // falls past the last finite bound.
+    std::optional<double> response_time_quantile(const std::string& method,
+                                                 double quantile,
+                                                 uint64_t min_count = 1) const;
     std::string render_prometheus() const;
 
 private:
     struct SummarySeries {
-        uint64_t count = 0;
-        double sum = 0.0;
-    };
-
-    struct HistogramSeries {
-        uint64_t count = 0;
-        double sum = 0.0;
-        std::vector<uint64_t> buckets;
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> sum_ns{0};
     };
 
-    Metrics();
+    Metrics() = default;
 
-    HistogramSeries& histogram_for(const std::string& method);
     SummarySeries& summary_for(const std::string& method);
+    static std::string format_labels(const Labels& labels);
 
-    mutable std::mutex mutex_;
-    uint64_t request_total_ = 0;
-    std::unordered_map<std::string, SummarySeries> response_summaries_;
-    std::unordered_map<std::string, HistogramSeries> response_histograms_;
-    std::vector<double> histogram_bounds_;
+    // Guards the maps, not the series in them.
+    mutable std::shared_mutex registry_mutex_;
+    Counter request_total_;
+    std::unordered_map<std::string, std::unique_ptr<SummarySeries>> response_summaries_;
+    std::unordered_map<std::string, std::unique_ptr<Histogram>> response_histograms_;
+    std::map<std::string, std::map<std::string, std::unique_ptr<Histogram>>> histograms_;
+    std::map<std::string, std::map<std::string, std::unique_ptr<Gauge>>> gauges_;
+    std::map<std::string, std::map<std::string, std::unique_ptr<Counter>>> counters_;
 };
 
 }
@@ -1,9 +1,12 @@
 #pragma once
 
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <string>
 #include <thread>
+#include <utility>
+#include <vector>
 
 #include <httplib.h>
 #include <nlohmann/json.hpp>
@@ -15,25 +18,61 @@ namespace sip_gateway {
 struct RestResponse {
     int status = 200;
     nlohmann::json body;
+    std::vector<std::pair<std::string, std::string>> headers = {};
 };
 
 class RestServer {
 public:
+    // Set, to the sending node's id, on requests forwarded between nodes.
+    static constexpr const char* kForwardedHeader = "X-Gateway-Forwarded";
+
     using CallHandler = std::function<RestResponse(const nlohmann::json&)>;
-    using TransferHandler = std::function<RestResponse(const std::string&, const nlohmann::json&)>;
+    // forwarded: another gateway node sent the request on (kForwardedHeader),
+    // so it must not be forwarded again.
+    using TransferHandler =
+        std::function<RestResponse(const std::string&, const nlohmann::json&, bool forwarded)>;
+    // Fields merged into the /health response next to "status".
+    using HealthHandler = std::function<nlohmann::json()>;
+    using DialStatusHandler = std::function<RestResponse(const std::string&)>;
 
-    RestServer(const Config& config, CallHandler on_call, TransferHandler on_transfer);
+    // on_batch serves POST /calls and on_dial_status GET /call/<request id>;
+    // either route is left out when its handler is empty.
+    RestServer(const Config& config,
+               CallHandler on_call,
+               TransferHandler on_transfer,
+               HealthHandler on_health = {},
+               CallHandler on_batch = {},
+               DialStatusHandler on_dial_status = {});
+    ~RestServer();
 
     void start();
     void stop();
+    // Until set, GET /ready answers 503 and /call and /transfer are refused;
+    // GET /health (liveness) answers from the start.
+    void set_ready(bool ready);
 
 private:
+    bool check_ready(httplib::Response& response) const;
+    // Ready and auth checks, JSON body parsing and error mapping shared by
+    // the POST routes that take a JSON body.
+    void serve_json_post(const httplib::Request& request,
+                         httplib::Response& response,
+                         const CallHandler& handler,
+                         const char* route,
+                         const char* failure_message) const;
     bool authorize_request(const httplib::Request& request, httplib::Response& response) const;
+    // Requests forwarded by another node authenticate with CLUSTER_SECRET
+    // instead of AUTHORIZATION_TOKEN, and are refused without one.
+    bool authorize_forwarded(const httplib::Request& request, httplib::Response& response) const;
     void write_json(httplib::Response& response, const RestResponse& payload) const;
 
     const Config& config_;
     CallHandler on_call_;
     TransferHandler on_transfer_;
+    HealthHandler on_health_;
+    CallHandler on_batch_;
+    DialStatusHandler on_dial_status_;
+    std::atomic<bool> ready_{false};
     std::unique_ptr<httplib::Server> server_;
     std::thread server_thread_;
 };
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+#include "sip_gateway/metrics.hpp"
+
+namespace sip_gateway {
+
+struct AdmissionOptions {
+    size_t max_calls = 64;
+    // Seconds of VAD inference per second the node can sustain.
+    double vad_cpu_cores = 3.2;
+    // Backend lane tasks waiting in the worker pool.
+    size_t max_backlog = 256;
+    double backend_p95_sec = 3.0;
+    // Rates and the backend p95 are taken over this trailing window.
+    std::chrono::steady_clock::duration window = std::chrono::seconds(10);
+    // How often the owner calls sample().
+    std::chrono::steady_clock::duration sample_interval = std::chrono::seconds(1);
+};
+
+struct LoadSample {
+    size_t live_calls = 0;
+    double vad_cpu_cores = 0.0;
+    size_t backlog = 0;
+    // Unset until the window holds enough backend requests.
+    std::optional<double> backend_p95_sec;
+};
+
+// Each signal as a fraction of its budget; score is the largest of them.
+struct LoadReport {
+    LoadSample sample;
+    double calls = 0.0;
+    double vad_cpu = 0.0;
+    double backlog = 0.0;
+    double backend_latency = 0.0;
+    double score = 0.0;
+    const char* limiting = "calls";
+
+    bool over_budget() const { return score >= 1.0; }
+};
+
+// Scores the node's load from live calls, VAD inference time
+// (vad_inference), the worker pool's backend backlog and the p95 of
+// backend REST requests (backend_request_{reused,new}_conn). A node whose
+// score reaches 1 should take no new calls.
+class AdmissionController {
+public:
+    explicit AdmissionController(AdmissionOptions options);
+
+    AdmissionController(const AdmissionController&) = delete;
+    AdmissionController& operator=(const AdmissionController&) = delete;
+
+    LoadReport assess(const LoadSample& sample) const;
+    // Records the metrics the window is measured from. The owner calls it
+    // every sample_interval, so the window stays full however rarely
+    // evaluate() runs. Thread-safe.
+    void sample();
+    // Adds VAD time and the backend p95 since the oldest sample in the
+    // window to the caller's counts and assesses the result; publishes the
+    // admission_load gauge. Thread-safe.
+    LoadReport evaluate(size_t live_calls, size_t backlog);
+
+private:
+    struct Snapshot {
+        std::chrono::steady_clock::time_point at;
+        double vad_sec = 0.0;
+        Metrics::Histogram::FineCounts backend{};
+    };
+
+    static Snapshot take_snapshot();
+
+    AdmissionOptions options_;
+    std::mutex mutex_;
+    // One snapshot per sample(), oldest first, spanning at most the window.
+    std::deque<Snapshot> history_;
+};
+
+}
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
 #include <memory>
 #include <optional>
 #include <string>
@@ -8,9 +11,16 @@
 #include <unordered_map>
 #include <mutex>
 
+#include "sip_gateway/audio/media_partition.hpp"
+#include "sip_gateway/audio/tts_cache.hpp"
 #include "sip_gateway/backend/client.hpp"
 #include "sip_gateway/config.hpp"
 #include "sip_gateway/sip/account.hpp"
+#include "sip_gateway/sip/admission.hpp"
+#include "sip_gateway/sip/call_registry.hpp"
+#include "sip_gateway/sip/cluster_registry.hpp"
+#include "sip_gateway/sip/dial_queue.hpp"
+#include "sip_gateway/sip/job_queue.hpp"
 #include "sip_gateway/server/rest_server.hpp"
 #include <nlohmann/json.hpp>
 #include <pjsua2.hpp>
@@ -19,7 +29,9 @@ namespace sip_gateway {
 
 class SipAccount;
 class SipCall;
+class TtsScheduler;
 namespace vad {
+class VadBatchScheduler;
 class VadModel;
 }
 
@@ -31,16 +43,39 @@ public:
     void run();
     void stop();
     const Config& config() const;
-    std::string synthesize_session_audio(const std::string& session_id,
-                                         const std::string& text);
-    std::string transcribe_audio(const std::string& wav_bytes);
-    nlohmann::json start_session_text(const std::string& session_id,
-                                      const std::string& text);
+    // A deadline aborts the request (BackendDeadlineError) once it passes.
+    std::string synthesize_session_audio(
+        const std::string& session_id,
+        const std::string& text,
+        std::optional<std::chrono::steady_clock::time_point> deadline = std::nullopt);
+    void stream_session_audio(const std::string& session_id,
+                              const std::string& text,
+                              const std::function<bool(const char*, size_t)>& receiver);
+    std::string transcribe_audio(
+        const std::string& audio,
+        const std::string& content_type,
+        std::optional<std::chrono::steady_clock::time_point> deadline = std::nullopt);
+    nlohmann::json start_session_text(
+        const std::string& session_id,
+        const std::string& text,
+        std::optional<std::chrono::steady_clock::time_point> deadline = std::nullopt);
     nlohmann::json commit_session(const std::string& session_id);
     nlohmann::json rollback_session(const std::string& session_id);
     void close_session(const std::string& session_id,
                        const std::optional<std::string>& status);
     std::shared_ptr<vad::VadModel> vad_model() const;
+    // Null unless VAD_BATCH_MAX > 1.
+    std::shared_ptr<vad::VadBatchScheduler> vad_batch_scheduler() const;
+    // Null unless TTS_SCHEDULER is set.
+    std::shared_ptr<TtsScheduler> tts_scheduler() const;
+    // Null unless MEDIA_PARTITIONS is set.
+    audio::MediaPartitionPool* media_partitions() const;
+    // STT_STREAMING is set and the backend advertised "stt_streaming".
+    bool stt_streaming() const;
+    // Runs a PJSUA operation on the SIP event loop when it is event-driven,
+    // otherwise inline. Blocks until the job has run and rethrows its error.
+    // Not for use from PJSIP callbacks.
+    void run_on_sip_thread(const std::function<void()>& job);
 
 private:
     friend class SipAccount;
@@ -52,36 +87,95 @@ private:
     };
 
     void init_pjsip();
+    void create_account();
     void init_vad();
     void shutdown_pjsip();
-    int handle_events();
+    int handle_events(int timeout_ms);
     void handle_incoming_call(const std::shared_ptr<SipCall>& call, const std::string& from_uri);
+    void answer_incoming_call(const std::shared_ptr<SipCall>& call,
+                              std::chrono::steady_clock::time_point setup_start);
     void handle_call_disconnected(int call_id);
     void register_call(const std::shared_ptr<SipCall>& call);
     void unregister_call(int call_id);
+    // Leaves the entry alone once the id belongs to a newer call.
+    void unregister_call(const std::shared_ptr<SipCall>& call);
     void bind_session(const std::shared_ptr<SipCall>& call, const std::string& session_id);
+    LoadReport load_report();
+    // False when ADMISSION_CONTROL is set and the node is over budget; the
+    // rejection is logged and counted under source.
+    bool admit_call(const char* source);
+    nlohmann::json health_payload();
+    // Publishes call_memory_bytes{kind} (summed over live calls) and
+    // call_memory_max_bytes every few seconds until stop().
+    void schedule_call_memory_report();
+    void report_call_memory();
+    // Samples the admission window every second until stop().
+    void schedule_admission_sample();
+    // Cluster mode (CLUSTER_MODE): this node's sessions and load are PUT to
+    // the backend's /cluster/nodes/<node id> every heartbeat and shortly
+    // after a session starts or ends.
+    void schedule_cluster_heartbeat();
+    void request_cluster_publish();
+    void publish_cluster_node();
+    // POSTs body to path on the node that owns session_id and relays its
+    // answer; nullopt when no other node owns the session.
+    std::optional<RestResponse> forward_to_owner(const std::string& session_id,
+                                                 const std::string& path,
+                                                 const nlohmann::json& body);
 
     BackendSession create_backend_session(const std::string& user_id,
                                           const std::string& name,
                                           const std::string& conversation_id,
                                           const nlohmann::json& kwargs,
                                           const std::optional<std::string>& communication_id);
+    // Places the call now, or queues it when "async" is set.
     RestResponse handle_call_request(const nlohmann::json& body);
+    // POST /calls: {"calls": [<call body>, ...]}, all queued.
+    RestResponse handle_batch_call_request(const nlohmann::json& body);
+    RestResponse handle_dial_status_request(const std::string& request_id);
+    RestResponse queue_calls(std::vector<nlohmann::json> requests, bool batch);
+    // Creates the backend session and dials; returns the session id.
+    std::string place_call(const nlohmann::json& body);
+    // Live and dialing calls stay under SIP_MAX_CALLS and, with admission
+    // control on, the node is under its load budget.
+    bool has_dial_capacity(size_t dialing);
+    // POSTs the attempt to its "callback_url", if any. Callbacks for one
+    // attempt are sent one at a time in the order reported.
+    void report_dial_status(const DialAttempt& attempt);
+    void send_dial_callbacks(const std::string& id);
+    // A session this node does not hold is forwarded to its owner in
+    // cluster mode, unless the request was itself forwarded.
     RestResponse handle_transfer_request(const std::string& session_id,
-                                         const nlohmann::json& body);
+                                         const nlohmann::json& body,
+                                         bool forwarded);
 
     const std::string& backend_url() const;
 
     Config config_;
     BackendClient backend_client_;
+    audio::TtsCache tts_cache_;
+    AdmissionController admission_;
+    bool stt_streaming_ = false;
     std::unique_ptr<pj::Endpoint> endpoint_;
     std::unique_ptr<SipAccount> account_;
     std::shared_ptr<vad::VadModel> vad_model_;
-    std::unordered_map<int, std::shared_ptr<SipCall>> calls_;
-    std::unordered_map<std::string, int> session_calls_;
-    std::mutex calls_mutex_;
+    std::shared_ptr<vad::VadBatchScheduler> vad_batch_scheduler_;
+    std::shared_ptr<TtsScheduler> tts_scheduler_;
+    CallRegistry<SipCall> calls_;
     std::atomic<bool> quitting_{false};
+    std::unique_ptr<DialQueue> dial_queue_;
+    struct DialCallback {
+        std::string url;
+        std::string payload;
+    };
+    std::mutex dial_callbacks_mutex_;
+    // Unsent callbacks by request id; an entry exists while its sender runs.
+    std::unordered_map<std::string, std::deque<DialCallback>> dial_callbacks_;
+    std::unique_ptr<ClusterRegistry> cluster_; // Set in cluster mode.
+    std::unique_ptr<audio::MediaPartitionPool> media_partitions_;
+    std::atomic<bool> cluster_publish_pending_{false};
     std::unique_ptr<RestServer> rest_server_;
+    SipJobQueue sip_jobs_;
 };
 
 }
@@ -3,6 +3,8 @@
 #include <atomic>
 #include <filesystem>
 #include <chrono>
+#include <functional>
+#include <future>
 #include <memory>
 #include <mutex>
 #include <optional>
@@ -12,18 +14,27 @@
 #include <pjsua2.hpp>
 #include <nlohmann/json.hpp>
 
+#include "sip_gateway/audio/media_partition.hpp"
 #include "sip_gateway/audio/player.hpp"
 #include "sip_gateway/audio/port.hpp"
 #include "sip_gateway/audio/recorder.hpp"
+#include "sip_gateway/audio/segment.hpp"
+#include "sip_gateway/backend/stt_stream.hpp"
 #include "sip_gateway/backend/ws_client.hpp"
+#include "sip_gateway/sip/call_trace.hpp"
 #include "sip_gateway/sip/tts_pipeline.hpp"
+#include "sip_gateway/sip/turn_trace.hpp"
+#include "sip_gateway/utils/buffer_pool.hpp"
+#include "sip_gateway/utils/timer.hpp"
 #include "sip_gateway/vad/processor.hpp"
 
 namespace sip_gateway {
 
 class SipApp;
 
-class SipCall : public pj::Call {
+// Calls are always shared: work that outlives the current callback (timers,
+// TTS tasks) holds a weak reference and does nothing once the call is gone.
+class SipCall : public pj::Call, public std::enable_shared_from_this<SipCall> {
 public:
     enum class CallState {
         WaitForUser,
@@ -32,18 +43,34 @@ public:
         Finished
     };
 
+    // Bytes of call audio held in memory, by owner.
+    struct MemoryUsage {
+        size_t vad = 0;      // VAD rings and windows.
+        size_t segments = 0; // Utterance segments, held or pooled.
+        size_t uploads = 0;  // Pooled upload encode buffers.
+        size_t tts = 0;      // Synthesized audio waiting to play.
+
+        size_t total() const { return vad + segments + uploads + tts; }
+    };
+
     SipCall(SipApp& app,
             pj::Account& account,
             std::string backend_url,
             int call_id = PJSUA_INVALID_ID);
     ~SipCall() override;
 
+    // The way to make a call: the TTS pipeline is tied to the shared call.
+    static std::shared_ptr<SipCall> create(SipApp& app,
+                                           pj::Account& account,
+                                           std::string backend_url,
+                                           int call_id = PJSUA_INVALID_ID);
+
     void set_session_id(const std::string& session_id);
     const std::optional<std::string>& session_id() const;
 
     void make_call(const std::string& to_uri);
     void answer(int status_code);
-    void hangup(int status_code);
+    void hangup(int status_code, const pj::SipHeaderVector& headers = {});
     void set_transfer_target(const std::string& to_uri, double delay_sec);
 
     void connect_ws(BackendWsClient::MessageHandler on_message,
@@ -51,6 +78,21 @@ public:
                     BackendWsClient::EventHandler on_close);
     void stop_ws();
     void set_greeting(std::optional<std::string> greeting);
+    // Starts synthesizing the greeting before the call is answered. Returns
+    // false when there is nothing to prepare or it must wait for media.
+    bool prepare_greeting();
+    // Runs answer on a worker once the greeting is synthesized, or when
+    // timeout passes first; never waits. answer runs at most once, and not
+    // at all if the call is gone.
+    void answer_when_greeting_ready(std::chrono::milliseconds timeout,
+                                    std::function<void(bool greeting_ready)> answer);
+    bool is_disconnected() const;
+    // Runs fn under the lock that marks the call disconnected, so it either
+    // finishes before the hangup is handled or does not run. Returns whether
+    // it ran.
+    bool run_unless_disconnected(const std::function<void()>& fn);
+    // Safe from any thread.
+    MemoryUsage memory_usage() const;
 
     void handle_ws_message(const nlohmann::json& message);
     void handle_ws_timeout();
@@ -59,25 +101,55 @@ public:
     void onCallState(pj::OnCallStateParam& prm) override;
     void onCallMediaState(pj::OnCallMediaStateParam& prm) override;
     void onCallTransferStatus(pj::OnCallTransferStatusParam& prm) override;
+    // MEDIA_PARTITIONS: the codec stream is moved onto the call's partition
+    // and the media ports attach there instead of to the pjsua bridge.
+    void onStreamCreated(pj::OnStreamCreatedParam& prm) override;
+    void onStreamDestroyed(pj::OnStreamDestroyedParam& prm) override;
 
 private:
     void open_media();
+    // VAD_NARROWBAND: 8 kHz when the active audio codec is narrowband,
+    // otherwise VAD_SAMPLING_RATE.
+    int media_sampling_rate() const;
     void close_media();
+    // Connects open media to a stream recreated on the call's partition.
+    void reconnect_partition_media();
+    void detach_from_partition();
     void set_state(CallState state);
-    void handle_audio_frame(const std::vector<int16_t>& data);
-    void on_vad_speech_start(const std::vector<float>& audio, double start, double duration);
-    void on_vad_speech_end(const std::vector<float>& audio, double start, double duration);
-    void on_vad_short_pause(const std::vector<float>& audio, double start, double duration);
-    void on_vad_long_pause(const std::vector<float>& audio, double start, double duration);
+    void handle_audio_frame(const int16_t* samples, size_t count);
+    void on_vad_speech_start(const audio::AudioSegment& audio, double start, double duration);
+    void on_vad_speech_end(const audio::AudioSegment& audio, double start, double duration);
+    void on_vad_short_pause(const audio::AudioSegment& audio, double start, double duration);
+    void on_vad_long_pause(const audio::AudioSegment& audio, double start, double duration);
     void on_vad_user_silence_timeout(double current_time);
-    std::string encode_wav(const std::vector<float>& audio) const;
-    std::string transcribe_audio(const std::vector<float>& audio) const;
-    void start_session_text(const std::string& text);
+    // BACKEND_TURN_DEADLINE_MS after the current turn's end of speech, or
+    // nullopt when the budget is off. One deadline covers the turn's
+    // transcription, start request and first synthesized clause.
+    std::optional<std::chrono::steady_clock::time_point> turn_deadline();
+    std::string transcribe_audio(
+        const std::vector<float>& audio,
+        const std::optional<std::chrono::steady_clock::time_point>& deadline) const;
+    // Waits for the streamed transcript, falling back to /transcribe.
+    std::string transcribe_utterance(
+        const std::vector<float>& audio,
+        std::optional<uint64_t> stt_request,
+        const std::optional<std::chrono::steady_clock::time_point>& deadline) const;
+    // Reuses the short-pause transcript when the long pause adds no speech.
+    std::string transcribe_long_pause(
+        const std::vector<float>& audio,
+        const vad::PauseInfo& pause,
+        std::optional<uint64_t> stt_request,
+        const std::optional<std::chrono::steady_clock::time_point>& deadline);
+    void start_session_text(
+        const std::string& text,
+        const std::optional<std::chrono::steady_clock::time_point>& deadline);
     void commit_session();
     void rollback_session();
     void handle_playback_finished();
     bool start_transfer();
     void schedule_soft_hangup();
+    void run_pending_answer(bool greeting_ready);
+    void cancel_timers();
     bool ai_can_speak() const;
     bool is_active_ai_speech() const;
     bool has_tts_queue() const;
@@ -85,11 +157,34 @@ private:
     void cancel_tts_queue();
     void enqueue_tts_text(const std::string& text, double delay_sec = 0.0);
     void try_play_tts();
-    std::filesystem::path make_tts_path() const;
     std::string recording_basename() const;
-    std::optional<std::filesystem::path> synthesize_tts_text(
+    std::optional<TtsPipeline::Audio> synthesize_tts_text(
+        const std::string& text,
+        const std::shared_ptr<std::atomic<bool>>& canceled,
+        const TtsPipeline::PublishFn& publish);
+    // Downloads on the calling task and publishes the stream once prebuffered.
+    std::optional<TtsPipeline::Audio> stream_tts_text(
         const std::string& text,
-        const std::shared_ptr<std::atomic<bool>>& canceled);
+        const std::shared_ptr<std::atomic<bool>>& canceled,
+        const TtsPipeline::PublishFn& publish,
+        const std::optional<std::chrono::steady_clock::time_point>& response_start);
+    void finish_response_generation(
+        const std::optional<std::chrono::steady_clock::time_point>& response_start);
+    // Turn tracing (TURN_TRACE): a trace starts at VAD end of speech and is
+    // finished by the next speech start, the next end of speech or hangup.
+    void begin_turn_trace();
+    void finish_turn_trace(bool barge_in);
+    void mark_turn(TurnTrace::Stage stage,
+                   TurnTrace::Clock::time_point at = TurnTrace::Clock::now()) const;
+    // Null while media is closed. Safe from any thread; tasks that outlive
+    // the current callback hold the returned player, not the call.
+    std::shared_ptr<audio::SmartPlayer> player() const;
+    // Call capture (CALL_TRACE): null until media opens with tracing on.
+    std::shared_ptr<CallTraceWriter> call_trace() const;
+    void trace_vad(CallTraceRecord::VadEvent event, double start, double duration) const;
+    // Runs a backend request and records its time in the call trace.
+    template <typename Fn>
+    auto traced_backend(const char* endpoint, Fn&& fn) const;
 
     SipApp& app_;
     BackendWsClient ws_client_;
@@ -102,18 +197,58 @@ private:
     std::optional<std::string> close_status_;
     std::mutex transfer_mutex_;
     std::atomic<bool> media_active_ = false; // Media is attached and active.
+    int sampling_rate_; // Rate of the media port and VAD; fixed once media opens.
+    std::atomic<bool> greeting_queued_ = false; // Greeting already in the TTS pipeline.
+    std::atomic<bool> disconnected_ = false; // PJSIP reported DISCONNECTED.
+    std::mutex disconnect_mutex_; // Held while disconnected_ is set.
     bool user_speaking_ = false; // VAD currently reports user speech.
     bool soft_hangup_pending_ = false; // Hangup timer scheduled.
+    std::atomic<utils::TimerService::TimerId> soft_hangup_timer_ =
+        utils::TimerService::kInvalidTimer;
+    std::atomic<utils::TimerService::TimerId> transfer_hangup_timer_ =
+        utils::TimerService::kInvalidTimer;
+    std::atomic<utils::TimerService::TimerId> answer_timer_ =
+        utils::TimerService::kInvalidTimer;
+    std::mutex answer_mutex_;
+    std::function<void(bool)> pending_answer_; // Guarded by answer_mutex_.
+    std::atomic<bool> answer_pending_ = false; // Lets try_play_tts skip the lock.
     std::string last_unstable_transcription_;
     std::optional<std::chrono::steady_clock::time_point> start_reply_generation_;
     std::optional<std::chrono::steady_clock::time_point> start_response_generation_;
+    // End of speech of the current turn; guarded by generation_mutex_.
+    std::optional<std::chrono::steady_clock::time_point> turn_end_of_speech_;
     std::unique_ptr<pj::AudioMedia> audio_media_;
     std::unique_ptr<audio::AudioMediaPort> media_port_;
     std::unique_ptr<audio::CallRecorder> recorder_;
-    std::unique_ptr<audio::SmartPlayer> player_;
+    mutable std::mutex player_mutex_;
+    std::shared_ptr<audio::SmartPlayer> player_; // Guarded by player_mutex_.
+    // Partition slots, -1 when absent. The partition is picked by the first
+    // stream and kept for the call.
+    audio::MediaPartition* media_partition_ = nullptr;
+    int stream_slot_ = -1;
+    bool media_partitioned_ = false; // Media opened on the partition.
+    int rx_slot_ = -1;
+    int recorder_caller_slot_ = -1;
+    int recorder_playback_slot_ = -1;
     std::unique_ptr<TtsPipeline> tts_pipeline_;
+    std::unique_ptr<SttStream> stt_stream_; // Set for the call's lifetime when streaming STT.
     std::unique_ptr<vad::StreamingVadProcessor> vad_processor_;
+    std::atomic<size_t> vad_memory_bytes_ = 0; // Refreshed by the audio thread.
+    // Per-call scratch reused across turns; emptied when media closes.
+    std::shared_ptr<vad::StreamingVadProcessor::SegmentPool> segment_pool_ =
+        std::make_shared<vad::StreamingVadProcessor::SegmentPool>();
+    std::shared_ptr<utils::BufferPool<std::string>> upload_pool_ =
+        std::make_shared<utils::BufferPool<std::string>>();
     std::mutex generation_mutex_;
+    struct PauseTranscript {
+        vad::PauseInfo pause;
+        std::shared_future<std::string> text;
+    };
+    std::optional<PauseTranscript> short_pause_transcript_; // Guarded by generation_mutex_.
+    mutable std::mutex turn_trace_mutex_;
+    std::shared_ptr<TurnTrace> turn_trace_; // Guarded by turn_trace_mutex_.
+    mutable std::mutex call_trace_mutex_;
+    std::shared_ptr<CallTraceWriter> call_trace_; // Guarded by call_trace_mutex_.
     bool start_in_flight_ = false; // Speculative start request in progress.
     bool commit_in_flight_ = false; // Commit request in progress.
     bool spec_active_ = false; // Speculative session is active.
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace sip_gateway {
+
+// Live calls by PJSUA call id and by backend session id, published as
+// immutable snapshots. Writers copy the snapshot, change the copy and
+// publish it under a mutex that only writers take; with at most
+// SIP_MAX_CALLS entries the copy is cheap next to call setup. Readers never
+// take that mutex, so a REST lookup does not wait out a writer's copy.
+// The atomic shared_ptr functions are not lock-free in libstdc++: a load
+// or store takes a mutex from a small address-hashed pool for the
+// pointer copy and refcount bump only, so readers can still briefly wait
+// on a publish or on an unrelated shared_ptr hashed to the same lock.
+template <typename Call>
+class CallRegistry {
+public:
+    struct Entry {
+        std::shared_ptr<Call> call;
+        std::optional<std::string> session_id;
+    };
+
+    struct Snapshot {
+        std::unordered_map<int, Entry> calls;
+        std::unordered_map<std::string, int> sessions;
+    };
+
+    CallRegistry() : current_(std::make_shared<const Snapshot>()) {}
+
+    CallRegistry(const CallRegistry&) = delete;
+    CallRegistry& operator=(const CallRegistry&) = delete;
+
+    // Stays valid, and unchanged, while the caller holds it.
+    std::shared_ptr<const Snapshot> snapshot() const {
+        return std::atomic_load_explicit(&current_, std::memory_order_acquire);
+    }
+
+    size_t size() const { return snapshot()->calls.size(); }
+
+    std::shared_ptr<Call> find(int call_id) const {
+        const auto current = snapshot();
+        const auto it = current->calls.find(call_id);
+        return it == current->calls.end() ? nullptr : it->second.call;
+    }
+
+    std::shared_ptr<Call> find_session(const std::string& session_id) const {
+        const auto current = snapshot();
+        const auto it = current->sessions.find(session_id);
+        if (it == current->sessions.end()) {
+            return nullptr;
+        }
+        const auto call_it = current->calls.find(it->second);
+        return call_it == current->calls.end() ? nullptr : call_it->second.call;
+    }
+
+    // Adds or replaces the call. Without a session id, a session already
+    // bound to this call id is kept.
+    void insert(int call_id, std::shared_ptr<Call> call,
+                std::optional<std::string> session_id = std::nullopt) {
+        update([&](Snapshot& next) {
+            auto& entry = next.calls[call_id];
+            if (session_id && entry.session_id && *entry.session_id != *session_id) {
+                next.sessions.erase(*entry.session_id);
+            }
+            entry.call = std::move(call);
+            if (session_id) {
+                entry.session_id = session_id;
+                next.sessions[*session_id] = call_id;
+            }
+        });
+    }
+
+    // Returns the removed call, or null when it was not registered.
+    std::shared_ptr<Call> erase(int call_id) {
+        return erase_if(call_id, nullptr);
+    }
+
+    // Removes the entry only while it still holds this call: PJSUA reuses
+    // call ids, so a late cleanup must not remove a newer call.
+    bool erase(int call_id, const std::shared_ptr<Call>& call) {
+        return call && erase_if(call_id, call.get()) != nullptr;
+    }
+
+    // Empties the registry and returns what it held.
+    std::shared_ptr<const Snapshot> clear() {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        auto previous = std::atomic_load_explicit(&current_, std::memory_order_acquire);
+        std::atomic_store_explicit(&current_, std::make_shared<const Snapshot>(),
+                                   std::memory_order_release);
+        return previous;
+    }
+
+private:
+    // Removes call_id's entry, when expected is null or matches it.
+    std::shared_ptr<Call> erase_if(int call_id, const Call* expected) {
+        std::shared_ptr<Call> removed;
+        update([&](Snapshot& next) {
+            const auto it = next.calls.find(call_id);
+            if (it == next.calls.end() || (expected && it->second.call.get() != expected)) {
+                return;
+            }
+            removed = std::move(it->second.call);
+            if (it->second.session_id) {
+                const auto session = next.sessions.find(*it->second.session_id);
+                if (session != next.sessions.end() && session->second == call_id) {
+                    next.sessions.erase(session);
+                }
+            }
+            next.calls.erase(it);
+        });
+        return removed;
+    }
+
+    template <typename Fn>
+    void update(Fn&& change) {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        auto next = std::make_shared<Snapshot>(
+            *std::atomic_load_explicit(&current_, std::memory_order_relaxed));
+        change(*next);
+        std::atomic_store_explicit(&current_, std::shared_ptr<const Snapshot>(std::move(next)),
+                                   std::memory_order_release);
+    }
+
+    std::mutex write_mutex_;
+    std::shared_ptr<const Snapshot> current_;
+};
+
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace sip_gateway {
+
+// One entry of a call trace (CALL_TRACE). wall_sec is the time since the
+// trace was opened; VAD event times are in the VAD's own media time.
+struct CallTraceRecord {
+    enum class Kind : uint8_t {
+        Audio = 1,
+        WsMessage = 2,
+        Backend = 3,
+        Vad = 4,
+    };
+    enum class VadEvent : uint8_t {
+        SpeechStart,
+        SpeechEnd,
+        ShortPause,
+        LongPause,
+        SilenceTimeout,
+    };
+
+    Kind kind = Kind::Audio;
+    double wall_sec = 0.0;
+    std::vector<int16_t> samples; // Audio: caller PCM as handed to the VAD.
+    std::string text;             // WsMessage: the JSON; Backend: the endpoint.
+    double start_sec = 0.0;       // Vad
+    double duration_sec = 0.0;    // Backend: request time; Vad: segment length.
+    bool ok = true;               // Backend
+    VadEvent vad = VadEvent::SpeechStart;
+
+    static const char* vad_event_name(VadEvent event);
+};
+
+// Appends records to a compact binary trace: a header with the sample
+// rate, then per record a kind byte, the wall-time delta and the payload,
+// with integers as LEB128 varints. Writes are buffered and flushed every
+// 64 KiB, so a trace costs about one write per two seconds of 16 kHz
+// audio. Thread-safe.
+class CallTraceWriter {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Throws std::runtime_error when the file cannot be created.
+    CallTraceWriter(std::filesystem::path path, uint32_t sample_rate);
+    ~CallTraceWriter();
+
+    CallTraceWriter(const CallTraceWriter&) = delete;
+    CallTraceWriter& operator=(const CallTraceWriter&) = delete;
+
+    const std::filesystem::path& path() const;
+
+    void audio(const int16_t* samples, size_t count);
+    void ws_message(const std::string& json);
+    void backend(const std::string& endpoint, Clock::duration duration, bool ok);
+    void vad(CallTraceRecord::VadEvent event, double start_sec, double duration_sec);
+    void close();
+
+private:
+    // Starts a record; mutex_ must be held.
+    void begin(CallTraceRecord::Kind kind);
+    void flush_locked();
+
+    std::filesystem::path path_;
+    std::mutex mutex_;
+    std::ofstream out_;
+    std::string buffer_;
+    Clock::time_point last_;
+    bool closed_ = false;
+};
+
+// Reads a trace written by CallTraceWriter.
+class CallTraceReader {
+public:
+    // Throws std::runtime_error when the file is missing or not a trace.
+    explicit CallTraceReader(const std::filesystem::path& path);
+
+    uint32_t sample_rate() const;
+    // False at the end of the trace. Throws std::runtime_error on a
+    // truncated or unknown record.
+    bool next(CallTraceRecord& record);
+
+private:
+    std::ifstream in_;
+    uint32_t sample_rate_ = 0;
+    uint64_t wall_us_ = 0;
+};
+
+}
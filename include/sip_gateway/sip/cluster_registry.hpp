@@ -0,0 +1,80 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "sip_gateway/sip/admission.hpp"
+
+namespace sip_gateway {
+
+struct ClusterOptions {
+    std::string node_id;
+    // Base URL other nodes use to reach this node's REST API.
+    std::string advertise_url;
+    std::chrono::seconds heartbeat = std::chrono::seconds(5);
+    // Owners found by lookup are reused for this long; sessions do not move
+    // between nodes, so only a node restart makes an entry stale.
+    std::chrono::seconds owner_cache_ttl = std::chrono::seconds(30);
+    size_t max_cached_owners = 4096;
+    // Base URLs of the nodes requests may be forwarded to. The shared
+    // registry is not trusted to say where a forwarded request (and the
+    // cluster secret) goes, so an owner at any other URL is refused.
+    std::vector<std::string> peers;
+};
+
+struct ClusterNode {
+    std::string node_id;
+    std::string url;
+};
+
+// This node's view of the gateway cluster. Nodes publish their live
+// sessions and load to a shared registry (the backend's /cluster API) with
+// node_record(); a node asked about a session it does not hold finds the
+// owner with remote_owner() and forwards the request there.
+class ClusterRegistry {
+public:
+    // The node that owns session_id, or nullopt when none does; may throw.
+    using LookupFn = std::function<std::optional<ClusterNode>(const std::string& session_id)>;
+
+    ClusterRegistry(ClusterOptions options, LookupFn lookup);
+
+    ClusterRegistry(const ClusterRegistry&) = delete;
+    ClusterRegistry& operator=(const ClusterRegistry&) = delete;
+
+    const ClusterOptions& options() const;
+
+    // The record published on each heartbeat. The registry should drop it
+    // once ttl_sec passes without a new one.
+    nlohmann::json node_record(const std::vector<std::string>& sessions,
+                               const LoadReport& load) const;
+
+    // Owner on another node, or nullopt when the session is unknown, the
+    // lookup failed, this node is the owner or the owner is not one of the
+    // peers. Thread safe.
+    std::optional<ClusterNode> remote_owner(const std::string& session_id);
+    // Drops a cached owner, e.g. after it no longer knew the session.
+    void forget(const std::string& session_id);
+
+private:
+    struct CachedOwner {
+        ClusterNode node;
+        std::chrono::steady_clock::time_point expires;
+    };
+
+    void prune_locked(std::chrono::steady_clock::time_point now);
+
+    ClusterOptions options_;
+    LookupFn lookup_;
+    std::mutex mutex_;
+    std::unordered_map<std::string, CachedOwner> owners_;
+};
+
+}
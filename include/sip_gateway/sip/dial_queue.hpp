@@ -0,0 +1,137 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace sip_gateway {
+
+struct DialQueueOptions {
+    // Call attempts started per second; zero does not pace them.
+    double calls_per_second = 5.0;
+    // Attempts setting up (backend session and INVITE) at once.
+    size_t max_dialing = 8;
+    size_t max_queued = 1000;
+    // Finished attempts kept for polling, oldest dropped first.
+    size_t history = 1000;
+    // How often a queue held back by capacity checks again without notify().
+    std::chrono::milliseconds capacity_poll{250};
+};
+
+enum class DialStatus {
+    Queued,
+    Dialing,
+    Placed,
+    Failed
+};
+
+const char* to_string(DialStatus status);
+
+struct DialAttempt {
+    std::string id;
+    // The /call body the attempt was queued with.
+    nlohmann::json request;
+    DialStatus status = DialStatus::Queued;
+    std::optional<std::string> session_id;
+    std::string error;
+    std::chrono::steady_clock::time_point queued_at;
+    std::optional<std::chrono::steady_clock::time_point> started_at;
+
+    bool finished() const {
+        return status == DialStatus::Placed || status == DialStatus::Failed;
+    }
+    nlohmann::json to_json() const;
+};
+
+// Outbound calls requested through the REST API, started in order at a
+// paced rate by one dispatcher thread. An attempt waits in the queue while
+// max_dialing attempts are setting up or the capacity check says the node
+// is full, so a campaign burst neither blocks REST workers nor overruns
+// SIP_MAX_CALLS. Queued attempts and recent results can be polled by id.
+class DialQueue {
+public:
+    // Places the call and returns its backend session id; throws on failure.
+    using DialFn = std::function<std::string(const nlohmann::json& request)>;
+    // Whether the node can take one more call while dialing attempts are
+    // still setting up.
+    using CapacityFn = std::function<bool(size_t dialing)>;
+    // Called on every status change, off the queue's lock. Calls for one
+    // attempt never overlap and arrive in the order the changes happened,
+    // though not always on the thread that made the change.
+    using StatusFn = std::function<void(const DialAttempt& attempt)>;
+    // Runs an attempt off the dispatcher thread; SipApp passes
+    // utils::run_async. Returns false when the task was dropped, which fails
+    // the attempt.
+    using Executor = std::function<bool(std::function<void()>)>;
+
+    DialQueue(DialQueueOptions options,
+              DialFn dial,
+              CapacityFn has_capacity,
+              Executor executor,
+              StatusFn on_status = {});
+    ~DialQueue();
+
+    DialQueue(const DialQueue&) = delete;
+    DialQueue& operator=(const DialQueue&) = delete;
+
+    // Queues every request in order and returns their ids, or queues none
+    // and returns nullopt when they do not all fit.
+    std::optional<std::vector<std::string>> enqueue(std::vector<nlohmann::json> requests);
+    std::optional<DialAttempt> find(const std::string& id) const;
+    // Capacity may have freed up, e.g. a call ended.
+    void notify();
+    // Stops dispatching; attempts already dialing still finish.
+    void stop();
+
+    size_t queued() const;
+    size_t dialing() const;
+
+private:
+    void dispatch_loop();
+    void run(const std::string& id, const nlohmann::json& request);
+    void finish(const std::string& id,
+                const std::optional<std::string>& session_id,
+                const std::string& error);
+    std::string next_id_locked();
+    void publish_locked() const;
+    // Status changes are queued per attempt under the lock and handed to
+    // on_status by whichever caller of report() finds none in progress.
+    void queue_report_locked(const DialAttempt& attempt);
+    void report(const std::string& id);
+
+    DialQueueOptions options_;
+    DialFn dial_;
+    CapacityFn has_capacity_;
+    Executor executor_;
+    StatusFn on_status_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::unordered_map<std::string, DialAttempt> attempts_;
+    std::deque<std::string> queue_;
+    std::deque<std::string> finished_;
+    struct PendingReports {
+        std::deque<DialAttempt> attempts;
+        bool reporting = false;
+    };
+    std::unordered_map<std::string, PendingReports> reports_;
+    size_t dialing_ = 0;
+    std::chrono::steady_clock::time_point next_start_{};
+    std::mt19937_64 rng_{std::random_device{}()};
+    bool stopping_ = false;
+    std::thread thread_;
+};
+
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include <pjsua-lib/pjsua.h>
+
+namespace sip_gateway {
+
+// Cross-thread job queue drained by whichever thread polls the PJSIP ioqueue.
+// A loopback UDP socket registered with the ioqueue wakes a blocked
+// libHandleEvents() as soon as a job is posted.
+class SipJobQueue {
+public:
+    using Job = std::function<void()>;
+
+    SipJobQueue() = default;
+    ~SipJobQueue();
+
+    SipJobQueue(const SipJobQueue&) = delete;
+    SipJobQueue& operator=(const SipJobQueue&) = delete;
+
+    // Must be called after libStart(), from a PJSIP-registered thread.
+    bool start();
+    // Unregisters the socket and runs whatever is still queued.
+    void stop();
+    bool active() const;
+
+    // Returns false when the queue is not running; the job is not queued.
+    bool post(Job job);
+    size_t run_pending();
+    // True while the calling thread is executing a posted job.
+    static bool in_job();
+
+private:
+    static void on_read_complete(pj_ioqueue_key_t* key,
+                                 pj_ioqueue_op_key_t* op_key,
+                                 pj_ssize_t bytes_read);
+    void arm_read();
+    void wake();
+
+    std::mutex mutex_;
+    std::vector<Job> jobs_;
+    std::atomic<bool> active_{false};
+    std::atomic<bool> signalled_{false};
+    pj_pool_t* pool_ = nullptr;
+    pj_sock_t sock_ = PJ_INVALID_SOCKET;
+    pj_ioqueue_key_t* key_ = nullptr;
+    pj_ioqueue_op_key_t read_op_{};
+    pj_sockaddr_in addr_{};
+    char read_buf_[64] = {};
+};
+
+}
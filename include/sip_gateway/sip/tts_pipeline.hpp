@@ -1,6 +1,7 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <deque>
 #include <filesystem>
 #include <functional>
@@ -9,53 +10,118 @@
 #include <mutex>
 #include <optional>
 #include <string>
+#include <variant>
+#include <vector>
+
+#include "sip_gateway/utils/timer.hpp"
 
 namespace sip_gateway {
 
+namespace audio {
+class PcmStream;
+}
+
+class TtsScheduler;
+
+struct TtsChunkingOptions {
+    // Splits each enqueued text into clauses (utils::split_clauses) that are
+    // synthesized and played one after another.
+    bool enabled = false;
+    size_t min_chars = 20;
+    size_t max_chars = 150;
+};
+
 class TtsPipeline {
 public:
-    using SynthFn = std::function<std::optional<std::filesystem::path>(
+    // A synthesized WAV file, or a stream that is still being downloaded.
+    using Audio = std::variant<std::filesystem::path, std::shared_ptr<audio::PcmStream>>;
+    // Hands audio to playback while synthesis is still running, e.g. a
+    // stream once prebuffered. The synthesis result is then ignored.
+    using PublishFn = std::function<void(const Audio& audio)>;
+    using SynthFn = std::function<std::optional<Audio>(
         const std::string& text,
-        const std::shared_ptr<std::atomic<bool>>& canceled)>;
-    using ReadyFn = std::function<void(const std::filesystem::path& path,
+        const std::shared_ptr<std::atomic<bool>>& canceled,
+        const PublishFn& publish)>;
+    using ReadyFn = std::function<void(const Audio& audio,
                                        const std::string& text)>;
     using ReadySignalFn = std::function<void()>;
 
     TtsPipeline(int max_inflight,
                 SynthFn synth_fn,
                 ReadyFn ready_fn,
-                ReadySignalFn ready_signal_fn);
+                ReadySignalFn ready_signal_fn,
+                TtsChunkingOptions chunking = {});
+    ~TtsPipeline();
+
+    // The object the callbacks belong to, usually the call. Delayed enqueues
+    // and synthesis tasks hold it while they run and are dropped once it is
+    // gone, so they never run on a destroyed pipeline.
+    void set_owner(std::weak_ptr<void> owner);
+    // Hands syntheses to a process-wide scheduler; max_inflight then only
+    // bounds how far this call prefetches.
+    void set_scheduler(std::shared_ptr<TtsScheduler> scheduler);
+    // Holds back later chunks while synthesized audio waiting to play
+    // reaches bytes; zero is unbounded. The first chunk of a turn always
+    // starts.
+    void set_max_queued_bytes(size_t bytes);
 
     void enqueue(const std::string& text, double delay_sec);
     void cancel();
     bool has_queue() const;
+    // Waits until the oldest queued synthesis has finished or published.
+    bool wait_front_ready(std::chrono::milliseconds timeout) const;
     void try_play(bool can_play);
+    // PCM bytes of synthesized audio not yet handed to the player. Audio
+    // synthesized to a file is not held in memory and counts as zero.
+    size_t queued_bytes() const;
 
 private:
     struct TtsTask {
         std::string text;
-        std::shared_future<std::optional<std::filesystem::path>> future;
+        std::shared_future<std::optional<Audio>> future;
         std::shared_ptr<std::atomic<bool>> canceled;
+        // Set on the first chunk of a turn, which reports tts_first_audio.
+        std::optional<std::chrono::steady_clock::time_point> turn_start;
     };
 
     struct PendingTtsTask {
         std::string text;
-        std::shared_ptr<std::packaged_task<std::optional<std::filesystem::path>()>> task;
+        std::function<void()> run;
+        // Settles future with no audio when run is dropped unstarted.
+        std::function<void()> fail;
+        std::shared_future<std::optional<Audio>> future;
         std::shared_ptr<std::atomic<bool>> canceled;
+        bool turn_first = false;
+    };
+
+    // A weak reference to the owner, copied into each task.
+    struct OwnerRef {
+        std::weak_ptr<void> owner;
+        bool owned = false;
+
+        // False once the owner is gone; otherwise hold keeps it alive.
+        bool lock(std::shared_ptr<void>& hold) const;
     };
 
+    void cancel_delayed();
     void maybe_start_synthesis();
+    size_t queued_bytes_locked() const;
     void on_synthesis_finished();
 
     int max_inflight_;
+    TtsChunkingOptions chunking_;
     SynthFn synth_fn_;
     ReadyFn ready_fn_;
     ReadySignalFn ready_signal_fn_;
+    std::shared_ptr<TtsScheduler> scheduler_;
+    OwnerRef owner_;
 
     mutable std::mutex mutex_;
     std::deque<TtsTask> queue_;
     std::deque<PendingTtsTask> pending_;
     size_t inflight_ = 0;
+    size_t max_queued_bytes_ = 0;
+    std::vector<utils::TimerService::TimerId> delayed_;
 };
 
 }
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+namespace sip_gateway {
+
+struct AdaptiveLimitOptions {
+    size_t min_limit = 2;
+    size_t max_limit = 64;
+    size_t initial_limit = 8;
+    // A completion slower than tolerance times the baseline latency, or a
+    // failure, shrinks the limit by backoff.
+    double tolerance = 2.0;
+    double backoff = 0.75;
+};
+
+// AIMD concurrency limit driven by latency. The baseline follows faster
+// samples down at once and drifts up slowly. While the limit is being
+// reached, a limit's worth of on-time completions raises it by one. A
+// decrease is followed by a limit's worth of samples that cannot decrease
+// it again, since those requests started under the old limit.
+class AdaptiveLimit {
+public:
+    explicit AdaptiveLimit(AdaptiveLimitOptions options = {});
+
+    size_t limit() const;
+    double baseline() const;
+    // saturated: the limit was reached when the request started.
+    void on_sample(double seconds, bool saturated);
+    void on_failure();
+
+private:
+    void decrease();
+
+    AdaptiveLimitOptions options_;
+    double limit_;
+    double baseline_ = 0.0;
+    size_t on_time_ = 0;
+    size_t cooldown_ = 0;
+};
+
+// Process-wide queue for TTS synthesis requests from every call, run under
+// one AdaptiveLimit fed by their latency. A turn's first chunk is started
+// before any later chunk or prefetch; each priority is FIFO.
+class TtsScheduler {
+public:
+    enum class Priority { TurnFirst, Later };
+    enum class Outcome { Done, Failed, Cancelled };
+    using Task = std::function<Outcome()>;
+    // Runs a dispatched task off the caller's thread; SipApp passes
+    // utils::run_async. Returns false when the task was dropped.
+    using Executor = std::function<bool(std::function<void()>)>;
+
+    TtsScheduler(AdaptiveLimitOptions options, Executor executor);
+
+    TtsScheduler(const TtsScheduler&) = delete;
+    TtsScheduler& operator=(const TtsScheduler&) = delete;
+
+    // rejected runs instead of task when the executor drops it; the task's
+    // slot is released without counting against the limit.
+    void submit(Priority priority, Task task, std::function<void()> rejected = {});
+
+    size_t limit() const;
+    size_t inflight() const;
+    size_t queue_depth() const;
+
+private:
+    void dispatch();
+    void finish(Outcome outcome, double seconds, bool saturated);
+    void publish_locked() const;
+
+    struct Entry {
+        Task task;
+        std::function<void()> rejected;
+    };
+
+    Executor executor_;
+    mutable std::mutex mutex_;
+    AdaptiveLimit limit_;
+    std::array<std::deque<Entry>, 2> queues_;
+    size_t inflight_ = 0;
+};
+
+}
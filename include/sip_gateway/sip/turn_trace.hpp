@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace sip_gateway {
+
+// Timeline of one user turn, from VAD end of speech to the bot's first
+// played frame and a possible barge-in. Stages may be marked from any
+// thread; only the first time of each stage is kept.
+class TurnTrace {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Stage {
+        SpeechEnd,
+        ShortPause,
+        TranscribeSent,
+        TranscribeReceived,
+        StartSent,
+        FirstMessage,
+        SynthesisStart,
+        SynthesisEnd,
+        FirstFramePlayed,
+        BargeIn,
+    };
+    static constexpr size_t kStageCount = static_cast<size_t>(Stage::BargeIn) + 1;
+
+    explicit TurnTrace(Clock::time_point speech_end = Clock::now());
+
+    TurnTrace(const TurnTrace&) = delete;
+    TurnTrace& operator=(const TurnTrace&) = delete;
+
+    void mark(Stage stage, Clock::time_point at = Clock::now());
+    bool has(Stage stage) const;
+    // Seconds since end of speech; nullopt when the stage was not reached.
+    std::optional<double> offset(Stage stage) const;
+    // "short_pause=212 transcribe_sent=215 ..." in milliseconds, reached
+    // stages only.
+    std::string summary() const;
+
+    // Exports each reached stage's offset as the turn_<stage> histogram,
+    // once. A turn whose first frame played later than slow_threshold_sec
+    // after end of speech is logged with its summary; 0 disables the log.
+    // Returns whether it was slow.
+    bool finish(const std::string& session_id, double slow_threshold_sec);
+
+    static const char* stage_name(Stage stage);
+
+private:
+    static constexpr int64_t kUnset = INT64_MIN;
+
+    Clock::time_point origin_;
+    std::array<std::atomic<int64_t>, kStageCount> offsets_ns_;
+    std::atomic<bool> finished_{false};
+};
+
+}
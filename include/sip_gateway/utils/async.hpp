@@ -2,10 +2,15 @@
 
 #include <functional>
 
+#include "sip_gateway/utils/worker_pool.hpp"
+
 namespace sip_gateway {
 namespace utils {
 
-void run_async(std::function<void()> task);
+// False when the pool drops the task: it is stopped, or the lane is past
+// its overflow on a thread that must not wait. Callers that counted the task
+// as started must undo that themselves.
+bool run_async(std::function<void()> task, TaskLane lane = TaskLane::Backend);
 void ensure_pj_thread_registered(const char* name);
 
 }
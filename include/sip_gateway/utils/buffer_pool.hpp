@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace sip_gateway {
+namespace utils {
+
+// Recycles the storage of a call's scratch buffers (std::vector, std::string)
+// across turns, so steady-state turns reuse capacity instead of allocating
+// and freeing blocks of varying size. At most max_idle buffers are kept.
+// Thread safe. share() hands storage to readers that may outlive the turn;
+// it comes back to the pool when the last reader drops it, or is freed if
+// the pool is gone by then.
+template <typename Buffer>
+class BufferPool : public std::enable_shared_from_this<BufferPool<Buffer>> {
+public:
+    explicit BufferPool(size_t max_idle = 4) : max_idle_(max_idle) {}
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    // An empty buffer with room for at least capacity elements; reuses the
+    // smallest idle buffer that fits, else the largest.
+    Buffer take(size_t capacity) {
+        Buffer buffer;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!idle_.empty()) {
+                size_t best = 0;
+                for (size_t i = 1; i < idle_.size(); ++i) {
+                    if (better_fit(idle_[i].capacity(), idle_[best].capacity(), capacity)) {
+                        best = i;
+                    }
+                }
+                idle_bytes_ -= bytes_of(idle_[best]);
+                buffer = std::move(idle_[best]);
+                idle_[best] = std::move(idle_.back());
+                idle_.pop_back();
+            }
+        }
+        buffer.clear();
+        buffer.reserve(capacity);
+        return buffer;
+    }
+
+    void give(Buffer buffer) {
+        if (buffer.capacity() == 0) {
+            return;
+        }
+        buffer.clear();
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (idle_.size() < max_idle_) {
+            idle_bytes_ += bytes_of(buffer);
+            idle_.push_back(std::move(buffer));
+        }
+    }
+
+    // Freezes buffer for shared reading. Without a shared_ptr owning the
+    // pool the storage is simply freed when the last reader drops it.
+    std::shared_ptr<const Buffer> share(Buffer buffer) {
+        const size_t bytes = bytes_of(buffer);
+        shared_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+        auto pool = this->weak_from_this();
+        return std::shared_ptr<const Buffer>(
+            new Buffer(std::move(buffer)), [pool, bytes, this](const Buffer* shared) {
+                std::unique_ptr<Buffer> owned(const_cast<Buffer*>(shared));
+                if (const auto alive = pool.lock()) {
+                    shared_bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+                    give(std::move(*owned));
+                }
+            });
+    }
+
+    // Frees the idle buffers. Shared buffers dropped later are pooled again.
+    void release() {
+        std::vector<Buffer> idle;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            idle.swap(idle_);
+            idle_bytes_ = 0;
+        }
+    }
+
+    size_t idle_bytes() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return idle_bytes_;
+    }
+
+    // Bytes held by buffers handed out with share() and not yet returned.
+    size_t shared_bytes() const {
+        return shared_bytes_.load(std::memory_order_relaxed);
+    }
+
+private:
+    static bool better_fit(size_t candidate, size_t best, size_t wanted) {
+        const bool candidate_fits = candidate >= wanted;
+        if (candidate_fits != (best >= wanted)) {
+            return candidate_fits;
+        }
+        return candidate_fits ? candidate < best : candidate > best;
+    }
+
+    static size_t bytes_of(const Buffer& buffer) {
+        return buffer.capacity() * sizeof(typename Buffer::value_type);
+    }
+
+    const size_t max_idle_;
+    mutable std::mutex mutex_;
+    std::vector<Buffer> idle_;
+    size_t idle_bytes_ = 0;
+    std::atomic<size_t> shared_bytes_{0};
+};
+
+}
+}
@@ -1,7 +1,11 @@
 #pragma once
 
+#include <chrono>
 #include <filesystem>
+#include <optional>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace sip_gateway::utils {
 
@@ -18,6 +22,23 @@ std::string resolve_redirect_url(const std::string& base_url,
 
 bool download_file(const std::string& url, const std::filesystem::path& path);
 
+struct HttpResponse {
+    int status = 0;
+    std::string body;
+};
+
+// POSTs a JSON body; nullopt when no response arrived. Redirects are not
+// followed. With verify_certificate, only https URLs are posted to and the
+// server certificate is checked against ca_file, or the system store when
+// ca_file is empty.
+std::optional<HttpResponse> post_json(
+    const std::string& url,
+    const std::string& body,
+    std::chrono::seconds timeout,
+    const std::vector<std::pair<std::string, std::string>>& headers = {},
+    bool verify_certificate = false,
+    const std::string& ca_file = "");
+
 std::string url_encode(const std::string& value);
 
 }
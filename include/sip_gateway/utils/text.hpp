@@ -1,10 +1,21 @@
 #pragma once
 
+#include <cstddef>
 #include <string>
+#include <vector>
 
 namespace sip_gateway::utils {
 
 std::string remove_emojis(const std::string& text);
 std::string normalize_text(const std::string& text);
+std::string base64_encode(const void* data, size_t size);
+// Splits text into speakable chunks at sentence ends, skipping common
+// abbreviations, initials and decimal points. Sentences shorter than
+// min_chars are joined with the next. A chunk longer than max_chars (0 for
+// no limit) is cut at its last clause mark (, ; : or a sentence end), or
+// else at its last space. Chunks are trimmed.
+std::vector<std::string> split_clauses(const std::string& text,
+                                       size_t min_chars,
+                                       size_t max_chars);
 
 }
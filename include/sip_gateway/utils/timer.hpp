@@ -0,0 +1,74 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "sip_gateway/utils/worker_pool.hpp"
+
+namespace sip_gateway {
+namespace utils {
+
+// Single-threaded timer heap. Expired timers are posted to the worker pool,
+// which never blocks the timer thread, so callbacks may block without
+// delaying other timers.
+class TimerService {
+public:
+    using TimerId = uint64_t;
+    using Task = std::function<void()>;
+
+    static constexpr TimerId kInvalidTimer = 0;
+
+    TimerService();
+    ~TimerService();
+
+    TimerService(const TimerService&) = delete;
+    TimerService& operator=(const TimerService&) = delete;
+
+    TimerId schedule(std::chrono::steady_clock::duration delay,
+                     Task task,
+                     TaskLane lane = TaskLane::Backend);
+    // Returns true when the callback was prevented from running. A callback
+    // that has already started is not waited for, so callbacks must not
+    // capture a raw pointer to anything that can be destroyed meanwhile; hold
+    // a weak reference and lock it when the callback runs.
+    bool cancel(TimerId id);
+    void shutdown();
+
+    size_t pending() const;
+
+private:
+    struct Entry {
+        Task task;
+        TaskLane lane;
+    };
+
+    struct Deadline {
+        std::chrono::steady_clock::time_point at;
+        TimerId id;
+        bool operator>(const Deadline& other) const { return at > other.at; }
+    };
+
+    void run_loop();
+    void fire(TimerId id);
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>> heap_;
+    std::unordered_map<TimerId, Entry> entries_;
+    TimerId next_id_ = 1;
+    bool stopping_ = false;
+    std::thread thread_;
+};
+
+TimerService& timer_service();
+void shutdown_timer_service();
+
+}
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sip_gateway {
+namespace utils {
+
+// Media lane tasks (player EOF, barge-in teardown) are always dequeued ahead of
+// backend lane tasks (HTTP round trips, session bookkeeping).
+enum class TaskLane {
+    Media,
+    Backend
+};
+
+struct WorkerPoolOptions {
+    size_t threads = 32;
+    size_t media_threads = 2;
+    size_t queue_capacity = 1024;
+};
+
+class WorkerPool {
+public:
+    using Task = std::function<void()>;
+
+    explicit WorkerPool(WorkerPoolOptions options);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Backend submissions from outside the pool block while the lane is full
+    // (backpressure). Anything else is handled as post().
+    bool submit(Task task, TaskLane lane = TaskLane::Backend);
+    // Never blocks. A full lane takes the task anyway, up to twice its
+    // capacity (counted in worker_pool_overflow_total), and rejects it past
+    // that. For threads that must not stall: PJSIP callbacks, the timer.
+    bool post(Task task, TaskLane lane = TaskLane::Backend);
+    void shutdown();
+
+    size_t queue_depth(TaskLane lane) const;
+    size_t thread_count() const;
+
+private:
+    struct QueuedTask {
+        Task task;
+        std::chrono::steady_clock::time_point enqueued_at;
+    };
+
+    bool enqueue(Task task, TaskLane lane, bool may_block);
+    void worker_loop(bool media_only);
+    void publish_depth(TaskLane lane, size_t depth) const;
+
+    WorkerPoolOptions options_;
+    mutable std::mutex mutex_;
+    std::condition_variable media_cv_;
+    std::condition_variable general_cv_;
+    std::condition_variable space_cv_;
+    std::deque<QueuedTask> media_queue_;
+    std::deque<QueuedTask> backend_queue_;
+    std::vector<std::thread> workers_;
+    bool stopping_ = false;
+};
+
+void init_worker_pool(const WorkerPoolOptions& options);
+WorkerPool& worker_pool();
+void shutdown_worker_pool();
+
+}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace sip_gateway {
+namespace vad {
+
+class VadModel;
+
+struct VadBatchOptions {
+    size_t max_batch = 8;
+    std::chrono::microseconds max_wait{250};
+};
+
+// Coalesces windows from concurrent callers (the audio shard threads) into
+// one batched VadModel run. The first caller of a batch leads: it waits up to
+// max_wait for others, runs the batch and scatters results, while the rest
+// block until their window is done. No thread of its own is needed.
+class VadBatchScheduler {
+public:
+    VadBatchScheduler(std::shared_ptr<VadModel> model, VadBatchOptions options);
+
+    VadBatchScheduler(const VadBatchScheduler&) = delete;
+    VadBatchScheduler& operator=(const VadBatchScheduler&) = delete;
+
+    // Same contract as VadModel::get_speech_prob.
+    float get_speech_prob(const std::vector<float>& audio,
+                          std::vector<float>* state,
+                          int sampling_rate = 0);
+
+private:
+    struct Request {
+        const std::vector<float>* audio = nullptr;
+        std::vector<float>* state = nullptr;
+        int sampling_rate = 0;
+        float prob = 0.0f;
+        bool taken = false;
+        bool done = false;
+        std::exception_ptr error;
+    };
+
+    void run_batch(std::vector<Request*>& batch);
+
+    std::shared_ptr<VadModel> model_;
+    VadBatchOptions options_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<Request*> pending_;
+    bool leader_waiting_ = false;
+};
+
+}
+}
@@ -1,6 +1,6 @@
 #pragma once
 
-#include <deque>
+#include <cstddef>
 #include <utility>
 #include <vector>
 
@@ -39,6 +39,41 @@ struct VADCorrectionConfig {
     bool debug = false;
 };
 
+// Mean and population variance of a multiset under insertion and removal,
+// updated in O(1) with Welford's recurrences.
+class RunningStats {
+public:
+    void add(double value);
+    void remove(double value);
+    void clear();
+
+    size_t count() const;
+    double mean() const;
+    double variance() const;
+
+private:
+    size_t count_ = 0;
+    double mean_ = 0.0;
+    double m2_ = 0.0;
+};
+
+// The most recent values in a fixed circular array.
+class RecentValues {
+public:
+    explicit RecentValues(size_t capacity);
+
+    // Returns true and sets evicted when the oldest value was dropped.
+    bool push(double value, double& evicted);
+    size_t size() const;
+    // recent(0) is the newest value.
+    double recent(size_t age) const;
+
+private:
+    std::vector<double> values_;
+    size_t next_ = 0;
+    size_t size_ = 0;
+};
+
 class DynamicCorrection {
 public:
     explicit DynamicCorrection(VADCorrectionConfig cfg = {});
@@ -55,8 +90,12 @@ private:
     double get_dynamic_threshold() const;
 
     VADCorrectionConfig cfg_;
-    std::deque<double> score_buf_;
-    std::deque<double> prob_buf_;
+    RecentValues score_buf_;
+    RecentValues prob_buf_;
+    RunningStats score_stats_;
+    RunningStats prob_stats_;
+    // Probabilities in prob_buf_ above speech_prob_threshold.
+    RunningStats speech_prob_stats_;
     double noise_energy_ = 0.01;
     double peak_energy_ = 0.1;
     std::vector<double> initial_energy_samples_;
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace sip_gateway {
+namespace vad {
+
+enum class SimdLevel {
+    Scalar,
+    Sse2,
+    Avx2,
+    Neon
+};
+
+const char* simd_level_name(SimdLevel level);
+
+// One implementation of each per-window kernel. Every level gives the same
+// results as Scalar, except that sum_squares may round differently because
+// it adds the terms in a different order.
+struct DspKernels {
+    // x / 32768 per sample.
+    void (*pcm16_to_float)(const int16_t* in, float* out, size_t count);
+    float (*peak_abs)(const float* data, size_t count);
+    void (*divide)(float* data, size_t count, float divisor);
+    // Sum of float squares, accumulated in double.
+    double (*sum_squares)(const float* data, size_t count);
+};
+
+// Levels this build can run on this CPU, Scalar first.
+std::vector<SimdLevel> supported_simd_levels();
+const DspKernels& dsp_kernels(SimdLevel level);
+// The best supported level, detected once from the CPU.
+SimdLevel active_simd_level();
+const DspKernels& dsp_kernels();
+
+// Quarter-sine fade across count samples: out[i] = in[i] * sin(i / (count - 1)
+// * pi / 2), or one minus the curve when fading out. It reads the curve from a
+// table instead of calling std::sin. in and out may alias.
+void apply_fade(const float* in, float* out, size_t count, bool fade_in);
+
+}
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+namespace sip_gateway {
+namespace vad {
+
+struct EnergyGateConfig {
+    // A window is quiet when its RMS is at most floor_ratio times the noise
+    // floor and at most max_rms.
+    double floor_ratio = 2.0;
+    double max_rms = 0.01;
+    // Quiet windows that still run the model before skipping starts.
+    int hold_windows = 8;
+    double noise_alpha = 0.05;
+    // Reset the model state when inference resumes after a skipped run.
+    bool reset_on_resume = true;
+};
+
+// Decides when a window is clearly silent and the VAD model can be skipped.
+// The noise floor follows quiet windows down immediately and rises slowly,
+// and only while the last probability was low, like DynamicCorrection's.
+class EnergyGate {
+public:
+    explicit EnergyGate(EnergyGateConfig cfg = {});
+
+    bool should_skip(double rms, double last_prob);
+    double noise_floor() const;
+    const EnergyGateConfig& config() const;
+
+private:
+    EnergyGateConfig cfg_;
+    double floor_ = -1.0;
+    int quiet_windows_ = 0;
+};
+
+}
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <filesystem>
 #include <memory>
 #include <string>
@@ -8,17 +9,99 @@
 namespace sip_gateway {
 namespace vad {
 
+enum class GraphOptimization {
+    Disabled,
+    Basic,
+    Extended,
+    All
+};
+
+// Accepts "disabled", "basic", "extended" and "all"; throws
+// std::runtime_error otherwise.
+GraphOptimization parse_graph_optimization(const std::string& name);
+
+struct VadModelOptions {
+    int intra_op_threads = 1;
+    int inter_op_threads = 1;
+    bool allow_spinning = false;
+    GraphOptimization graph_optimization = GraphOptimization::All;
+    // Sessions run on the Env's global thread pool instead of their own.
+    // Decided by the first model created in the process.
+    bool global_thread_pool = false;
+    // When set, the graph-optimized model is saved here on first load and
+    // loaded instead of the source model while it is newer than it. The file
+    // name carries the ORT version, provider and CPU features it was built for.
+    std::filesystem::path optimized_cache_dir;
+};
+
 class VadModel {
 public:
-    VadModel(const std::filesystem::path& model_path, int sampling_rate);
+    // Inference state for one audio stream with every tensor preallocated and
+    // bound once through Ort::IoBinding. The recurrent state ping-pongs
+    // between two buffers, so a window costs no heap allocation on our side.
+    // Not thread-safe; the model must outlive it.
+    class Stream {
+    public:
+        ~Stream();
+        Stream(const Stream&) = delete;
+        Stream& operator=(const Stream&) = delete;
+
+        size_t window_size() const;
+        // count must equal window_size().
+        float get_speech_prob(const float* audio, size_t count);
+        void reset();
+
+    private:
+        friend class VadModel;
+        struct Impl;
+        explicit Stream(std::unique_ptr<Impl> impl);
+        std::unique_ptr<Impl> impl_;
+    };
+
+    VadModel(const std::filesystem::path& model_path,
+             int sampling_rate,
+             const VadModelOptions& options = {});
     ~VadModel();
 
+    // Silero takes 256-sample windows at 8 kHz and 512 at 16 kHz; only those
+    // two rates are accepted per stream or batch.
+    static bool supports_sampling_rate(int sampling_rate);
+    static size_t window_size_for(int sampling_rate);
+
+    // The rate the model was loaded for; a zero sampling_rate argument below
+    // means this one.
     int sampling_rate() const;
+    // fp16 exports; their tensors are converted to and from float here.
+    bool half_precision() const;
+    // The session was loaded from optimized_cache_dir.
+    bool loaded_from_cache() const;
+    // Runs a few silent windows, and one batch of batch_size when it is
+    // above one, so ORT's lazy allocations happen before the first call.
+    void warm_up(size_t batch_size = 1) const;
     std::vector<float> initialize_state() const;
     float get_speech_prob(const std::vector<float>& audio,
-                          std::vector<float>* state) const;
+                          std::vector<float>* state,
+                          int sampling_rate = 0) const;
+    // Runs equally sized windows as one [N, window_size] tensor with stacked
+    // [2, N, 128] state; a null or empty state starts from zeros.
+    void get_speech_probs(const std::vector<const float*>& windows,
+                          size_t window_size,
+                          const std::vector<std::vector<float>*>& states,
+                          float* probs,
+                          int sampling_rate = 0) const;
+    std::unique_ptr<Stream> create_stream(size_t window_size, int sampling_rate = 0) const;
 
 private:
+    static constexpr size_t kStateSize = 128;
+
+    template <typename T>
+    void run_batch(const std::vector<const float*>& windows,
+                   size_t window_size,
+                   const std::vector<std::vector<float>*>& states,
+                   float* probs,
+                   int64_t sampling_rate) const;
+    int64_t resolve_rate(int sampling_rate) const;
+
     struct Impl;
     std::unique_ptr<Impl> impl_;
 };
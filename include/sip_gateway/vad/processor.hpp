@@ -1,23 +1,48 @@
 #pragma once
 
+#include <cstdint>
 #include <deque>
 #include <functional>
 #include <memory>
 #include <vector>
 
+#include "sip_gateway/audio/sample_ring.hpp"
+#include "sip_gateway/audio/segment.hpp"
+#include "sip_gateway/utils/buffer_pool.hpp"
 #include "sip_gateway/vad/correction.hpp"
+#include "sip_gateway/vad/energy_gate.hpp"
+#include "sip_gateway/vad/model.hpp"
 
 namespace sip_gateway {
 namespace vad {
 
-class VadModel;
+class VadBatchScheduler;
+
+// Identifies the speech a pause buffer covers. Two pauses with equal fields
+// carry the same speech and differ only in trailing silence.
+struct PauseInfo {
+    uint64_t utterance_id = 0;
+    int64_t speech_start_sample = 0;
+    int64_t speech_end_sample = 0;
+
+    bool same_speech(const PauseInfo& other) const {
+        return utterance_id == other.utterance_id &&
+               speech_start_sample == other.speech_start_sample &&
+               speech_end_sample == other.speech_end_sample;
+    }
+};
 
 class StreamingVadProcessor {
 public:
-    using SpeechCallback = std::function<void(const std::vector<float>&, double, double)>;
+    // The segment is shared, not copied; keep the handle to retain the audio.
+    using SpeechCallback = std::function<void(const audio::AudioSegment&, double, double)>;
     using SilenceCallback = std::function<void(double)>;
+    using SegmentPool = utils::BufferPool<std::vector<float>>;
 
+    // sampling_rate is the call's audio rate, 8 or 16 kHz; zero uses the
+    // model's. The window size follows it.
     StreamingVadProcessor(std::shared_ptr<VadModel> model,
+                          int sampling_rate,
                           float threshold,
                           int min_speech_duration_ms,
                           int min_silence_duration_ms,
@@ -25,6 +50,7 @@ public:
                           int short_pause_ms,
                           int long_pause_ms,
                           int user_silence_duration_ms,
+                          int max_utterance_ms,
                           int speech_prob_window,
                           bool use_dynamic_corrections,
                           bool correction_debug,
@@ -36,31 +62,51 @@ public:
     void set_on_short_pause(SpeechCallback cb);
     void set_on_long_pause(SpeechCallback cb);
     void set_on_user_silence_timeout(SilenceCallback cb);
+    // Routes inference through a scheduler shared with other calls.
+    void set_batch_scheduler(std::shared_ptr<VadBatchScheduler> scheduler);
+    // Skips inference for clearly silent windows, which get probability 0.
+    void set_energy_gate(const EnergyGateConfig& config);
+    // Builds the segments passed to the callbacks from pooled storage,
+    // which returns to the pool once every holder has dropped them.
+    void set_segment_pool(std::shared_ptr<SegmentPool> pool);
 
+    void process_samples(const int16_t* samples, size_t count);
     void process_samples(const std::vector<int16_t>& samples);
     void finalize();
     void start_user_silence();
     void reset_user_salience();
     void cancel_user_salience();
     void set_long_pause_suspended(bool suspended);
+    // The pause being reported; valid inside the short/long pause callbacks.
+    const PauseInfo& last_pause() const;
+    // Windows the energy gate kept from the model.
+    uint64_t skipped_windows() const;
+    // Bytes held by the speech and silence rings and the window buffers.
+    // Segments handed to the callbacks are not included.
+    size_t memory_bytes() const;
 
 private:
     void process_window(const std::vector<float>& window);
     float get_smoothed_prob(const std::vector<float>& window);
-    void grow_silence_buffer(const std::vector<float>& window);
+    float smooth_prob(float prob);
+    void resume_inference();
     void fire_speech_start();
     void fire_speech_end();
     void fire_short_pause();
     void fire_long_pause();
     void fire_user_silence_timeout();
-    std::vector<float> apply_fade(const std::vector<float>& audio, bool fade_in) const;
+    // Start padding, speech, then the faded-out silence that ended it.
+    audio::AudioSegment pause_segment() const;
+    std::vector<float> take_buffer(size_t capacity) const;
+    audio::AudioSegment make_segment(std::vector<float> samples) const;
     double current_time_sec() const;
-    void times_sec(const std::vector<float>& audio, double& start, double& duration) const;
+    void times_sec(size_t samples, double& start, double& duration) const;
 
     std::shared_ptr<VadModel> model_;
+    std::shared_ptr<VadBatchScheduler> batch_scheduler_;
     float threshold_;
-    int window_size_samples_ = 512;
     int sampling_rate_;
+    int window_size_samples_;
     int speech_prob_window_;
 
     int min_speech_samples_;
@@ -69,16 +115,28 @@ private:
     int short_pause_samples_;
     int long_pause_samples_;
     int user_silence_samples_;
-    int max_silence_samples_;
 
-    std::vector<float> buffer_;
-    std::vector<float> speech_buffer_;
-    std::vector<float> silence_buffer_;
-    std::vector<float> silence_pad_buffer_;
+    // Samples of the window being filled; window_fill_ of them are valid.
+    std::vector<float> window_;
+    size_t window_fill_ = 0;
+    // Bounded by the max utterance length; the oldest speech is dropped.
+    audio::SampleRing speech_buffer_;
+    audio::SampleRing silence_buffer_;
+    audio::AudioSegment silence_pad_;
     std::deque<float> prob_history_;
+    // Batched inference keeps state here; unbatched inference keeps it in
+    // stream_.
     std::vector<float> state_;
+    std::unique_ptr<VadModel::Stream> stream_;
+    std::vector<float> normalized_;
     bool use_dynamic_corrections_ = true;
     std::unique_ptr<DynamicCorrection> correction_;
+    std::unique_ptr<EnergyGate> energy_gate_;
+    std::shared_ptr<SegmentPool> segment_pool_;
+    float last_prob_ = 0.0f;
+    // Windows skipped since inference last ran, and in total.
+    uint64_t gated_windows_ = 0;
+    uint64_t skipped_windows_ = 0;
 
     int64_t current_sample_ = 0;
     bool active_speech_ = false;
@@ -86,6 +144,10 @@ private:
     bool short_pause_fired_ = false;
     bool long_pause_suspended_ = false;
     int64_t speech_start_ = 0;
+    uint64_t utterance_id_ = 0;
+    int64_t utterance_start_ = 0;
+    int64_t last_speech_sample_ = 0;
+    PauseInfo last_pause_;
     int64_t user_silence_start_ = 0;
     bool user_silence_timeout_fired_ = false;
 
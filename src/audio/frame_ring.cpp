@@ -0,0 +1,64 @@
+#include "sip_gateway/audio/frame_ring.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace sip_gateway::audio {
+
+FrameRing::FrameRing(size_t slots, size_t slot_samples)
+    : slots_(std::max<size_t>(1, slots)),
+      slot_samples_(std::max<size_t>(1, slot_samples)),
+      storage_(slots_ * slot_samples_),
+      lengths_(slots_, 0) {}
+
+size_t FrameRing::capacity() const {
+    return slots_;
+}
+
+size_t FrameRing::slot_samples() const {
+    return slot_samples_;
+}
+
+size_t FrameRing::size() const {
+    return tail_.load(std::memory_order_acquire) -
+           head_.load(std::memory_order_acquire);
+}
+
+bool FrameRing::push(const int16_t* samples, size_t count) {
+    if (count > slot_samples_) {
+        return false;
+    }
+    const auto tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) >= slots_) {
+        return false;
+    }
+    const auto slot = tail % slots_;
+    if (count > 0) {
+        std::memcpy(storage_.data() + slot * slot_samples_, samples,
+                    count * sizeof(int16_t));
+    }
+    lengths_[slot] = count;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+bool FrameRing::front(const int16_t*& samples, size_t& count) const {
+    const auto head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+        return false;
+    }
+    const auto slot = head % slots_;
+    samples = storage_.data() + slot * slot_samples_;
+    count = lengths_[slot];
+    return true;
+}
+
+void FrameRing::pop() {
+    const auto head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+        return;
+    }
+    head_.store(head + 1, std::memory_order_release);
+}
+
+}
@@ -0,0 +1,432 @@
+#include "sip_gateway/audio/media_partition.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "sip_gateway/logging.hpp"
+
+namespace sip_gateway::audio {
+
+namespace {
+
+constexpr unsigned kSignature = PJMEDIA_SIG_CLASS_APP('S', 'P');
+// Removed ports are kept this long; the bridge lets go of them on its next
+// tick.
+constexpr auto kRetireDelay = std::chrono::seconds(1);
+constexpr unsigned kNarrowbandClockRate = 8000;
+
+int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+std::runtime_error pj_failure(const std::string& what, pj_status_t status) {
+    char buffer[PJ_ERR_MSG_SIZE] = {};
+    const auto message = pj_strerror(status, buffer, sizeof(buffer));
+    return std::runtime_error(what + ": " +
+                              std::string(message.ptr, static_cast<size_t>(message.slen)));
+}
+
+// name must outlive the port: the info keeps a pointer to it.
+void init_port(pjmedia_port& port,
+               const std::string& name,
+               unsigned clock_rate,
+               unsigned channels,
+               unsigned bits,
+               unsigned samples_per_frame,
+               void* data) {
+    pj_str_t pj_name = pj_str(const_cast<char*>(name.c_str()));
+    pjmedia_port_info_init(&port.info, &pj_name, kSignature, clock_rate, channels, bits,
+                           samples_per_frame);
+    port.port_data.pdata = data;
+}
+
+// Takes a stream's place on the pjsua bridge, which then neither reads nor
+// writes the stream. Nothing connects to it; pjsua destroys it with the
+// stream.
+struct Placeholder {
+    Placeholder(std::string port_name, const pjmedia_port_info& info)
+        : name(std::move(port_name)) {
+        init_port(port, name, PJMEDIA_PIA_SRATE(&info), PJMEDIA_PIA_CCNT(&info),
+                  PJMEDIA_PIA_BITS(&info), PJMEDIA_PIA_SPF(&info), this);
+        port.get_frame = &get_frame;
+        port.put_frame = &put_frame;
+        port.on_destroy = &on_destroy;
+    }
+
+    static pj_status_t get_frame(pjmedia_port*, pjmedia_frame* frame) {
+        frame->type = PJMEDIA_FRAME_TYPE_NONE;
+        frame->size = 0;
+        return PJ_SUCCESS;
+    }
+
+    static pj_status_t put_frame(pjmedia_port*, pjmedia_frame*) {
+        return PJ_SUCCESS;
+    }
+
+    static pj_status_t on_destroy(pjmedia_port* port) {
+        delete static_cast<Placeholder*>(port->port_data.pdata);
+        return PJ_SUCCESS;
+    }
+
+    pjmedia_port port{};
+    std::string name;
+};
+
+}
+
+// Hands the bridge's frames to a pjsua2 port or a pjmedia port. The lock
+// is held only while a frame is handed over, so detach() waits at most for
+// one frame.
+struct MediaPartition::Port {
+    Port(std::string port_name,
+         unsigned clock_rate,
+         unsigned channels,
+         unsigned bits,
+         unsigned samples_per_frame)
+        : name(std::move(port_name)) {
+        init_port(base, name, clock_rate, channels, bits, samples_per_frame, this);
+        base.get_frame = &get_frame;
+        base.put_frame = &put_frame;
+    }
+
+    ~Port() {
+        if (pool) {
+            pj_pool_release(pool);
+        }
+    }
+
+    void detach() {
+        std::lock_guard<std::mutex> lock(mutex);
+        app = nullptr;
+        media = nullptr;
+    }
+
+    static pj_status_t get_frame(pjmedia_port* base, pjmedia_frame* frame) {
+        auto& port = *static_cast<Port*>(base->port_data.pdata);
+        std::lock_guard<std::mutex> lock(port.mutex);
+        if (port.media) {
+            return pjmedia_port_get_frame(port.media, frame);
+        }
+        if (!port.app) {
+            frame->type = PJMEDIA_FRAME_TYPE_NONE;
+            frame->size = 0;
+            return PJ_SUCCESS;
+        }
+        auto& scratch = port.frame;
+        scratch.type = PJMEDIA_FRAME_TYPE_NONE;
+        scratch.size = static_cast<unsigned>(frame->size);
+        scratch.buf.clear();
+        port.app->onFrameRequested(scratch);
+        const auto bytes = std::min({scratch.buf.size(), static_cast<size_t>(scratch.size),
+                                     static_cast<size_t>(frame->size)});
+        if (bytes > 0) {
+            std::memcpy(frame->buf, scratch.buf.data(), bytes);
+        }
+        frame->type = bytes > 0 ? scratch.type : PJMEDIA_FRAME_TYPE_NONE;
+        frame->size = bytes;
+        return PJ_SUCCESS;
+    }
+
+    static pj_status_t put_frame(pjmedia_port* base, pjmedia_frame* frame) {
+        auto& port = *static_cast<Port*>(base->port_data.pdata);
+        std::lock_guard<std::mutex> lock(port.mutex);
+        if (port.media) {
+            return pjmedia_port_put_frame(port.media, frame);
+        }
+        if (!port.app) {
+            return PJ_SUCCESS;
+        }
+        // Reused, so the clock thread allocates only when a frame grows.
+        auto& scratch = port.frame;
+        scratch.type = frame->type;
+        if (frame->type == PJMEDIA_FRAME_TYPE_AUDIO && frame->buf && frame->size > 0) {
+            const auto* data = static_cast<const unsigned char*>(frame->buf);
+            scratch.buf.assign(data, data + frame->size);
+        } else {
+            scratch.buf.clear();
+        }
+        scratch.size = static_cast<unsigned>(scratch.buf.size());
+        port.app->onFrameReceived(scratch);
+        return PJ_SUCCESS;
+    }
+
+    pjmedia_port base{};
+    std::string name;
+    pj_pool_t* pool = nullptr; // The bridge's buffers for this slot.
+    std::mutex mutex;
+    pj::AudioMediaPort* app = nullptr;
+    pjmedia_port* media = nullptr;
+    pj::MediaFrame frame; // Clock thread only.
+    bool stream = false;
+    std::chrono::steady_clock::time_point retired_at;
+};
+
+MediaPartition::MediaPartition(size_t index, const MediaPartitionOptions& options)
+    : index_(index),
+      options_(options),
+      frame_time_ns_(static_cast<int64_t>(options.ptime_ms) * 1000000),
+      lateness_(Metrics::instance().named_histogram("media_partition_tick_lateness_seconds",
+                                                    {{"partition", std::to_string(index)}})),
+      calls_gauge_(Metrics::instance().gauge("media_partition_calls",
+                                             {{"partition", std::to_string(index)}})) {
+    const auto samples_per_frame = options_.clock_rate * options_.ptime_ms / 1000;
+    const auto name = "sipgw_partition" + std::to_string(index_);
+    pool_ = pjsua_pool_create(name.c_str(), 4096, 4096);
+    if (!pool_) {
+        throw std::runtime_error("Failed to create media partition pool");
+    }
+    auto status = pjmedia_conf_create(pool_, options_.max_ports, options_.clock_rate, 1,
+                                      samples_per_frame, 16, PJMEDIA_CONF_NO_DEVICE, &conf_);
+    if (status != PJ_SUCCESS) {
+        pj_pool_release(pool_);
+        throw pj_failure("Failed to create media partition bridge", status);
+    }
+    clock_name_ = name + "/clock";
+    init_port(clock_port_, clock_name_, options_.clock_rate, 1, 16, samples_per_frame, this);
+    clock_port_.get_frame = &clock_get_frame;
+    clock_port_.put_frame = &clock_put_frame;
+    status = pjmedia_master_port_create(pool_, &clock_port_,
+                                        pjmedia_conf_get_master_port(conf_), 0, &master_);
+    if (status == PJ_SUCCESS) {
+        status = pjmedia_master_port_start(master_);
+    }
+    if (status != PJ_SUCCESS) {
+        if (master_) {
+            pjmedia_master_port_destroy(master_, PJ_FALSE);
+        }
+        pjmedia_conf_destroy(conf_);
+        pj_pool_release(pool_);
+        throw pj_failure("Failed to start media partition clock", status);
+    }
+    calls_gauge_.set(0.0);
+}
+
+MediaPartition::~MediaPartition() {
+    shutdown();
+}
+
+size_t MediaPartition::index() const {
+    return index_;
+}
+
+size_t MediaPartition::calls() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return streams_;
+}
+
+unsigned MediaPartition::clock_rate() const {
+    return options_.clock_rate;
+}
+
+pjmedia_port* MediaPartition::add_stream(pjmedia_port* stream,
+                                         const std::string& name,
+                                         int& slot) {
+    const auto& info = stream->info;
+    auto port = std::make_unique<Port>(name, PJMEDIA_PIA_SRATE(&info), PJMEDIA_PIA_CCNT(&info),
+                                       PJMEDIA_PIA_BITS(&info), PJMEDIA_PIA_SPF(&info));
+    port->media = stream;
+    port->stream = true;
+    auto placeholder = std::make_unique<Placeholder>(name + "/placeholder", info);
+    std::lock_guard<std::mutex> lock(mutex_);
+    slot = add_locked(std::move(port));
+    ++streams_;
+    calls_gauge_.set(static_cast<double>(streams_));
+    return &placeholder.release()->port;
+}
+
+void MediaPartition::remove_stream(int slot) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto it = ports_.find(slot);
+    if (it == ports_.end() || !it->second->stream) {
+        return;
+    }
+    retire_locked(slot);
+    --streams_;
+    calls_gauge_.set(static_cast<double>(streams_));
+}
+
+int MediaPartition::add_port(pj::AudioMediaPort& target,
+                             const pj::MediaFormatAudio& format,
+                             const std::string& name) {
+    const auto samples_per_frame = static_cast<unsigned>(
+        static_cast<uint64_t>(format.clockRate) * format.channelCount * format.frameTimeUsec /
+        1000000);
+    auto port = std::make_unique<Port>(name, format.clockRate, format.channelCount,
+                                       format.bitsPerSample, samples_per_frame);
+    port->app = &target;
+    std::lock_guard<std::mutex> lock(mutex_);
+    return add_locked(std::move(port));
+}
+
+int MediaPartition::add_port(pjmedia_port* target, const std::string& name) {
+    const auto& info = target->info;
+    auto port = std::make_unique<Port>(name, PJMEDIA_PIA_SRATE(&info), PJMEDIA_PIA_CCNT(&info),
+                                       PJMEDIA_PIA_BITS(&info), PJMEDIA_PIA_SPF(&info));
+    port->media = target;
+    std::lock_guard<std::mutex> lock(mutex_);
+    return add_locked(std::move(port));
+}
+
+void MediaPartition::remove_port(int slot) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto it = ports_.find(slot);
+    if (it == ports_.end() || it->second->stream) {
+        return;
+    }
+    retire_locked(slot);
+}
+
+void MediaPartition::connect(int source, int sink) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopped_) {
+        return;
+    }
+    const auto status = pjmedia_conf_connect_port(conf_, static_cast<unsigned>(source),
+                                                  static_cast<unsigned>(sink), 0);
+    if (status != PJ_SUCCESS) {
+        throw pj_failure("Failed to connect media partition ports", status);
+    }
+}
+
+void MediaPartition::shutdown() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopped_) {
+        return;
+    }
+    stopped_ = true;
+    pjmedia_master_port_stop(master_);
+    pjmedia_master_port_destroy(master_, PJ_FALSE);
+    master_ = nullptr;
+    for (auto& item : ports_) {
+        item.second->detach();
+    }
+    pjmedia_conf_destroy(conf_);
+    conf_ = nullptr;
+    ports_.clear();
+    retired_.clear();
+    streams_ = 0;
+    calls_gauge_.set(0.0);
+    pj_pool_release(pool_);
+    pool_ = nullptr;
+}
+
+pj_status_t MediaPartition::clock_get_frame(pjmedia_port* port, pjmedia_frame* frame) {
+    static_cast<MediaPartition*>(port->port_data.pdata)->tick();
+    frame->type = PJMEDIA_FRAME_TYPE_NONE;
+    frame->size = 0;
+    return PJ_SUCCESS;
+}
+
+pj_status_t MediaPartition::clock_put_frame(pjmedia_port*, pjmedia_frame*) {
+    // The mix of the bridge's master slot, which nothing transmits to.
+    return PJ_SUCCESS;
+}
+
+int MediaPartition::add_locked(std::unique_ptr<Port> port) {
+    if (stopped_) {
+        throw std::runtime_error("Media partition is stopped");
+    }
+    sweep_locked(std::chrono::steady_clock::now());
+    port->pool = pjsua_pool_create(port->name.c_str(), 1024, 1024);
+    if (!port->pool) {
+        throw std::runtime_error("Failed to create media partition port pool");
+    }
+    pj_str_t name = pj_str(const_cast<char*>(port->name.c_str()));
+    unsigned slot = 0;
+    const auto status = pjmedia_conf_add_port(conf_, port->pool, &port->base, &name, &slot);
+    if (status != PJ_SUCCESS) {
+        throw pj_failure("Failed to add media partition port", status);
+    }
+    const auto id = static_cast<int>(slot);
+    ports_[id] = std::move(port);
+    return id;
+}
+
+void MediaPartition::retire_locked(int slot) {
+    const auto it = ports_.find(slot);
+    if (it == ports_.end() || stopped_) {
+        return;
+    }
+    it->second->detach();
+    pjmedia_conf_remove_port(conf_, static_cast<unsigned>(slot));
+    it->second->retired_at = std::chrono::steady_clock::now();
+    retired_.push_back(std::move(it->second));
+    ports_.erase(it);
+}
+
+void MediaPartition::sweep_locked(std::chrono::steady_clock::time_point now) {
+    retired_.erase(std::remove_if(retired_.begin(), retired_.end(),
+                                  [now](const std::unique_ptr<Port>& port) {
+                                      return now - port->retired_at >= kRetireDelay;
+                                  }),
+                   retired_.end());
+}
+
+void MediaPartition::tick() {
+    const auto now = now_ns();
+    if (last_tick_ns_ != 0) {
+        // How far behind its nominal tick this partition's clock fired.
+        const auto late = now - last_tick_ns_ - frame_time_ns_;
+        lateness_.observe(late > 0 ? static_cast<double>(late) / 1e9 : 0.0);
+    }
+    last_tick_ns_ = now;
+}
+
+MediaPartitionPool::MediaPartitionPool(const MediaPartitionOptions& options)
+    : clock_rate_(options.clock_rate) {
+    const auto count = std::max<size_t>(1, options.partitions);
+    const bool narrowband = options.narrowband && options.clock_rate > kNarrowbandClockRate;
+    partitions_.reserve(narrowband ? count * 2 : count);
+    for (size_t i = 0; i < count; ++i) {
+        partitions_.push_back(std::make_unique<MediaPartition>(i, options));
+    }
+    if (narrowband) {
+        auto narrowband_options = options;
+        narrowband_options.clock_rate = kNarrowbandClockRate;
+        for (size_t i = 0; i < count; ++i) {
+            partitions_.push_back(
+                std::make_unique<MediaPartition>(count + i, narrowband_options));
+        }
+    }
+    logging::info(
+        "Media partitions started",
+        {kv("partitions", count),
+         kv("clock_rate", options.clock_rate),
+         kv("narrowband_partitions", narrowband ? count : 0),
+         kv("ptime_ms", options.ptime_ms)});
+}
+
+MediaPartition& MediaPartitionPool::assign(unsigned clock_rate) {
+    const bool any = std::any_of(
+        partitions_.begin(), partitions_.end(),
+        [clock_rate](const std::unique_ptr<MediaPartition>& partition) {
+            return partition->clock_rate() == clock_rate;
+        });
+    const unsigned rate = any ? clock_rate : clock_rate_;
+    const auto fewer_calls = [rate](const std::unique_ptr<MediaPartition>& a,
+                                    const std::unique_ptr<MediaPartition>& b) {
+        // Partitions at the chosen rate order before all others.
+        const bool a_match = a->clock_rate() == rate;
+        const bool b_match = b->clock_rate() == rate;
+        if (a_match != b_match) {
+            return a_match;
+        }
+        return a->calls() < b->calls();
+    };
+    return **std::min_element(partitions_.begin(), partitions_.end(), fewer_calls);
+}
+
+size_t MediaPartitionPool::size() const {
+    return partitions_.size();
+}
+
+void MediaPartitionPool::shutdown() {
+    for (auto& partition : partitions_) {
+        partition->shutdown();
+    }
+}
+
+}
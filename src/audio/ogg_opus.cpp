@@ -0,0 +1,278 @@
+#include "sip_gateway/audio/ogg_opus.hpp"
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+#ifdef SIPGATEWAY_HAVE_OPUS
+#include <opus/opus.h>
+#endif
+
+namespace sip_gateway::audio {
+
+namespace {
+
+#ifdef SIPGATEWAY_HAVE_OPUS
+
+uint32_t ogg_crc(const std::string& data) {
+    static const auto table = []() {
+        std::array<uint32_t, 256> values{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i << 24;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc & 0x80000000u) ? (crc << 1) ^ 0x04c11db7u : (crc << 1);
+            }
+            values[i] = crc;
+        }
+        return values;
+    }();
+    uint32_t crc = 0;
+    for (const unsigned char ch : data) {
+        crc = (crc << 8) ^ table[((crc >> 24) & 0xFF) ^ ch];
+    }
+    return crc;
+}
+
+void put_le(std::string& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+class OggWriter {
+public:
+    void add_packet(const std::string& packet) {
+        const auto lacing = packet.size() / 255 + 1;
+        if (segments_.size() + lacing > 255) {
+            flush(false);
+        }
+        for (size_t i = 0; i < lacing - 1; ++i) {
+            segments_.push_back(static_cast<char>(0xFF));
+        }
+        segments_.push_back(static_cast<unsigned char>(packet.size() % 255));
+        body_ += packet;
+    }
+
+    // Header packets must each end their own page.
+    void flush_page(uint64_t granule, bool last) {
+        granule_ = granule;
+        flush(last);
+    }
+
+    void set_granule(uint64_t granule) {
+        granule_ = granule;
+    }
+
+    std::string take() {
+        return std::move(out_);
+    }
+
+private:
+    void flush(bool last) {
+        if (segments_.empty() && !last) {
+            return;
+        }
+        std::string page = "OggS";
+        page.push_back(0);
+        unsigned char flags = 0;
+        if (sequence_ == 0) {
+            flags |= 0x02;
+        }
+        if (last) {
+            flags |= 0x04;
+        }
+        page.push_back(static_cast<char>(flags));
+        put_le(page, granule_, 8);
+        put_le(page, kSerial, 4);
+        put_le(page, sequence_++, 4);
+        put_le(page, 0, 4);
+        page.push_back(static_cast<char>(segments_.size()));
+        page.append(segments_.begin(), segments_.end());
+        page += body_;
+        const auto crc = ogg_crc(page);
+        for (int i = 0; i < 4; ++i) {
+            page[22 + i] = static_cast<char>((crc >> (8 * i)) & 0xFF);
+        }
+        out_ += page;
+        segments_.clear();
+        body_.clear();
+    }
+
+    static constexpr uint32_t kSerial = 0x53475057;
+    std::string out_;
+    std::string segments_;
+    std::string body_;
+    uint32_t sequence_ = 0;
+    uint64_t granule_ = 0;
+};
+
+#endif
+
+}
+
+#ifdef SIPGATEWAY_HAVE_OPUS
+
+struct OggOpusEncoder::Impl {
+    OpusEncoder* encoder = nullptr;
+    OggWriter ogg;
+    unsigned channels = 1;
+    size_t packet_frames = 0;
+    // Granule positions are always counted at 48 kHz.
+    uint64_t scale = 1;
+    uint64_t pre_skip = 0;
+    uint64_t frames = 0;
+    std::vector<opus_int16> pcm;
+    size_t pcm_frames = 0;
+    std::vector<unsigned char> packet = std::vector<unsigned char>(4000);
+    bool ok = true;
+    bool finished = false;
+
+    ~Impl() {
+        if (encoder) {
+            opus_encoder_destroy(encoder);
+        }
+    }
+
+    bool encode_packet() {
+        const auto size = opus_encode(encoder, pcm.data(), static_cast<int>(packet_frames),
+                                      packet.data(), static_cast<opus_int32>(packet.size()));
+        if (size < 0) {
+            ok = false;
+            return false;
+        }
+        ogg.add_packet(std::string(reinterpret_cast<const char*>(packet.data()),
+                                   static_cast<size_t>(size)));
+        ogg.set_granule(pre_skip + frames * scale);
+        pcm_frames = 0;
+        return true;
+    }
+};
+
+#else
+
+struct OggOpusEncoder::Impl {};
+
+#endif
+
+bool OggOpusEncoder::supported(uint32_t sample_rate) {
+#ifdef SIPGATEWAY_HAVE_OPUS
+    return sample_rate == 8000 || sample_rate == 12000 || sample_rate == 16000 ||
+           sample_rate == 24000 || sample_rate == 48000;
+#else
+    (void)sample_rate;
+    return false;
+#endif
+}
+
+std::unique_ptr<OggOpusEncoder> OggOpusEncoder::create(uint32_t sample_rate,
+                                                       unsigned channels,
+                                                       int bitrate) {
+#ifdef SIPGATEWAY_HAVE_OPUS
+    if (!supported(sample_rate) || channels < 1 || channels > 2) {
+        return nullptr;
+    }
+    auto impl = std::make_unique<Impl>();
+    int error = OPUS_OK;
+    impl->encoder = opus_encoder_create(static_cast<opus_int32>(sample_rate),
+                                        static_cast<int>(channels),
+                                        OPUS_APPLICATION_VOIP, &error);
+    if (error != OPUS_OK || !impl->encoder) {
+        impl->encoder = nullptr;
+        return nullptr;
+    }
+    opus_encoder_ctl(impl->encoder, OPUS_SET_BITRATE(bitrate));
+    opus_int32 lookahead = 0;
+    opus_encoder_ctl(impl->encoder, OPUS_GET_LOOKAHEAD(&lookahead));
+    impl->channels = channels;
+    impl->packet_frames = sample_rate / 50;
+    impl->scale = 48000 / sample_rate;
+    impl->pre_skip = static_cast<uint64_t>(lookahead) * impl->scale;
+    impl->pcm.assign(impl->packet_frames * channels, 0);
+
+    std::string head = "OpusHead";
+    head.push_back(1);
+    head.push_back(static_cast<char>(channels));
+    put_le(head, impl->pre_skip, 2);
+    put_le(head, sample_rate, 4);
+    put_le(head, 0, 2);
+    head.push_back(0);
+    impl->ogg.add_packet(head);
+    impl->ogg.flush_page(0, false);
+    std::string tags = "OpusTags";
+    const std::string vendor = "sip_gateway";
+    put_le(tags, vendor.size(), 4);
+    tags += vendor;
+    put_le(tags, 0, 4);
+    impl->ogg.add_packet(tags);
+    impl->ogg.flush_page(0, false);
+    return std::unique_ptr<OggOpusEncoder>(new OggOpusEncoder(std::move(impl)));
+#else
+    (void)sample_rate;
+    (void)channels;
+    (void)bitrate;
+    return nullptr;
+#endif
+}
+
+OggOpusEncoder::OggOpusEncoder(std::unique_ptr<Impl> impl) : impl_(std::move(impl)) {}
+
+OggOpusEncoder::~OggOpusEncoder() = default;
+
+bool OggOpusEncoder::write(const int16_t* samples, size_t frames) {
+#ifdef SIPGATEWAY_HAVE_OPUS
+    auto& impl = *impl_;
+    if (!impl.ok || impl.finished) {
+        return false;
+    }
+    while (frames > 0) {
+        const auto count = std::min(frames, impl.packet_frames - impl.pcm_frames);
+        std::copy(samples, samples + count * impl.channels,
+                  impl.pcm.begin() + impl.pcm_frames * impl.channels);
+        impl.pcm_frames += count;
+        impl.frames += count;
+        samples += count * impl.channels;
+        frames -= count;
+        if (impl.pcm_frames == impl.packet_frames && !impl.encode_packet()) {
+            return false;
+        }
+    }
+    return true;
+#else
+    (void)samples;
+    (void)frames;
+    return false;
+#endif
+}
+
+bool OggOpusEncoder::finish() {
+#ifdef SIPGATEWAY_HAVE_OPUS
+    auto& impl = *impl_;
+    if (impl.finished) {
+        return impl.ok;
+    }
+    impl.finished = true;
+    if (!impl.ok) {
+        return false;
+    }
+    if (impl.pcm_frames > 0) {
+        std::fill(impl.pcm.begin() + impl.pcm_frames * impl.channels, impl.pcm.end(), 0);
+        if (!impl.encode_packet()) {
+            return false;
+        }
+    }
+    impl.ogg.flush_page(impl.pre_skip + impl.frames * impl.scale, true);
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::string OggOpusEncoder::take() {
+#ifdef SIPGATEWAY_HAVE_OPUS
+    return impl_->ogg.take();
+#else
+    return {};
+#endif
+}
+
+}
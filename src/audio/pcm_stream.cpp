@@ -0,0 +1,219 @@
+#include "sip_gateway/audio/pcm_stream.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace sip_gateway::audio {
+
+namespace {
+
+uint32_t read_le32(const char* data) {
+    const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+    return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+           (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+uint16_t read_le16(const char* data) {
+    const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+    return static_cast<uint16_t>(bytes[0] | (bytes[1] << 8));
+}
+
+// Anything longer is not a WAV header we know how to stream.
+constexpr size_t kMaxHeaderBytes = 4096;
+
+}
+
+PcmStream::PcmStream(std::chrono::milliseconds prebuffer)
+    : prebuffer_(prebuffer) {}
+
+void PcmStream::write(const char* data, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    bool notify = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (finished_ || failed_) {
+            return;
+        }
+        if (!header_done_) {
+            header_.append(data, size);
+            parse_header_locked();
+        } else {
+            append_pcm_locked(data, size);
+        }
+        notify = ready_locked();
+    }
+    if (notify) {
+        ready_cv_.notify_all();
+    }
+}
+
+void PcmStream::finish() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        finished_ = true;
+        if (!header_done_) {
+            failed_ = true;
+        }
+    }
+    ready_cv_.notify_all();
+}
+
+void PcmStream::fail(const std::string& reason) {
+    (void)reason;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        failed_ = true;
+        finished_ = true;
+    }
+    ready_cv_.notify_all();
+}
+
+bool PcmStream::wait_ready(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    ready_cv_.wait_for(lock, timeout, [this]() {
+        return ready_locked() || finished_ || failed_ || cancelled_;
+    });
+    return ready_locked() && !failed_ && !cancelled_;
+}
+
+size_t PcmStream::read(int16_t* out, size_t max_samples) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto available = samples_.size() - read_pos_;
+    const auto count = std::min(available, max_samples);
+    if (count > 0) {
+        std::memcpy(out, samples_.data() + read_pos_, count * sizeof(int16_t));
+        read_pos_ += count;
+    }
+    return count;
+}
+
+bool PcmStream::drained() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return finished_ && read_pos_ >= samples_.size();
+}
+
+void PcmStream::cancel() {
+    {
+        // Taken so a reader between its predicate check and wait sees the flag.
+        std::lock_guard<std::mutex> lock(mutex_);
+        cancelled_ = true;
+    }
+    ready_cv_.notify_all();
+}
+
+bool PcmStream::cancelled() const {
+    return cancelled_;
+}
+
+bool PcmStream::failed() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return failed_;
+}
+
+bool PcmStream::finished() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return finished_;
+}
+
+unsigned PcmStream::sample_rate() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return sample_rate_;
+}
+
+size_t PcmStream::buffered_samples() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return samples_.size() - read_pos_;
+}
+
+size_t PcmStream::total_samples() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return samples_.size();
+}
+
+bool PcmStream::ready_locked() const {
+    if (!header_done_ || failed_ || samples_.empty()) {
+        return false;
+    }
+    if (finished_) {
+        return true;
+    }
+    const auto prebuffer_samples =
+        static_cast<size_t>(sample_rate_) * static_cast<size_t>(prebuffer_.count()) / 1000;
+    return samples_.size() >= prebuffer_samples;
+}
+
+void PcmStream::parse_header_locked() {
+    if (header_.size() < 12) {
+        return;
+    }
+    if (header_.compare(0, 4, "RIFF") != 0 || header_.compare(8, 4, "WAVE") != 0) {
+        failed_ = true;
+        finished_ = true;
+        return;
+    }
+    size_t offset = 12;
+    while (offset + 8 <= header_.size()) {
+        const auto chunk_id = header_.substr(offset, 4);
+        const auto chunk_size = read_le32(header_.data() + offset + 4);
+        const auto body = offset + 8;
+        if (chunk_id == "data") {
+            if (sample_rate_ == 0) {
+                failed_ = true;
+                finished_ = true;
+                return;
+            }
+            header_done_ = true;
+            const auto rest = header_.substr(body);
+            header_.clear();
+            append_pcm_locked(rest.data(), rest.size());
+            return;
+        }
+        if (body + chunk_size > header_.size()) {
+            break;
+        }
+        if (chunk_id == "fmt " && chunk_size >= 16) {
+            const auto format = read_le16(header_.data() + body);
+            const auto channels = read_le16(header_.data() + body + 2);
+            const auto bits = read_le16(header_.data() + body + 14);
+            if (format != 1 || channels != 1 || bits != 16) {
+                failed_ = true;
+                finished_ = true;
+                return;
+            }
+            sample_rate_ = read_le32(header_.data() + body + 4);
+        }
+        // Chunks are word aligned.
+        offset = body + chunk_size + (chunk_size & 1);
+    }
+    if (header_.size() > kMaxHeaderBytes) {
+        failed_ = true;
+        finished_ = true;
+    }
+}
+
+void PcmStream::append_pcm_locked(const char* data, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    if (has_odd_byte_) {
+        const char pair[2] = {odd_byte_, data[0]};
+        samples_.push_back(static_cast<int16_t>(read_le16(pair)));
+        has_odd_byte_ = false;
+        ++data;
+        --size;
+    }
+    const auto count = size / 2;
+    const auto start = samples_.size();
+    samples_.resize(start + count);
+    for (size_t i = 0; i < count; ++i) {
+        samples_[start + i] = static_cast<int16_t>(read_le16(data + i * 2));
+    }
+    if (size % 2 != 0) {
+        has_odd_byte_ = true;
+        odd_byte_ = data[size - 1];
+    }
+}
+
+}
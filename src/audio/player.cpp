@@ -1,8 +1,18 @@
 #include "sip_gateway/audio/player.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
 #include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
 
+#include "sip_gateway/audio/media_partition.hpp"
+#include "sip_gateway/audio/pcm_stream.hpp"
 #include "sip_gateway/logging.hpp"
+#include "sip_gateway/metrics.hpp"
 #include "sip_gateway/utils/async.hpp"
 
 namespace sip_gateway {
@@ -10,70 +20,246 @@ namespace audio {
 
 namespace {
 
+// EOF is handled on the media lane, where the player may already be gone.
+void post_eof(std::weak_ptr<SmartPlayer> owner) {
+    utils::run_async(
+        [owner = std::move(owner)]() {
+            if (auto player = owner.lock()) {
+                player->handle_eof();
+            }
+        },
+        utils::TaskLane::Media);
+}
+
 class AudioMediaPlayer : public pj::AudioMediaPlayer {
 public:
-    explicit AudioMediaPlayer(SmartPlayer& owner) : owner_(owner) {}
+    explicit AudioMediaPlayer(SmartPlayer& owner) : owner_(owner.weak_from_this()) {}
 
     void onEof2() override {
-        utils::run_async([this]() { owner_.handle_eof(); });
+        post_eof(owner_);
+    }
+
+private:
+    std::weak_ptr<SmartPlayer> owner_;
+};
+
+// Pulls from a PcmStream on the conference clock thread. Underruns are filled
+// with silence rather than ending playback; EOF fires once the stream is
+// finished and drained.
+class StreamPlayerPort : public pj::AudioMediaPort {
+public:
+    StreamPlayerPort(SmartPlayer& owner, std::shared_ptr<PcmStream> stream)
+        : owner_(owner), stream_(std::move(stream)) {}
+
+    ~StreamPlayerPort() override {
+        const auto underruns = underruns_.load(std::memory_order_relaxed);
+        if (underruns > 0) {
+            Metrics::instance().increment_counter("tts_stream_underrun_total", {}, underruns);
+        }
+    }
+
+    void onFrameRequested(pj::MediaFrame& frame) override {
+        frame.type = PJMEDIA_FRAME_TYPE_AUDIO;
+        const auto samples = static_cast<size_t>(frame.size / sizeof(int16_t));
+        frame.buf.resize(samples * sizeof(int16_t));
+        auto* out = reinterpret_cast<int16_t*>(frame.buf.data());
+        if (owner_.muted()) {
+            std::fill(out, out + samples, static_cast<int16_t>(0));
+            frame.size = static_cast<unsigned>(frame.buf.size());
+            owner_.handle_muted_frame();
+            return;
+        }
+        const auto read = stream_->read(out, samples);
+        if (read > 0 && !first_frame_sent_.exchange(true, std::memory_order_relaxed)) {
+            owner_.handle_first_frame();
+        }
+        if (read < samples) {
+            std::fill(out + read, out + samples, static_cast<int16_t>(0));
+            if (stream_->drained()) {
+                if (!eof_sent_.exchange(true)) {
+                    post_eof(owner_.weak_from_this());
+                }
+            } else if (!stream_->cancelled()) {
+                underruns_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        frame.size = static_cast<unsigned>(frame.buf.size());
     }
 
 private:
     SmartPlayer& owner_;
+    std::shared_ptr<PcmStream> stream_;
+    std::atomic<bool> eof_sent_{false};
+    std::atomic<bool> first_frame_sent_{false};
+    std::atomic<uint64_t> underruns_{0};
 };
 
+std::shared_ptr<PcmStream> load_wav(const std::filesystem::path& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Failed to open " + filename.string());
+    }
+    const std::string body((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+    auto stream = std::make_shared<PcmStream>(std::chrono::milliseconds(0));
+    stream->write(body.data(), body.size());
+    stream->finish();
+    if (stream->failed() || stream->sample_rate() == 0) {
+        throw std::runtime_error("Not a playable WAV file: " + filename.string());
+    }
+    return stream;
+}
+
 }
 
 SmartPlayer::SmartPlayer(
     pj::AudioMedia& audio_media,
-    pj::AudioMediaRecorder* wav_recorder,
-    std::function<void()> on_stop_callback
+    pj::AudioMedia* recorder,
+    std::function<void()> on_stop_callback,
+    unsigned frame_time_usec
 )
     : on_stop_callback_(std::move(on_stop_callback)),
       active_(false)
       ,
-      audio_media_(audio_media),
-      wav_recorder_(wav_recorder)
+      audio_media_(&audio_media),
+      recorder_(recorder),
+      frame_time_usec_(frame_time_usec)
 {
 }
 
+SmartPlayer::SmartPlayer(
+    PartitionTarget target,
+    std::function<void()> on_stop_callback,
+    unsigned frame_time_usec
+)
+    : on_stop_callback_(std::move(on_stop_callback)),
+      partition_(target),
+      frame_time_usec_(frame_time_usec)
+{
+}
+
+SmartPlayer::~SmartPlayer() {
+    // A partition would otherwise keep pulling from the deleted port.
+    if (partition_.partition) {
+        destroy_player();
+    }
+}
+
 void SmartPlayer::enqueue(const std::filesystem::path& filename, bool discard_after) {
+    std::lock_guard<std::mutex> lock(mutex_);
     queue_.push_back({filename, discard_after});
 }
 
+void SmartPlayer::enqueue(std::shared_ptr<PcmStream> stream) {
+    if (!stream || stream->failed()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push_back({std::move(stream), false});
+}
+
 void SmartPlayer::play() {
-    if (!current_audio_ && !queue_.empty()) {
-        play_next();
+    bool stopped = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!current_audio_ && !queue_.empty()) {
+            stopped = play_next();
+        }
+    }
+    if (stopped) {
+        notify_stopped();
+    }
+}
+
+void SmartPlayer::mute() {
+    if (muted_.load(std::memory_order_relaxed)) {
+        return;
+    }
+    muted_at_ns_.store(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::steady_clock::now().time_since_epoch())
+                           .count(),
+                       std::memory_order_relaxed);
+    muted_.store(true, std::memory_order_release);
+}
+
+bool SmartPlayer::muted() const {
+    return muted_.load(std::memory_order_acquire);
+}
+
+void SmartPlayer::handle_muted_frame() {
+    if (mute_reported_.exchange(true, std::memory_order_relaxed)) {
+        return;
+    }
+    const auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::steady_clock::now().time_since_epoch())
+                         .count();
+    const double seconds =
+        static_cast<double>(now - muted_at_ns_.load(std::memory_order_relaxed)) / 1e9;
+    // Off the conference clock thread, which must not wait on the metrics lock.
+    utils::run_async(
+        [seconds]() { Metrics::instance().observe_response_time("barge_in_to_silence", seconds); },
+        utils::TaskLane::Media);
+}
+
+void SmartPlayer::set_on_first_frame(FirstFrameFn on_first_frame) {
+    on_first_frame_ = std::move(on_first_frame);
+}
+
+void SmartPlayer::handle_first_frame() {
+    if (!on_first_frame_) {
+        return;
+    }
+    utils::run_async(
+        [on_first_frame = on_first_frame_, at = std::chrono::steady_clock::now()]() {
+            on_first_frame(at);
+        },
+        utils::TaskLane::Media);
+}
+
+void SmartPlayer::set_call_slot(int slot) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    partition_.call_slot = slot;
+    if (!partition_.partition || player_slot_ < 0 || slot < 0) {
+        return;
+    }
+    try {
+        partition_.partition->connect(player_slot_, slot);
+    } catch (const std::exception& ex) {
+        logging::warn("Failed to reconnect player",
+                      {kv("error", ex.what())});
     }
 }
 
 void SmartPlayer::interrupt() {
+    std::lock_guard<std::mutex> lock(mutex_);
     tearing_down_ = true;
     destroy_player();
     discard_current();
     while (!queue_.empty()) {
-        auto next = queue_.front();
+        discard(queue_.front());
         queue_.pop_front();
-        if (next.discard_after) {
-            std::error_code ec;
-            std::filesystem::remove(next.filename, ec);
-        }
     }
     tearing_down_ = false;
     active_ = false;
+    muted_.store(false, std::memory_order_release);
+    mute_reported_.store(false, std::memory_order_relaxed);
 }
 
 bool SmartPlayer::is_active() const {
+    std::lock_guard<std::mutex> lock(mutex_);
     return active_;
 }
 
-void SmartPlayer::play_next() {
+void SmartPlayer::notify_stopped() {
+    if (on_stop_callback_) {
+        on_stop_callback_();
+    }
+}
+
+bool SmartPlayer::play_next() {
     if (queue_.empty()) {
         active_ = false;
-        if (on_stop_callback_) {
-            on_stop_callback_();
-        }
-        return;
+        return true;
     }
 
     current_audio_ = queue_.front();
@@ -81,52 +267,116 @@ void SmartPlayer::play_next() {
 
     if (tearing_down_) {
         logging::debug("Skip play_next during teardown.");
-        return;
+        return false;
     }
 
-    current_player_ = std::make_unique<AudioMediaPlayer>(*this);
     try {
-        current_player_->createPlayer(current_audio_->filename.string(), PJMEDIA_FILE_NO_LOOP);
-        if (wav_recorder_) {
-            current_player_->startTransmit(*wav_recorder_);
+        current_player_ = create_player(*current_audio_);
+        if (partition_.partition) {
+            if (partition_.recorder_slot >= 0) {
+                partition_.partition->connect(player_slot_, partition_.recorder_slot);
+            }
+            if (partition_.call_slot >= 0) {
+                partition_.partition->connect(player_slot_, partition_.call_slot);
+            }
+        } else {
+            if (recorder_) {
+                current_player_->startTransmit(*recorder_);
+            }
+            current_player_->startTransmit(*audio_media_);
         }
-        current_player_->startTransmit(audio_media_);
         active_ = true;
+        // A partitioned file plays from memory and reports its first frame.
+        if (!partition_.partition &&
+            std::holds_alternative<std::filesystem::path>(current_audio_->source)) {
+            handle_first_frame();
+        }
     } catch (const pj::Error&) {
         current_player_.reset();
         active_ = false;
         discard_current();
         if (!queue_.empty()) {
-            play_next();
+            return play_next();
+        }
+    } catch (const std::exception& ex) {
+        logging::warn("Failed to start playback",
+                      {kv("error", ex.what())});
+        destroy_player();
+        active_ = false;
+        discard_current();
+        if (!queue_.empty()) {
+            return play_next();
         }
     }
+    return false;
+}
+
+std::unique_ptr<pj::AudioMedia> SmartPlayer::create_player(const AudioFile& audio) {
+    std::shared_ptr<PcmStream> stream;
+    if (const auto* filename = std::get_if<std::filesystem::path>(&audio.source)) {
+        if (!partition_.partition) {
+            auto player = std::make_unique<AudioMediaPlayer>(*this);
+            player->createPlayer(filename->string(), PJMEDIA_FILE_NO_LOOP);
+            return player;
+        }
+        stream = load_wav(*filename);
+    } else {
+        stream = std::get<std::shared_ptr<PcmStream>>(audio.source);
+    }
+    pj::MediaFormatAudio format;
+    format.type = PJMEDIA_TYPE_AUDIO;
+    format.clockRate = stream->sample_rate();
+    format.channelCount = 1;
+    format.bitsPerSample = 16;
+    format.frameTimeUsec = frame_time_usec_;
+    auto port = std::make_unique<StreamPlayerPort>(*this, stream);
+    if (partition_.partition) {
+        player_slot_ = partition_.partition->add_port(*port, format, "port/tts-stream");
+    } else {
+        port->createPort("port/tts-stream", format);
+    }
+    return port;
 }
 
 void SmartPlayer::handle_eof() {
-    destroy_player();
-    discard_current();
-    if (!queue_.empty() && !tearing_down_) {
-        play_next();
-    } else if (!tearing_down_) {
-        active_ = false;
-        if (on_stop_callback_) {
-            on_stop_callback_();
+    bool stopped = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        destroy_player();
+        discard_current();
+        if (!queue_.empty() && !tearing_down_) {
+            stopped = play_next();
+        } else if (!tearing_down_) {
+            active_ = false;
+            stopped = true;
         }
     }
+    if (stopped) {
+        notify_stopped();
+    }
 }
 
 void SmartPlayer::destroy_player() {
+    if (partition_.partition) {
+        // No frame reaches the port once it is off the partition.
+        if (player_slot_ >= 0) {
+            partition_.partition->remove_port(player_slot_);
+            player_slot_ = -1;
+        }
+        current_player_.reset();
+        return;
+    }
     if (!current_player_) {
         return;
     }
-    if (wav_recorder_) {
+    if (recorder_) {
         try {
-            current_player_->stopTransmit(*wav_recorder_);
+            current_player_->stopTransmit(*recorder_);
         } catch (const pj::Error&) {
         }
     }
     try {
-        current_player_->stopTransmit(audio_media_);
+        current_player_->stopTransmit(*audio_media_);
     } catch (const pj::Error&) {
     }
     current_player_.reset();
@@ -136,11 +386,17 @@ void SmartPlayer::discard_current() {
     if (!current_audio_) {
         return;
     }
-    if (current_audio_->discard_after) {
+    discard(*current_audio_);
+    current_audio_.reset();
+}
+
+void SmartPlayer::discard(const AudioFile& audio) {
+    if (const auto* stream = std::get_if<std::shared_ptr<PcmStream>>(&audio.source)) {
+        (*stream)->cancel();
+    } else if (audio.discard_after) {
         std::error_code ec;
-        std::filesystem::remove(current_audio_->filename, ec);
+        std::filesystem::remove(std::get<std::filesystem::path>(audio.source), ec);
     }
-    current_audio_.reset();
 }
 
 }
@@ -1,30 +1,44 @@
 #include "sip_gateway/audio/port.hpp"
 
 #include <algorithm>
+#include <chrono>
 
-#include "sip_gateway/utils/async.hpp"
-
+#include "sip_gateway/audio/shard_pool.hpp"
+#include "sip_gateway/logging.hpp"
+#include "sip_gateway/metrics.hpp"
 
 namespace sip_gateway::audio {
 
-AudioMediaPort::AudioMediaPort() {
-    worker_ = std::thread([this]() { worker_loop(); });
+namespace {
+
+int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+}
+
+AudioMediaPort::AudioMediaPort(int shard_key, size_t frame_samples, unsigned frame_time_usec)
+    : frames_(kMaxQueueSize, frame_samples),
+      frame_time_ns_(static_cast<int64_t>(frame_time_usec) * 1000),
+      shard_pool_(audio_shard_pool()),
+      shard_(shard_pool_.shard_for(shard_key)) {
+    shard_pool_.attach(shard_, this);
 }
 
 AudioMediaPort::~AudioMediaPort() {
-    {
-        std::lock_guard<std::mutex> lock(queue_mutex_);
-        stop_worker_ = true;
-    }
-    queue_cv_.notify_one();
-    if (worker_.joinable()) {
-        worker_.join();
-    }
+    detached_.store(true, std::memory_order_release);
+    shard_pool_.detach(shard_, this);
 }
 
 void AudioMediaPort::set_on_frame_received(FrameHandler handler) {
-    std::lock_guard<std::mutex> lock(handler_mutex_);
+    if (handler_ready_.load(std::memory_order_acquire)) {
+        logging::warn("Frame handler already installed, ignoring");
+        return;
+    }
     on_frame_received_ = std::move(handler);
+    handler_ready_.store(on_frame_received_ != nullptr, std::memory_order_release);
 }
 
 void AudioMediaPort::set_on_frame_requested(FrameProvider handler) {
@@ -59,47 +73,63 @@ void AudioMediaPort::onFrameRequested(pj::MediaFrame& frame) {
 }
 
 void AudioMediaPort::onFrameReceived(pj::MediaFrame& frame) {
-    FrameHandler handler;
-    {
-        std::lock_guard<std::mutex> lock(handler_mutex_);
-        handler = on_frame_received_;
+    // Runs on the shared conference clock thread: no locks, no allocation.
+    if (!handler_ready_.load(std::memory_order_acquire) ||
+        detached_.load(std::memory_order_acquire)) {
+        return;
     }
-    if (frame.buf.empty() || frame.size == 0 || !handler) {
+    const auto now = now_ns();
+    if (last_tick_ns_ != 0) {
+        // How far behind its nominal tick the bridge delivered this frame.
+        static auto& lateness = Metrics::instance().histogram("media_tick_lateness");
+        const auto late = now - last_tick_ns_ - frame_time_ns_;
+        lateness.observe(late > 0 ? static_cast<double>(late) / 1e9 : 0.0);
+    }
+    last_tick_ns_ = now;
+    if (frame.buf.empty() || frame.size == 0) {
         return;
     }
     const auto available_bytes = std::min(static_cast<size_t>(frame.size), frame.buf.size());
-    const auto samples = available_bytes / sizeof(int16_t);
-    std::vector<int16_t> audio_data(samples);
-    std::memcpy(audio_data.data(), frame.buf.data(), samples * sizeof(int16_t));
-    FrameTask task{std::move(handler), std::move(audio_data)};
-    {
-        std::lock_guard<std::mutex> lock(queue_mutex_);
-        if (frame_queue_.size() >= kMaxQueueSize) {
-            frame_queue_.pop_front();
+    auto remaining = available_bytes / sizeof(int16_t);
+    const auto* samples = reinterpret_cast<const int16_t*>(frame.buf.data());
+    bool pushed = false;
+    while (remaining > 0) {
+        const auto chunk = std::min(remaining, frames_.slot_samples());
+        if (!frames_.push(samples, chunk)) {
+            dropped_frames_.fetch_add(1, std::memory_order_relaxed);
+            break;
         }
-        frame_queue_.push_back(std::move(task));
+        pushed = true;
+        samples += chunk;
+        remaining -= chunk;
+    }
+    if (pushed && !pending_.load(std::memory_order_acquire)) {
+        pending_since_ns_.store(now, std::memory_order_relaxed);
+    }
+    if (pushed && !pending_.exchange(true, std::memory_order_acq_rel)) {
+        shard_pool_.notify(shard_);
     }
-    queue_cv_.notify_one();
 }
 
-void AudioMediaPort::worker_loop() {
-    utils::ensure_pj_thread_registered("sipgw_audio");
-    while (true) {
-        FrameTask task;
-        {
-            std::unique_lock<std::mutex> lock(queue_mutex_);
-            queue_cv_.wait(lock, [this]() { return stop_worker_ || !frame_queue_.empty(); });
-            if (stop_worker_ && frame_queue_.empty()) {
-                break;
-            }
-            task = std::move(frame_queue_.front());
-            frame_queue_.pop_front();
-        }
-        if (task.handler) {
-            task.handler(task.data);
-        }
+size_t AudioMediaPort::drain_frames() {
+    static auto& handoff = Metrics::instance().histogram("audio_frame_handoff");
+    static auto& dropped_total = Metrics::instance().counter("audio_frames_dropped_total");
+    const auto since = pending_since_ns_.load(std::memory_order_relaxed);
+    if (since != 0) {
+        handoff.observe(static_cast<double>(std::max<int64_t>(0, now_ns() - since)) / 1e9);
     }
+    const auto dropped = dropped_frames_.exchange(0, std::memory_order_relaxed);
+    if (dropped > 0) {
+        dropped_total.increment(dropped);
+    }
+    const auto depth = frames_.size();
+    const int16_t* samples = nullptr;
+    size_t count = 0;
+    while (frames_.front(samples, count)) {
+        on_frame_received_(samples, count);
+        frames_.pop();
+    }
+    return depth;
 }
 
 }
-
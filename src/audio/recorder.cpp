@@ -1,63 +1,341 @@
 #include "sip_gateway/audio/recorder.hpp"
 
-#include <filesystem>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <stdexcept>
+#include <thread>
+#include <vector>
 
+#include "sip_gateway/audio/frame_ring.hpp"
 #include "sip_gateway/logging.hpp"
+#include "sip_gateway/metrics.hpp"
 
 namespace sip_gateway {
 namespace audio {
 
-CallRecorder::CallRecorder() = default;
+namespace {
+
+// Rings hold this much audio per channel, so the disk may stall this long
+// before frames are dropped.
+constexpr unsigned kRingUsec = 5000000;
+constexpr std::chrono::milliseconds kFlushInterval{200};
+// A channel whose port got no frames is padded with silence once the other
+// channel is this many frames ahead.
+constexpr size_t kMaxSkewFrames = 10;
 
-CallRecorder::~CallRecorder() {
-    stop_recording();
 }
 
-void CallRecorder::start_recording(
-    const std::filesystem::path& filename,
-    unsigned sample_rate,
-    unsigned channels,
-    unsigned bits_per_sample
-) {
-    (void)sample_rate;
-    (void)channels;
-    (void)bits_per_sample;
+struct CallRecorder::Recording {
+    Recording(const std::filesystem::path& filename, const RecorderOptions& options)
+        : file(filename, options.format, options.sample_rate, options.stereo ? 2 : 1,
+               options.opus_bitrate),
+          frame_samples(std::max<size_t>(
+              1, static_cast<uint64_t>(options.sample_rate) * options.frame_time_usec / 1000000)),
+          slots(std::max<size_t>(1, kRingUsec / std::max(1u, options.frame_time_usec))),
+          caller(slots, frame_samples) {
+        if (options.stereo) {
+            playback = std::make_unique<FrameRing>(slots, frame_samples);
+        }
+    }
 
-    if (recording_) {
-        stop_recording();
+    size_t backlog() const {
+        return std::max(caller.size(), playback ? playback->size() : 0);
+    }
+
+    RecordingFile file; // Writer thread only.
+    size_t frame_samples;
+    size_t slots;
+    FrameRing caller;
+    std::unique_ptr<FrameRing> playback; // Stereo only.
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<bool> closing{false};
+    std::vector<int16_t> batch; // Writer thread only.
+};
+
+// Receives frames from the bridge on the clock thread and only copies them
+// into the recording's ring; an empty frame is stored as a silent slot.
+class CallRecorder::Port : public pj::AudioMediaPort {
+public:
+    Port(std::shared_ptr<Recording> recording, FrameRing& ring)
+        : recording_(std::move(recording)), ring_(ring) {}
+
+    void onFrameRequested(pj::MediaFrame& frame) override {
+        frame.type = PJMEDIA_FRAME_TYPE_NONE;
+        frame.size = 0;
+        frame.buf.clear();
+    }
+
+    void onFrameReceived(pj::MediaFrame& frame) override {
+        const auto bytes = std::min(static_cast<size_t>(frame.size), frame.buf.size());
+        if (frame.type != PJMEDIA_FRAME_TYPE_AUDIO || bytes == 0) {
+            push(nullptr, 0);
+            return;
+        }
+        const auto* samples = reinterpret_cast<const int16_t*>(frame.buf.data());
+        auto remaining = bytes / sizeof(int16_t);
+        while (remaining > 0) {
+            const auto chunk = std::min(remaining, ring_.slot_samples());
+            if (!push(samples, chunk)) {
+                return;
+            }
+            samples += chunk;
+            remaining -= chunk;
+        }
+    }
+
+private:
+    bool push(const int16_t* samples, size_t count) {
+        if (ring_.push(samples, count)) {
+            return true;
+        }
+        recording_->dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    std::shared_ptr<Recording> recording_;
+    FrameRing& ring_;
+};
+
+// One thread for every recording in the process. Each pass drains whatever
+// the rings hold into a single write per file.
+class RecordingWriter {
+public:
+    using RecordingPtr = std::shared_ptr<CallRecorder::Recording>;
+
+    ~RecordingWriter() {
+        shutdown();
+    }
+
+    void add(RecordingPtr recording) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        recordings_.push_back(std::move(recording));
+        if (!thread_.joinable() && !stopping_) {
+            thread_ = std::thread([this]() { run(); });
+        }
+    }
+
+    void notify() {
+        cv_.notify_one();
     }
 
-    current_file_ = filename;
-    const auto parent_dir = current_file_.parent_path();
-    if (!parent_dir.empty()) {
-        std::filesystem::create_directories(parent_dir);
+    void shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_one();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+        // Whatever is left, including recordings added after the thread
+        // stopped.
+        std::vector<RecordingPtr> left;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            left.swap(recordings_);
+        }
+        for (auto& recording : left) {
+            drain(*recording, true);
+            recording->file.close();
+        }
     }
 
-    recorder_ = std::make_unique<pj::AudioMediaRecorder>();
+private:
+    void run() {
+        std::vector<RecordingPtr> current;
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stopping_) {
+            cv_.wait_for(lock, kFlushInterval);
+            current = recordings_;
+            lock.unlock();
+            size_t backlog = 0;
+            std::vector<const CallRecorder::Recording*> finished;
+            for (auto& recording : current) {
+                backlog += recording->backlog();
+                const bool closing = recording->closing.load(std::memory_order_acquire);
+                drain(*recording, closing);
+                if (closing) {
+                    recording->file.close();
+                    finished.push_back(recording.get());
+                }
+            }
+            current.clear();
+            Metrics::instance().set_gauge("recording_writer_backlog_frames",
+                                          static_cast<double>(backlog));
+            lock.lock();
+            recordings_.erase(
+                std::remove_if(recordings_.begin(), recordings_.end(),
+                               [&finished](const RecordingPtr& recording) {
+                                   return std::find(finished.begin(), finished.end(),
+                                                    recording.get()) != finished.end();
+                               }),
+                recordings_.end());
+        }
+    }
+
+    // With flush set, a channel that ran dry no longer holds the other back.
+    static void drain(CallRecorder::Recording& recording, bool flush) {
+        auto& batch = recording.batch;
+        batch.clear();
+        const size_t frame = recording.frame_samples;
+        size_t frames = 0;
+        if (!recording.playback) {
+            const int16_t* samples = nullptr;
+            size_t count = 0;
+            while (recording.caller.front(samples, count)) {
+                if (count == 0) {
+                    batch.insert(batch.end(), frame, 0);
+                } else {
+                    batch.insert(batch.end(), samples, samples + count);
+                }
+                recording.caller.pop();
+            }
+            frames = batch.size();
+        } else {
+            auto& left = recording.caller;
+            auto& right = *recording.playback;
+            while (true) {
+                const int16_t* left_samples = nullptr;
+                const int16_t* right_samples = nullptr;
+                size_t left_count = 0;
+                size_t right_count = 0;
+                const bool has_left = left.front(left_samples, left_count);
+                const bool has_right = right.front(right_samples, right_count);
+                if (!has_left && !has_right) {
+                    break;
+                }
+                if (has_left != has_right && !flush &&
+                    (has_left ? left.size() : right.size()) < kMaxSkewFrames) {
+                    break;
+                }
+                if (!has_left || left_count == 0) {
+                    left_samples = nullptr;
+                    left_count = frame;
+                }
+                if (!has_right || right_count == 0) {
+                    right_samples = nullptr;
+                    right_count = frame;
+                }
+                const size_t count = std::max(left_count, right_count);
+                for (size_t i = 0; i < count; ++i) {
+                    batch.push_back(left_samples && i < left_count ? left_samples[i] : 0);
+                    batch.push_back(right_samples && i < right_count ? right_samples[i] : 0);
+                }
+                frames += count;
+                if (has_left) {
+                    left.pop();
+                }
+                if (has_right) {
+                    right.pop();
+                }
+            }
+        }
+        auto& metrics = Metrics::instance();
+        const auto dropped = recording.dropped.exchange(0, std::memory_order_relaxed);
+        if (dropped > 0) {
+            metrics.increment_counter("recording_frames_dropped_total", {}, dropped);
+        }
+        if (frames == 0) {
+            return;
+        }
+        const auto before = recording.file.bytes_written();
+        if (!recording.file.write(batch.data(), frames)) {
+            logging::error("Recording write failed",
+                           {kv("filename", recording.file.path().string())});
+        }
+        metrics.increment_counter(
+            "recording_bytes_total",
+            {{"format", recording.file.format() == RecordingFormat::Opus ? "opus" : "wav"}},
+            recording.file.bytes_written() - before);
+    }
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<RecordingPtr> recordings_;
+    std::thread thread_;
+    bool stopping_ = false;
+};
+
+namespace {
+
+RecordingWriter& recording_writer() {
+    static RecordingWriter writer;
+    return writer;
+}
+
+}
 
+CallRecorder::CallRecorder() = default;
+
+CallRecorder::~CallRecorder() {
+    stop_recording();
+}
+
+void CallRecorder::start_recording(const std::filesystem::path& filename,
+                                   const RecorderOptions& options) {
+    if (recording_) {
+        stop_recording();
+    }
+    auto recording = std::make_shared<Recording>(filename, options);
+    pj::MediaFormatAudio format;
+    format.type = PJMEDIA_TYPE_AUDIO;
+    format.clockRate = options.sample_rate;
+    format.channelCount = 1;
+    format.bitsPerSample = 16;
+    format.frameTimeUsec = options.frame_time_usec;
     try {
-        recorder_->createRecorder(filename.string());
-        recording_ = true;
+        caller_port_ = std::make_unique<Port>(recording, recording->caller);
+        if (options.register_ports) {
+            caller_port_->createPort("port/record/" + filename.stem().string(), format);
+        }
+        if (recording->playback) {
+            playback_port_ = std::make_unique<Port>(recording, *recording->playback);
+            if (options.register_ports) {
+                playback_port_->createPort("port/record-tx/" + filename.stem().string(),
+                                           format);
+            }
+        }
     } catch (const pj::Error& e) {
-        recorder_.reset();
-        recording_ = false;
+        caller_port_.reset();
+        playback_port_.reset();
         throw std::runtime_error(e.info());
     }
+    logging::debug("Call recording started",
+                   {kv("filename", recording->file.path().string()),
+                    kv("stereo", options.stereo)});
+    recording_ = recording;
+    recording_writer().add(std::move(recording));
 }
 
 void CallRecorder::stop_recording() {
-    recorder_.reset();
-    recording_ = false;
-    current_file_.clear();
+    if (!recording_) {
+        return;
+    }
+    // Removing the ports from the bridge ends the producers.
+    caller_port_.reset();
+    playback_port_.reset();
+    recording_->closing.store(true, std::memory_order_release);
+    recording_.reset();
+    recording_writer().notify();
 }
 
 bool CallRecorder::is_recording() const {
-    return recording_;
+    return recording_ != nullptr;
+}
+
+pj::AudioMediaPort* CallRecorder::caller_input() {
+    return caller_port_.get();
+}
+
+pj::AudioMediaPort* CallRecorder::playback_input() {
+    return playback_port_ ? playback_port_.get() : caller_port_.get();
 }
 
-pj::AudioMediaRecorder* CallRecorder::get_recorder() {
-    return recorder_.get();
+void shutdown_recording_writer() {
+    recording_writer().shutdown();
 }
 
 }
@@ -0,0 +1,115 @@
+#include "sip_gateway/audio/recording_file.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include "sip_gateway/audio/ogg_opus.hpp"
+#include "sip_gateway/audio/wav.hpp"
+
+namespace sip_gateway::audio {
+
+RecordingFormat parse_recording_format(const std::string& name) {
+    if (name == "wav") {
+        return RecordingFormat::Wav;
+    }
+    if (name == "opus") {
+        return RecordingFormat::Opus;
+    }
+    throw std::runtime_error("Unknown recording format: " + name);
+}
+
+RecordingFile::RecordingFile(std::filesystem::path path,
+                             RecordingFormat format,
+                             uint32_t sample_rate,
+                             unsigned channels,
+                             int opus_bitrate)
+    : path_(std::move(path)),
+      format_(RecordingFormat::Wav),
+      sample_rate_(sample_rate),
+      channels_(channels) {
+    if (format == RecordingFormat::Opus) {
+        opus_ = OggOpusEncoder::create(sample_rate, channels, opus_bitrate);
+        if (opus_) {
+            format_ = RecordingFormat::Opus;
+        }
+    }
+    path_.replace_extension(format_ == RecordingFormat::Opus ? ".ogg" : ".wav");
+    const auto parent_dir = path_.parent_path();
+    if (!parent_dir.empty()) {
+        std::filesystem::create_directories(parent_dir);
+    }
+    out_.open(path_, std::ios::binary | std::ios::trunc);
+    if (!out_) {
+        throw std::runtime_error("Cannot create recording " + path_.string());
+    }
+    if (opus_) {
+        append(opus_->take());
+    } else {
+        append(wav_header(sample_rate_, static_cast<uint16_t>(channels_), 0));
+    }
+}
+
+RecordingFile::~RecordingFile() {
+    close();
+}
+
+const std::filesystem::path& RecordingFile::path() const {
+    return path_;
+}
+
+RecordingFormat RecordingFile::format() const {
+    return format_;
+}
+
+unsigned RecordingFile::channels() const {
+    return channels_;
+}
+
+uint64_t RecordingFile::bytes_written() const {
+    return bytes_written_;
+}
+
+bool RecordingFile::write(const int16_t* samples, size_t frames) {
+    if (closed_ || frames == 0) {
+        return !closed_;
+    }
+    if (opus_) {
+        return opus_->write(samples, frames) && append(opus_->take());
+    }
+    // PCM16 little-endian, which is the host order on every target we build.
+    const auto bytes = frames * channels_ * sizeof(int16_t);
+    out_.write(reinterpret_cast<const char*>(samples), static_cast<std::streamsize>(bytes));
+    data_bytes_ += bytes;
+    bytes_written_ += bytes;
+    return static_cast<bool>(out_);
+}
+
+void RecordingFile::close() {
+    if (closed_) {
+        return;
+    }
+    closed_ = true;
+    if (opus_) {
+        if (opus_->finish()) {
+            append(opus_->take());
+        }
+    } else if (out_) {
+        const auto data_size = static_cast<uint32_t>(
+            std::min<uint64_t>(data_bytes_, std::numeric_limits<uint32_t>::max() - 36));
+        out_.seekp(0);
+        out_ << wav_header(sample_rate_, static_cast<uint16_t>(channels_), data_size);
+    }
+    out_.close();
+}
+
+bool RecordingFile::append(const std::string& bytes) {
+    if (bytes.empty()) {
+        return static_cast<bool>(out_);
+    }
+    out_.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    bytes_written_ += bytes.size();
+    return static_cast<bool>(out_);
+}
+
+}
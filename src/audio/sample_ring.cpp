@@ -0,0 +1,97 @@
+#include "sip_gateway/audio/sample_ring.hpp"
+
+#include <algorithm>
+
+namespace sip_gateway::audio {
+
+SampleRing::SampleRing(size_t capacity) : capacity_(capacity) {}
+
+size_t SampleRing::capacity() const {
+    return capacity_;
+}
+
+size_t SampleRing::size() const {
+    return size_;
+}
+
+bool SampleRing::empty() const {
+    return size_ == 0;
+}
+
+size_t SampleRing::dropped() const {
+    return dropped_;
+}
+
+size_t SampleRing::allocated() const {
+    return storage_.capacity();
+}
+
+void SampleRing::push(const float* samples, size_t count) {
+    if (count == 0) {
+        return;
+    }
+    if (capacity_ == 0) {
+        dropped_ += count;
+        return;
+    }
+    if (count >= capacity_) {
+        storage_.resize(capacity_);
+        std::copy(samples + (count - capacity_), samples + count, storage_.begin());
+        dropped_ += size_ + count - capacity_;
+        head_ = 0;
+        size_ = capacity_;
+        return;
+    }
+    // Until the storage reaches capacity it has never wrapped, so the samples
+    // start at index 0 and growing keeps them in place.
+    if (size_ + count > storage_.size() && storage_.size() < capacity_) {
+        storage_.resize(std::min(capacity_, std::max(size_ + count, storage_.size() * 2)));
+    }
+    const size_t slots = storage_.size();
+    const size_t tail = (head_ + size_) % slots;
+    const size_t first = std::min(count, slots - tail);
+    std::copy(samples, samples + first, storage_.begin() + tail);
+    std::copy(samples + first, samples + count, storage_.begin());
+    if (size_ + count > slots) {
+        const size_t overflow = size_ + count - slots;
+        head_ = (head_ + overflow) % slots;
+        size_ = slots;
+        dropped_ += overflow;
+    } else {
+        size_ += count;
+    }
+}
+
+void SampleRing::push(const SampleRing& other) {
+    for (const auto& span : other.view(0, other.size())) {
+        push(span.data, span.size);
+    }
+}
+
+void SampleRing::clear() {
+    head_ = 0;
+    size_ = 0;
+    dropped_ = 0;
+}
+
+std::array<SampleRing::Span, 2> SampleRing::view(size_t offset, size_t count) const {
+    std::array<Span, 2> spans{};
+    offset = std::min(offset, size_);
+    count = std::min(count, size_ - offset);
+    if (count == 0) {
+        return spans;
+    }
+    const size_t start = (head_ + offset) % storage_.size();
+    const size_t first = std::min(count, storage_.size() - start);
+    spans[0] = {storage_.data() + start, first};
+    spans[1] = {storage_.data(), count - first};
+    return spans;
+}
+
+void SampleRing::copy_to(size_t offset, size_t count, std::vector<float>& out) const {
+    for (const auto& span : view(offset, count)) {
+        out.insert(out.end(), span.data, span.data + span.size);
+    }
+}
+
+}
@@ -0,0 +1,185 @@
+#include "sip_gateway/audio/shard_pool.hpp"
+
+#include <algorithm>
+#include <string>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "sip_gateway/audio/port.hpp"
+#include "sip_gateway/logging.hpp"
+#include "sip_gateway/metrics.hpp"
+#include "sip_gateway/utils/async.hpp"
+
+namespace sip_gateway::audio {
+
+namespace {
+
+std::mutex pool_mutex;
+std::unique_ptr<AudioShardPool> pool_instance;
+
+}
+
+AudioShardPool::AudioShardPool(AudioShardPoolOptions options)
+    : options_(options) {
+    options_.threads = std::max<size_t>(1, options_.threads);
+    shards_.reserve(options_.threads);
+    for (size_t i = 0; i < options_.threads; ++i) {
+        shards_.push_back(std::make_unique<Shard>());
+    }
+    for (size_t i = 0; i < options_.threads; ++i) {
+        shards_[i]->thread = std::thread([this, i]() { shard_loop(i); });
+    }
+}
+
+AudioShardPool::~AudioShardPool() {
+    shutdown();
+}
+
+size_t AudioShardPool::shard_for(int key) const {
+    const auto unsigned_key = static_cast<size_t>(key < 0 ? -key : key);
+    return unsigned_key % shards_.size();
+}
+
+void AudioShardPool::attach(size_t shard, AudioMediaPort* port) {
+    auto& target = *shards_[shard % shards_.size()];
+    std::lock_guard<std::mutex> lock(target.mutex);
+    target.ports.push_back(port);
+}
+
+void AudioShardPool::detach(size_t shard, AudioMediaPort* port) {
+    auto& target = *shards_[shard % shards_.size()];
+    std::unique_lock<std::mutex> lock(target.mutex);
+    target.ports.erase(std::remove(target.ports.begin(), target.ports.end(), port),
+                       target.ports.end());
+    if (target.thread.get_id() == std::this_thread::get_id()) {
+        return;
+    }
+    target.idle_cv.wait(lock, [&target, port]() { return target.running != port; });
+}
+
+void AudioShardPool::notify(size_t shard) {
+    auto& target = *shards_[shard % shards_.size()];
+    target.signals.fetch_add(1, std::memory_order_release);
+    target.cv.notify_one();
+}
+
+void AudioShardPool::shutdown() {
+    for (auto& shard : shards_) {
+        {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            shard->stopping = true;
+        }
+        shard->cv.notify_all();
+    }
+    for (auto& shard : shards_) {
+        if (shard->thread.joinable()) {
+            shard->thread.join();
+        }
+    }
+}
+
+size_t AudioShardPool::shard_count() const {
+    return shards_.size();
+}
+
+void AudioShardPool::shard_loop(size_t index) {
+    const auto name = "sipgw_audio" + std::to_string(index);
+    utils::ensure_pj_thread_registered(name.c_str());
+    if (options_.pin_threads) {
+        pin_thread(index);
+    }
+    auto& shard = *shards_[index];
+    // Deepest port queue of each pass; a shard that cannot keep up shows
+    // here well before audio_frames_dropped_total moves.
+    auto& depth_gauge = Metrics::instance().gauge("audio_shard_queue_depth",
+                                                  {{"shard", std::to_string(index)}});
+    std::vector<AudioMediaPort*> batch;
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(shard.mutex);
+            shard.cv.wait_for(lock, kPollInterval, [&shard, seen]() {
+                return shard.stopping ||
+                       shard.signals.load(std::memory_order_acquire) != seen;
+            });
+            if (shard.stopping) {
+                break;
+            }
+            seen = shard.signals.load(std::memory_order_acquire);
+            batch.assign(shard.ports.begin(), shard.ports.end());
+        }
+        size_t max_depth = 0;
+        for (auto* port : batch) {
+            {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                if (std::find(shard.ports.begin(), shard.ports.end(), port) ==
+                    shard.ports.end()) {
+                    continue;
+                }
+                shard.running = port;
+            }
+            if (port->pending_.exchange(false, std::memory_order_acq_rel)) {
+                max_depth = std::max(max_depth, port->drain_frames());
+            }
+            {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                shard.running = nullptr;
+            }
+            shard.idle_cv.notify_all();
+        }
+        depth_gauge.set(static_cast<double>(max_depth));
+    }
+}
+
+void AudioShardPool::pin_thread(size_t index) {
+#ifdef __linux__
+    const auto cpus = std::max(1u, std::thread::hardware_concurrency());
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(index % cpus, &set);
+    const int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (rc != 0) {
+        logging::warn("Failed to pin audio worker",
+                      {kv("shard", index), kv("error", rc)});
+    }
+#else
+    (void)index;
+#endif
+}
+
+void init_audio_shard_pool(const AudioShardPoolOptions& options) {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    if (pool_instance) {
+        logging::warn("Audio shard pool already initialized");
+        return;
+    }
+    pool_instance = std::make_unique<AudioShardPool>(options);
+    logging::info(
+        "Audio shard pool started",
+        {kv("threads", options.threads),
+         kv("pin_threads", options.pin_threads)});
+}
+
+AudioShardPool& audio_shard_pool() {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    if (!pool_instance) {
+        pool_instance = std::make_unique<AudioShardPool>(AudioShardPoolOptions{});
+    }
+    return *pool_instance;
+}
+
+void shutdown_audio_shard_pool() {
+    AudioShardPool* pool = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        pool = pool_instance.get();
+    }
+    if (pool) {
+        pool->shutdown();
+    }
+}
+
+}
@@ -0,0 +1,195 @@
+#include "sip_gateway/audio/tts_cache.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+#include "sip_gateway/logging.hpp"
+#include "sip_gateway/metrics.hpp"
+#include "sip_gateway/utils/text.hpp"
+
+namespace sip_gateway::audio {
+
+namespace {
+
+uint64_t fnv1a(const std::string& value) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (const unsigned char ch : value) {
+        hash ^= ch;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+void count_lookup(const char* result) {
+    Metrics::instance().increment_counter("tts_cache_requests_total", {{"result", result}});
+}
+
+}
+
+TtsCache::TtsCache(TtsCacheOptions options)
+    : options_(std::move(options)) {
+    if (!options_.disk_dir.empty()) {
+        std::error_code ec;
+        std::filesystem::create_directories(options_.disk_dir, ec);
+        if (ec) {
+            logging::warn(
+                "TTS cache directory unavailable, disk tier disabled",
+                {kv("dir", options_.disk_dir.string()),
+                 kv("error", ec.message())});
+            options_.disk_dir.clear();
+        }
+    }
+}
+
+std::string TtsCache::make_key(const std::string& text, const std::string& voice) {
+    return voice + '\n' + utils::normalize_text(text);
+}
+
+bool TtsCache::enabled() const {
+    return options_.max_bytes > 0;
+}
+
+std::shared_ptr<const std::string> TtsCache::get(const std::string& key) {
+    if (!enabled()) {
+        return nullptr;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const auto it = index_.find(key);
+        if (it != index_.end()) {
+            lru_.splice(lru_.begin(), lru_, it->second);
+            count_lookup("hit");
+            return it->second->audio;
+        }
+    }
+    auto audio = load_from_disk(key);
+    if (!audio) {
+        count_lookup("miss");
+        return nullptr;
+    }
+    count_lookup("disk_hit");
+    std::lock_guard<std::mutex> lock(mutex_);
+    insert_locked(key, audio);
+    return audio;
+}
+
+void TtsCache::put(const std::string& key, std::string audio) {
+    if (!enabled() || audio.empty() || audio.size() > options_.max_entry_bytes) {
+        return;
+    }
+    auto shared = std::make_shared<const std::string>(std::move(audio));
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (index_.count(key) != 0) {
+            return;
+        }
+        insert_locked(key, shared);
+    }
+    store_on_disk(key, *shared);
+}
+
+size_t TtsCache::size_bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytes_;
+}
+
+size_t TtsCache::entries() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lru_.size();
+}
+
+void TtsCache::insert_locked(const std::string& key, std::shared_ptr<const std::string> audio) {
+    const auto existing = index_.find(key);
+    if (existing != index_.end()) {
+        bytes_ -= existing->second->audio->size();
+        lru_.erase(existing->second);
+        index_.erase(existing);
+    }
+    bytes_ += audio->size();
+    lru_.push_front({key, std::move(audio)});
+    index_[key] = lru_.begin();
+    uint64_t evicted = 0;
+    while (bytes_ > options_.max_bytes && lru_.size() > 1) {
+        auto& victim = lru_.back();
+        bytes_ -= victim.audio->size();
+        index_.erase(victim.key);
+        lru_.pop_back();
+        ++evicted;
+    }
+    if (evicted > 0) {
+        Metrics::instance().increment_counter("tts_cache_evictions_total", {}, evicted);
+    }
+    publish_size_locked();
+}
+
+void TtsCache::publish_size_locked() const {
+    Metrics::instance().set_gauge("tts_cache_bytes", static_cast<double>(bytes_));
+    Metrics::instance().set_gauge("tts_cache_entries", static_cast<double>(lru_.size()));
+}
+
+std::filesystem::path TtsCache::disk_path(const std::string& key) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.tts",
+                  static_cast<unsigned long long>(fnv1a(key)));
+    return options_.disk_dir / name;
+}
+
+// Disk entries are "<key length>\n<key><wav>", so a hash collision reads as
+// a miss rather than the wrong audio.
+std::shared_ptr<const std::string> TtsCache::load_from_disk(const std::string& key) const {
+    if (options_.disk_dir.empty()) {
+        return nullptr;
+    }
+    std::ifstream in(disk_path(key), std::ios::binary);
+    if (!in) {
+        return nullptr;
+    }
+    size_t key_size = 0;
+    if (!(in >> key_size) || in.get() != '\n' || key_size != key.size()) {
+        return nullptr;
+    }
+    std::string stored_key(key_size, '\0');
+    if (!in.read(stored_key.data(), static_cast<std::streamsize>(key_size)) ||
+        stored_key != key) {
+        return nullptr;
+    }
+    std::string audio((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (audio.empty() || audio.size() > options_.max_entry_bytes) {
+        return nullptr;
+    }
+    return std::make_shared<const std::string>(std::move(audio));
+}
+
+void TtsCache::store_on_disk(const std::string& key, const std::string& audio) const {
+    if (options_.disk_dir.empty()) {
+        return;
+    }
+    const auto path = disk_path(key);
+    auto tmp = path;
+    tmp += ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        out << key.size() << '\n';
+        out.write(key.data(), static_cast<std::streamsize>(key.size()));
+        out.write(audio.data(), static_cast<std::streamsize>(audio.size()));
+        if (!out) {
+            std::error_code ec;
+            std::filesystem::remove(tmp, ec);
+            return;
+        }
+    }
+    // Readers in another process never see a partially written entry.
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) {
+        logging::warn(
+            "TTS cache disk write failed",
+            {kv("path", path.string()),
+             kv("error", ec.message())});
+        std::filesystem::remove(tmp, ec);
+    }
+}
+
+}
@@ -0,0 +1,71 @@
+#include "sip_gateway/audio/upload_encoder.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#include "sip_gateway/audio/ogg_opus.hpp"
+#include "sip_gateway/audio/wav.hpp"
+#include "sip_gateway/logging.hpp"
+
+namespace sip_gateway::audio {
+
+namespace {
+
+// The gateway sends WAV as "wav" for compatibility with the Python client.
+const char* default_content_type(UploadCodec codec) {
+    return codec == UploadCodec::Opus ? "audio/ogg; codecs=opus" : "wav";
+}
+
+bool encode_ogg_opus(const std::vector<float>& audio, uint32_t sample_rate, int bitrate,
+                     std::string& out) {
+    auto encoder = OggOpusEncoder::create(sample_rate, 1, bitrate);
+    if (!encoder) {
+        return false;
+    }
+    std::vector<int16_t> pcm(audio.size());
+    std::transform(audio.begin(), audio.end(), pcm.begin(), float_to_pcm16);
+    if (!encoder->write(pcm.data(), pcm.size()) || !encoder->finish()) {
+        return false;
+    }
+    out = encoder->take();
+    return true;
+}
+
+}
+
+UploadCodec parse_upload_codec(const std::string& name) {
+    if (name == "wav") {
+        return UploadCodec::Wav;
+    }
+    if (name == "opus") {
+        return UploadCodec::Opus;
+    }
+    throw std::runtime_error("Unknown upload codec: " + name);
+}
+
+EncodedAudio encode_upload(const std::vector<float>& audio,
+                           uint32_t sample_rate,
+                           const UploadEncoderOptions& options,
+                           std::string scratch) {
+    EncodedAudio result;
+    if (options.codec == UploadCodec::Opus &&
+        encode_ogg_opus(audio, sample_rate, options.opus_bitrate, result.bytes)) {
+        result.codec = UploadCodec::Opus;
+    }
+    if (result.codec != UploadCodec::Opus) {
+        if (options.codec == UploadCodec::Opus) {
+            logging::debug(
+                "Opus upload unavailable, sending WAV",
+                {kv("sample_rate", sample_rate)});
+        }
+        encode_wav(audio, sample_rate, scratch);
+        result.bytes = std::move(scratch);
+    }
+    result.content_type = !options.content_type.empty() && result.codec == options.codec
+                              ? options.content_type
+                              : default_content_type(result.codec);
+    return result;
+}
+
+}
@@ -0,0 +1,75 @@
+#include "sip_gateway/audio/wav.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace sip_gateway::audio {
+
+int16_t float_to_pcm16(float sample) {
+    const float clamped = std::max(-1.0f, std::min(1.0f, sample));
+    return static_cast<int16_t>(clamped * std::numeric_limits<int16_t>::max());
+}
+
+std::string wav_header(uint32_t sample_rate, uint16_t channels, uint32_t data_size) {
+    const uint16_t bits_per_sample = 16;
+    const uint16_t block_align = channels * (bits_per_sample / 8);
+    const uint32_t byte_rate = sample_rate * block_align;
+    const uint32_t chunk_size = 36 + data_size;
+
+    std::string result;
+    result.reserve(44);
+    auto append = [&result](const void* data, size_t size) {
+        result.append(static_cast<const char*>(data), size);
+    };
+    auto append_u16 = [&append](uint16_t value) {
+        const uint8_t bytes[2] = {
+            static_cast<uint8_t>(value & 0xFF),
+            static_cast<uint8_t>((value >> 8) & 0xFF)
+        };
+        append(bytes, sizeof(bytes));
+    };
+    auto append_u32 = [&append](uint32_t value) {
+        const uint8_t bytes[4] = {
+            static_cast<uint8_t>(value & 0xFF),
+            static_cast<uint8_t>((value >> 8) & 0xFF),
+            static_cast<uint8_t>((value >> 16) & 0xFF),
+            static_cast<uint8_t>((value >> 24) & 0xFF)
+        };
+        append(bytes, sizeof(bytes));
+    };
+
+    append("RIFF", 4);
+    append_u32(chunk_size);
+    append("WAVE", 4);
+    append("fmt ", 4);
+    append_u32(16);
+    append_u16(1);
+    append_u16(channels);
+    append_u32(sample_rate);
+    append_u32(byte_rate);
+    append_u16(block_align);
+    append_u16(bits_per_sample);
+    append("data", 4);
+    append_u32(data_size);
+    return result;
+}
+
+std::string encode_wav(const std::vector<float>& audio, uint32_t sample_rate) {
+    std::string result;
+    encode_wav(audio, sample_rate, result);
+    return result;
+}
+
+void encode_wav(const std::vector<float>& audio, uint32_t sample_rate, std::string& out) {
+    const uint32_t data_size = static_cast<uint32_t>(audio.size() * sizeof(int16_t));
+    out.clear();
+    out.reserve(44 + data_size);
+    out += wav_header(sample_rate, 1, data_size);
+    for (float sample : audio) {
+        const auto pcm = static_cast<uint16_t>(float_to_pcm16(sample));
+        out.push_back(static_cast<char>(pcm & 0xFF));
+        out.push_back(static_cast<char>((pcm >> 8) & 0xFF));
+    }
+}
+
+}
@@ -1,7 +1,10 @@
 #include "sip_gateway/backend/client.hpp"
 
 #include <algorithm>
+#include <chrono>
+#include <condition_variable>
 #include <httplib.h>
+#include <memory>
 #include <utility>
 
 #include "sip_gateway/metrics.hpp"
@@ -16,6 +19,21 @@ std::string to_lower(std::string value) {
     return value;
 }
 
+// Shared by the caller, which runs the first attempt, and the watcher task,
+// which may run the hedge and aborts the first attempt at the deadline.
+// Each client pointer is set only while its attempt is in flight.
+struct HedgedCall {
+    std::mutex mutex;
+    std::condition_variable cv;
+    httplib::Client* primary = nullptr;
+    httplib::Client* hedge = nullptr;
+    bool primary_done = false;
+    bool hedge_running = false;
+    bool hedge_launched = false;
+    bool finished = false; // The caller is returning; the watcher must stop.
+    httplib::Result hedge_result;
+};
+
 void parse_url(const std::string& url, std::string& scheme, std::string& host,
                int& port, std::string& base_path) {
     std::string working = url;
@@ -50,27 +68,222 @@ BackendClient::BackendClient(const std::string& base_url,
                              std::optional<std::string> authorization_token,
                              const BackendRequestOptions& options)
     : authorization_token_(std::move(authorization_token)),
-      options_(options) {
+      options_(options),
+      pool_([this]() { return make_client(); }, options.pool),
+      hedge_tokens_(options.hedge.budget_burst) {
     parse_url(base_url, scheme_, host_, port_, base_path_);
 }
 
-httplib::Client* BackendClient::get_client() {
-    thread_local std::unique_ptr<httplib::Client> client;
-    if (!client) {
-        client = std::make_unique<httplib::Client>(host_, port_);
-        apply_timeouts(*client);
+std::unique_ptr<httplib::Client> BackendClient::make_client() const {
+    auto client = std::make_unique<httplib::Client>(
+        scheme_ + "://" + host_ + ":" + std::to_string(port_));
+    if (scheme_ == "https") {
+        client->enable_server_certificate_verification(false);
     }
-    return client.get();
+    client->set_keep_alive(true);
+    apply_timeouts(*client);
+    return client;
 }
 
-httplib::SSLClient* BackendClient::get_ssl_client() {
-    thread_local std::unique_ptr<httplib::SSLClient> client;
-    if (!client) {
-        client = std::make_unique<httplib::SSLClient>(host_, port_);
-        client->enable_server_certificate_verification(false);
-        apply_timeouts(*client);
+httplib::Result BackendClient::send(BackendConnectionPool::Lease& lease,
+                                    const Request& request) {
+    // A client without an open socket connects (and handshakes) inside this
+    // request, so the two histograms differ by the connection setup cost.
+    const bool reused = lease->is_socket_open();
+    const auto started = std::chrono::steady_clock::now();
+    auto response = request(*lease);
+    const auto elapsed = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - started).count();
+    Metrics::instance().observe_response_time(
+        reused ? "backend_request_reused_conn" : "backend_request_new_conn", elapsed);
+    Metrics::instance().increment_counter(
+        "backend_pool_connections_total", {{"result", reused ? "reused" : "new"}});
+    return response;
+}
+
+httplib::Result BackendClient::execute(const Request& request) {
+    auto lease = pool_.acquire();
+    auto response = send(lease, request);
+    if (!response) {
+        lease.discard();
+    }
+    return response;
+}
+
+std::optional<std::chrono::steady_clock::duration> BackendClient::hedge_delay(
+    const std::string& method) {
+    if (!options_.hedge.enabled || method.empty()) {
+        return std::nullopt;
+    }
+    const auto quantile = Metrics::instance().response_time_quantile(
+        method, options_.hedge.quantile, options_.hedge.min_samples);
+    if (!quantile) {
+        return std::nullopt;
+    }
+    {
+        std::lock_guard<std::mutex> lock(hedge_mutex_);
+        hedge_tokens_ = std::min(options_.hedge.budget_burst,
+                                 hedge_tokens_ + options_.hedge.budget_ratio);
+    }
+    const auto delay = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(*quantile));
+    return std::max<std::chrono::steady_clock::duration>(delay, options_.hedge.min_delay);
+}
+
+void BackendClient::apply_timeouts(httplib::Client& client,
+                                   std::chrono::steady_clock::time_point deadline) const {
+    const auto remaining = std::max<std::chrono::steady_clock::duration>(
+        deadline - std::chrono::steady_clock::now(), std::chrono::milliseconds(1));
+    const auto limit = [&](std::chrono::seconds configured) {
+        const auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::min<std::chrono::steady_clock::duration>(configured, remaining)).count();
+        return std::make_pair(static_cast<time_t>(us / 1000000), static_cast<time_t>(us % 1000000));
+    };
+    const auto connect = limit(options_.connect_timeout);
+    const auto read = limit(options_.sock_read_timeout);
+    const auto write = limit(options_.request_timeout);
+    client.set_connection_timeout(connect.first, connect.second);
+    client.set_read_timeout(read.first, read.second);
+    client.set_write_timeout(write.first, write.second);
+}
+
+bool BackendClient::take_hedge_token() {
+    std::lock_guard<std::mutex> lock(hedge_mutex_);
+    if (hedge_tokens_ < 1.0) {
+        return false;
+    }
+    hedge_tokens_ -= 1.0;
+    return true;
+}
+
+httplib::Result BackendClient::execute(const Request& request,
+                                       const BackendCallPolicy& policy) {
+    std::optional<std::chrono::steady_clock::duration> delay;
+    if (options_.executor) {
+        delay = hedge_delay(policy.latency_method);
+    }
+    if (!delay && !policy.deadline) {
+        return execute(request);
+    }
+    const std::string method = policy.latency_method.empty() ? "default" : policy.latency_method;
+    const auto deadline_exceeded = [&]() {
+        Metrics::instance().increment_counter(
+            "backend_deadline_exceeded_total", {{"method", method}});
+        return BackendDeadlineError("Backend deadline exceeded");
+    };
+    if (policy.deadline && std::chrono::steady_clock::now() >= *policy.deadline) {
+        throw deadline_exceeded();
+    }
+
+    auto lease = pool_.acquire();
+    if (policy.deadline) {
+        apply_timeouts(*lease, *policy.deadline);
+    }
+    auto call = std::make_shared<HedgedCall>();
+    call->primary = &*lease;
+    if (options_.executor) {
+        const auto hedge_at = std::chrono::steady_clock::now() +
+                              delay.value_or(std::chrono::steady_clock::duration::zero());
+        // The watcher may start after this call has returned; it then sees
+        // finished and touches nothing else.
+        options_.executor([this, call, &request, method, hedge_at,
+                           hedge_pending = delay.has_value(),
+                           deadline = policy.deadline]() mutable {
+            std::unique_lock<std::mutex> lock(call->mutex);
+            while (!call->finished && !call->primary_done) {
+                const auto now = std::chrono::steady_clock::now();
+                if (deadline && now >= *deadline) {
+                    // stop() makes the blocked request return with an error
+                    // on the calling thread.
+                    call->primary->stop();
+                    return;
+                }
+                if (hedge_pending && now >= hedge_at) {
+                    hedge_pending = false;
+                    if (!take_hedge_token()) {
+                        Metrics::instance().increment_counter(
+                            "backend_hedges_skipped_total",
+                            {{"method", method}, {"reason", "budget"}});
+                        continue;
+                    }
+                    auto hedge = pool_.acquire();
+                    if (deadline) {
+                        apply_timeouts(*hedge, *deadline);
+                    }
+                    call->hedge = &*hedge;
+                    call->hedge_running = true;
+                    call->hedge_launched = true;
+                    lock.unlock();
+                    auto result = send(hedge, request);
+                    lock.lock();
+                    if (result && !call->primary_done) {
+                        // The first response wins.
+                        call->primary->stop();
+                    }
+                    if (result) {
+                        apply_timeouts(*hedge);
+                    } else {
+                        hedge.discard();
+                    }
+                    call->hedge_result = std::move(result);
+                    call->hedge = nullptr;
+                    call->hedge_running = false;
+                    call->cv.notify_all();
+                    continue;
+                }
+                if (hedge_pending && (!deadline || hedge_at < *deadline)) {
+                    call->cv.wait_until(lock, hedge_at);
+                } else if (deadline) {
+                    call->cv.wait_until(lock, *deadline);
+                } else {
+                    return;
+                }
+            }
+        });
     }
-    return client.get();
+
+    auto result = send(lease, request);
+    std::unique_lock<std::mutex> lock(call->mutex);
+    // The watcher may stop() the primary until it sees this, so the lease is
+    // only reset or freed afterwards.
+    call->primary = nullptr;
+    call->primary_done = true;
+    call->cv.notify_all();
+    lock.unlock();
+    if (result) {
+        apply_timeouts(*lease);
+    } else {
+        lease.discard();
+    }
+    lock.lock();
+    // Only a hedge that is already running is waited for, never a queued
+    // task, so this cannot starve the pool it runs on.
+    const auto hedge_idle = [&]() { return !call->hedge_running; };
+    if (!result && policy.deadline) {
+        call->cv.wait_until(lock, *policy.deadline, hedge_idle);
+    } else if (!result) {
+        call->cv.wait(lock, hedge_idle);
+    }
+    if (call->hedge_running) {
+        // The hedge uses the caller's request, so it must end before this
+        // returns.
+        call->hedge->stop();
+        call->cv.wait(lock, hedge_idle);
+    }
+    call->finished = true;
+    const bool hedge_won = !result && call->hedge_result;
+    if (call->hedge_launched) {
+        Metrics::instance().increment_counter(
+            "backend_hedges_total", {{"method", method}, {"result", hedge_won ? "won" : "lost"}});
+    }
+    if (hedge_won) {
+        result = std::move(call->hedge_result);
+    }
+    lock.unlock();
+    if (!result && policy.deadline && std::chrono::steady_clock::now() >= *policy.deadline) {
+        throw deadline_exceeded();
+    }
+    return result;
 }
 
 nlohmann::json BackendClient::get_json(const std::string& path) {
@@ -79,9 +292,9 @@ nlohmann::json BackendClient::get_json(const std::string& path) {
     if (authorization_token_) {
         headers.emplace("Authorization", "Bearer " + *authorization_token_);
     }
-    auto response = scheme_ == "https"
-                        ? get_ssl_client()->Get(build_path(path), headers)
-                        : get_client()->Get(build_path(path), headers);
+    auto response = execute([&](httplib::Client& client) {
+        return client.Get(build_path(path), headers);
+    });
     if (!response) {
         throw BackendError("Backend request failed");
     }
@@ -94,18 +307,18 @@ nlohmann::json BackendClient::get_json(const std::string& path) {
     return nlohmann::json::parse(response->body);
 }
 
-nlohmann::json BackendClient::post_json(const std::string& path, const nlohmann::json& body) {
+nlohmann::json BackendClient::post_json(const std::string& path,
+                                        const nlohmann::json& body,
+                                        const BackendCallPolicy& policy) {
     Metrics::instance().increment_request();
     auto headers = httplib::Headers{{"Content-Type", "application/json"},
                                     {"Accept", "application/json"}};
     if (authorization_token_) {
         headers.emplace("Authorization", "Bearer " + *authorization_token_);
     }
-    auto response = scheme_ == "https"
-                        ? get_ssl_client()->Post(build_path(path), headers, body.dump(),
-                                              "application/json")
-                        : get_client()->Post(build_path(path), headers, body.dump(),
-                                             "application/json");
+    auto response = execute([&](httplib::Client& client) {
+        return client.Post(build_path(path), headers, body.dump(), "application/json");
+    }, policy);
     if (!response) {
         throw BackendError("Backend request failed");
     }
@@ -128,9 +341,9 @@ nlohmann::json BackendClient::post_multipart_json(const std::string& path,
     }
     httplib::MultipartFormDataItems items;
     items.push_back({field_name, body.dump(), "", "application/json"});
-    auto response = scheme_ == "https"
-                        ? get_ssl_client()->Post(build_path(path), headers, items)
-                        : get_client()->Post(build_path(path), headers, items);
+    auto response = execute([&](httplib::Client& client) {
+        return client.Post(build_path(path), headers, items);
+    });
     if (!response) {
         throw BackendError("Backend request failed");
     }
@@ -150,11 +363,9 @@ nlohmann::json BackendClient::put_json(const std::string& path, const nlohmann::
     if (authorization_token_) {
         headers.emplace("Authorization", "Bearer " + *authorization_token_);
     }
-    auto response = scheme_ == "https"
-                        ? get_ssl_client()->Put(build_path(path), headers, body.dump(),
-                                             "application/json")
-                        : get_client()->Put(build_path(path), headers, body.dump(),
-                                            "application/json");
+    auto response = execute([&](httplib::Client& client) {
+        return client.Put(build_path(path), headers, body.dump(), "application/json");
+    });
     if (!response) {
         throw BackendError("Backend request failed");
     }
@@ -173,9 +384,9 @@ nlohmann::json BackendClient::delete_json(const std::string& path) {
     if (authorization_token_) {
         headers.emplace("Authorization", "Bearer " + *authorization_token_);
     }
-    auto response = scheme_ == "https"
-                        ? get_ssl_client()->Delete(build_path(path), headers)
-                        : get_client()->Delete(build_path(path), headers);
+    auto response = execute([&](httplib::Client& client) {
+        return client.Delete(build_path(path), headers);
+    });
     if (!response) {
         throw BackendError("Backend request failed");
     }
@@ -190,18 +401,17 @@ nlohmann::json BackendClient::delete_json(const std::string& path) {
 
 nlohmann::json BackendClient::post_binary(const std::string& path,
                                           const std::string& content_type,
-                                          const std::string& payload) {
+                                          const std::string& payload,
+                                          const BackendCallPolicy& policy) {
     Metrics::instance().increment_request();
     auto headers = httplib::Headers{{"Content-Type", content_type},
                                     {"Accept", "application/json"}};
     if (authorization_token_) {
         headers.emplace("Authorization", "Bearer " + *authorization_token_);
     }
-    auto response = scheme_ == "https"
-                        ? get_ssl_client()->Post(build_path(path), headers, payload,
-                                              content_type)
-                        : get_client()->Post(build_path(path), headers, payload,
-                                             content_type);
+    auto response = execute([&](httplib::Client& client) {
+        return client.Post(build_path(path), headers, payload, content_type);
+    }, policy);
     if (!response) {
         throw BackendError("Backend request failed");
     }
@@ -214,16 +424,18 @@ nlohmann::json BackendClient::post_binary(const std::string& path,
     return nlohmann::json::parse(response->body);
 }
 
-std::string BackendClient::get_binary(const std::string& path, const std::string& query) {
+std::string BackendClient::get_binary(const std::string& path,
+                                      const std::string& query,
+                                      const BackendCallPolicy& policy) {
     Metrics::instance().increment_request();
     auto headers = httplib::Headers{{"Accept", "*/*"}};
     if (authorization_token_) {
         headers.emplace("Authorization", "Bearer " + *authorization_token_);
     }
     const auto full_path = build_path(path) + "?" + query;
-    auto response = scheme_ == "https"
-                        ? get_ssl_client()->Get(full_path, headers)
-                        : get_client()->Get(full_path, headers);
+    auto response = execute([&](httplib::Client& client) {
+        return client.Get(full_path, headers);
+    }, policy);
     if (!response) {
         throw BackendError("Backend request failed");
     }
@@ -236,6 +448,37 @@ std::string BackendClient::get_binary(const std::string& path, const std::string
     return response->body;
 }
 
+void BackendClient::get_binary_stream(
+    const std::string& path,
+    const std::string& query,
+    const std::function<bool(const char*, size_t)>& receiver) {
+    Metrics::instance().increment_request();
+    auto headers = httplib::Headers{{"Accept", "*/*"}};
+    if (authorization_token_) {
+        headers.emplace("Authorization", "Bearer " + *authorization_token_);
+    }
+    const auto full_path = build_path(path) + "?" + query;
+    int status = 0;
+    auto response = execute([&](httplib::Client& client) {
+        return client.Get(
+            full_path, headers,
+            [&status](const httplib::Response& res) {
+                status = res.status;
+                return status >= 200 && status < 300;
+            },
+            [&receiver](const char* data, size_t size) { return receiver(data, size); });
+    });
+    if (status == 403) {
+        throw BackendPermissionError("Backend request forbidden");
+    }
+    if (status != 0 && (status < 200 || status >= 300)) {
+        throw BackendError("Backend returned status " + std::to_string(status));
+    }
+    if (!response && response.error() != httplib::Error::Canceled) {
+        throw BackendError("Backend request failed");
+    }
+}
+
 std::string BackendClient::build_path(const std::string& path) const {
     if (base_path_.empty()) {
         return path;
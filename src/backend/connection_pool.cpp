@@ -0,0 +1,86 @@
+#include "sip_gateway/backend/connection_pool.hpp"
+
+#include "sip_gateway/metrics.hpp"
+
+namespace sip_gateway {
+
+BackendConnectionPool::Lease::Lease(BackendConnectionPool& pool,
+                                    std::unique_ptr<httplib::Client> client)
+    : pool_(&pool), client_(std::move(client)) {}
+
+BackendConnectionPool::Lease::Lease(Lease&& other) noexcept
+    : pool_(other.pool_), client_(std::move(other.client_)) {
+    other.pool_ = nullptr;
+}
+
+BackendConnectionPool::Lease::~Lease() {
+    if (pool_) {
+        const bool reusable = client_ != nullptr;
+        pool_->release(std::move(client_), reusable);
+    }
+}
+
+void BackendConnectionPool::Lease::discard() {
+    client_.reset();
+}
+
+BackendConnectionPool::BackendConnectionPool(Factory factory, ConnectionPoolOptions options)
+    : factory_(std::move(factory)), options_(options) {}
+
+BackendConnectionPool::Lease BackendConnectionPool::acquire() {
+    std::unique_ptr<httplib::Client> client;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        evict_idle_locked(std::chrono::steady_clock::now());
+        if (!idle_.empty()) {
+            client = std::move(idle_.back().client);
+            idle_.pop_back();
+        }
+        ++leased_;
+        publish_locked();
+    }
+    if (!client) {
+        client = factory_();
+    }
+    return Lease(*this, std::move(client));
+}
+
+size_t BackendConnectionPool::idle_count() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return idle_.size();
+}
+
+void BackendConnectionPool::release(std::unique_ptr<httplib::Client> client, bool reusable) {
+    std::unique_ptr<httplib::Client> dropped; // Closed after the lock is released.
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (leased_ > 0) {
+        --leased_;
+    }
+    // A client whose peer already closed the socket is not worth keeping.
+    if (reusable && client && client->is_socket_open() && options_.max_idle > 0) {
+        if (idle_.size() >= options_.max_idle) {
+            // The oldest is the likeliest to have been closed by the peer.
+            dropped = std::move(idle_.front().client);
+            idle_.pop_front();
+        }
+        idle_.push_back({std::move(client), std::chrono::steady_clock::now()});
+    } else {
+        dropped = std::move(client);
+    }
+    publish_locked();
+}
+
+void BackendConnectionPool::evict_idle_locked(std::chrono::steady_clock::time_point now) {
+    // Front entries are the oldest, since releases push to the back.
+    while (!idle_.empty() && now - idle_.front().idle_since > options_.idle_timeout) {
+        idle_.pop_front();
+        Metrics::instance().increment_counter("backend_pool_evicted_total");
+    }
+}
+
+void BackendConnectionPool::publish_locked() const {
+    Metrics::instance().set_gauge("backend_pool_idle", static_cast<double>(idle_.size()));
+    Metrics::instance().set_gauge("backend_pool_leased", static_cast<double>(leased_));
+}
+
+}
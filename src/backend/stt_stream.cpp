@@ -0,0 +1,139 @@
+#include "sip_gateway/backend/stt_stream.hpp"
+
+#include <algorithm>
+
+#include "sip_gateway/utils/text.hpp"
+
+namespace sip_gateway {
+
+SttStream::SttStream(SendFn send, unsigned sample_rate, size_t chunk_samples,
+                     size_t history_samples)
+    : send_(std::move(send)),
+      sample_rate_(sample_rate),
+      chunk_samples_(std::max<size_t>(1, chunk_samples)),
+      history_samples_(history_samples) {
+    pending_.reserve(chunk_samples_);
+}
+
+void SttStream::push(const int16_t* samples, size_t count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!active_) {
+        history_.insert(history_.end(), samples, samples + count);
+        if (history_.size() > history_samples_) {
+            history_.erase(history_.begin(),
+                           history_.begin() + (history_.size() - history_samples_));
+        }
+        return;
+    }
+    pending_.insert(pending_.end(), samples, samples + count);
+    if (pending_.size() >= chunk_samples_) {
+        flush_locked();
+    }
+}
+
+void SttStream::begin() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (active_) {
+        return;
+    }
+    active_ = true;
+    cancelled_ = false;
+    seq_ = 0;
+    send_({{"type", "stt_start"},
+           {"sample_rate", sample_rate_},
+           {"encoding", "pcm_s16le"}});
+    pending_.assign(history_.begin(), history_.end());
+    history_.clear();
+    flush_locked();
+}
+
+uint64_t SttStream::request_transcript(bool final) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto request_id = next_request_++;
+    if (!active_) {
+        return request_id;
+    }
+    flush_locked();
+    send_({{"type", "stt_finalize"},
+           {"request_id", request_id},
+           {"final", final}});
+    if (final) {
+        active_ = false;
+    }
+    return request_id;
+}
+
+std::optional<std::string> SttStream::wait_transcript(uint64_t request_id,
+                                                      std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    const bool arrived = transcript_cv_.wait_for(lock, timeout, [this, request_id]() {
+        return cancelled_ || transcripts_.count(request_id) != 0;
+    });
+    const auto it = transcripts_.find(request_id);
+    if (!arrived || it == transcripts_.end()) {
+        return std::nullopt;
+    }
+    auto text = std::move(it->second);
+    transcripts_.erase(it);
+    return text;
+}
+
+bool SttStream::handle_message(const nlohmann::json& message) {
+    if (message.value("type", "") != "transcript" || !message.contains("request_id") ||
+        !message["request_id"].is_number_unsigned()) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const auto request_id = message["request_id"].get<uint64_t>();
+        if (request_id >= next_request_) {
+            return true;
+        }
+        transcripts_[request_id] = message.value("text", "");
+        // Transcripts nobody waited for (timed out) are dropped eventually.
+        while (transcripts_.size() > 16) {
+            transcripts_.erase(transcripts_.begin());
+        }
+    }
+    transcript_cv_.notify_all();
+    return true;
+}
+
+void SttStream::cancel() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        active_ = false;
+        cancelled_ = true;
+        pending_.clear();
+        history_.clear();
+    }
+    transcript_cv_.notify_all();
+}
+
+void SttStream::set_sample_rate(unsigned sample_rate) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (sample_rate == 0 || sample_rate == sample_rate_) {
+        return;
+    }
+    const auto scale = [this, sample_rate](size_t samples) {
+        return static_cast<size_t>(static_cast<uint64_t>(samples) * sample_rate / sample_rate_);
+    };
+    chunk_samples_ = std::max<size_t>(1, scale(chunk_samples_));
+    history_samples_ = scale(history_samples_);
+    sample_rate_ = sample_rate;
+    history_.clear();
+    pending_.clear();
+    pending_.reserve(chunk_samples_);
+}
+
+void SttStream::flush_locked() {
+    if (pending_.empty()) {
+        return;
+    }
+    send_({{"type", "stt_audio"},
+           {"seq", seq_++},
+           {"audio", utils::base64_encode(pending_.data(), pending_.size() * sizeof(int16_t))}});
+    pending_.clear();
+}
+
+}
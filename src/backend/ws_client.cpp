@@ -1,10 +1,18 @@
 #include "sip_gateway/backend/ws_client.hpp"
 
+#include "sip_gateway/logging.hpp"
+#include "sip_gateway/metrics.hpp"
 #include "sip_gateway/utils/async.hpp"
 
+#include <algorithm>
 #include <chrono>
 #include <memory>
+#include <mutex>
+#include <random>
 #include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <websocketpp/client.hpp>
 #include <websocketpp/config/asio_client.hpp>
@@ -15,6 +23,9 @@ namespace {
 
 using WsClient = websocketpp::client<websocketpp::config::asio_client>;
 
+constexpr std::chrono::milliseconds kInitialBackoff{500};
+constexpr std::chrono::milliseconds kMaxBackoff{30000};
+
 std::string replace_scheme(const std::string& base_url) {
     if (base_url.rfind("https://", 0) == 0) {
         return "wss://" + base_url.substr(8);
@@ -24,128 +35,576 @@ std::string replace_scheme(const std::string& base_url) {
     }
     return "ws://" + base_url;
 }
-}
 
-struct BackendWsClient::WsState {
-    std::shared_ptr<WsClient> client;
-    websocketpp::connection_hdl connection;
+class WsTransport {
+public:
+    explicit WsTransport(size_t threads) {
+        client_.clear_access_channels(websocketpp::log::alevel::all);
+        client_.clear_error_channels(websocketpp::log::elevel::all);
+        client_.init_asio();
+        client_.start_perpetual();
+        threads = std::max<size_t>(1, threads);
+        for (size_t i = 0; i < threads; ++i) {
+            threads_.emplace_back([this]() {
+                utils::ensure_pj_thread_registered("sipgw_ws");
+                client_.run();
+            });
+        }
+    }
+
+    ~WsTransport() {
+        shutdown();
+    }
+
+    WsClient& client() {
+        return client_;
+    }
+
+    void shutdown() {
+        if (threads_.empty()) {
+            return;
+        }
+        client_.stop_perpetual();
+        client_.stop();
+        for (auto& thread : threads_) {
+            if (thread.joinable()) {
+                thread.join();
+            }
+        }
+        threads_.clear();
+    }
+
+private:
+    WsClient client_;
+    std::vector<std::thread> threads_;
 };
 
+std::mutex transport_mutex;
+std::unique_ptr<WsTransport> transport_instance;
 
-BackendWsClient::BackendWsClient(std::string base_url)
-    : base_url_(std::move(base_url)) {}
+WsTransport& ws_transport() {
+    std::lock_guard<std::mutex> lock(transport_mutex);
+    if (!transport_instance) {
+        transport_instance = std::make_unique<WsTransport>(2);
+    }
+    return *transport_instance;
+}
 
-BackendWsClient::~BackendWsClient() {
-    stop();
+std::chrono::milliseconds with_jitter(std::chrono::milliseconds delay) {
+    // +/-20% so sessions dropped together do not reconnect together.
+    thread_local std::mt19937 rng{std::random_device{}()};
+    std::uniform_real_distribution<double> spread(0.8, 1.2);
+    return std::chrono::milliseconds(
+        static_cast<long>(static_cast<double>(delay.count()) * spread(rng)));
 }
 
-void BackendWsClient::connect(const std::string& session_id,
-                              MessageHandler on_message,
-                              EventHandler on_timeout,
-                              EventHandler on_close) {
-    if (running_) {
-        return;
-    }
-    session_id_ = session_id;
-    on_message_ = std::move(on_message);
-    on_timeout_ = std::move(on_timeout);
-    on_close_ = std::move(on_close);
-    running_ = true;
-    worker_ = std::thread([this]() { run_loop(); });
+WsClient::timer_ptr schedule_retry(std::chrono::milliseconds& backoff,
+                                   std::function<void()> retry) {
+    const auto delay = with_jitter(backoff);
+    backoff = std::min(backoff * 2, kMaxBackoff);
+    Metrics::instance().increment_counter("ws_reconnects_total");
+    return ws_transport().client().set_timer(
+        static_cast<long>(delay.count()),
+        [retry = std::move(retry)](const websocketpp::lib::error_code& ec) {
+            if (!ec) {
+                retry();
+            }
+        });
 }
 
-void BackendWsClient::send_json(const nlohmann::json& payload) {
-    std::lock_guard<std::mutex> lock(ws_mutex_);
-    if (!ws_state_ || !ws_state_->client || ws_state_->connection.expired()) {
-        return;
-    }
-    websocketpp::lib::error_code ec;
-    ws_state_->client->send(ws_state_->connection, payload.dump(),
-                            websocketpp::frame::opcode::text, ec);
 }
 
-void BackendWsClient::stop() {
-    if (!running_) {
+void init_ws_transport(size_t threads) {
+    std::lock_guard<std::mutex> lock(transport_mutex);
+    if (transport_instance) {
+        logging::warn("WebSocket transport already initialized");
         return;
     }
-    running_ = false;
-    {
-        std::lock_guard<std::mutex> lock(ws_mutex_);
-        if (ws_state_ && ws_state_->client && !ws_state_->connection.expired()) {
-            websocketpp::lib::error_code ec;
-            ws_state_->client->close(ws_state_->connection,
-                                     websocketpp::close::status::going_away,
-                                     "shutdown", ec);
+    transport_instance = std::make_unique<WsTransport>(threads);
+    logging::info("WebSocket transport started", {kv("threads", threads)});
+}
+
+
+struct BackendWsClient::WsState : std::enable_shared_from_this<WsState> {
+    std::string url;
+    std::string session_id;
+    MessageHandler on_message;
+    EventHandler on_timeout;
+    EventHandler on_close;
+    bool multiplexed = false;
+
+    std::mutex mutex;
+    bool running = false;
+    websocketpp::connection_hdl connection;
+    WsClient::timer_ptr reconnect_timer;
+    std::chrono::milliseconds backoff = kInitialBackoff;
+    size_t reconnects = 0;
+
+    // Copies the handler out while running and calls it with no lock held,
+    // so a slow handler never holds up stop() and may call stop() itself.
+    template <typename Handler, typename... Args>
+    void dispatch(const Handler& handler, Args&&... args) {
+        Handler copy;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!running || !handler) {
+                return;
+            }
+            copy = handler;
         }
+        copy(std::forward<Args>(args)...);
     }
-    if (worker_.joinable()) {
-        worker_.join();
+
+    void deliver(const nlohmann::json& payload) {
+        const auto type = payload.value("type", "");
+        if (type == "timeout") {
+            dispatch(on_timeout);
+        } else if (type == "close") {
+            dispatch(on_close);
+        } else {
+            dispatch(on_message, payload);
+        }
     }
-}
 
-void BackendWsClient::run_loop() {
-    utils::ensure_pj_thread_registered("sipgw_ws");
-    while (running_) {
-        auto client = std::make_shared<WsClient>();
-        client->clear_access_channels(websocketpp::log::alevel::all);
-        client->clear_error_channels(websocketpp::log::elevel::all);
-        client->init_asio();
+    void notify_closed() {
+        dispatch(on_close);
+    }
 
-        client->set_message_handler([this](websocketpp::connection_hdl,
-                                           WsClient::message_ptr msg) {
-            utils::ensure_pj_thread_registered("sipgw_ws");
+    void open() {
+        auto& client = ws_transport().client();
+        websocketpp::lib::error_code ec;
+        auto conn = client.get_connection(url, ec);
+        if (ec) {
+            logging::warn(
+                "WebSocket connection setup failed",
+                {kv("session_id", session_id),
+                 kv("error", ec.message())});
+            schedule_reconnect();
+            return;
+        }
+        std::weak_ptr<WsState> weak = shared_from_this();
+        conn->set_open_handler([weak](websocketpp::connection_hdl) {
+            if (auto self = weak.lock()) {
+                std::lock_guard<std::mutex> lock(self->mutex);
+                self->backoff = kInitialBackoff;
+            }
+        });
+        conn->set_message_handler([weak](websocketpp::connection_hdl,
+                                         WsClient::message_ptr msg) {
+            auto self = weak.lock();
+            if (!self) {
+                return;
+            }
             try {
-                auto payload = nlohmann::json::parse(msg->get_payload());
-                const auto type = payload.value("type", "");
-                if (type == "timeout") {
-                    if (on_timeout_) {
-                        on_timeout_();
-                    }
-                } else if (type == "close") {
-                    if (on_close_) {
-                        on_close_();
-                    }
-                } else if (on_message_) {
-                    on_message_(payload);
-                }
+                self->deliver(nlohmann::json::parse(msg->get_payload()));
             } catch (...) {
             }
         });
-        client->set_close_handler([this](websocketpp::connection_hdl) {
-            utils::ensure_pj_thread_registered("sipgw_ws");
-            if (on_close_) {
-                on_close_();
+        auto on_disconnect = [weak](websocketpp::connection_hdl) {
+            if (auto self = weak.lock()) {
+                self->notify_closed();
+                self->schedule_reconnect();
             }
-        });
-        client->set_fail_handler([this](websocketpp::connection_hdl) {
-            utils::ensure_pj_thread_registered("sipgw_ws");
-            if (on_close_) {
-                on_close_();
+        };
+        conn->set_close_handler(on_disconnect);
+        conn->set_fail_handler(on_disconnect);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!running) {
+                return;
+            }
+            connection = conn->get_handle();
+        }
+        client.connect(conn);
+    }
+
+    void schedule_reconnect() {
+        std::weak_ptr<WsState> weak = shared_from_this();
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running) {
+            return;
+        }
+        connection.reset();
+        ++reconnects;
+        reconnect_timer = schedule_retry(backoff, [weak]() {
+            if (auto self = weak.lock()) {
+                self->open();
             }
         });
+    }
+};
+
+namespace {
+
+// One long-lived backend connection carrying many sessions. Frames in both
+// directions are tagged with session_id (see docs/backend_api.md).
+class MuxConnection : public std::enable_shared_from_this<MuxConnection> {
+public:
+    using Session = BackendWsClient::WsState;
 
+    MuxConnection(std::string url, size_t index)
+        : url_(std::move(url)), index_(index) {}
+
+    void start() {
+        auto& client = ws_transport().client();
         websocketpp::lib::error_code ec;
-        auto conn = client->get_connection(make_ws_url(session_id_), ec);
+        auto conn = client.get_connection(url_, ec);
         if (ec) {
-            std::this_thread::sleep_for(std::chrono::seconds(5));
-            continue;
+            logging::warn(
+                "Multiplexed WebSocket setup failed",
+                {kv("connection", index_),
+                 kv("error", ec.message())});
+            schedule_reconnect();
+            return;
+        }
+        std::weak_ptr<MuxConnection> weak = shared_from_this();
+        conn->set_open_handler([weak](websocketpp::connection_hdl) {
+            if (auto self = weak.lock()) {
+                self->handle_open();
+            }
+        });
+        conn->set_message_handler([weak](websocketpp::connection_hdl,
+                                         WsClient::message_ptr msg) {
+            if (auto self = weak.lock()) {
+                self->route(msg->get_payload());
+            }
+        });
+        auto on_disconnect = [weak](websocketpp::connection_hdl) {
+            if (auto self = weak.lock()) {
+                self->handle_disconnect();
+            }
+        };
+        conn->set_close_handler(on_disconnect);
+        conn->set_fail_handler(on_disconnect);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!running_) {
+                return;
+            }
+            connection_ = conn->get_handle();
+        }
+        client.connect(conn);
+    }
+
+    void stop() {
+        websocketpp::connection_hdl connection;
+        WsClient::timer_ptr timer;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_ = false;
+            open_ = false;
+            connection = connection_;
+            timer = std::move(reconnect_timer_);
+        }
+        if (timer) {
+            timer->cancel();
+        }
+        if (!connection.expired()) {
+            websocketpp::lib::error_code ec;
+            ws_transport().client().close(connection,
+                                          websocketpp::close::status::going_away,
+                                          "shutdown", ec);
+        }
+    }
+
+    void subscribe(const std::shared_ptr<Session>& session) {
+        bool open = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            sessions_[session->session_id] = session;
+            open = open_;
+        }
+        if (open) {
+            send({{"type", "subscribe"}, {"session_id", session->session_id}});
+        }
+    }
+
+    void unsubscribe(const std::string& session_id) {
+        bool open = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            sessions_.erase(session_id);
+            open = open_;
+        }
+        if (open) {
+            send({{"type", "unsubscribe"}, {"session_id", session_id}});
+        }
+    }
+
+    void send(const nlohmann::json& frame) {
+        websocketpp::connection_hdl connection;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!open_) {
+                return;
+            }
+            connection = connection_;
         }
+        websocketpp::lib::error_code ec;
+        ws_transport().client().send(connection, frame.dump(),
+                                     websocketpp::frame::opcode::text, ec);
+    }
+
+private:
+    void handle_open() {
+        std::vector<std::string> session_ids;
         {
-            std::lock_guard<std::mutex> lock(ws_mutex_);
-            ws_state_ = std::make_unique<WsState>();
-            ws_state_->client = client;
-            ws_state_->connection = conn->get_handle();
+            std::lock_guard<std::mutex> lock(mutex_);
+            open_ = true;
+            backoff_ = kInitialBackoff;
+            session_ids.reserve(sessions_.size());
+            for (const auto& entry : sessions_) {
+                session_ids.push_back(entry.first);
+            }
         }
-        client->connect(conn);
-        client->run();
+        logging::info(
+            "Multiplexed WebSocket connected",
+            {kv("connection", index_),
+             kv("sessions", session_ids.size())});
+        for (const auto& session_id : session_ids) {
+            send({{"type", "subscribe"}, {"session_id", session_id}});
+        }
+    }
 
+    void handle_disconnect() {
+        std::vector<std::shared_ptr<Session>> sessions;
         {
-            std::lock_guard<std::mutex> lock(ws_mutex_);
-            ws_state_.reset();
+            std::lock_guard<std::mutex> lock(mutex_);
+            open_ = false;
+            for (const auto& entry : sessions_) {
+                if (auto session = entry.second.lock()) {
+                    sessions.push_back(std::move(session));
+                }
+            }
+        }
+        for (const auto& session : sessions) {
+            session->notify_closed();
+        }
+        schedule_reconnect();
+    }
+
+    void route(const std::string& text) {
+        nlohmann::json payload;
+        try {
+            payload = nlohmann::json::parse(text);
+        } catch (...) {
+            return;
+        }
+        const auto session_id = payload.value("session_id", "");
+        std::shared_ptr<Session> session;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = sessions_.find(session_id);
+            if (it != sessions_.end()) {
+                session = it->second.lock();
+            }
+        }
+        if (session) {
+            session->deliver(payload);
+        }
+    }
+
+    void schedule_reconnect() {
+        std::weak_ptr<MuxConnection> weak = shared_from_this();
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) {
+            return;
+        }
+        connection_.reset();
+        reconnect_timer_ = schedule_retry(backoff_, [weak]() {
+            if (auto self = weak.lock()) {
+                self->start();
+            }
+        });
+    }
+
+    std::string url_;
+    size_t index_;
+    std::mutex mutex_;
+    bool running_ = true;
+    bool open_ = false;
+    websocketpp::connection_hdl connection_;
+    WsClient::timer_ptr reconnect_timer_;
+    std::chrono::milliseconds backoff_ = kInitialBackoff;
+    std::unordered_map<std::string, std::weak_ptr<Session>> sessions_;
+};
+
+class WsMultiplexer {
+public:
+    WsMultiplexer(const std::string& url, size_t connections) {
+        connections = std::max<size_t>(1, connections);
+        for (size_t i = 0; i < connections; ++i) {
+            connections_.push_back(std::make_shared<MuxConnection>(url, i));
+        }
+        for (auto& connection : connections_) {
+            connection->start();
+        }
+    }
+
+    MuxConnection& connection_for(const std::string& session_id) {
+        return *connections_[std::hash<std::string>{}(session_id) % connections_.size()];
+    }
+
+    void stop() {
+        for (auto& connection : connections_) {
+            connection->stop();
+        }
+    }
+
+private:
+    std::vector<std::shared_ptr<MuxConnection>> connections_;
+};
+
+std::mutex mux_mutex;
+std::shared_ptr<WsMultiplexer> mux_instance;
+
+std::shared_ptr<WsMultiplexer> ws_multiplexer() {
+    std::lock_guard<std::mutex> lock(mux_mutex);
+    return mux_instance;
+}
+
+}
+
+void enable_ws_multiplex(const std::string& base_url, size_t connections) {
+    std::lock_guard<std::mutex> lock(mux_mutex);
+    if (mux_instance) {
+        return;
+    }
+    mux_instance = std::make_shared<WsMultiplexer>(
+        replace_scheme(base_url) + "/ws_mux", connections);
+    logging::info(
+        "Multiplexed backend WebSocket enabled",
+        {kv("connections", connections)});
+}
+
+void shutdown_ws_transport() {
+    std::shared_ptr<WsMultiplexer> mux;
+    {
+        std::lock_guard<std::mutex> lock(mux_mutex);
+        mux = std::move(mux_instance);
+    }
+    if (mux) {
+        mux->stop();
+    }
+    WsTransport* transport = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(transport_mutex);
+        transport = transport_instance.get();
+    }
+    // Joined outside the lock: transport threads may still call ws_transport().
+    if (transport) {
+        transport->shutdown();
+    }
+}
+
+BackendWsClient::BackendWsClient(std::string base_url)
+    : base_url_(std::move(base_url)) {}
+
+BackendWsClient::~BackendWsClient() {
+    stop();
+}
+
+void BackendWsClient::connect(const std::string& session_id,
+                              MessageHandler on_message,
+                              EventHandler on_timeout,
+                              EventHandler on_close) {
+    // Held until the session is open or subscribed, so a concurrent stop()
+    // tears down a started session.
+    std::lock_guard<std::mutex> lock(ws_mutex_);
+    if (ws_state_) {
+        return;
+    }
+    auto state = std::make_shared<WsState>();
+    state->url = make_ws_url(session_id);
+    state->session_id = session_id;
+    state->on_message = std::move(on_message);
+    state->on_timeout = std::move(on_timeout);
+    state->on_close = std::move(on_close);
+    state->running = true;
+    ws_state_ = state;
+    if (auto mux = ws_multiplexer()) {
+        state->multiplexed = true;
+        mux->connection_for(session_id).subscribe(state);
+        return;
+    }
+    state->open();
+}
+
+void BackendWsClient::send_json(const nlohmann::json& payload) {
+    std::shared_ptr<WsState> state;
+    {
+        std::lock_guard<std::mutex> lock(ws_mutex_);
+        state = ws_state_;
+    }
+    if (!state) {
+        return;
+    }
+    if (state->multiplexed) {
+        if (auto mux = ws_multiplexer()) {
+            auto frame = payload;
+            frame["session_id"] = state->session_id;
+            mux->connection_for(state->session_id).send(frame);
         }
-        if (running_) {
-            std::this_thread::sleep_for(std::chrono::seconds(5));
+        return;
+    }
+    websocketpp::connection_hdl connection;
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (!state->running || state->connection.expired()) {
+            return;
         }
+        connection = state->connection;
+    }
+    websocketpp::lib::error_code ec;
+    ws_transport().client().send(connection, payload.dump(),
+                                 websocketpp::frame::opcode::text, ec);
+}
+
+void BackendWsClient::stop() {
+    std::shared_ptr<WsState> state;
+    {
+        std::lock_guard<std::mutex> lock(ws_mutex_);
+        state = std::move(ws_state_);
+    }
+    if (!state) {
+        return;
+    }
+    if (state->multiplexed) {
+        if (auto mux = ws_multiplexer()) {
+            mux->connection_for(state->session_id).unsubscribe(state->session_id);
+        }
+    }
+    websocketpp::connection_hdl connection;
+    WsClient::timer_ptr timer;
+    size_t reconnects = 0;
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->running = false;
+        // The handlers usually hold the call, which holds this client.
+        state->on_message = nullptr;
+        state->on_timeout = nullptr;
+        state->on_close = nullptr;
+        connection = state->connection;
+        timer = std::move(state->reconnect_timer);
+        reconnects = state->reconnects;
+    }
+    // Per session, so a flapping backend shows as the share of calls hit
+    // rather than one total.
+    auto& metrics = Metrics::instance();
+    metrics.increment_counter("ws_sessions_total");
+    if (reconnects > 0) {
+        metrics.increment_counter("ws_sessions_reconnected_total");
+        logging::info("WebSocket session reconnected during call",
+                      {kv("reconnects", reconnects), kv("session_id", state->session_id)});
+    }
+    if (timer) {
+        timer->cancel();
+    }
+    if (!connection.expired()) {
+        websocketpp::lib::error_code ec;
+        ws_transport().client().close(connection,
+                                      websocketpp::close::status::going_away,
+                                      "shutdown", ec);
     }
 }
 
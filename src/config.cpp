@@ -10,10 +10,20 @@
 #include <sstream>
 #include <stdexcept>
 
+#include <unistd.h>
+
 namespace sip_gateway {
 
 namespace {
 
+std::string host_name() {
+    char name[256] = {};
+    if (gethostname(name, sizeof(name) - 1) != 0) {
+        return "";
+    }
+    return name;
+}
+
 std::string get_env_str(const char* name, const std::string& fallback) {
     const char* value = std::getenv(name);
     return value ? std::string(value) : fallback;
@@ -205,8 +215,14 @@ Config Config::load() {
     config.ec_tail_len = get_env_int("EC_TAIL_LEN", 200);
     config.ec_no_vad = get_env_bool("EC_NO_VAD", false);
     config.sip_media_thread_cnt = get_env_int("SIP_MEDIA_THREAD_CNT", 1);
+    config.media_partitions = get_env_int("MEDIA_PARTITIONS", 0);
     config.log_level = get_env_str("LOG_LEVEL", "INFO");
 
+    config.log_format = get_env_str("LOG_FORMAT", "text");
+    config.log_async = get_env_bool("LOG_ASYNC", false);
+    config.log_async_queue_size = get_env_int("LOG_ASYNC_QUEUE_SIZE", 8192);
+    config.log_async_overflow = get_env_str("LOG_ASYNC_OVERFLOW", "drop_oldest");
+
     const auto log_filename_raw = get_env_str("LOG_FILENAME", "");
     if (!log_filename_raw.empty()) {
         const std::filesystem::path log_path(log_filename_raw);
@@ -226,11 +242,26 @@ Config Config::load() {
         get_env_int("PJSIP_CONSOLE_LOG_LEVEL", default_console_level);
 
     config.vad_sampling_rate = get_env_int("VAD_SAMPLING_RATE", 16000);
+    config.vad_narrowband = get_env_bool("VAD_NARROWBAND", false);
     config.vad_threshold = get_env_double("VAD_THRESHOLD", 0.65);
     config.vad_min_speech_duration_ms = get_env_int("VAD_MIN_SPEECH_DURATION_MS", 150);
     config.vad_min_silence_duration_ms = get_env_int("VAD_MIN_SILENCE_DURATION_MS", 300);
     config.vad_speech_pad_ms = get_env_int("VAD_SPEECH_PAD_MS", 700);
     config.vad_speech_prob_window = get_env_int("VAD_SPEECH_PROB_WINDOW", 3);
+    config.vad_max_utterance_ms = get_env_int("VAD_MAX_UTTERANCE_MS", 60000);
+    config.vad_energy_gate = get_env_bool("VAD_ENERGY_GATE", false);
+    config.vad_energy_gate_ratio = get_env_double("VAD_ENERGY_GATE_RATIO", 2.0);
+    config.vad_energy_gate_max_rms = get_env_double("VAD_ENERGY_GATE_MAX_RMS", 0.01);
+    config.vad_energy_gate_windows = get_env_int("VAD_ENERGY_GATE_WINDOWS", 8);
+    config.vad_energy_gate_reset = get_env_bool("VAD_ENERGY_GATE_RESET", true);
+    config.vad_batch_max = get_env_int("VAD_BATCH_MAX", 1);
+    config.vad_batch_wait_us = get_env_int("VAD_BATCH_WAIT_US", 250);
+    config.vad_ort_intra_op_threads = get_env_int("VAD_ORT_INTRA_OP_THREADS", 1);
+    config.vad_ort_inter_op_threads = get_env_int("VAD_ORT_INTER_OP_THREADS", 1);
+    config.vad_ort_spinning = get_env_bool("VAD_ORT_SPINNING", false);
+    config.vad_ort_graph_optimization = get_env_str("VAD_ORT_GRAPH_OPTIMIZATION", "all");
+    config.vad_ort_global_threads = get_env_bool("VAD_ORT_GLOBAL_THREADS", false);
+    config.vad_ort_cache_dir = get_env_str("VAD_ORT_CACHE_DIR", "");
     config.vad_correction_debug = get_env_bool("VAD_CORRECTION_DEBUG", false);
     config.vad_correction_enter_thres = get_env_double("VAD_CORRECTION_ENTER_THRESHOLD", 0.6);
     config.vad_correction_exit_thres = get_env_double("VAD_CORRECTION_EXIT_THRESHOLD", 0.4);
@@ -248,12 +279,16 @@ Config Config::load() {
     config.local_stt_lang = get_env_str("LOCAL_STT_LANG", "en");
 
     config.greeting_delay_sec = get_env_double("GREETING_DELAY_SEC", 0.0);
+    config.greeting_answer_deadline_ms = get_env_int("GREETING_ANSWER_DEADLINE_MS", 1000);
 
     const std::map<std::string, int> default_codecs = {{"opus/48000", 254}, {"G722/16000", 253}};
     config.codecs_priority = parse_json_map(get_env_str("CODECS_PRIORITY", ""), default_codecs);
 
     config.interruptions_are_allowed = get_env_bool("INTERRUPTIONS_ARE_ALLOWED", true);
     config.record_audio_parts = get_env_bool("RECORD_AUDIO_PARTS", false);
+    config.record_audio_format = get_env_str("RECORD_AUDIO_FORMAT", "wav");
+    config.record_audio_stereo = get_env_bool("RECORD_AUDIO_STEREO", false);
+    config.record_audio_opus_bitrate = get_env_int("RECORD_AUDIO_OPUS_BITRATE", 24000);
 
     config.flametree_callback_url = get_env_optional("FLAMETREE_CALLBACK_URL");
     config.flametree_callback_port = get_env_int("FLAMETREE_CALLBACK_PORT", 8088);
@@ -274,9 +309,63 @@ Config Config::load() {
                           streaming_flag;
     config.show_waiting_messages = get_env_bool("SHOW_WAITING_MESSAGES", false);
     config.allow_inbound_calls = get_env_bool("ALLOW_INBOUND_CALLS", true);
+    config.admission_control = get_env_bool("ADMISSION_CONTROL", false);
+    config.admission_vad_cpu_budget = get_env_double("ADMISSION_VAD_CPU_BUDGET", 0.8);
+    config.admission_max_backlog = get_env_int("ADMISSION_MAX_BACKLOG", 256);
+    config.admission_backend_p95_ms = get_env_int("ADMISSION_BACKEND_P95_MS", 3000);
+    config.admission_retry_after_sec = get_env_int("ADMISSION_RETRY_AFTER_SEC", 30);
+    config.dial_calls_per_second = get_env_double("DIAL_CPS", 5.0);
+    config.dial_max_concurrent = get_env_int("DIAL_MAX_CONCURRENT", 8);
+    config.dial_queue_max = get_env_int("DIAL_QUEUE_MAX", 1000);
+    config.dial_history = get_env_int("DIAL_HISTORY", 1000);
+    config.cluster_mode = get_env_bool("CLUSTER_MODE", false);
+    config.cluster_node_id = get_env_str("CLUSTER_NODE_ID", host_name());
+    config.cluster_advertise_url = get_env_optional("CLUSTER_ADVERTISE_URL");
+    config.cluster_heartbeat_sec = get_env_int("CLUSTER_HEARTBEAT_SEC", 5);
+    config.cluster_secret = get_env_optional("CLUSTER_SECRET");
+    config.cluster_peers = split_csv(get_env_str("CLUSTER_PEERS", ""));
+    config.cluster_ca_file = get_env_optional("CLUSTER_CA_FILE");
 
     config.log_name = get_env_str("LOG_NAME", "sip_gateway");
     config.tts_max_inflight = get_env_int("TTS_MAX_INFLIGHT", 3);
+    config.tts_max_queued_kb = get_env_int("TTS_MAX_QUEUED_KB", 0);
+    config.tts_clause_chunking = get_env_bool("TTS_CLAUSE_CHUNKING", false);
+    config.tts_clause_min_chars = get_env_int("TTS_CLAUSE_MIN_CHARS", 20);
+    config.tts_clause_max_chars = get_env_int("TTS_CLAUSE_MAX_CHARS", 150);
+    config.tts_scheduler = get_env_bool("TTS_SCHEDULER", false);
+    config.tts_scheduler_min = get_env_int("TTS_SCHEDULER_MIN", 2);
+    config.tts_scheduler_max = get_env_int("TTS_SCHEDULER_MAX", 64);
+    config.tts_scheduler_initial = get_env_int("TTS_SCHEDULER_INITIAL", 8);
+    config.tts_scheduler_tolerance = get_env_double("TTS_SCHEDULER_TOLERANCE", 2.0);
+    config.turn_trace = get_env_bool("TURN_TRACE", false);
+    config.turn_trace_slow_ms = get_env_int("TURN_TRACE_SLOW_MS", 1000);
+    config.call_trace = get_env_bool("CALL_TRACE", false);
+    config.call_trace_dir = get_env_str("CALL_TRACE_DIR", audio_base + "/traces");
+    config.worker_pool_threads = get_env_int("WORKER_POOL_THREADS", 32);
+    config.worker_pool_media_threads = get_env_int("WORKER_POOL_MEDIA_THREADS", 2);
+    config.worker_pool_queue_size = get_env_int("WORKER_POOL_QUEUE_SIZE", 1024);
+    config.audio_worker_threads = get_env_int("AUDIO_WORKER_THREADS", 4);
+    config.audio_worker_affinity = get_env_bool("AUDIO_WORKER_AFFINITY", false);
+    config.sip_event_driven_loop = get_env_bool("SIP_EVENT_DRIVEN_LOOP", false);
+    config.ws_transport_threads = get_env_int("WS_TRANSPORT_THREADS", 2);
+    config.backend_pool_size = get_env_int("BACKEND_POOL_SIZE", 16);
+    config.backend_pool_idle_timeout = get_env_int("BACKEND_POOL_IDLE_TIMEOUT", 60);
+    config.backend_hedge = get_env_bool("BACKEND_HEDGE", false);
+    config.backend_hedge_quantile = get_env_double("BACKEND_HEDGE_QUANTILE", 0.9);
+    config.backend_hedge_budget = get_env_double("BACKEND_HEDGE_BUDGET", 0.1);
+    config.backend_turn_deadline_ms = get_env_int("BACKEND_TURN_DEADLINE_MS", 0);
+    config.ws_multiplex = get_env_bool("WS_MULTIPLEX", false);
+    config.ws_multiplex_connections = get_env_int("WS_MULTIPLEX_CONNECTIONS", 2);
+    config.tts_streaming = get_env_bool("TTS_STREAMING", false);
+    config.tts_prebuffer_ms = get_env_int("TTS_PREBUFFER_MS", 200);
+    config.stt_streaming = get_env_bool("STT_STREAMING", false);
+    config.stt_stream_chunk_ms = get_env_int("STT_STREAM_CHUNK_MS", 100);
+    config.stt_stream_timeout_ms = get_env_int("STT_STREAM_TIMEOUT_MS", 2000);
+    config.stt_upload_codec = get_env_str("STT_UPLOAD_CODEC", "wav");
+    config.stt_upload_opus_bitrate = get_env_int("STT_UPLOAD_OPUS_BITRATE", 24000);
+    config.stt_upload_content_type = get_env_str("STT_UPLOAD_CONTENT_TYPE", "");
+    config.tts_cache_mb = get_env_int("TTS_CACHE_MB", 64);
+    config.tts_cache_dir = get_env_str("TTS_CACHE_DIR", "");
 
     return config;
 }
@@ -306,9 +395,183 @@ void Config::validate() const {
     if (sip_media_thread_cnt < 0) {
         throw std::runtime_error("SIP_MEDIA_THREAD_CNT must be zero or positive");
     }
+    if (media_partitions < 0) {
+        throw std::runtime_error("MEDIA_PARTITIONS must be zero or positive");
+    }
     if (tts_max_inflight <= 0) {
         throw std::runtime_error("TTS_MAX_INFLIGHT must be positive");
     }
+    if (tts_max_queued_kb < 0) {
+        throw std::runtime_error("TTS_MAX_QUEUED_KB must be zero or positive");
+    }
+    if (tts_clause_min_chars < 0) {
+        throw std::runtime_error("TTS_CLAUSE_MIN_CHARS must be zero or positive");
+    }
+    if (tts_clause_max_chars < 0) {
+        throw std::runtime_error("TTS_CLAUSE_MAX_CHARS must be zero or positive");
+    }
+    if (tts_scheduler_min <= 0) {
+        throw std::runtime_error("TTS_SCHEDULER_MIN must be positive");
+    }
+    if (tts_scheduler_max < tts_scheduler_min) {
+        throw std::runtime_error("TTS_SCHEDULER_MAX must not be below TTS_SCHEDULER_MIN");
+    }
+    if (tts_scheduler_initial < tts_scheduler_min || tts_scheduler_initial > tts_scheduler_max) {
+        throw std::runtime_error(
+            "TTS_SCHEDULER_INITIAL must be between TTS_SCHEDULER_MIN and TTS_SCHEDULER_MAX");
+    }
+    if (tts_scheduler_tolerance <= 1.0) {
+        throw std::runtime_error("TTS_SCHEDULER_TOLERANCE must be greater than 1");
+    }
+    if (turn_trace_slow_ms < 0) {
+        throw std::runtime_error("TURN_TRACE_SLOW_MS must be zero or positive");
+    }
+    if (worker_pool_threads <= 0) {
+        throw std::runtime_error("WORKER_POOL_THREADS must be positive");
+    }
+    if (worker_pool_media_threads < 0) {
+        throw std::runtime_error("WORKER_POOL_MEDIA_THREADS must be zero or positive");
+    }
+    if (worker_pool_queue_size <= 0) {
+        throw std::runtime_error("WORKER_POOL_QUEUE_SIZE must be positive");
+    }
+    if (audio_worker_threads <= 0) {
+        throw std::runtime_error("AUDIO_WORKER_THREADS must be positive");
+    }
+    if (admission_vad_cpu_budget <= 0.0) {
+        throw std::runtime_error("ADMISSION_VAD_CPU_BUDGET must be positive");
+    }
+    if (admission_max_backlog <= 0) {
+        throw std::runtime_error("ADMISSION_MAX_BACKLOG must be positive");
+    }
+    if (admission_backend_p95_ms <= 0) {
+        throw std::runtime_error("ADMISSION_BACKEND_P95_MS must be positive");
+    }
+    if (dial_calls_per_second < 0.0) {
+        throw std::runtime_error("DIAL_CPS must be zero or positive");
+    }
+    if (dial_max_concurrent <= 0) {
+        throw std::runtime_error("DIAL_MAX_CONCURRENT must be positive");
+    }
+    if (dial_queue_max <= 0) {
+        throw std::runtime_error("DIAL_QUEUE_MAX must be positive");
+    }
+    if (dial_history < 0) {
+        throw std::runtime_error("DIAL_HISTORY must be zero or positive");
+    }
+    if (cluster_mode) {
+        if (cluster_node_id.empty()) {
+            throw std::runtime_error("CLUSTER_NODE_ID is required when CLUSTER_MODE is set");
+        }
+        if (!cluster_advertise_url || cluster_advertise_url->empty()) {
+            throw std::runtime_error("CLUSTER_ADVERTISE_URL is required when CLUSTER_MODE is set");
+        }
+        if (cluster_heartbeat_sec <= 0) {
+            throw std::runtime_error("CLUSTER_HEARTBEAT_SEC must be positive");
+        }
+        if (!cluster_secret || cluster_secret->empty()) {
+            throw std::runtime_error("CLUSTER_SECRET is required when CLUSTER_MODE is set");
+        }
+        // Forwarded requests carry the cluster secret, so they only travel
+        // over verified TLS.
+        if (cluster_advertise_url->rfind("https://", 0) != 0) {
+            throw std::runtime_error("CLUSTER_ADVERTISE_URL must be an https URL");
+        }
+        for (const auto& peer : cluster_peers) {
+            if (peer.rfind("https://", 0) != 0) {
+                throw std::runtime_error("CLUSTER_PEERS must be https URLs: " + peer);
+            }
+        }
+    }
+    if (admission_retry_after_sec < 0) {
+        throw std::runtime_error("ADMISSION_RETRY_AFTER_SEC must be zero or positive");
+    }
+    if (ws_transport_threads <= 0) {
+        throw std::runtime_error("WS_TRANSPORT_THREADS must be positive");
+    }
+    if (backend_pool_size <= 0) {
+        throw std::runtime_error("BACKEND_POOL_SIZE must be positive");
+    }
+    if (backend_pool_idle_timeout <= 0) {
+        throw std::runtime_error("BACKEND_POOL_IDLE_TIMEOUT must be positive");
+    }
+    if (vad_max_utterance_ms <= 0) {
+        throw std::runtime_error("VAD_MAX_UTTERANCE_MS must be positive");
+    }
+    if (vad_energy_gate_ratio < 1.0) {
+        throw std::runtime_error("VAD_ENERGY_GATE_RATIO must be at least 1");
+    }
+    if (vad_energy_gate_max_rms <= 0.0) {
+        throw std::runtime_error("VAD_ENERGY_GATE_MAX_RMS must be positive");
+    }
+    if (vad_energy_gate_windows < 0) {
+        throw std::runtime_error("VAD_ENERGY_GATE_WINDOWS must be zero or positive");
+    }
+    if (vad_batch_max <= 0) {
+        throw std::runtime_error("VAD_BATCH_MAX must be positive");
+    }
+    if (vad_batch_wait_us < 0) {
+        throw std::runtime_error("VAD_BATCH_WAIT_US must be zero or positive");
+    }
+    if (vad_ort_intra_op_threads <= 0) {
+        throw std::runtime_error("VAD_ORT_INTRA_OP_THREADS must be positive");
+    }
+    if (vad_ort_inter_op_threads <= 0) {
+        throw std::runtime_error("VAD_ORT_INTER_OP_THREADS must be positive");
+    }
+    if (vad_ort_graph_optimization != "disabled" && vad_ort_graph_optimization != "basic" &&
+        vad_ort_graph_optimization != "extended" && vad_ort_graph_optimization != "all") {
+        throw std::runtime_error(
+            "VAD_ORT_GRAPH_OPTIMIZATION must be disabled, basic, extended or all");
+    }
+    if (backend_hedge_quantile <= 0.0 || backend_hedge_quantile >= 1.0) {
+        throw std::runtime_error("BACKEND_HEDGE_QUANTILE must be between 0 and 1");
+    }
+    if (backend_hedge_budget < 0.0) {
+        throw std::runtime_error("BACKEND_HEDGE_BUDGET must be zero or positive");
+    }
+    if (backend_turn_deadline_ms < 0) {
+        throw std::runtime_error("BACKEND_TURN_DEADLINE_MS must be zero or positive");
+    }
+    if (ws_multiplex_connections <= 0) {
+        throw std::runtime_error("WS_MULTIPLEX_CONNECTIONS must be positive");
+    }
+    if (tts_prebuffer_ms <= 0) {
+        throw std::runtime_error("TTS_PREBUFFER_MS must be positive");
+    }
+    if (greeting_answer_deadline_ms < 0) {
+        throw std::runtime_error("GREETING_ANSWER_DEADLINE_MS must be zero or positive");
+    }
+    if (stt_stream_chunk_ms <= 0) {
+        throw std::runtime_error("STT_STREAM_CHUNK_MS must be positive");
+    }
+    if (stt_stream_timeout_ms <= 0) {
+        throw std::runtime_error("STT_STREAM_TIMEOUT_MS must be positive");
+    }
+    if (tts_cache_mb < 0) {
+        throw std::runtime_error("TTS_CACHE_MB must be zero or positive");
+    }
+    if (stt_upload_codec != "wav" && stt_upload_codec != "opus") {
+        throw std::runtime_error("STT_UPLOAD_CODEC must be wav or opus");
+    }
+    if (stt_upload_opus_bitrate <= 0) {
+        throw std::runtime_error("STT_UPLOAD_OPUS_BITRATE must be positive");
+    }
+    if (log_format != "text" && log_format != "json") {
+        throw std::runtime_error("LOG_FORMAT must be text or json");
+    }
+    if (log_async_queue_size <= 0) {
+        throw std::runtime_error("LOG_ASYNC_QUEUE_SIZE must be positive");
+    }
+    if (log_async_overflow != "block" && log_async_overflow != "drop_oldest") {
+        throw std::runtime_error("LOG_ASYNC_OVERFLOW must be block or drop_oldest");
+    }
+    if (record_audio_format != "wav" && record_audio_format != "opus") {
+        throw std::runtime_error("RECORD_AUDIO_FORMAT must be wav or opus");
+    }
+    if (record_audio_opus_bitrate <= 0) {
+        throw std::runtime_error("RECORD_AUDIO_OPUS_BITRATE must be positive");
+    }
 }
 
 }
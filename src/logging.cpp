@@ -1,10 +1,13 @@
 #include "sip_gateway/logging.hpp"
 
 #include <algorithm>
+#include <atomic>
+#include <cstdio>
 #include <filesystem>
 #include <string>
 #include <vector>
 
+#include "spdlog/async.h"
 #include "spdlog/sinks/basic_file_sink.h"
 #include "spdlog/sinks/stdout_color_sinks.h"
 #include "spdlog/spdlog.h"
@@ -14,6 +17,11 @@ namespace sip_gateway::logging {
 
 namespace {
 
+// Raw pointer to the logger init() registered; the registry keeps it alive
+// until shutdown().
+std::atomic<spdlog::logger*> g_logger{nullptr};
+std::atomic<bool> g_json{false};
+
 spdlog::level::level_enum parse_level(std::string value) {
     std::transform(value.begin(), value.end(), value.begin(),
                    [](unsigned char ch) { return static_cast<char>(std::toupper(ch)); });
@@ -26,6 +34,80 @@ spdlog::level::level_enum parse_level(std::string value) {
     return spdlog::level::info;
 }
 
+void append_json_string(std::string& out, std::string_view value) {
+    out += '"';
+    for (const char ch : value) {
+        switch (ch) {
+            case '"':
+                out += "\\\"";
+                break;
+            case '\\':
+                out += "\\\\";
+                break;
+            case '\n':
+                out += "\\n";
+                break;
+            case '\r':
+                out += "\\r";
+                break;
+            case '\t':
+                out += "\\t";
+                break;
+            default:
+                if (static_cast<unsigned char>(ch) < 0x20) {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x",
+                                  static_cast<unsigned>(static_cast<unsigned char>(ch)));
+                    out += escaped;
+                } else {
+                    out += ch;
+                }
+        }
+    }
+    out += '"';
+}
+
+// message [key=value key="value with spaces"]
+void format_text(std::string& out, std::string& value, std::string_view message,
+                 std::initializer_list<KeyValue> items) {
+    out += message;
+    bool first = true;
+    for (const auto& item : items) {
+        value.clear();
+        item.append(value, item.value);
+        out += first ? " [" : " ";
+        first = false;
+        out += item.key;
+        out += '=';
+        if (value.find(' ') != std::string::npos) {
+            out += '"';
+            out += value;
+            out += '"';
+        } else {
+            out += value;
+        }
+    }
+    if (!first) {
+        out += ']';
+    }
+}
+
+// "msg":"...","key":"value" -- the rest of the object comes from the
+// pattern set in init().
+void format_json(std::string& out, std::string& value, std::string_view message,
+                 std::initializer_list<KeyValue> items) {
+    out += "\"msg\":";
+    append_json_string(out, message);
+    for (const auto& item : items) {
+        value.clear();
+        item.append(value, item.value);
+        out += ',';
+        append_json_string(out, item.key);
+        out += ':';
+        append_json_string(out, value);
+    }
+}
+
 }
 
 void init(const Config& config) {
@@ -41,10 +123,33 @@ void init(const Config& config) {
                                                                             true));
     }
 
-    auto logger = std::make_shared<spdlog::logger>("sip_gateway", sinks.begin(), sinks.end());
+    std::shared_ptr<spdlog::logger> logger;
+    if (config.log_async) {
+        // One thread drains the queue, so records keep their order. When it
+        // is full, callers either wait or overwrite the oldest queued record.
+        spdlog::init_thread_pool(static_cast<size_t>(config.log_async_queue_size), 1);
+        const auto policy = config.log_async_overflow == "block"
+                                ? spdlog::async_overflow_policy::block
+                                : spdlog::async_overflow_policy::overrun_oldest;
+        logger = std::make_shared<spdlog::async_logger>("sip_gateway", sinks.begin(), sinks.end(),
+                                                        spdlog::thread_pool(), policy);
+    } else {
+        logger = std::make_shared<spdlog::logger>("sip_gateway", sinks.begin(), sinks.end());
+    }
+    const bool json = config.log_format == "json";
+    if (json) {
+        logger->set_pattern(R"({"ts":"%Y-%m-%dT%H:%M:%S.%e%z","level":"%l","thread":%t,%v})");
+    }
     spdlog::register_logger(logger);
     spdlog::set_default_logger(logger);
     spdlog::set_level(parse_level(config.log_level));
+    g_json.store(json, std::memory_order_relaxed);
+    g_logger.store(logger.get(), std::memory_order_release);
+}
+
+void shutdown() {
+    g_logger.store(nullptr, std::memory_order_release);
+    spdlog::shutdown();
 }
 
 std::shared_ptr<spdlog::logger> get_logger() {
@@ -54,5 +159,31 @@ std::shared_ptr<spdlog::logger> get_logger() {
     return spdlog::default_logger();
 }
 
+spdlog::logger* current_logger() {
+    if (auto* logger = g_logger.load(std::memory_order_acquire)) {
+        return logger;
+    }
+    return spdlog::default_logger_raw();
+}
+
+void write(spdlog::level::level_enum level,
+           std::string_view message,
+           std::initializer_list<KeyValue> items) {
+    auto* logger = current_logger();
+    if (!logger) {
+        return;
+    }
+    // Per-thread scratch buffers: the record is copied by the sink (or the
+    // async queue), so formatting allocates only while they grow.
+    thread_local std::string out;
+    thread_local std::string value;
+    out.clear();
+    if (g_json.load(std::memory_order_relaxed)) {
+        format_json(out, value, message, items);
+    } else {
+        format_text(out, value, message, items);
+    }
+    logger->log(level, spdlog::string_view_t(out.data(), out.size()));
 }
 
+}
@@ -22,7 +22,9 @@ int main() {
         sip_gateway::error(
             "Startup failed",
             {sip_gateway::kv("error", ex.what())});
+        sip_gateway::logging::shutdown();
         return 1;
     }
+    sip_gateway::logging::shutdown();
     return 0;
 }
@@ -1,67 +1,376 @@
 #include "sip_gateway/metrics.hpp"
 
 #include <algorithm>
+#include <cmath>
+#include <fstream>
 #include <iomanip>
+#include <mutex>
 #include <sstream>
 
 namespace sip_gateway {
 
+namespace {
+
+constexpr std::array<double, 3> kSummaryQuantiles = {0.5, 0.95, 0.99};
+
+size_t stripe_index() {
+    static std::atomic<size_t> next{0};
+    thread_local const size_t index =
+        next.fetch_add(1, std::memory_order_relaxed) % Metrics::kStripes;
+    return index;
+}
+
+// Threads in this process, from /proc; nullopt where that is unavailable.
+std::optional<uint64_t> process_threads() {
+#ifdef __linux__
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind("Threads:", 0) == 0) {
+            return std::stoull(line.substr(8));
+        }
+    }
+#endif
+    return std::nullopt;
+}
+
+uint64_t to_ns(double seconds) {
+    if (!(seconds > 0.0)) {
+        return 0;
+    }
+    return static_cast<uint64_t>(std::llround(seconds * 1e9));
+}
+
+// Looks a series up under the shared lock and only takes the exclusive lock
+// the first time it is seen.
+template <typename Map, typename Create>
+auto& find_or_create(std::shared_mutex& mutex, Map& map, const std::string& key,
+                     Create create) {
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        const auto it = map.find(key);
+        if (it != map.end()) {
+            return *it->second;
+        }
+    }
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    auto& slot = map[key];
+    if (!slot) {
+        slot = create();
+    }
+    return *slot;
+}
+
+// A series' label text with the bucket bound appended.
+std::string with_le(const std::string& label_text, const std::string& le) {
+    if (label_text.empty()) {
+        return "{le=\"" + le + "\"}";
+    }
+    return label_text.substr(0, label_text.size() - 1) + ",le=\"" + le + "\"}";
+}
+
+}
+
+void Metrics::Histogram::observe(double seconds) {
+    auto& stripe = stripes_[stripe_index()];
+    const auto bucket = static_cast<size_t>(
+        std::lower_bound(kBounds.begin(), kBounds.end(), seconds) - kBounds.begin());
+    stripe.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    stripe.fine[fine_index(seconds)].fetch_add(1, std::memory_order_relaxed);
+    stripe.sum_ns.fetch_add(to_ns(seconds), std::memory_order_relaxed);
+}
+
+uint64_t Metrics::Histogram::count() const {
+    return cumulative_buckets().back();
+}
+
+double Metrics::Histogram::sum() const {
+    uint64_t total = 0;
+    for (const auto& stripe : stripes_) {
+        total += stripe.sum_ns.load(std::memory_order_relaxed);
+    }
+    return static_cast<double>(total) / 1e9;
+}
+
+std::array<uint64_t, Metrics::Histogram::kBounds.size() + 1>
+Metrics::Histogram::cumulative_buckets() const {
+    std::array<uint64_t, kBounds.size() + 1> out{};
+    for (const auto& stripe : stripes_) {
+        for (size_t i = 0; i < out.size(); ++i) {
+            out[i] += stripe.buckets[i].load(std::memory_order_relaxed);
+        }
+    }
+    for (size_t i = 1; i < out.size(); ++i) {
+        out[i] += out[i - 1];
+    }
+    return out;
+}
+
+std::optional<double> Metrics::Histogram::bucket_quantile(double quantile,
+                                                          uint64_t min_count) const {
+    const auto buckets = cumulative_buckets();
+    const uint64_t count = buckets.back();
+    if (count == 0 || count < min_count) {
+        return std::nullopt;
+    }
+    const double rank = std::clamp(quantile, 0.0, 1.0) * static_cast<double>(count);
+    double lower_bound = 0.0;
+    uint64_t lower_count = 0;
+    for (size_t i = 0; i < kBounds.size(); ++i) {
+        const uint64_t cumulative = buckets[i];
+        if (static_cast<double>(cumulative) >= rank && cumulative > lower_count) {
+            const double fraction = (rank - static_cast<double>(lower_count)) /
+                                    static_cast<double>(cumulative - lower_count);
+            return lower_bound + fraction * (kBounds[i] - lower_bound);
+        }
+        lower_bound = kBounds[i];
+        lower_count = cumulative;
+    }
+    return std::nullopt;
+}
+
+std::optional<double> Metrics::Histogram::quantile(double quantile) const {
+    return quantile_of(fine_counts(), quantile);
+}
+
+Metrics::Histogram::FineCounts Metrics::Histogram::fine_counts() const {
+    FineCounts fine{};
+    for (const auto& stripe : stripes_) {
+        for (size_t i = 0; i < kFineBuckets; ++i) {
+            fine[i] += stripe.fine[i].load(std::memory_order_relaxed);
+        }
+    }
+    return fine;
+}
+
+std::optional<double> Metrics::Histogram::quantile_of(const FineCounts& fine, double quantile) {
+    uint64_t count = 0;
+    for (const auto value : fine) {
+        count += value;
+    }
+    if (count == 0) {
+        return std::nullopt;
+    }
+    const double rank = std::clamp(quantile, 0.0, 1.0) * static_cast<double>(count);
+    uint64_t below = 0;
+    for (size_t i = 0; i + 1 < kFineBuckets; ++i) {
+        if (fine[i] == 0) {
+            continue;
+        }
+        if (static_cast<double>(below + fine[i]) >= rank) {
+            const double fraction =
+                std::clamp((rank - static_cast<double>(below)) / static_cast<double>(fine[i]),
+                           0.0, 1.0);
+            const double lower = fine_lower(i);
+            return lower + fraction * (fine_lower(i + 1) - lower);
+        }
+        below += fine[i];
+    }
+    return std::nullopt;
+}
+
+size_t Metrics::Histogram::fine_index(double seconds) {
+    if (!(seconds > 0.0)) {
+        return 0;
+    }
+    int exponent = 0;
+    const double mantissa = std::frexp(seconds, &exponent);
+    if (exponent < kMinExponent) {
+        return 0;
+    }
+    if (exponent > kMaxExponent) {
+        return kFineBuckets - 1;
+    }
+    // mantissa is in [0.5, 1): split each octave linearly.
+    const auto sub = std::min(kSubBuckets - 1,
+                              static_cast<size_t>((mantissa - 0.5) * 2.0 * kSubBuckets));
+    return 1 + static_cast<size_t>(exponent - kMinExponent) * kSubBuckets + sub;
+}
+
+double Metrics::Histogram::fine_lower(size_t index) {
+    if (index == 0) {
+        return 0.0;
+    }
+    const size_t offset = index - 1;
+    const int exponent = kMinExponent + static_cast<int>(offset / kSubBuckets);
+    const double sub = static_cast<double>(offset % kSubBuckets);
+    return std::ldexp(1.0 + sub / kSubBuckets, exponent - 1);
+}
+
+void Metrics::Counter::increment(uint64_t delta) {
+    stripes_[stripe_index()].value.fetch_add(delta, std::memory_order_relaxed);
+}
+
+uint64_t Metrics::Counter::value() const {
+    uint64_t total = 0;
+    for (const auto& stripe : stripes_) {
+        total += stripe.value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void Metrics::Gauge::set(double value) {
+    value_.store(value, std::memory_order_relaxed);
+}
+
+void Metrics::Gauge::add(double delta) {
+    double current = value_.load(std::memory_order_relaxed);
+    while (!value_.compare_exchange_weak(current, current + delta, std::memory_order_relaxed)) {
+    }
+}
+
+double Metrics::Gauge::value() const {
+    return value_.load(std::memory_order_relaxed);
+}
+
 Metrics& Metrics::instance() {
     static Metrics metrics;
     return metrics;
 }
 
-Metrics::Metrics() {
-    histogram_bounds_ = {0.005, 0.01, 0.025, 0.05, 0.075, 0.1, 0.25, 0.5,
-                         0.75, 1.0, 2.5, 5.0, 7.5, 10.0};
+Metrics::Histogram& Metrics::histogram(const std::string& method) {
+    return find_or_create(registry_mutex_, response_histograms_, method,
+                          []() { return std::unique_ptr<Histogram>(new Histogram()); });
 }
 
-void Metrics::increment_request() {
-    std::lock_guard<std::mutex> lock(mutex_);
-    ++request_total_;
+Metrics::Histogram& Metrics::named_histogram(const std::string& name, const Labels& labels) {
+    const auto label_text = format_labels(labels);
+    {
+        std::shared_lock<std::shared_mutex> lock(registry_mutex_);
+        const auto family = histograms_.find(name);
+        if (family != histograms_.end()) {
+            const auto it = family->second.find(label_text);
+            if (it != family->second.end()) {
+                return *it->second;
+            }
+        }
+    }
+    std::unique_lock<std::shared_mutex> lock(registry_mutex_);
+    auto& slot = histograms_[name][label_text];
+    if (!slot) {
+        slot.reset(new Histogram());
+    }
+    return *slot;
+}
+
+Metrics::Counter& Metrics::counter(const std::string& name, const Labels& labels) {
+    const auto label_text = format_labels(labels);
+    {
+        std::shared_lock<std::shared_mutex> lock(registry_mutex_);
+        const auto family = counters_.find(name);
+        if (family != counters_.end()) {
+            const auto it = family->second.find(label_text);
+            if (it != family->second.end()) {
+                return *it->second;
+            }
+        }
+    }
+    std::unique_lock<std::shared_mutex> lock(registry_mutex_);
+    auto& slot = counters_[name][label_text];
+    if (!slot) {
+        slot.reset(new Counter());
+    }
+    return *slot;
 }
 
-Metrics::HistogramSeries& Metrics::histogram_for(const std::string& method) {
-    auto& series = response_histograms_[method];
-    if (series.buckets.empty()) {
-        series.buckets.assign(histogram_bounds_.size() + 1, 0);
+Metrics::Gauge& Metrics::gauge(const std::string& name, const Labels& labels) {
+    const auto label_text = format_labels(labels);
+    {
+        std::shared_lock<std::shared_mutex> lock(registry_mutex_);
+        const auto family = gauges_.find(name);
+        if (family != gauges_.end()) {
+            const auto it = family->second.find(label_text);
+            if (it != family->second.end()) {
+                return *it->second;
+            }
+        }
     }
-    return series;
+    std::unique_lock<std::shared_mutex> lock(registry_mutex_);
+    auto& slot = gauges_[name][label_text];
+    if (!slot) {
+        slot.reset(new Gauge());
+    }
+    return *slot;
 }
 
 Metrics::SummarySeries& Metrics::summary_for(const std::string& method) {
-    return response_summaries_[method];
+    return find_or_create(registry_mutex_, response_summaries_, method,
+                          []() { return std::make_unique<SummarySeries>(); });
+}
+
+void Metrics::increment_request() {
+    request_total_.increment();
 }
 
 void Metrics::observe_response_time(const std::string& method, double seconds) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    auto& histogram = histogram_for(method);
-    histogram.count += 1;
-    histogram.sum += seconds;
-    for (size_t i = 0; i < histogram_bounds_.size(); ++i) {
-        if (seconds <= histogram_bounds_[i]) {
-            histogram.buckets[i] += 1;
+    histogram(method).observe(seconds);
+}
+
+std::optional<double> Metrics::response_time_quantile(const std::string& method,
+                                                     double quantile,
+                                                     uint64_t min_count) const {
+    const Histogram* series = nullptr;
+    {
+        std::shared_lock<std::shared_mutex> lock(registry_mutex_);
+        const auto it = response_histograms_.find(method);
+        if (it == response_histograms_.end()) {
+            return std::nullopt;
         }
+        series = it->second.get();
     }
-    histogram.buckets.back() += 1;
+    return series->bucket_quantile(quantile, min_count);
 }
 
 void Metrics::observe_response_summary(const std::string& method, double seconds) {
-    std::lock_guard<std::mutex> lock(mutex_);
     auto& summary = summary_for(method);
-    summary.count += 1;
-    summary.sum += seconds;
+    summary.count.fetch_add(1, std::memory_order_relaxed);
+    summary.sum_ns.fetch_add(to_ns(seconds), std::memory_order_relaxed);
+}
+
+std::string Metrics::format_labels(const Labels& labels) {
+    if (labels.empty()) {
+        return "";
+    }
+    std::string result = "{";
+    for (size_t i = 0; i < labels.size(); ++i) {
+        if (i > 0) {
+            result += ',';
+        }
+        result += labels[i].first;
+        result += "=\"";
+        result += labels[i].second;
+        result += '"';
+    }
+    result += '}';
+    return result;
+}
+
+void Metrics::set_gauge(const std::string& name, double value, const Labels& labels) {
+    gauge(name, labels).set(value);
+}
+
+void Metrics::increment_counter(const std::string& name,
+                                const Labels& labels,
+                                uint64_t delta) {
+    counter(name, labels).increment(delta);
 }
 
 std::string Metrics::render_prometheus() const {
-    std::lock_guard<std::mutex> lock(mutex_);
     std::ostringstream out;
     out.setf(std::ios::fixed);
     out << std::setprecision(6);
 
+    // Only registration waits on this; updates go straight to the series.
+    std::shared_lock<std::shared_mutex> lock(registry_mutex_);
+
     out << "# HELP client_requests_total Total number of client requests\n";
     out << "# TYPE client_requests_total counter\n";
-    out << "client_requests_total " << request_total_ << "\n";
+    out << "client_requests_total " << request_total_.value() << "\n";
+
+    if (const auto threads = process_threads()) {
+        out << "# TYPE process_threads gauge\n";
+        out << "process_threads " << *threads << "\n";
+    }
 
     out << "# HELP client_response_summary Time elapsed for response\n";
     out << "# TYPE client_response_summary summary\n";
@@ -73,14 +382,16 @@ std::string Metrics::render_prometheus() const {
     }
     std::sort(methods.begin(), methods.end());
     for (const auto& method : methods) {
-        const auto& series = response_summaries_.at(method);
+        const auto& series = *response_summaries_.at(method);
         out << "client_response_summary_count{method=\"" << method << "\"} "
-            << series.count << "\n";
+            << series.count.load(std::memory_order_relaxed) << "\n";
         out << "client_response_summary_sum{method=\"" << method << "\"} "
-            << series.sum << "\n";
+            << static_cast<double>(series.sum_ns.load(std::memory_order_relaxed)) / 1e9
+            << "\n";
     }
 
-    out << "# HELP response_time_milliseconds Response time in milliseconds\n";
+    // The name is kept from the Python gateway; the values are seconds.
+    out << "# HELP response_time_milliseconds Response time in seconds\n";
     out << "# TYPE response_time_milliseconds histogram\n";
     methods.clear();
     methods.reserve(response_histograms_.size());
@@ -89,18 +400,68 @@ std::string Metrics::render_prometheus() const {
     }
     std::sort(methods.begin(), methods.end());
     for (const auto& method : methods) {
-        const auto& series = response_histograms_.at(method);
-        for (size_t i = 0; i < histogram_bounds_.size(); ++i) {
+        const auto& series = *response_histograms_.at(method);
+        const auto buckets = series.cumulative_buckets();
+        for (size_t i = 0; i < Histogram::kBounds.size(); ++i) {
             out << "response_time_milliseconds_bucket{method=\"" << method
-                << "\",le=\"" << histogram_bounds_[i] << "\"} "
-                << series.buckets[i] << "\n";
+                << "\",le=\"" << Histogram::kBounds[i] << "\"} " << buckets[i] << "\n";
         }
         out << "response_time_milliseconds_bucket{method=\"" << method
-            << "\",le=\"+Inf\"} " << series.buckets.back() << "\n";
+            << "\",le=\"+Inf\"} " << buckets.back() << "\n";
         out << "response_time_milliseconds_count{method=\"" << method << "\"} "
-            << series.count << "\n";
+            << buckets.back() << "\n";
         out << "response_time_milliseconds_sum{method=\"" << method << "\"} "
-            << series.sum << "\n";
+            << series.sum() << "\n";
+    }
+
+    out << "# HELP response_time_seconds Response time quantiles since start\n";
+    out << "# TYPE response_time_seconds summary\n";
+    for (const auto& method : methods) {
+        const auto& series = *response_histograms_.at(method);
+        for (const auto quantile : kSummaryQuantiles) {
+            const auto value = series.quantile(quantile);
+            if (!value) {
+                continue;
+            }
+            out << "response_time_seconds{method=\"" << method << "\",quantile=\""
+                << std::setprecision(2) << quantile << std::setprecision(6) << "\"} "
+                << *value << "\n";
+        }
+    }
+
+    for (const auto& family : histograms_) {
+        out << "# TYPE " << family.first << " histogram\n";
+        for (const auto& series : family.second) {
+            const auto buckets = series.second->cumulative_buckets();
+            std::ostringstream bound;
+            bound.flags(out.flags());
+            bound.precision(out.precision());
+            for (size_t i = 0; i < Histogram::kBounds.size(); ++i) {
+                bound.str("");
+                bound << Histogram::kBounds[i];
+                out << family.first << "_bucket" << with_le(series.first, bound.str()) << " "
+                    << buckets[i] << "\n";
+            }
+            out << family.first << "_bucket" << with_le(series.first, "+Inf") << " "
+                << buckets.back() << "\n";
+            out << family.first << "_count" << series.first << " " << buckets.back() << "\n";
+            out << family.first << "_sum" << series.first << " " << series.second->sum()
+                << "\n";
+        }
+    }
+
+    for (const auto& family : gauges_) {
+        out << "# TYPE " << family.first << " gauge\n";
+        for (const auto& series : family.second) {
+            out << family.first << series.first << " " << series.second->value() << "\n";
+        }
+    }
+
+    for (const auto& family : counters_) {
+        out << "# TYPE " << family.first << " counter\n";
+        for (const auto& series : family.second) {
+            out << family.first << series.first << " " << series.second->value() << "\n";
+        }
     }
 
     return out.str();
@@ -6,57 +6,81 @@
 
 namespace sip_gateway {
 
-RestServer::RestServer(const Config& config, CallHandler on_call, TransferHandler on_transfer)
+RestServer::RestServer(const Config& config,
+                       CallHandler on_call,
+                       TransferHandler on_transfer,
+                       HealthHandler on_health,
+                       CallHandler on_batch,
+                       DialStatusHandler on_dial_status)
     : config_(config),
       on_call_(std::move(on_call)),
-      on_transfer_(std::move(on_transfer)) {}
+      on_transfer_(std::move(on_transfer)),
+      on_health_(std::move(on_health)),
+      on_batch_(std::move(on_batch)),
+      on_dial_status_(std::move(on_dial_status)) {}
+
+RestServer::~RestServer() {
+    stop();
+}
 
 void RestServer::start() {
     server_ = std::make_unique<httplib::Server>();
 
-    server_->Get("/health", [](const httplib::Request&, httplib::Response& res) {
-        nlohmann::json payload{{"status", "ok"}};
+    server_->Get("/health", [this](const httplib::Request&, httplib::Response& res) {
+        nlohmann::json payload{{"status", "ok"}, {"ready", ready_.load()}};
+        if (on_health_) {
+            try {
+                payload.update(on_health_());
+            } catch (const std::exception& ex) {
+                logging::warn(
+                    "Health details unavailable",
+                    {kv("error", ex.what())});
+            }
+        }
         res.set_content(payload.dump(), "application/json");
         logging::debug("Health check served");
     });
 
+    server_->Get("/ready", [this](const httplib::Request&, httplib::Response& res) {
+        const bool ready = ready_.load();
+        res.status = ready ? 200 : 503;
+        nlohmann::json payload{{"status", ready ? "ready" : "starting"}};
+        res.set_content(payload.dump(), "application/json");
+    });
+
     server_->Get("/metrics", [](const httplib::Request&, httplib::Response& res) {
         res.set_content(Metrics::instance().render_prometheus(),
                         "text/plain; version=0.0.4");
     });
 
     server_->Post("/call", [this](const httplib::Request& req, httplib::Response& res) {
-        utils::ensure_pj_thread_registered("sipgw_rest");
-        if (!authorize_request(req, res)) {
-            return;
-        }
-        nlohmann::json body;
-        try {
-            body = nlohmann::json::parse(req.body);
-        } catch (const std::exception& ex) {
-            logging::error(
-                "Failed to parse /call request",
-                {kv("error", ex.what())});
-            res.status = 400;
-            res.set_content(R"({"message":"invalid request body"})", "application/json");
-            return;
-        }
-        try {
-            const auto payload = on_call_(body);
-            write_json(res, payload);
-        } catch (const std::exception& ex) {
-            logging::error(
-                "Failed to handle /call request",
-                {kv("error", ex.what())});
-            res.status = 500;
-            res.set_content(R"({"message":"failed to start session"})", "application/json");
-        }
+        serve_json_post(req, res, on_call_, "/call", "failed to start session");
     });
 
+    if (on_batch_) {
+        server_->Post("/calls", [this](const httplib::Request& req, httplib::Response& res) {
+            serve_json_post(req, res, on_batch_, "/calls", "failed to queue calls");
+        });
+    }
+
+    if (on_dial_status_) {
+        server_->Get(R"(/call/([0-9a-f]+))",
+                     [this](const httplib::Request& req, httplib::Response& res) {
+            if (!check_ready(res) || !authorize_request(req, res)) {
+                return;
+            }
+            write_json(res, on_dial_status_(req.matches[1].str()));
+        });
+    }
+
     server_->Post(R"(/transfer/([A-Za-z0-9_-]+))",
                   [this](const httplib::Request& req, httplib::Response& res) {
+        if (!check_ready(res)) {
+            return;
+        }
         utils::ensure_pj_thread_registered("sipgw_rest");
-        if (!authorize_request(req, res)) {
+        const bool forwarded = req.has_header(kForwardedHeader);
+        if (forwarded ? !authorize_forwarded(req, res) : !authorize_request(req, res)) {
             return;
         }
         const auto session_id = req.matches[1].str();
@@ -74,7 +98,7 @@ void RestServer::start() {
             }
         }
         try {
-            const auto payload = on_transfer_(session_id, body);
+            const auto payload = on_transfer_(session_id, body, forwarded);
             write_json(res, payload);
         } catch (const std::exception& ex) {
             logging::error(
@@ -102,6 +126,58 @@ void RestServer::stop() {
     }
 }
 
+void RestServer::set_ready(bool ready) {
+    ready_.store(ready);
+}
+
+bool RestServer::check_ready(httplib::Response& response) const {
+    // PJSIP is not initialized yet, so these requests cannot even register
+    // their thread with it.
+    if (ready_.load()) {
+        return true;
+    }
+    response.status = 503;
+    response.set_content(R"({"message":"starting"})", "application/json");
+    return false;
+}
+
+void RestServer::serve_json_post(const httplib::Request& request,
+                                 httplib::Response& response,
+                                 const CallHandler& handler,
+                                 const char* route,
+                                 const char* failure_message) const {
+    if (!check_ready(response)) {
+        return;
+    }
+    utils::ensure_pj_thread_registered("sipgw_rest");
+    if (!authorize_request(request, response)) {
+        return;
+    }
+    nlohmann::json body;
+    try {
+        body = nlohmann::json::parse(request.body);
+    } catch (const std::exception& ex) {
+        logging::error(
+            "Failed to parse REST request",
+            {kv("route", route),
+             kv("error", ex.what())});
+        response.status = 400;
+        response.set_content(R"({"message":"invalid request body"})", "application/json");
+        return;
+    }
+    try {
+        write_json(response, handler(body));
+    } catch (const std::exception& ex) {
+        logging::error(
+            "Failed to handle REST request",
+            {kv("route", route),
+             kv("error", ex.what())});
+        response.status = 500;
+        response.set_content(nlohmann::json{{"message", failure_message}}.dump(),
+                             "application/json");
+    }
+}
+
 bool RestServer::authorize_request(const httplib::Request& request,
                                    httplib::Response& response) const {
     if (!config_.authorization_token) {
@@ -122,8 +198,24 @@ bool RestServer::authorize_request(const httplib::Request& request,
     return true;
 }
 
+bool RestServer::authorize_forwarded(const httplib::Request& request,
+                                     httplib::Response& response) const {
+    const auto it = request.headers.find("Authorization");
+    if (!config_.cluster_secret || it == request.headers.end() ||
+        it->second != "Bearer " + *config_.cluster_secret) {
+        response.status = 403;
+        response.set_content(R"({"message":"invalid cluster authorization"})",
+                             "application/json");
+        return false;
+    }
+    return true;
+}
+
 void RestServer::write_json(httplib::Response& response, const RestResponse& payload) const {
     response.status = payload.status;
+    for (const auto& [name, value] : payload.headers) {
+        response.set_header(name, value);
+    }
     response.set_content(payload.body.dump(), "application/json");
 }
 
@@ -6,6 +6,7 @@
 #include "sip_gateway/logging.hpp"
 #include "sip_gateway/sip/app.hpp"
 #include "sip_gateway/sip/call.hpp"
+#include "sip_gateway/utils/async.hpp"
 
 namespace sip_gateway {
 
@@ -49,36 +50,81 @@ void SipAccount::onIncomingCall(pj::OnIncomingCallParam& iprm) {
         logging::info(
             "Inbound call rejected (disabled)",
             {kv("call_id", iprm.callId)});
-        auto call = std::make_shared<SipCall>(app_, *this, app_.backend_url(), iprm.callId);
+        auto call = SipCall::create(app_, *this, app_.backend_url(), iprm.callId);
         call->hangup(PJSIP_SC_FORBIDDEN);
         return;
     }
+    if (!app_.admit_call("inbound")) {
+        auto call = SipCall::create(app_, *this, app_.backend_url(), iprm.callId);
+        pj::SipHeader retry_after;
+        retry_after.hName = "Retry-After";
+        retry_after.hValue = std::to_string(app_.config().admission_retry_after_sec);
+        call->hangup(PJSIP_SC_SERVICE_UNAVAILABLE, {retry_after});
+        return;
+    }
 
     logging::info(
         "Incoming call",
         {kv("call_id", iprm.callId)});
-    auto call = std::make_shared<SipCall>(app_, *this, app_.backend_url(), iprm.callId);
+    auto call = SipCall::create(app_, *this, app_.backend_url(), iprm.callId);
     call->answer(PJSIP_SC_RINGING);
     app_.register_call(call);
+    std::string remote_uri;
     try {
-        const auto info = call->getInfo();
-        app_.handle_incoming_call(call, info.remoteUri);
-    } catch (const BackendError& ex) {
-        logging::error(
-            "Incoming call backend error",
-            {kv("error", ex.what()),
-             kv("call_id", iprm.callId)});
-        call->hangup(PJSIP_SC_SERVICE_UNAVAILABLE);
-        app_.unregister_call(iprm.callId);
-    } catch (const std::exception& ex) {
+        remote_uri = call->getInfo().remoteUri;
+    } catch (const pj::Error& ex) {
         logging::error(
-            "Exception in onIncomingCall",
-            {kv("error_type", typeid(ex).name()),
-             kv("error", ex.what()),
+            "Incoming call info unavailable",
+            {kv("reason", ex.reason),
              kv("call_id", iprm.callId)});
         call->hangup(PJSIP_SC_INTERNAL_SERVER_ERROR);
-        app_.unregister_call(iprm.callId);
+        app_.unregister_call(call);
+        return;
     }
+    // Session setup talks to the backend, so it runs off the SIP thread while
+    // the call keeps ringing; handle_incoming_call answers it when ready.
+    const auto call_id = iprm.callId;
+    utils::run_async([this, call, remote_uri, call_id]() {
+        const auto reject = [this, &call, call_id](int status_code) {
+            try {
+                app_.run_on_sip_thread([&call, status_code]() {
+                    if (!call->is_disconnected()) {
+                        call->hangup(status_code);
+                    }
+                });
+            } catch (const pj::Error& ex) {
+                logging::warn(
+                    "Incoming call reject failed",
+                    {kv("reason", ex.reason),
+                     kv("call_id", call_id)});
+            }
+            // By pointer: the id may already belong to a newer call.
+            app_.unregister_call(call);
+        };
+        try {
+            app_.handle_incoming_call(call, remote_uri);
+        } catch (const BackendError& ex) {
+            logging::error(
+                "Incoming call backend error",
+                {kv("error", ex.what()),
+                 kv("call_id", call_id)});
+            reject(PJSIP_SC_SERVICE_UNAVAILABLE);
+        } catch (const pj::Error& ex) {
+            logging::error(
+                "Incoming call answer failed",
+                {kv("reason", ex.reason),
+                 kv("status", ex.status),
+                 kv("call_id", call_id)});
+            reject(PJSIP_SC_INTERNAL_SERVER_ERROR);
+        } catch (const std::exception& ex) {
+            logging::error(
+                "Exception in onIncomingCall",
+                {kv("error_type", typeid(ex).name()),
+                 kv("error", ex.what()),
+                 kv("call_id", call_id)});
+            reject(PJSIP_SC_INTERNAL_SERVER_ERROR);
+        }
+    });
 }
 
 }
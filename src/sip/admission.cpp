@@ -0,0 +1,101 @@
+#include "sip_gateway/sip/admission.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace sip_gateway {
+
+namespace {
+
+// Fewer backend requests than this in the window give no p95.
+constexpr uint64_t kMinBackendSamples = 20;
+
+double ratio(double value, double budget) {
+    return budget > 0.0 ? value / budget : 0.0;
+}
+
+}
+
+AdmissionController::AdmissionController(AdmissionOptions options)
+    : options_(options) {}
+
+LoadReport AdmissionController::assess(const LoadSample& sample) const {
+    LoadReport report;
+    report.sample = sample;
+    report.calls = ratio(static_cast<double>(sample.live_calls),
+                         static_cast<double>(options_.max_calls));
+    report.vad_cpu = ratio(sample.vad_cpu_cores, options_.vad_cpu_cores);
+    report.backlog = ratio(static_cast<double>(sample.backlog),
+                           static_cast<double>(options_.max_backlog));
+    report.backend_latency = ratio(sample.backend_p95_sec.value_or(0.0),
+                                   options_.backend_p95_sec);
+    const std::pair<double, const char*> signals[] = {
+        {report.calls, "calls"},
+        {report.vad_cpu, "vad_cpu"},
+        {report.backlog, "backlog"},
+        {report.backend_latency, "backend_latency"},
+    };
+    for (const auto& [value, name] : signals) {
+        if (value > report.score) {
+            report.score = value;
+            report.limiting = name;
+        }
+    }
+    return report;
+}
+
+void AdmissionController::sample() {
+    auto now = take_snapshot();
+    std::lock_guard<std::mutex> lock(mutex_);
+    history_.push_back(std::move(now));
+    const auto at = history_.back().at;
+    while (history_.size() > 1 && at - history_.front().at > options_.window) {
+        history_.pop_front();
+    }
+}
+
+LoadReport AdmissionController::evaluate(size_t live_calls, size_t backlog) {
+    LoadSample sample;
+    sample.live_calls = live_calls;
+    sample.backlog = backlog;
+    const auto now = take_snapshot();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const auto& oldest = history_.empty() ? now : history_.front();
+        const double elapsed = std::chrono::duration<double>(now.at - oldest.at).count();
+        if (elapsed > 0.0) {
+            sample.vad_cpu_cores = std::max(0.0, now.vad_sec - oldest.vad_sec) / elapsed;
+        }
+        Metrics::Histogram::FineCounts window{};
+        uint64_t requests = 0;
+        for (size_t i = 0; i < window.size(); ++i) {
+            window[i] = now.backend[i] - oldest.backend[i];
+            requests += window[i];
+        }
+        if (requests >= kMinBackendSamples) {
+            sample.backend_p95_sec = Metrics::Histogram::quantile_of(window, 0.95);
+        }
+    }
+    auto report = assess(sample);
+    static auto& load = Metrics::instance().gauge("admission_load");
+    load.set(report.score);
+    return report;
+}
+
+AdmissionController::Snapshot AdmissionController::take_snapshot() {
+    auto& metrics = Metrics::instance();
+    static auto& vad = metrics.histogram("vad_inference");
+    static auto& reused = metrics.histogram("backend_request_reused_conn");
+    static auto& fresh = metrics.histogram("backend_request_new_conn");
+    Snapshot snapshot;
+    snapshot.at = std::chrono::steady_clock::now();
+    snapshot.vad_sec = vad.sum();
+    snapshot.backend = reused.fine_counts();
+    const auto added = fresh.fine_counts();
+    for (size_t i = 0; i < added.size(); ++i) {
+        snapshot.backend[i] += added[i];
+    }
+    return snapshot;
+}
+
+}
@@ -2,52 +2,238 @@
 
 #include <pjsua-lib/pjsua.h>
 
+#include <algorithm>
 #include <chrono>
 #include <filesystem>
+#include <future>
 #include <httplib.h>
 #include <thread>
 
 #include <nlohmann/json.hpp>
 
+#include "sip_gateway/audio/recorder.hpp"
+#include "sip_gateway/audio/shard_pool.hpp"
+#include "sip_gateway/backend/ws_client.hpp"
 #include "sip_gateway/logging.hpp"
+#include "sip_gateway/metrics.hpp"
 #include "sip_gateway/sip/account.hpp"
 #include "sip_gateway/sip/call.hpp"
+#include "sip_gateway/sip/tts_scheduler.hpp"
 #include "sip_gateway/server/rest_server.hpp"
+#include "sip_gateway/utils/async.hpp"
 #include "sip_gateway/utils/http.hpp"
+#include "sip_gateway/utils/timer.hpp"
+#include "sip_gateway/utils/worker_pool.hpp"
+#include "sip_gateway/vad/batch_scheduler.hpp"
+#include "sip_gateway/vad/dsp.hpp"
 #include "sip_gateway/vad/model.hpp"
 
 namespace sip_gateway {
 
+namespace {
+
+constexpr auto kCallMemoryReportInterval = std::chrono::seconds(5);
+// Session changes are published this soon instead of waiting for the next
+// heartbeat; changes within the delay share one publish.
+constexpr auto kClusterPublishDelay = std::chrono::milliseconds(200);
+
+BackendRequestOptions backend_request_options(const Config& config) {
+    BackendRequestOptions options;
+    options.request_timeout = std::chrono::seconds(static_cast<int>(config.backend_request_timeout));
+    options.connect_timeout = std::chrono::seconds(static_cast<int>(config.backend_connect_timeout));
+    options.sock_read_timeout =
+        std::chrono::seconds(static_cast<int>(config.backend_sock_read_timeout));
+    options.pool = {static_cast<size_t>(config.backend_pool_size),
+                    std::chrono::seconds(config.backend_pool_idle_timeout)};
+    options.hedge.enabled = config.backend_hedge;
+    options.hedge.quantile = config.backend_hedge_quantile;
+    options.hedge.budget_ratio = config.backend_hedge_budget;
+    options.executor = [](std::function<void()> task) {
+        utils::worker_pool().post(std::move(task), utils::TaskLane::Backend);
+    };
+    return options;
+}
+
+DialQueueOptions dial_queue_options(const Config& config) {
+    DialQueueOptions options;
+    options.calls_per_second = config.dial_calls_per_second;
+    options.max_dialing = static_cast<size_t>(config.dial_max_concurrent);
+    options.max_queued = static_cast<size_t>(config.dial_queue_max);
+    options.history = static_cast<size_t>(config.dial_history);
+    return options;
+}
+
+ClusterOptions cluster_options(const Config& config) {
+    ClusterOptions options;
+    options.node_id = config.cluster_node_id;
+    options.advertise_url = config.cluster_advertise_url.value_or("");
+    while (!options.advertise_url.empty() && options.advertise_url.back() == '/') {
+        options.advertise_url.pop_back();
+    }
+    options.heartbeat = std::chrono::seconds(config.cluster_heartbeat_sec);
+    for (auto peer : config.cluster_peers) {
+        while (!peer.empty() && peer.back() == '/') {
+            peer.pop_back();
+        }
+        options.peers.push_back(std::move(peer));
+    }
+    return options;
+}
+
+AdmissionOptions admission_options(const Config& config) {
+    AdmissionOptions options;
+    options.max_calls = static_cast<size_t>(config.sip_max_calls);
+    options.vad_cpu_cores = config.admission_vad_cpu_budget * config.audio_worker_threads;
+    options.max_backlog = static_cast<size_t>(config.admission_max_backlog);
+    options.backend_p95_sec = config.admission_backend_p95_ms / 1000.0;
+    return options;
+}
+
+}
+
 SipApp::SipApp(Config config)
     : config_(std::move(config)),
       backend_client_(config_.backend_url, config_.authorization_token,
-                      {std::chrono::seconds(static_cast<int>(config_.backend_request_timeout)),
-                       std::chrono::seconds(static_cast<int>(config_.backend_connect_timeout)),
-                       std::chrono::seconds(static_cast<int>(config_.backend_sock_read_timeout))}),
+                      backend_request_options(config_)),
+      tts_cache_({static_cast<size_t>(config_.tts_cache_mb) * 1024 * 1024,
+                  audio::TtsCacheOptions{}.max_entry_bytes,
+                  config_.tts_cache_dir}),
+      admission_(admission_options(config_)),
       endpoint_(nullptr),
       account_(nullptr) {}
 
 void SipApp::init() {
-    auto capabilities = backend_client_.get_json("/capabilities");
-    logging::info(
-        "Backend capabilities received",
-        {kv("capabilities", capabilities.dump())});
+    utils::init_worker_pool(
+        {static_cast<size_t>(config_.worker_pool_threads),
+         static_cast<size_t>(config_.worker_pool_media_threads),
+         static_cast<size_t>(config_.worker_pool_queue_size)});
+    audio::init_audio_shard_pool(
+        {static_cast<size_t>(config_.audio_worker_threads),
+         config_.audio_worker_affinity});
+    init_ws_transport(static_cast<size_t>(config_.ws_transport_threads));
+    if (config_.tts_scheduler) {
+        // Each synthesis holds a Backend-lane worker, so a limit above the
+        // lane's threads would only queue.
+        const auto backend_threads = static_cast<size_t>(config_.worker_pool_threads);
+        AdaptiveLimitOptions options;
+        options.max_limit =
+            std::min(static_cast<size_t>(config_.tts_scheduler_max), backend_threads);
+        options.min_limit =
+            std::min(static_cast<size_t>(config_.tts_scheduler_min), options.max_limit);
+        options.initial_limit = std::clamp(static_cast<size_t>(config_.tts_scheduler_initial),
+                                           options.min_limit, options.max_limit);
+        options.tolerance = config_.tts_scheduler_tolerance;
+        tts_scheduler_ = std::make_shared<TtsScheduler>(
+            options, [](std::function<void()> task) { return utils::run_async(std::move(task)); });
+        logging::info("TTS scheduler enabled",
+                      {kv("min", options.min_limit),
+                       kv("max", options.max_limit),
+                       kv("initial", options.initial_limit)});
+    }
 
-    init_pjsip();
-    init_vad();
+    // Liveness is served from here on; readiness once everything below is
+    // up. The backend handshake and the VAD load (which may download the
+    // model) run beside the PJSIP setup, which stays on this thread because
+    // it becomes the SIP thread.
+    const auto init_started = std::chrono::steady_clock::now();
+    if (config_.cluster_mode) {
+        cluster_ = std::make_unique<ClusterRegistry>(
+            cluster_options(config_),
+            [this](const std::string& session_id) -> std::optional<ClusterNode> {
+                const auto owner = backend_client_.get_json(
+                    "/cluster/sessions/" + utils::url_encode(session_id));
+                if (!owner.is_object() || !owner.contains("node_id") ||
+                    !owner["node_id"].is_string() || !owner.contains("url") ||
+                    !owner["url"].is_string()) {
+                    return std::nullopt;
+                }
+                return ClusterNode{owner["node_id"].get<std::string>(),
+                                   owner["url"].get<std::string>()};
+            });
+    }
+    dial_queue_ = std::make_unique<DialQueue>(
+        dial_queue_options(config_),
+        [this](const nlohmann::json& request) { return place_call(request); },
+        [this](size_t dialing) { return has_dial_capacity(dialing); },
+        [](std::function<void()> task) { return utils::run_async(std::move(task)); },
+        [this](const DialAttempt& attempt) { report_dial_status(attempt); });
     rest_server_ = std::make_unique<RestServer>(
         config_,
         [this](const nlohmann::json& body) { return handle_call_request(body); },
-        [this](const std::string& session_id, const nlohmann::json& body) {
-            return handle_transfer_request(session_id, body);
+        [this](const std::string& session_id, const nlohmann::json& body, bool forwarded) {
+            return handle_transfer_request(session_id, body, forwarded);
+        },
+        [this]() { return health_payload(); },
+        [this](const nlohmann::json& body) { return handle_batch_call_request(body); },
+        [this](const std::string& request_id) {
+            return handle_dial_status_request(request_id);
         });
     rest_server_->start();
+    auto capabilities_ready = std::async(std::launch::async, [this]() {
+        return backend_client_.get_json("/capabilities");
+    });
+    auto vad_ready = std::async(std::launch::async, [this]() { init_vad(); });
+
+    init_pjsip();
+
+    const auto capabilities = capabilities_ready.get();
+    logging::info(
+        "Backend capabilities received",
+        {kv("capabilities", capabilities)});
+    if (config_.ws_multiplex) {
+        if (capabilities.is_object() && capabilities.value("ws_multiplex", false)) {
+            enable_ws_multiplex(config_.backend_url,
+                                static_cast<size_t>(config_.ws_multiplex_connections));
+        } else {
+            logging::info("Backend does not advertise ws_multiplex, using per-session WebSockets");
+        }
+    }
+    if (config_.stt_streaming) {
+        stt_streaming_ = capabilities.is_object() && capabilities.value("stt_streaming", false);
+        if (!stt_streaming_) {
+            logging::info("Backend does not advertise stt_streaming, using /transcribe");
+        }
+    }
+    vad_ready.get();
+
+    // Registering the account is what lets calls in, so it comes last.
+    create_account();
+    rest_server_->set_ready(true);
+    const auto init_elapsed =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - init_started).count();
+    Metrics::instance().set_gauge("startup_seconds", init_elapsed);
+    logging::info(
+        "Gateway ready",
+        {kv("startup_ms", static_cast<int>(init_elapsed * 1000.0))});
+    schedule_call_memory_report();
+    admission_.sample();
+    schedule_admission_sample();
+    if (cluster_) {
+        logging::info(
+            "Cluster mode enabled",
+            {kv("node_id", cluster_->options().node_id),
+             kv("url", cluster_->options().advertise_url),
+             kv("peers", cluster_->options().peers.size())});
+        request_cluster_publish();
+        schedule_cluster_heartbeat();
+    }
 }
 
 void SipApp::run() {
+    if (sip_jobs_.active()) {
+        // Posted jobs wake the ioqueue poll, so block for longer than any
+        // reasonable idle period; PJSIP still returns early for its timers.
+        constexpr int kBlockingPollMs = 500;
+        while (!quitting_) {
+            handle_events(kBlockingPollMs);
+            sip_jobs_.run_pending();
+        }
+        return;
+    }
     int consecutive_empty_cycles = 0;
+    const auto delay_ms = static_cast<int>(config_.events_delay * 1000.0);
     while (!quitting_) {
-        const auto processed = handle_events();
+        const auto processed = handle_events(delay_ms);
         if (processed == 0) {
             ++consecutive_empty_cycles;
             const auto delay =
@@ -64,10 +250,32 @@ void SipApp::run() {
 
 void SipApp::stop() {
     quitting_ = true;
+    sip_jobs_.post([]() {});
     if (rest_server_) {
         rest_server_->stop();
     }
+    if (dial_queue_) {
+        dial_queue_->stop();
+    }
+    if (cluster_) {
+        // Best effort; the registry also expires the record on its own.
+        try {
+            backend_client_.delete_json("/cluster/nodes/" +
+                                        utils::url_encode(cluster_->options().node_id));
+        } catch (const std::exception& ex) {
+            logging::warn(
+                "Failed to leave cluster",
+                {kv("error", ex.what())});
+        }
+    }
+    // Call teardown posts close_session tasks, so the pool outlives pjsua
+    // and drains them before it stops.
     shutdown_pjsip();
+    utils::shutdown_timer_service();
+    utils::shutdown_worker_pool();
+    audio::shutdown_recording_writer();
+    shutdown_ws_transport();
+    audio::shutdown_audio_shard_pool();
 }
 
 const Config& SipApp::config() const {
@@ -75,13 +283,53 @@ const Config& SipApp::config() const {
 }
 
 std::string SipApp::synthesize_session_audio(const std::string& session_id,
-                                             const std::string& text) {
+                                             const std::string& text,
+                                             std::optional<std::chrono::steady_clock::time_point> deadline) {
+    // Voice selection is per session type on the backend.
+    const auto cache_key = audio::TtsCache::make_key(text, config_.session_type);
+    if (auto cached = tts_cache_.get(cache_key)) {
+        return *cached;
+    }
     const auto query = "text=" + utils::url_encode(text) + "&format=wav";
-    return backend_client_.get_binary("/session/" + session_id + "/synthesize", query);
+    auto audio = backend_client_.get_binary("/session/" + session_id + "/synthesize", query,
+                                            {"synthesize", deadline});
+    tts_cache_.put(cache_key, audio);
+    return audio;
 }
 
-std::string SipApp::transcribe_audio(const std::string& wav_bytes) {
-    auto response = backend_client_.post_binary("/transcribe", "wav", wav_bytes);
+void SipApp::stream_session_audio(const std::string& session_id,
+                                  const std::string& text,
+                                  const std::function<bool(const char*, size_t)>& receiver) {
+    const auto cache_key = audio::TtsCache::make_key(text, config_.session_type);
+    if (auto cached = tts_cache_.get(cache_key)) {
+        receiver(cached->data(), cached->size());
+        return;
+    }
+    const auto query = "text=" + utils::url_encode(text) + "&format=wav";
+    std::string body;
+    bool complete = tts_cache_.enabled();
+    backend_client_.get_binary_stream(
+        "/session/" + session_id + "/synthesize", query,
+        [&](const char* data, size_t size) {
+            if (!receiver(data, size)) {
+                complete = false;
+                return false;
+            }
+            if (complete) {
+                body.append(data, size);
+            }
+            return true;
+        });
+    if (complete) {
+        tts_cache_.put(cache_key, std::move(body));
+    }
+}
+
+std::string SipApp::transcribe_audio(const std::string& audio,
+                                     const std::string& content_type,
+                                     std::optional<std::chrono::steady_clock::time_point> deadline) {
+    auto response = backend_client_.post_binary("/transcribe", content_type, audio,
+                                                {"transcribe", deadline});
     if (response.is_string()) {
         return response.get<std::string>();
     }
@@ -92,7 +340,8 @@ std::string SipApp::transcribe_audio(const std::string& wav_bytes) {
 }
 
 nlohmann::json SipApp::start_session_text(const std::string& session_id,
-                                          const std::string& text) {
+                                          const std::string& text,
+                                          std::optional<std::chrono::steady_clock::time_point> deadline) {
     logging::debug(
         "Backend start sent",
         {kv("session_id", session_id),
@@ -100,7 +349,9 @@ nlohmann::json SipApp::start_session_text(const std::string& session_id,
     nlohmann::json payload;
     payload["message"] = text;
     payload["kwargs"] = nlohmann::json::object();
-    return backend_client_.post_json("/session/" + session_id + "/start", payload);
+    // Not hedged: a second /start would begin a second generation.
+    return backend_client_.post_json("/session/" + session_id + "/start", payload,
+                                     {"", deadline});
 }
 
 nlohmann::json SipApp::commit_session(const std::string& session_id) {
@@ -135,17 +386,46 @@ void SipApp::close_session(const std::string& session_id,
     backend_client_.delete_json(path);
 }
 
+bool SipApp::stt_streaming() const {
+    return stt_streaming_;
+}
+
 std::shared_ptr<vad::VadModel> SipApp::vad_model() const {
     return vad_model_;
 }
 
-int SipApp::handle_events() {
+std::shared_ptr<vad::VadBatchScheduler> SipApp::vad_batch_scheduler() const {
+    return vad_batch_scheduler_;
+}
+
+std::shared_ptr<TtsScheduler> SipApp::tts_scheduler() const {
+    return tts_scheduler_;
+}
+
+audio::MediaPartitionPool* SipApp::media_partitions() const {
+    return media_partitions_.get();
+}
+
+void SipApp::run_on_sip_thread(const std::function<void()>& job) {
+    if (SipJobQueue::in_job()) {
+        job();
+        return;
+    }
+    auto task = std::make_shared<std::packaged_task<void()>>(job);
+    auto done = task->get_future();
+    if (!sip_jobs_.post([task]() { (*task)(); })) {
+        job();
+        return;
+    }
+    done.get();
+}
+
+int SipApp::handle_events(int timeout_ms) {
     if (!endpoint_) {
         return 0;
     }
     try {
-        const auto delay_ms = static_cast<int>(config_.events_delay * 1000.0);
-        return endpoint_->libHandleEvents(delay_ms);
+        return endpoint_->libHandleEvents(timeout_ms);
     } catch (const pj::Error& err) {
         logging::error("PJSIP handle events error",
                        {kv("reason", err.reason),
@@ -190,9 +470,75 @@ const std::string& SipApp::backend_url() const {
 }
 
 RestResponse SipApp::handle_call_request(const nlohmann::json& body) {
-    if (!body.contains("to_uri")) {
+    if (!body.contains("to_uri") || !body["to_uri"].is_string()) {
         return {400, nlohmann::json{{"message", "to_uri is required"}}};
     }
+    if (body.contains("async") && !body["async"].is_boolean()) {
+        return {400, nlohmann::json{{"message", "async must be a boolean"}}};
+    }
+    if (body.contains("async") && body["async"].get<bool>()) {
+        return queue_calls({body}, false);
+    }
+    if (!admit_call("rest")) {
+        return {503,
+                nlohmann::json{{"message", "over capacity"}},
+                {{"Retry-After", std::to_string(config_.admission_retry_after_sec)}}};
+    }
+    if (!account_) {
+        return {503, nlohmann::json{{"message", "sip not initialized"}}};
+    }
+    const auto session_id = place_call(body);
+    return {200, nlohmann::json{{"message", "ok"}, {"session_id", session_id}}};
+}
+
+RestResponse SipApp::handle_batch_call_request(const nlohmann::json& body) {
+    if (!body.contains("calls") || !body["calls"].is_array() || body["calls"].empty()) {
+        return {400, nlohmann::json{{"message", "calls must be a non-empty array"}}};
+    }
+    std::vector<nlohmann::json> requests;
+    requests.reserve(body["calls"].size());
+    for (const auto& call : body["calls"]) {
+        if (!call.is_object() || !call.contains("to_uri") || !call["to_uri"].is_string()) {
+            return {400, nlohmann::json{{"message", "to_uri is required"},
+                                        {"index", requests.size()}}};
+        }
+        requests.push_back(call);
+    }
+    return queue_calls(std::move(requests), true);
+}
+
+RestResponse SipApp::handle_dial_status_request(const std::string& request_id) {
+    const auto attempt = dial_queue_ ? dial_queue_->find(request_id) : std::nullopt;
+    if (!attempt) {
+        return {404, nlohmann::json{{"message", "request not found"}}};
+    }
+    return {200, attempt->to_json()};
+}
+
+RestResponse SipApp::queue_calls(std::vector<nlohmann::json> requests, bool batch) {
+    const size_t count = requests.size();
+    auto ids = dial_queue_ ? dial_queue_->enqueue(std::move(requests)) : std::nullopt;
+    if (!ids) {
+        Metrics::instance().increment_counter(
+            "admission_rejected_total", {{"source", "rest"}, {"reason", "dial_queue"}});
+        return {503,
+                nlohmann::json{{"message", "dial queue full"}},
+                {{"Retry-After", std::to_string(config_.admission_retry_after_sec)}}};
+    }
+    logging::info(
+        "Outbound calls queued",
+        {kv("count", count),
+         kv("queued", dial_queue_->queued())});
+    if (batch) {
+        return {202, nlohmann::json{{"message", "queued"}, {"request_ids", *ids}}};
+    }
+    return {202, nlohmann::json{{"message", "queued"}, {"request_id", ids->front()}}};
+}
+
+std::string SipApp::place_call(const nlohmann::json& body) {
+    if (!account_) {
+        throw std::runtime_error("sip not initialized");
+    }
     const auto to_uri = body.at("to_uri").get<std::string>();
     nlohmann::json env_info = nlohmann::json::object();
     if (body.contains("env_info") && body["env_info"].is_object()) {
@@ -208,10 +554,7 @@ RestResponse SipApp::handle_call_request(const nlohmann::json& body) {
          kv("communication_id", communication_id.value_or(""))});
     auto backend_session =
         create_backend_session(to_uri, "", "", env_info, communication_id);
-    if (!account_) {
-        return {503, nlohmann::json{{"message", "sip not initialized"}}};
-    }
-    auto call = std::make_shared<SipCall>(*this, *account_, backend_url());
+    auto call = SipCall::create(*this, *account_, backend_url());
     bind_session(call, backend_session.session_id);
     call->set_greeting(backend_session.greeting);
     call->connect_ws(
@@ -224,13 +567,69 @@ RestResponse SipApp::handle_call_request(const nlohmann::json& body) {
         [call]() {
             call->handle_ws_close();
         });
-    call->make_call(to_uri);
-    register_call(call);
-    return {200, nlohmann::json{{"message", "ok"}, {"session_id", backend_session.session_id}}};
+    run_on_sip_thread([this, &call, &to_uri]() {
+        call->make_call(to_uri);
+        register_call(call);
+    });
+    return backend_session.session_id;
+}
+
+bool SipApp::has_dial_capacity(size_t dialing) {
+    if (calls_.size() + dialing >= static_cast<size_t>(config_.sip_max_calls)) {
+        return false;
+    }
+    return !config_.admission_control || !load_report().over_budget();
+}
+
+void SipApp::report_dial_status(const DialAttempt& attempt) {
+    if (!attempt.request.contains("callback_url") || !attempt.request["callback_url"].is_string()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(dial_callbacks_mutex_);
+        auto [it, idle] = dial_callbacks_.try_emplace(attempt.id);
+        it->second.push_back(
+            {attempt.request["callback_url"].get<std::string>(), attempt.to_json().dump()});
+        if (!idle) {
+            // The attempt's sender is running and posts this one next.
+            return;
+        }
+    }
+    if (!utils::run_async([this, id = attempt.id]() { send_dial_callbacks(id); })) {
+        // Without a sender the entry would keep later callbacks queued.
+        std::lock_guard<std::mutex> lock(dial_callbacks_mutex_);
+        dial_callbacks_.erase(attempt.id);
+        logging::warn("Dial status callback dropped", {kv("request_id", attempt.id)});
+    }
+}
+
+void SipApp::send_dial_callbacks(const std::string& id) {
+    while (true) {
+        DialCallback callback;
+        {
+            std::lock_guard<std::mutex> lock(dial_callbacks_mutex_);
+            const auto it = dial_callbacks_.find(id);
+            if (it->second.empty()) {
+                dial_callbacks_.erase(it);
+                return;
+            }
+            callback = std::move(it->second.front());
+            it->second.pop_front();
+        }
+        const auto response =
+            utils::post_json(callback.url, callback.payload, std::chrono::seconds(5));
+        if (!response || response->status < 200 || response->status >= 300) {
+            logging::warn(
+                "Dial status callback failed",
+                {kv("url", callback.url),
+                 kv("request_id", id)});
+        }
+    }
 }
 
 RestResponse SipApp::handle_transfer_request(const std::string& session_id,
-                                             const nlohmann::json& body) {
+                                             const nlohmann::json& body,
+                                             bool forwarded) {
     if (!body.contains("to_uri") || !body["to_uri"].is_string()) {
         return {400, nlohmann::json{{"message", "to_uri is required"}}};
     }
@@ -240,18 +639,13 @@ RestResponse SipApp::handle_transfer_request(const std::string& session_id,
         transfer_delay = body["transfer_delay"].get<double>();
     }
 
-    std::shared_ptr<SipCall> call;
-    {
-        std::lock_guard<std::mutex> lock(calls_mutex_);
-        auto it = session_calls_.find(session_id);
-        if (it != session_calls_.end()) {
-            auto call_it = calls_.find(it->second);
-            if (call_it != calls_.end()) {
-                call = call_it->second;
+    const auto call = calls_.find_session(session_id);
+    if (!call) {
+        if (!forwarded) {
+            if (auto response = forward_to_owner(session_id, "/transfer/" + session_id, body)) {
+                return *response;
             }
         }
-    }
-    if (!call) {
         return {404, nlohmann::json{{"message", "session not found"}}};
     }
     try {
@@ -282,11 +676,22 @@ RestResponse SipApp::handle_transfer_request(const std::string& session_id,
 
 void SipApp::handle_incoming_call(const std::shared_ptr<SipCall>& call,
                                   const std::string& from_uri) {
+    const auto setup_start = std::chrono::steady_clock::now();
     nlohmann::json env_info = nlohmann::json::object();
     auto call_info = call->getInfo();
     auto backend_session =
         create_backend_session(from_uri, "", call_info.callIdString, env_info, std::nullopt);
-    bind_session(call, backend_session.session_id);
+    // A hangup handled before the bind finds no session to close, so the
+    // bind is refused once the call is disconnected and closed here instead.
+    const bool bound = call->run_unless_disconnected(
+        [&]() { bind_session(call, backend_session.session_id); });
+    if (!bound) {
+        logging::info(
+            "Caller hung up during call setup",
+            {kv("session_id", backend_session.session_id)});
+        close_session(backend_session.session_id, std::string("canceled"));
+        return;
+    }
     call->set_greeting(backend_session.greeting);
     call->connect_ws(
         [call](const nlohmann::json& message) {
@@ -298,42 +703,279 @@ void SipApp::handle_incoming_call(const std::shared_ptr<SipCall>& call,
         [call]() {
             call->handle_ws_close();
         });
-    call->answer(PJSIP_SC_OK);
+    // A hangup between the bind and the connect stopped nothing; the
+    // handlers hold the call, so stop them here.
+    if (call->is_disconnected()) {
+        call->stop_ws();
+        return;
+    }
+    auto answer = [this, weak_call = std::weak_ptr<SipCall>(call), setup_start,
+                   session_id = backend_session.session_id](bool greeting_ready) {
+        const auto incoming = weak_call.lock();
+        if (!incoming) {
+            return;
+        }
+        if (!greeting_ready) {
+            logging::info(
+                "Greeting not ready by answer deadline",
+                {kv("deadline_ms", config_.greeting_answer_deadline_ms),
+                 kv("session_id", session_id)});
+        }
+        answer_incoming_call(incoming, setup_start);
+    };
+    // Ring until the greeting is synthesized so it plays right after answer,
+    // but never longer than the deadline. Nothing here waits for it.
+    if (call->prepare_greeting() && config_.greeting_answer_deadline_ms > 0) {
+        call->answer_when_greeting_ready(
+            std::chrono::milliseconds(config_.greeting_answer_deadline_ms), std::move(answer));
+        return;
+    }
+    answer_incoming_call(call, setup_start);
+}
+
+void SipApp::answer_incoming_call(const std::shared_ptr<SipCall>& call,
+                                  std::chrono::steady_clock::time_point setup_start) {
+    try {
+        run_on_sip_thread([&call]() {
+            if (!call->is_disconnected()) {
+                call->answer(PJSIP_SC_OK);
+            }
+        });
+    } catch (const pj::Error& ex) {
+        logging::error(
+            "Incoming call answer failed",
+            {kv("reason", ex.reason),
+             kv("status", ex.status),
+             kv("session_id", call->session_id().value_or(""))});
+        try {
+            run_on_sip_thread([&call]() {
+                if (!call->is_disconnected()) {
+                    call->hangup(PJSIP_SC_INTERNAL_SERVER_ERROR);
+                }
+            });
+        } catch (const pj::Error&) {
+        }
+        unregister_call(call);
+        return;
+    }
+    Metrics::instance().observe_response_time(
+        "incoming_call_setup",
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - setup_start).count());
 }
 
 void SipApp::register_call(const std::shared_ptr<SipCall>& call) {
-    std::lock_guard<std::mutex> lock(calls_mutex_);
     const auto call_id = call->getId();
     if (call_id != PJSUA_INVALID_ID) {
-        calls_[call_id] = call;
-        if (call->session_id()) {
-            session_calls_[*call->session_id()] = call_id;
-        }
+        calls_.insert(call_id, call, call->session_id());
+        request_cluster_publish();
     }
 }
 
 void SipApp::bind_session(const std::shared_ptr<SipCall>& call,
                           const std::string& session_id) {
     call->set_session_id(session_id);
-    std::lock_guard<std::mutex> lock(calls_mutex_);
     const auto call_id = call->getId();
     if (call_id != PJSUA_INVALID_ID) {
-        calls_[call_id] = call;
-        session_calls_[session_id] = call_id;
+        calls_.insert(call_id, call, session_id);
+        request_cluster_publish();
     }
 }
 
-void SipApp::unregister_call(int call_id) {
-    std::lock_guard<std::mutex> lock(calls_mutex_);
-    auto it = calls_.find(call_id);
-    if (it == calls_.end()) {
+LoadReport SipApp::load_report() {
+    return admission_.evaluate(
+        calls_.size(), utils::worker_pool().queue_depth(utils::TaskLane::Backend));
+}
+
+bool SipApp::admit_call(const char* source) {
+    if (!config_.admission_control) {
+        return true;
+    }
+    const auto report = load_report();
+    if (!report.over_budget()) {
+        return true;
+    }
+    logging::warn(
+        "Call rejected (over capacity)",
+        {kv("source", source),
+         kv("load", report.score),
+         kv("limiting", report.limiting),
+         kv("live_calls", report.sample.live_calls)});
+    Metrics::instance().increment_counter(
+        "admission_rejected_total", {{"source", source}, {"reason", report.limiting}});
+    return false;
+}
+
+nlohmann::json SipApp::health_payload() {
+    const auto report = load_report();
+    nlohmann::json backend_p95_ms = nullptr;
+    if (report.sample.backend_p95_sec) {
+        backend_p95_ms = *report.sample.backend_p95_sec * 1000.0;
+    }
+    return {
+        {"load", report.score},
+        {"limiting", report.limiting},
+        {"accepting", !report.over_budget()},
+        {"calls", report.sample.live_calls},
+        {"max_calls", config_.sip_max_calls},
+        {"vad_cpu_cores", report.sample.vad_cpu_cores},
+        {"worker_backlog", report.sample.backlog},
+        {"backend_p95_ms", backend_p95_ms},
+        {"signals",
+         {{"calls", report.calls},
+          {"vad_cpu", report.vad_cpu},
+          {"backlog", report.backlog},
+          {"backend_latency", report.backend_latency}}},
+        {"dial_queue",
+         {{"queued", dial_queue_ ? dial_queue_->queued() : 0},
+          {"dialing", dial_queue_ ? dial_queue_->dialing() : 0}}},
+    };
+}
+
+void SipApp::schedule_call_memory_report() {
+    if (quitting_) {
+        return;
+    }
+    utils::timer_service().schedule(kCallMemoryReportInterval, [this]() {
+        report_call_memory();
+        schedule_call_memory_report();
+    });
+}
+
+void SipApp::schedule_admission_sample() {
+    if (quitting_) {
+        return;
+    }
+    utils::timer_service().schedule(admission_options(config_).sample_interval, [this]() {
+        admission_.sample();
+        schedule_admission_sample();
+    });
+}
+
+void SipApp::report_call_memory() {
+    SipCall::MemoryUsage total;
+    size_t largest = 0;
+    const auto snapshot = calls_.snapshot();
+    for (const auto& [call_id, entry] : snapshot->calls) {
+        const auto usage = entry.call->memory_usage();
+        total.vad += usage.vad;
+        total.segments += usage.segments;
+        total.uploads += usage.uploads;
+        total.tts += usage.tts;
+        largest = std::max(largest, usage.total());
+    }
+    auto& metrics = Metrics::instance();
+    const std::pair<const char*, size_t> kinds[] = {
+        {"vad", total.vad},
+        {"segments", total.segments},
+        {"uploads", total.uploads},
+        {"tts", total.tts},
+    };
+    for (const auto& [kind, bytes] : kinds) {
+        metrics.set_gauge("call_memory_bytes", static_cast<double>(bytes), {{"kind", kind}});
+    }
+    metrics.set_gauge("call_memory_max_bytes", static_cast<double>(largest));
+}
+
+void SipApp::schedule_cluster_heartbeat() {
+    if (quitting_) {
+        return;
+    }
+    utils::timer_service().schedule(cluster_->options().heartbeat, [this]() {
+        publish_cluster_node();
+        schedule_cluster_heartbeat();
+    });
+}
+
+void SipApp::request_cluster_publish() {
+    if (!cluster_ || quitting_ || cluster_publish_pending_.exchange(true)) {
         return;
     }
-    const auto session_id = it->second->session_id();
-    it->second->stop_ws();
-    calls_.erase(it);
-    if (session_id) {
-        session_calls_.erase(*session_id);
+    utils::timer_service().schedule(kClusterPublishDelay, [this]() {
+        cluster_publish_pending_ = false;
+        publish_cluster_node();
+    });
+}
+
+void SipApp::publish_cluster_node() {
+    std::vector<std::string> sessions;
+    const auto snapshot = calls_.snapshot();
+    sessions.reserve(snapshot->sessions.size());
+    for (const auto& [session_id, call_id] : snapshot->sessions) {
+        sessions.push_back(session_id);
+    }
+    const auto record = cluster_->node_record(sessions, load_report());
+    try {
+        backend_client_.put_json(
+            "/cluster/nodes/" + utils::url_encode(cluster_->options().node_id), record);
+    } catch (const std::exception& ex) {
+        Metrics::instance().increment_counter("cluster_publish_failures_total");
+        logging::warn(
+            "Failed to publish cluster node",
+            {kv("sessions", sessions.size()),
+             kv("error", ex.what())});
+    }
+}
+
+std::optional<RestResponse> SipApp::forward_to_owner(const std::string& session_id,
+                                                     const std::string& path,
+                                                     const nlohmann::json& body) {
+    if (!cluster_) {
+        return std::nullopt;
+    }
+    const auto owner = cluster_->remote_owner(session_id);
+    if (!owner) {
+        return std::nullopt;
+    }
+    // Peers authenticate each other with the cluster secret, never with
+    // this node's API token, and only over verified TLS.
+    const std::vector<std::pair<std::string, std::string>> headers{
+        {RestServer::kForwardedHeader, cluster_->options().node_id},
+        {"Authorization", "Bearer " + config_.cluster_secret.value_or("")}};
+    logging::info(
+        "Forwarding request to session owner",
+        {kv("path", path),
+         kv("node_id", owner->node_id),
+         kv("session_id", session_id)});
+    const auto response = utils::post_json(
+        owner->url + path, body.dump(),
+        std::chrono::seconds(static_cast<int>(config_.backend_request_timeout)), headers,
+        true, config_.cluster_ca_file.value_or(""));
+    if (!response) {
+        cluster_->forget(session_id);
+        Metrics::instance().increment_counter("cluster_forwarded_total", {{"result", "error"}});
+        return RestResponse{502, nlohmann::json{{"message", "session owner unreachable"},
+                                                {"node_id", owner->node_id}}};
+    }
+    if (response->status == 404) {
+        cluster_->forget(session_id);
+    }
+    Metrics::instance().increment_counter(
+        "cluster_forwarded_total",
+        {{"result", response->status >= 200 && response->status < 300 ? "ok" : "rejected"}});
+    auto payload = nlohmann::json::parse(response->body, nullptr, false);
+    if (payload.is_discarded()) {
+        payload = nlohmann::json{{"message", response->body}};
+    }
+    return RestResponse{response->status, std::move(payload)};
+}
+
+void SipApp::unregister_call(int call_id) {
+    if (const auto call = calls_.erase(call_id)) {
+        call->stop_ws();
+        request_cluster_publish();
+    }
+    if (dial_queue_) {
+        dial_queue_->notify();
+    }
+}
+
+void SipApp::unregister_call(const std::shared_ptr<SipCall>& call) {
+    if (calls_.erase(call->getId(), call)) {
+        call->stop_ws();
+        request_cluster_publish();
+    }
+    if (dial_queue_) {
+        dial_queue_->notify();
     }
 }
 
@@ -400,7 +1042,22 @@ void SipApp::init_pjsip() {
         endpoint_->transportCreate(PJSIP_TRANSPORT_TCP, sip_tp_config);
     }
     endpoint_->libStart();
+    if (config_.media_partitions > 0) {
+        audio::MediaPartitionOptions options;
+        options.partitions = static_cast<size_t>(config_.media_partitions);
+        options.clock_rate = ep_cfg.medConfig.clockRate;
+        options.ptime_ms = ep_cfg.medConfig.audioFramePtime;
+        // Stream, receiver, player and two recorder inputs per call.
+        options.max_ports = static_cast<unsigned>(config_.sip_max_calls) * 5 + 1;
+        options.narrowband = config_.vad_narrowband;
+        media_partitions_ = std::make_unique<audio::MediaPartitionPool>(options);
+    }
+    if (config_.sip_event_driven_loop) {
+        sip_jobs_.start();
+    }
+}
 
+void SipApp::create_account() {
     pj::AccountConfig account_cfg;
     account_cfg.mediaConfig.srtpUse = PJMEDIA_SRTP_OPTIONAL;
     account_cfg.mediaConfig.srtpSecureSignaling = 0;
@@ -459,12 +1116,50 @@ void SipApp::init_vad() {
                 throw std::runtime_error("downloaded VAD model is empty");
             }
         }
-        vad_model_ = std::make_shared<vad::VadModel>(
-            config_.vad_model_path, config_.vad_sampling_rate);
+        vad::VadModelOptions model_options;
+        model_options.intra_op_threads = config_.vad_ort_intra_op_threads;
+        model_options.inter_op_threads = config_.vad_ort_inter_op_threads;
+        model_options.allow_spinning = config_.vad_ort_spinning;
+        model_options.graph_optimization =
+            vad::parse_graph_optimization(config_.vad_ort_graph_optimization);
+        model_options.global_thread_pool = config_.vad_ort_global_threads;
+        model_options.optimized_cache_dir = config_.vad_ort_cache_dir;
+        const auto load_started = std::chrono::steady_clock::now();
+        auto model = std::make_shared<vad::VadModel>(
+            config_.vad_model_path, config_.vad_sampling_rate, model_options);
+        const size_t warm_up_batch =
+            config_.vad_batch_max > 1
+                ? std::min<size_t>(static_cast<size_t>(config_.vad_batch_max),
+                                   static_cast<size_t>(config_.audio_worker_threads))
+                : 1;
+        model->warm_up(warm_up_batch);
+        vad_model_ = std::move(model);
         logging::info(
             "VAD model loaded",
             {kv("path", config_.vad_model_path.string()),
-             kv("sampling_rate", config_.vad_sampling_rate)});
+             kv("sampling_rate", config_.vad_sampling_rate),
+             kv("precision", vad_model_->half_precision() ? "fp16" : "fp32"),
+             kv("from_cache", vad_model_->loaded_from_cache()),
+             kv("load_ms", static_cast<int>(std::chrono::duration<double, std::milli>(
+                               std::chrono::steady_clock::now() - load_started).count())),
+             kv("intra_op_threads", config_.vad_ort_intra_op_threads),
+             kv("inter_op_threads", config_.vad_ort_inter_op_threads),
+             kv("dsp", vad::simd_level_name(vad::active_simd_level()))});
+        if (config_.vad_batch_max > 1) {
+            // Windows only come from the audio shard threads, so a batch can
+            // never hold more than one window per shard.
+            const auto max_batch = std::min<size_t>(
+                static_cast<size_t>(config_.vad_batch_max),
+                static_cast<size_t>(config_.audio_worker_threads));
+            vad_batch_scheduler_ = std::make_shared<vad::VadBatchScheduler>(
+                vad_model_,
+                vad::VadBatchOptions{max_batch,
+                                     std::chrono::microseconds(config_.vad_batch_wait_us)});
+            logging::info(
+                "VAD batching enabled",
+                {kv("max_batch", max_batch),
+                 kv("max_wait_us", config_.vad_batch_wait_us)});
+        }
     } catch (const std::exception& ex) {
         logging::error(
             "VAD model load failed",
@@ -476,18 +1171,19 @@ void SipApp::init_vad() {
 }
 
 void SipApp::shutdown_pjsip() {
-    {
-        std::lock_guard<std::mutex> lock(calls_mutex_);
-        for (auto& entry : calls_) {
-            entry.second->stop_ws();
-        }
-        calls_.clear();
-        session_calls_.clear();
+    sip_jobs_.stop();
+    for (const auto& entry : calls_.clear()->calls) {
+        entry.second.call->stop_ws();
     }
     if (account_) {
         account_->shutdown();
         account_.reset();
     }
+    // Stopped while pjsua is still up; streams that outlive this are torn
+    // down by libDestroy and find their partition stopped.
+    if (media_partitions_) {
+        media_partitions_->shutdown();
+    }
     if (endpoint_) {
         endpoint_->libDestroy();
         endpoint_.reset();
@@ -4,50 +4,106 @@
 #include <atomic>
 #include <chrono>
 #include <filesystem>
-#include <fstream>
-#include <limits>
 #include <thread>
 
+#include "sip_gateway/audio/pcm_stream.hpp"
+#include "sip_gateway/audio/upload_encoder.hpp"
 #include "sip_gateway/logging.hpp"
 #include "sip_gateway/metrics.hpp"
 #include "sip_gateway/sip/app.hpp"
 #include "sip_gateway/utils/async.hpp"
 #include "sip_gateway/utils/text.hpp"
+#include "sip_gateway/utils/timer.hpp"
 
 namespace sip_gateway {
 
 SipCall::SipCall(SipApp& app, pj::Account& account, std::string backend_url, int call_id)
     : pj::Call(account, call_id),
       app_(app),
-      ws_client_(std::move(backend_url)) {
+      ws_client_(std::move(backend_url)),
+      sampling_rate_(app.config().vad_sampling_rate) {
     tts_pipeline_ = std::make_unique<TtsPipeline>(
         app_.config().tts_max_inflight,
         [this](const std::string& text,
-               const std::shared_ptr<std::atomic<bool>>& canceled) {
-            return synthesize_tts_text(text, canceled);
+               const std::shared_ptr<std::atomic<bool>>& canceled,
+               const TtsPipeline::PublishFn& publish) {
+            return synthesize_tts_text(text, canceled, publish);
         },
-        [this](const std::filesystem::path& path, const std::string& text) {
+        [this](const TtsPipeline::Audio& audio, const std::string& text) {
             logging::debug(
                 "TTS ready for playback",
                 {kv("text", text),
                  kv("session_id", session_id_.value_or(""))});
-            if (!player_) {
+            const auto player = this->player();
+            if (!player) {
                 return;
             }
-            player_->enqueue(path, true);
-            player_->play();
+            if (const auto* path = std::get_if<std::filesystem::path>(&audio)) {
+                player->enqueue(*path, true);
+            } else {
+                player->enqueue(std::get<std::shared_ptr<audio::PcmStream>>(audio));
+            }
+            player->play();
             if (vad_processor_) {
                 vad_processor_->reset_user_salience();
             }
         },
-        [this]() { try_play_tts(); });
+        [this]() { try_play_tts(); },
+        TtsChunkingOptions{app_.config().tts_clause_chunking,
+                           static_cast<size_t>(app_.config().tts_clause_min_chars),
+                           static_cast<size_t>(app_.config().tts_clause_max_chars)});
+    tts_pipeline_->set_scheduler(app_.tts_scheduler());
+    tts_pipeline_->set_max_queued_bytes(
+        static_cast<size_t>(app_.config().tts_max_queued_kb) * 1024);
+    if (app_.stt_streaming()) {
+        const auto& config = app_.config();
+        const auto rate = static_cast<size_t>(config.vad_sampling_rate);
+        stt_stream_ = std::make_unique<SttStream>(
+            [this](const nlohmann::json& payload) { ws_client_.send_json(payload); },
+            static_cast<unsigned>(config.vad_sampling_rate),
+            rate * static_cast<size_t>(config.stt_stream_chunk_ms) / 1000,
+            rate * static_cast<size_t>(config.vad_min_speech_duration_ms +
+                                       config.vad_speech_pad_ms) / 1000);
+    }
+}
+
+std::shared_ptr<SipCall> SipCall::create(SipApp& app,
+                                         pj::Account& account,
+                                         std::string backend_url,
+                                         int call_id) {
+    auto call = std::make_shared<SipCall>(app, account, std::move(backend_url), call_id);
+    call->tts_pipeline_->set_owner(call);
+    return call;
 }
 
 SipCall::~SipCall() {
     close_media();
+    // The stream may outlive the call object, which then hears nothing of
+    // its teardown.
+    if (media_partition_ && stream_slot_ >= 0) {
+        media_partition_->remove_stream(stream_slot_);
+        stream_slot_ = -1;
+    }
     stop_ws();
 }
 
+template <typename Fn>
+auto SipCall::traced_backend(const char* endpoint, Fn&& fn) const {
+    auto trace = call_trace();
+    if (!trace) {
+        return fn();
+    }
+    const auto start = std::chrono::steady_clock::now();
+    try {
+        auto result = fn();
+        trace->backend(endpoint, std::chrono::steady_clock::now() - start, true);
+        return result;
+    } catch (...) {
+        trace->backend(endpoint, std::chrono::steady_clock::now() - start, false);
+        throw;
+    }
+}
+
 void SipCall::set_session_id(const std::string& session_id) {
     session_id_ = session_id;
 }
@@ -68,9 +124,10 @@ void SipCall::answer(int status_code) {
     pj::Call::answer(prm);
 }
 
-void SipCall::hangup(int status_code) {
+void SipCall::hangup(int status_code, const pj::SipHeaderVector& headers) {
     pj::CallOpParam prm(true);
     prm.statusCode = static_cast<pjsip_status_code>(status_code);
+    prm.txOption.headers = headers;
     pj::Call::hangup(prm);
 }
 
@@ -100,9 +157,85 @@ void SipCall::set_greeting(std::optional<std::string> greeting) {
     greeting_ = std::move(greeting);
 }
 
+bool SipCall::prepare_greeting() {
+    // A configured delay is measured from media start, so keep that path.
+    if (!greeting_ || greeting_->empty() || app_.config().greeting_delay_sec > 0.0) {
+        return false;
+    }
+    if (greeting_queued_.exchange(true)) {
+        return false;
+    }
+    enqueue_tts_text(*greeting_, 0.0);
+    return true;
+}
+
+void SipCall::answer_when_greeting_ready(std::chrono::milliseconds timeout,
+                                         std::function<void(bool greeting_ready)> answer) {
+    {
+        std::lock_guard<std::mutex> lock(answer_mutex_);
+        pending_answer_ = std::move(answer);
+        answer_pending_ = true;
+    }
+    answer_timer_ = utils::timer_service().schedule(
+        timeout,
+        [this, self = weak_from_this()]() {
+            if (const auto call = self.lock()) {
+                run_pending_answer(false);
+            }
+        });
+    // The greeting may have finished before the answer was pending.
+    if (tts_pipeline_->wait_front_ready(std::chrono::milliseconds(0))) {
+        run_pending_answer(true);
+    }
+}
+
+void SipCall::run_pending_answer(bool greeting_ready) {
+    std::function<void(bool)> answer;
+    {
+        std::lock_guard<std::mutex> lock(answer_mutex_);
+        answer.swap(pending_answer_);
+        answer_pending_ = false;
+    }
+    if (!answer) {
+        return;
+    }
+    utils::timer_service().cancel(answer_timer_.exchange(utils::TimerService::kInvalidTimer));
+    // Answering waits for the SIP thread, which may be the caller.
+    utils::run_async([answer = std::move(answer), greeting_ready]() { answer(greeting_ready); });
+}
+
+bool SipCall::is_disconnected() const {
+    return disconnected_;
+}
+
+bool SipCall::run_unless_disconnected(const std::function<void()>& fn) {
+    std::lock_guard<std::mutex> lock(disconnect_mutex_);
+    if (disconnected_) {
+        return false;
+    }
+    fn();
+    return true;
+}
+
+SipCall::MemoryUsage SipCall::memory_usage() const {
+    MemoryUsage usage;
+    usage.vad = vad_memory_bytes_.load(std::memory_order_relaxed);
+    usage.segments = segment_pool_->shared_bytes() + segment_pool_->idle_bytes();
+    usage.uploads = upload_pool_->idle_bytes();
+    usage.tts = tts_pipeline_->queued_bytes();
+    return usage;
+}
+
 void SipCall::handle_ws_message(const nlohmann::json& message) {
+    if (auto trace = call_trace()) {
+        trace->ws_message(message.dump());
+    }
+    if (stt_stream_ && stt_stream_->handle_message(message)) {
+        return;
+    }
     const auto type = message.value("type", "");
     if (type == "message") {
+        mark_turn(TurnTrace::Stage::FirstMessage);
         if (!app_.config().is_streaming) {
             logging::debug(
                 "WebSocket message ignored (streaming disabled)",
@@ -159,7 +292,7 @@ void SipCall::handle_ws_message(const nlohmann::json& message) {
     }
     logging::debug(
         "WebSocket message received",
-        {kv("message", message.dump()),
+        {kv("message", message),
          kv("session_id", session_id_.value_or(""))});
 }
 
@@ -190,6 +323,10 @@ void SipCall::onCallState(pj::OnCallStateParam& prm) {
             open_media();
         }
         if (info.state == PJSIP_INV_STATE_DISCONNECTED) {
+            {
+                std::lock_guard<std::mutex> lock(disconnect_mutex_);
+                disconnected_ = true;
+            }
             close_media();
             std::optional<std::string> status = close_status_;
             if (!status) {
@@ -216,9 +353,10 @@ void SipCall::onCallState(pj::OnCallStateParam& prm) {
             }
             if (session_id_) {
                 const auto session_id = *session_id_;
-                utils::run_async([this, session_id, status]() {
+                // Runs after the call may be gone, e.g. during shutdown.
+                utils::run_async([&app = app_, session_id, status]() {
                     try {
-                        app_.close_session(session_id, status);
+                        app.close_session(session_id, status);
                     } catch (const std::exception& ex) {
                         logging::error(
                             "Backend close failed",
@@ -253,6 +391,48 @@ void SipCall::onCallMediaState(pj::OnCallMediaStateParam& prm) {
     }
 }
 
+void SipCall::onStreamCreated(pj::OnStreamCreatedParam& prm) {
+    auto* partitions = app_.media_partitions();
+    if (!partitions || !prm.pPort) {
+        return;
+    }
+    if (!media_partition_) {
+        // An 8 kHz stream goes to an 8 kHz partition when VAD_NARROWBAND
+        // made some, matching the rate media_sampling_rate() picks.
+        const auto* stream = static_cast<pjmedia_port*>(prm.pPort);
+        media_partition_ = &partitions->assign(PJMEDIA_PIA_SRATE(&stream->info));
+    }
+    try {
+        int slot = -1;
+        auto* placeholder = media_partition_->add_stream(
+            static_cast<pjmedia_port*>(prm.pPort), "stream/" + recording_basename(), slot);
+        prm.pPort = placeholder;
+        prm.destroyPort = true;
+        stream_slot_ = slot;
+    } catch (const std::exception& ex) {
+        // The call stays on the pjsua bridge.
+        logging::error("Failed to move call stream to media partition",
+                       {kv("error", ex.what()),
+                        kv("partition", media_partition_->index()),
+                        kv("session_id", session_id_.value_or(""))});
+        return;
+    }
+    logging::debug("Call stream on media partition",
+                   {kv("partition", media_partition_->index()),
+                    kv("session_id", session_id_.value_or(""))});
+    if (media_active_ && media_partitioned_) {
+        reconnect_partition_media();
+    }
+}
+
+void SipCall::onStreamDestroyed(pj::OnStreamDestroyedParam& prm) {
+    (void)prm;
+    if (media_partition_ && stream_slot_ >= 0) {
+        media_partition_->remove_stream(stream_slot_);
+        stream_slot_ = -1;
+    }
+}
+
 void SipCall::onCallTransferStatus(pj::OnCallTransferStatusParam& prm) {
     logging::info(
         "Transfer status",
@@ -268,6 +448,32 @@ void SipCall::onCallTransferStatus(pj::OnCallTransferStatusParam& prm) {
     }
 }
 
+int SipCall::media_sampling_rate() const {
+    const int configured = app_.config().vad_sampling_rate;
+    if (!app_.config().vad_narrowband || configured <= 8000) {
+        return configured;
+    }
+    try {
+        const auto info = getInfo();
+        for (const auto& media : info.media) {
+            if (media.type != PJMEDIA_TYPE_AUDIO || media.status != PJSUA_CALL_MEDIA_ACTIVE) {
+                continue;
+            }
+            const auto codec_rate = getStreamInfo(media.index).codecClockRate;
+            logging::debug("Call codec clock rate",
+                           {kv("clock_rate", codec_rate),
+                            kv("session_id", session_id_.value_or(""))});
+            return codec_rate > 0 && codec_rate <= 8000 ? 8000 : configured;
+        }
+    } catch (const pj::Error& ex) {
+        logging::warn(
+            "Call codec clock rate not available",
+            {kv("reason", ex.reason),
+             kv("session_id", session_id_.value_or(""))});
+    }
+    return configured;
+}
+
 void SipCall::open_media() {
     if (media_active_) {
         return;
@@ -285,57 +491,157 @@ void SipCall::open_media() {
 
     pj::MediaFormatAudio format;
     format.type = PJMEDIA_TYPE_AUDIO;
-    format.clockRate = app_.config().vad_sampling_rate;
+    // A reopened stream keeps the rate the VAD was built for.
+    if (!vad_processor_) {
+        sampling_rate_ = media_sampling_rate();
+        if (stt_stream_) {
+            stt_stream_->set_sample_rate(static_cast<unsigned>(sampling_rate_));
+        }
+    }
+    format.clockRate = static_cast<unsigned>(sampling_rate_);
     format.channelCount = 1;
     format.bitsPerSample = 16;
     format.frameTimeUsec = app_.config().frame_time_usec;
 
-    media_port_ = std::make_unique<audio::AudioMediaPort>();
-    media_port_->createPort("port/input/" + recording_basename(), format);
+    const auto frame_samples = static_cast<size_t>(
+        static_cast<uint64_t>(format.clockRate) * format.frameTimeUsec / 1000000);
+    media_partitioned_ = media_partition_ && stream_slot_ >= 0;
+    media_port_ = std::make_unique<audio::AudioMediaPort>(getId(), frame_samples,
+                                                          format.frameTimeUsec);
+    if (!media_partitioned_) {
+        media_port_->createPort("port/input/" + recording_basename(), format);
+    }
+    if (app_.config().call_trace) {
+        std::lock_guard<std::mutex> lock(call_trace_mutex_);
+        // A reopened stream appends to the call's trace.
+        if (!call_trace_) {
+            const auto path = app_.config().call_trace_dir / (recording_basename() + ".sgtrace");
+            try {
+                call_trace_ = std::make_shared<CallTraceWriter>(
+                    path, static_cast<uint32_t>(sampling_rate_));
+                logging::info("Call trace started",
+                              {kv("path", path.string()),
+                               kv("session_id", session_id_.value_or(""))});
+            } catch (const std::exception& ex) {
+                logging::error("Failed to start call trace",
+                               {kv("error", ex.what()),
+                                kv("path", path.string()),
+                                kv("session_id", session_id_.value_or(""))});
+            }
+        }
+    }
     media_port_->set_on_frame_received(
-        [this](const std::vector<int16_t>& data) { handle_audio_frame(data); });
+        [this](const int16_t* samples, size_t count) { handle_audio_frame(samples, count); });
 
-    try {
-        audio_media_->startTransmit(*media_port_);
-    } catch (const pj::Error& ex) {
-        logging::error("Failed to attach media port",
-                       {kv("reason", ex.reason),
-                        kv("status", ex.status),
-                        kv("session_id", session_id_.value_or(""))});
+    if (media_partitioned_) {
+        try {
+            rx_slot_ = media_partition_->add_port(*media_port_, format,
+                                                  "port/input/" + recording_basename());
+            media_partition_->connect(stream_slot_, rx_slot_);
+        } catch (const std::exception& ex) {
+            logging::error("Failed to attach media port",
+                           {kv("error", ex.what()),
+                            kv("partition", media_partition_->index()),
+                            kv("session_id", session_id_.value_or(""))});
+        }
+    } else {
+        try {
+            audio_media_->startTransmit(*media_port_);
+        } catch (const pj::Error& ex) {
+            logging::error("Failed to attach media port",
+                           {kv("reason", ex.reason),
+                            kv("status", ex.status),
+                            kv("session_id", session_id_.value_or(""))});
+        }
     }
 
     if (app_.config().record_audio_parts) {
+        const auto& config = app_.config();
         recorder_ = std::make_unique<audio::CallRecorder>();
-        const auto filename = app_.config().sip_audio_dir /
-                              (recording_basename() + ".wav");
+        const auto filename = config.sip_audio_dir / (recording_basename() + ".wav");
+        audio::RecorderOptions options;
+        options.format = audio::parse_recording_format(config.record_audio_format);
+        options.stereo = config.record_audio_stereo;
+        options.sample_rate = static_cast<unsigned>(sampling_rate_);
+        options.frame_time_usec = static_cast<unsigned>(config.frame_time_usec);
+        options.opus_bitrate = config.record_audio_opus_bitrate;
+        options.register_ports = !media_partitioned_;
         try {
-            recorder_->start_recording(filename);
-            if (auto* recorder_media = recorder_->get_recorder()) {
-                audio_media_->startTransmit(*recorder_media);
+            recorder_->start_recording(filename, options);
+            if (media_partitioned_) {
+                recorder_caller_slot_ = media_partition_->add_port(
+                    *recorder_->caller_input(), format, "port/record/" + recording_basename());
+                recorder_playback_slot_ = recorder_caller_slot_;
+                if (recorder_->playback_input() != recorder_->caller_input()) {
+                    recorder_playback_slot_ = media_partition_->add_port(
+                        *recorder_->playback_input(), format,
+                        "port/record-tx/" + recording_basename());
+                }
+                media_partition_->connect(stream_slot_, recorder_caller_slot_);
+            } else {
+                audio_media_->startTransmit(*recorder_->caller_input());
             }
         } catch (const std::exception& ex) {
             logging::error("Failed to start call recorder",
                            {kv("error", ex.what()),
                             kv("filename", filename.string()),
                             kv("session_id", session_id_.value_or(""))});
+            if (recorder_caller_slot_ >= 0) {
+                media_partition_->remove_port(recorder_caller_slot_);
+            }
+            if (recorder_playback_slot_ >= 0) {
+                media_partition_->remove_port(recorder_playback_slot_);
+            }
+            recorder_caller_slot_ = -1;
+            recorder_playback_slot_ = -1;
             recorder_.reset();
         }
     }
 
-    auto* recorder_media = recorder_ ? recorder_->get_recorder() : nullptr;
-    player_ = std::make_unique<audio::SmartPlayer>(
-        *audio_media_,
-        recorder_media,
-        [this, session_id = session_id_.value_or("")]() {
-            logging::debug("Audio playback finished",
-                           {kv("session_id", session_id)});
-            handle_playback_finished();
-        });
+    auto on_playback_finished = [this, self = weak_from_this(),
+                                 session_id = session_id_.value_or("")]() {
+        auto call = self.lock();
+        if (!call) {
+            return;
+        }
+        logging::debug("Audio playback finished",
+                       {kv("session_id", session_id)});
+        handle_playback_finished();
+    };
+    std::shared_ptr<audio::SmartPlayer> player;
+    if (media_partitioned_) {
+        player = std::make_shared<audio::SmartPlayer>(
+            audio::SmartPlayer::PartitionTarget{media_partition_, stream_slot_,
+                                                recorder_playback_slot_},
+            std::move(on_playback_finished),
+            static_cast<unsigned>(app_.config().frame_time_usec));
+    } else {
+        auto* recorder_media = recorder_ ? recorder_->playback_input() : nullptr;
+        player = std::make_shared<audio::SmartPlayer>(
+            *audio_media_,
+            recorder_media,
+            std::move(on_playback_finished),
+            static_cast<unsigned>(app_.config().frame_time_usec));
+    }
+    if (app_.config().turn_trace) {
+        // Runs later on the media lane, possibly after the call is gone.
+        player->set_on_first_frame(
+            [this, self = weak_from_this()](std::chrono::steady_clock::time_point at) {
+                if (auto call = self.lock()) {
+                    mark_turn(TurnTrace::Stage::FirstFramePlayed, at);
+                }
+            });
+    }
+    {
+        std::lock_guard<std::mutex> lock(player_mutex_);
+        player_ = std::move(player);
+    }
     if (!vad_processor_) {
         auto model = app_.vad_model();
         if (model) {
             vad_processor_ = std::make_unique<vad::StreamingVadProcessor>(
                 model,
+                sampling_rate_,
                 static_cast<float>(app_.config().vad_threshold),
                 app_.config().vad_min_speech_duration_ms,
                 app_.config().vad_min_silence_duration_ms,
@@ -343,58 +649,82 @@ void SipCall::open_media() {
                 app_.config().short_pause_offset_ms,
                 app_.config().long_pause_offset_ms,
                 app_.config().user_silence_timeout_ms,
+                app_.config().vad_max_utterance_ms,
                 app_.config().vad_speech_prob_window,
                 app_.config().vad_use_dynamic_corrections,
                 app_.config().vad_correction_debug,
                 app_.config().vad_correction_enter_thres,
                 app_.config().vad_correction_exit_thres);
+            vad_processor_->set_batch_scheduler(app_.vad_batch_scheduler());
+            vad_processor_->set_segment_pool(segment_pool_);
+            if (app_.config().vad_energy_gate) {
+                vad::EnergyGateConfig gate;
+                gate.floor_ratio = app_.config().vad_energy_gate_ratio;
+                gate.max_rms = app_.config().vad_energy_gate_max_rms;
+                gate.hold_windows = app_.config().vad_energy_gate_windows;
+                gate.reset_on_resume = app_.config().vad_energy_gate_reset;
+                vad_processor_->set_energy_gate(gate);
+            }
             vad_processor_->set_on_speech_start(
-                [this](const std::vector<float>& audio, double start, double duration) {
+                [this](const audio::AudioSegment& audio, double start, double duration) {
+                    trace_vad(CallTraceRecord::VadEvent::SpeechStart, start, duration);
                     on_vad_speech_start(audio, start, duration);
                 });
             vad_processor_->set_on_speech_end(
-                [this](const std::vector<float>& audio, double start, double duration) {
+                [this](const audio::AudioSegment& audio, double start, double duration) {
+                    trace_vad(CallTraceRecord::VadEvent::SpeechEnd, start, duration);
                     on_vad_speech_end(audio, start, duration);
                 });
             vad_processor_->set_on_short_pause(
-                [this](const std::vector<float>& audio, double start, double duration) {
+                [this](const audio::AudioSegment& audio, double start, double duration) {
+                    trace_vad(CallTraceRecord::VadEvent::ShortPause, start, duration);
                     on_vad_short_pause(audio, start, duration);
                 });
             vad_processor_->set_on_long_pause(
-                [this](const std::vector<float>& audio, double start, double duration) {
+                [this](const audio::AudioSegment& audio, double start, double duration) {
+                    trace_vad(CallTraceRecord::VadEvent::LongPause, start, duration);
                     on_vad_long_pause(audio, start, duration);
                 });
             vad_processor_->set_on_user_silence_timeout(
                 [this](double current_time) {
+                    trace_vad(CallTraceRecord::VadEvent::SilenceTimeout, current_time, 0.0);
                     on_vad_user_silence_timeout(current_time);
                 });
         }
     }
     media_active_ = true;
-    if (greeting_ && !greeting_->empty()) {
+    if (greeting_ && !greeting_->empty() && !greeting_queued_.exchange(true)) {
         enqueue_tts_text(*greeting_, app_.config().greeting_delay_sec);
     }
     try_play_tts();
 }
 
 void SipCall::close_media() {
+    cancel_timers();
+    if (stt_stream_) {
+        stt_stream_->cancel();
+    }
     if (!media_active_) {
         return;
     }
     cancel_tts_queue();
-    if (player_) {
-        player_->interrupt();
+    if (const auto player = this->player()) {
+        player->interrupt();
     }
-    if (audio_media_ && recorder_ && recorder_->get_recorder()) {
-        try {
-            audio_media_->stopTransmit(*recorder_->get_recorder());
-        } catch (const pj::Error&) {
+    if (media_partitioned_) {
+        detach_from_partition();
+    } else {
+        if (audio_media_ && recorder_ && recorder_->caller_input()) {
+            try {
+                audio_media_->stopTransmit(*recorder_->caller_input());
+            } catch (const pj::Error&) {
+            }
         }
-    }
-    if (audio_media_ && media_port_) {
-        try {
-            audio_media_->stopTransmit(*media_port_);
-        } catch (const pj::Error&) {
+        if (audio_media_ && media_port_) {
+            try {
+                audio_media_->stopTransmit(*media_port_);
+            } catch (const pj::Error&) {
+            }
         }
     }
     if (recorder_) {
@@ -403,26 +733,76 @@ void SipCall::close_media() {
     if (vad_processor_) {
         vad_processor_->finalize();
     }
-    player_.reset();
+    // Turns still in flight return their buffers on their own; those are
+    // freed with the call.
+    segment_pool_->release();
+    upload_pool_->release();
+    finish_turn_trace(false);
+    {
+        std::lock_guard<std::mutex> lock(player_mutex_);
+        player_.reset();
+    }
     recorder_.reset();
     media_port_.reset();
     audio_media_.reset();
+    media_partitioned_ = false;
     media_active_ = false;
 }
 
-void SipCall::handle_audio_frame(const std::vector<int16_t>& data) {
+void SipCall::reconnect_partition_media() {
+    try {
+        if (rx_slot_ >= 0) {
+            media_partition_->connect(stream_slot_, rx_slot_);
+        }
+        if (recorder_caller_slot_ >= 0) {
+            media_partition_->connect(stream_slot_, recorder_caller_slot_);
+        }
+    } catch (const std::exception& ex) {
+        logging::error("Failed to reconnect call media",
+                       {kv("error", ex.what()),
+                        kv("partition", media_partition_->index()),
+                        kv("session_id", session_id_.value_or(""))});
+    }
+    if (const auto player = this->player()) {
+        player->set_call_slot(stream_slot_);
+    }
+}
+
+void SipCall::detach_from_partition() {
+    if (!media_partition_) {
+        return;
+    }
+    // Once off the partition the ports get no more frames and may go.
+    for (auto* slot : {&rx_slot_, &recorder_caller_slot_, &recorder_playback_slot_}) {
+        if (*slot >= 0) {
+            media_partition_->remove_port(*slot);
+        }
+    }
+    rx_slot_ = -1;
+    recorder_caller_slot_ = -1;
+    recorder_playback_slot_ = -1;
+}
+
+void SipCall::handle_audio_frame(const int16_t* samples, size_t count) {
+    if (auto trace = call_trace()) {
+        trace->audio(samples, count);
+    }
     if (finished_) {
         return;
     }
     if (!app_.config().interruptions_are_allowed && is_active_ai_speech()) {
         return;
     }
+    if (stt_stream_) {
+        stt_stream_->push(samples, count);
+    }
     if (vad_processor_) {
-        vad_processor_->process_samples(data);
+        vad_processor_->process_samples(samples, count);
+        vad_memory_bytes_.store(vad_processor_->memory_bytes(), std::memory_order_relaxed);
     }
 }
 
-void SipCall::on_vad_speech_start(const std::vector<float>& audio,
+void SipCall::on_vad_speech_start(const audio::AudioSegment& audio,
                                   double start,
                                   double duration) {
     (void)audio;
@@ -433,8 +813,15 @@ void SipCall::on_vad_speech_start(const std::vector<float>& audio,
          kv("session_id", session_id_.value_or(""))});
 
     user_speaking_ = true;
-    if (player_) {
-        player_->interrupt();
+    finish_turn_trace(true);
+    // Silence the bot from the next frame; the player teardown, which takes
+    // the conference bridge lock, follows on the media lane.
+    const auto player = this->player();
+    if (player) {
+        player->mute();
+    }
+    if (stt_stream_) {
+        stt_stream_->begin();
     }
     cancel_tts_queue();
     if (vad_processor_) {
@@ -446,9 +833,19 @@ void SipCall::on_vad_speech_start(const std::vector<float>& audio,
         short_pause_handled_ = false;
         long_pause_handled_ = false;
         last_unstable_transcription_.clear();
+        short_pause_transcript_.reset();
     }
 
-    utils::run_async([this]() {
+    // Holds the player rather than the call: once close_media has
+    // interrupted it, a second interrupt finds nothing left to tear down.
+    if (player) {
+        utils::run_async([player]() { player->interrupt(); }, utils::TaskLane::Media);
+    }
+    utils::run_async([this, self = weak_from_this()]() {
+        const auto call = self.lock();
+        if (!call) {
+            return;
+        }
         bool allow_rollback = false;
         {
             std::lock_guard<std::mutex> lock(generation_mutex_);
@@ -468,7 +865,7 @@ void SipCall::on_vad_speech_start(const std::vector<float>& audio,
     });
 }
 
-void SipCall::on_vad_speech_end(const std::vector<float>& audio,
+void SipCall::on_vad_speech_end(const audio::AudioSegment& audio,
                                 double start,
                                 double duration) {
     (void)audio;
@@ -478,9 +875,14 @@ void SipCall::on_vad_speech_end(const std::vector<float>& audio,
          kv("duration_sec", duration),
          kv("session_id", session_id_.value_or(""))});
     user_speaking_ = false;
+    {
+        std::lock_guard<std::mutex> lock(generation_mutex_);
+        turn_end_of_speech_ = std::chrono::steady_clock::now();
+    }
+    begin_turn_trace();
 }
 
-void SipCall::on_vad_short_pause(const std::vector<float>& audio,
+void SipCall::on_vad_short_pause(const audio::AudioSegment& audio,
                                  double start,
                                  double duration) {
     if (duration < app_.config().min_speech_duration_sec) {
@@ -503,9 +905,15 @@ void SipCall::on_vad_short_pause(const std::vector<float>& audio,
         {kv("start_sec", start),
          kv("duration_sec", duration),
          kv("session_id", session_id_.value_or(""))});
+    mark_turn(TurnTrace::Stage::ShortPause);
 
-    auto audio_copy = audio;
-    utils::run_async([this, audio_copy = std::move(audio_copy)]() mutable {
+    std::optional<uint64_t> stt_request;
+    if (stt_stream_) {
+        stt_request = stt_stream_->request_transcript(false);
+    }
+    const auto pause = vad_processor_ ? vad_processor_->last_pause() : vad::PauseInfo{};
+    const auto deadline = turn_deadline();
+    utils::run_async([this, audio, stt_request, pause, deadline]() mutable {
         try {
             if (!media_active_.load()) {
                 logging::debug(
@@ -516,7 +924,19 @@ void SipCall::on_vad_short_pause(const std::vector<float>& audio,
                 return;
             }
             rollback_session();
-            const auto text = transcribe_audio(audio_copy);
+            auto transcript = std::make_shared<std::promise<std::string>>();
+            {
+                std::lock_guard<std::mutex> lock(generation_mutex_);
+                short_pause_transcript_ = PauseTranscript{pause, transcript->get_future().share()};
+            }
+            std::string text;
+            try {
+                text = transcribe_utterance(audio.samples(), stt_request, deadline);
+                transcript->set_value(text);
+            } catch (...) {
+                transcript->set_exception(std::current_exception());
+                throw;
+            }
             if (!text.empty()) {
                 if (is_same_unstable_text(text)) {
                     logging::debug(
@@ -534,7 +954,7 @@ void SipCall::on_vad_short_pause(const std::vector<float>& audio,
                     start_in_flight_ = false;
                     return;
                 }
-                start_session_text(text);
+                start_session_text(text, deadline);
                 std::lock_guard<std::mutex> lock(generation_mutex_);
                 spec_active_ = true;
                 short_pause_handled_ = true;
@@ -551,7 +971,7 @@ void SipCall::on_vad_short_pause(const std::vector<float>& audio,
     });
 }
 
-void SipCall::on_vad_long_pause(const std::vector<float>& audio,
+void SipCall::on_vad_long_pause(const audio::AudioSegment& audio,
                                 double start,
                                 double duration) {
     if (audio.empty()) {
@@ -560,6 +980,12 @@ void SipCall::on_vad_long_pause(const std::vector<float>& audio,
             {kv("session_id", session_id_.value_or(""))});
         return;
     }
+    // VAD ends the utterance here, so the stream is closed even when this
+    // pause is not handled.
+    std::optional<uint64_t> stt_request;
+    if (stt_stream_) {
+        stt_request = stt_stream_->request_transcript(true);
+    }
     {
         std::lock_guard<std::mutex> lock(generation_mutex_);
         if (commit_in_flight_ || long_pause_handled_) {
@@ -573,8 +999,9 @@ void SipCall::on_vad_long_pause(const std::vector<float>& audio,
          kv("duration_sec", duration),
          kv("session_id", session_id_.value_or(""))});
 
-    auto audio_copy = audio;
-    utils::run_async([this, audio_copy = std::move(audio_copy)]() mutable {
+    const auto pause = vad_processor_ ? vad_processor_->last_pause() : vad::PauseInfo{};
+    const auto deadline = turn_deadline();
+    utils::run_async([this, audio, stt_request, pause, deadline]() mutable {
         if (vad_processor_) {
             vad_processor_->set_long_pause_suspended(true);
         }
@@ -619,7 +1046,7 @@ void SipCall::on_vad_long_pause(const std::vector<float>& audio,
                 has_start = spec_active_;
             }
             if (!has_start) {
-                const auto text = transcribe_audio(audio_copy);
+                const auto text = transcribe_long_pause(audio.samples(), pause, stt_request, deadline);
                 if (text.empty()) {
                     std::lock_guard<std::mutex> lock(generation_mutex_);
                     commit_in_flight_ = false;
@@ -639,7 +1066,7 @@ void SipCall::on_vad_long_pause(const std::vector<float>& audio,
                     }
                     return;
                 }
-                start_session_text(text);
+                start_session_text(text, deadline);
                 std::lock_guard<std::mutex> lock(generation_mutex_);
                 spec_active_ = true;
                 short_pause_handled_ = true;
@@ -686,75 +1113,123 @@ void SipCall::on_vad_user_silence_timeout(double current_time) {
     handle_playback_finished();
 }
 
-std::string SipCall::encode_wav(const std::vector<float>& audio) const {
-    const uint16_t channels = 1;
-    const uint16_t bits_per_sample = 16;
-    const uint32_t sample_rate = static_cast<uint32_t>(app_.config().vad_sampling_rate);
-    const uint16_t block_align = channels * (bits_per_sample / 8);
-    const uint32_t byte_rate = sample_rate * block_align;
-    const uint32_t data_size = static_cast<uint32_t>(audio.size() * sizeof(int16_t));
-    const uint32_t chunk_size = 36 + data_size;
-
-    std::string result;
-    result.reserve(44 + data_size);
-    auto append = [&result](const void* data, size_t size) {
-        result.append(static_cast<const char*>(data), size);
-    };
-    auto append_u16 = [&append](uint16_t value) {
-        const uint8_t bytes[2] = {
-            static_cast<uint8_t>(value & 0xFF),
-            static_cast<uint8_t>((value >> 8) & 0xFF)
-        };
-        append(bytes, sizeof(bytes));
-    };
-    auto append_u32 = [&append](uint32_t value) {
-        const uint8_t bytes[4] = {
-            static_cast<uint8_t>(value & 0xFF),
-            static_cast<uint8_t>((value >> 8) & 0xFF),
-            static_cast<uint8_t>((value >> 16) & 0xFF),
-            static_cast<uint8_t>((value >> 24) & 0xFF)
-        };
-        append(bytes, sizeof(bytes));
-    };
-
-    append("RIFF", 4);
-    append_u32(chunk_size);
-    append("WAVE", 4);
-    append("fmt ", 4);
-    append_u32(16);
-    append_u16(1);
-    append_u16(channels);
-    append_u32(sample_rate);
-    append_u32(byte_rate);
-    append_u16(block_align);
-    append_u16(bits_per_sample);
-    append("data", 4);
-    append_u32(data_size);
-
-    for (float sample : audio) {
-        const float clamped = std::max(-1.0f, std::min(1.0f, sample));
-        const int16_t pcm = static_cast<int16_t>(
-            clamped * std::numeric_limits<int16_t>::max());
-        append(&pcm, sizeof(pcm));
+std::optional<std::chrono::steady_clock::time_point> SipCall::turn_deadline() {
+    const int budget_ms = app_.config().backend_turn_deadline_ms;
+    if (budget_ms <= 0) {
+        return std::nullopt;
     }
-
-    return result;
+    std::lock_guard<std::mutex> lock(generation_mutex_);
+    // A pause without a reported end of speech counts from now.
+    const auto end_of_speech = turn_end_of_speech_.value_or(std::chrono::steady_clock::now());
+    return end_of_speech + std::chrono::milliseconds(budget_ms);
 }
 
-std::string SipCall::transcribe_audio(const std::vector<float>& audio) const {
+std::string SipCall::transcribe_audio(
+    const std::vector<float>& audio,
+    const std::optional<std::chrono::steady_clock::time_point>& deadline) const {
     if (!session_id_) {
         return "";
     }
-    const auto wav_bytes = encode_wav(audio);
+    const auto& config = app_.config();
+    audio::UploadEncoderOptions options;
+    options.codec = audio::parse_upload_codec(config.stt_upload_codec);
+    options.opus_bitrate = config.stt_upload_opus_bitrate;
+    options.content_type = config.stt_upload_content_type;
+    const auto encode_start = std::chrono::steady_clock::now();
+    auto encoded = audio::encode_upload(
+        audio, static_cast<uint32_t>(sampling_rate_), options,
+        upload_pool_->take(44 + audio.size() * sizeof(int16_t)));
+    auto& metrics = Metrics::instance();
+    metrics.observe_response_time(
+        "stt_encode",
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - encode_start).count());
+    const char* codec = encoded.codec == audio::UploadCodec::Opus ? "opus" : "wav";
+    metrics.increment_counter("stt_upload_bytes_total", {{"codec", codec}},
+                              encoded.bytes.size());
+    const size_t wav_size = 44 + audio.size() * sizeof(int16_t);
+    if (encoded.bytes.size() < wav_size) {
+        metrics.increment_counter("stt_upload_bytes_saved_total", {},
+                                  wav_size - encoded.bytes.size());
+    }
     const auto start = std::chrono::steady_clock::now();
-    const auto text = app_.transcribe_audio(wav_bytes);
-    const auto elapsed = std::chrono::duration<double>(
-        std::chrono::steady_clock::now() - start).count();
+    mark_turn(TurnTrace::Stage::TranscribeSent, start);
+    std::string text;
+    try {
+        text = traced_backend("transcribe", [&]() {
+            return app_.transcribe_audio(encoded.bytes, encoded.content_type, deadline);
+        });
+    } catch (...) {
+        upload_pool_->give(std::move(encoded.bytes));
+        throw;
+    }
+    upload_pool_->give(std::move(encoded.bytes));
+    const auto end = std::chrono::steady_clock::now();
+    mark_turn(TurnTrace::Stage::TranscribeReceived, end);
+    const auto elapsed = std::chrono::duration<double>(end - start).count();
     Metrics::instance().observe_response_time("transcribe", elapsed);
     return text;
 }
 
-void SipCall::start_session_text(const std::string& text) {
+std::string SipCall::transcribe_utterance(
+    const std::vector<float>& audio,
+    std::optional<uint64_t> stt_request,
+    const std::optional<std::chrono::steady_clock::time_point>& deadline) const {
+    if (stt_stream_ && stt_request) {
+        const auto start = std::chrono::steady_clock::now();
+        auto text = stt_stream_->wait_transcript(
+            *stt_request, std::chrono::milliseconds(app_.config().stt_stream_timeout_ms));
+        if (text) {
+            // The audio went out as it was spoken; the request is the ask
+            // for the final transcript.
+            mark_turn(TurnTrace::Stage::TranscribeSent, start);
+            mark_turn(TurnTrace::Stage::TranscribeReceived);
+            Metrics::instance().observe_response_time(
+                "transcribe_stream",
+                std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            return *text;
+        }
+        Metrics::instance().increment_counter("stt_stream_fallback_total");
+        logging::warn(
+            "Streamed transcript missing, falling back to /transcribe",
+            {kv("session_id", session_id_.value_or(""))});
+    }
+    return transcribe_audio(audio, deadline);
+}
+
+std::string SipCall::transcribe_long_pause(
+    const std::vector<float>& audio,
+    const vad::PauseInfo& pause,
+    std::optional<uint64_t> stt_request,
+    const std::optional<std::chrono::steady_clock::time_point>& deadline) {
+    std::optional<std::shared_future<std::string>> previous;
+    {
+        std::lock_guard<std::mutex> lock(generation_mutex_);
+        if (short_pause_transcript_ && short_pause_transcript_->pause.same_speech(pause)) {
+            previous = short_pause_transcript_->text;
+        }
+    }
+    if (previous) {
+        try {
+            // May still be in flight; waiting is cheaper than a second upload.
+            auto text = previous->get();
+            Metrics::instance().increment_counter("transcriptions_reused_total");
+            logging::debug(
+                "Long pause reused short pause transcript",
+                {kv("session_id", session_id_.value_or(""))});
+            return text;
+        } catch (const std::exception& ex) {
+            logging::debug(
+                "Short pause transcript unusable",
+                {kv("error", ex.what()),
+                 kv("session_id", session_id_.value_or(""))});
+        }
+    }
+    return transcribe_utterance(audio, stt_request, deadline);
+}
+
+void SipCall::start_session_text(
+    const std::string& text,
+    const std::optional<std::chrono::steady_clock::time_point>& deadline) {
     if (!session_id_) {
         return;
     }
@@ -762,8 +1237,8 @@ void SipCall::start_session_text(const std::string& text) {
         return;
     }
     cancel_tts_queue();
-    if (player_) {
-        player_->interrupt();
+    if (const auto player = this->player()) {
+        player->interrupt();
     }
     {
         std::lock_guard<std::mutex> lock(generation_mutex_);
@@ -771,7 +1246,10 @@ void SipCall::start_session_text(const std::string& text) {
         start_reply_generation_ = std::chrono::steady_clock::now();
         start_response_generation_ = *start_reply_generation_;
     }
-    app_.start_session_text(*session_id_, text);
+    mark_turn(TurnTrace::Stage::StartSent);
+    traced_backend("start", [&]() {
+        return app_.start_session_text(*session_id_, text, deadline);
+    });
 }
 
 void SipCall::commit_session() {
@@ -779,11 +1257,13 @@ void SipCall::commit_session() {
         return;
     }
     try {
-        auto response = app_.commit_session(*session_id_);
+        auto response = traced_backend(
+            "commit", [&]() { return app_.commit_session(*session_id_); });
         if (!app_.config().is_streaming &&
             response.contains("response") && response["response"].is_string()) {
             const auto text = response["response"].get<std::string>();
             if (!text.empty()) {
+                mark_turn(TurnTrace::Stage::FirstMessage);
                 logging::debug(
                     "TTS queued from commit response",
                     {kv("text", text),
@@ -830,7 +1310,7 @@ void SipCall::rollback_session() {
     if (!session_id_ || !needs_rollback) {
         return;
     }
-    app_.rollback_session(*session_id_);
+    traced_backend("rollback", [&]() { return app_.rollback_session(*session_id_); });
 }
 
 void SipCall::handle_playback_finished() {
@@ -840,7 +1320,7 @@ void SipCall::handle_playback_finished() {
         }
         return;
     }
-    if (player_ && player_->is_active()) {
+    if (const auto player = this->player(); player && player->is_active()) {
         return;
     }
     if (has_tts_queue()) {
@@ -856,7 +1336,8 @@ bool SipCall::ai_can_speak() const {
 }
 
 bool SipCall::is_active_ai_speech() const {
-    const bool player_active = player_ && player_->is_active();
+    const auto player = this->player();
+    const bool player_active = player && player->is_active();
     const bool has_queued = has_tts_queue() && ai_can_speak();
     return player_active || has_queued || commit_in_flight_;
 }
@@ -874,23 +1355,31 @@ void SipCall::schedule_soft_hangup() {
         return;
     }
     soft_hangup_pending_ = true;
-    utils::run_async([this]() {
-        std::this_thread::sleep_for(std::chrono::milliseconds(300));
-        soft_hangup_pending_ = false;
-        if (!finished_) {
-            return;
-        }
-        if (player_ && player_->is_active()) {
-            return;
-        }
-        if (has_tts_queue()) {
-            return;
-        }
-        if (start_transfer()) {
-            return;
-        }
-        hangup(PJSIP_SC_OK);
-    });
+    soft_hangup_timer_ = utils::timer_service().schedule(
+        std::chrono::milliseconds(300),
+        [this, self = weak_from_this()]() {
+            const auto call = self.lock();
+            if (!call) {
+                return;
+            }
+            soft_hangup_timer_ = utils::TimerService::kInvalidTimer;
+            soft_hangup_pending_ = false;
+            if (!finished_) {
+                return;
+            }
+            if (const auto player = this->player(); player && player->is_active()) {
+                return;
+            }
+            if (has_tts_queue()) {
+                return;
+            }
+            app_.run_on_sip_thread([this]() {
+                if (start_transfer()) {
+                    return;
+                }
+                hangup(PJSIP_SC_OK);
+            });
+        });
 }
 
 bool SipCall::start_transfer() {
@@ -925,13 +1414,20 @@ bool SipCall::start_transfer() {
                      kv("session_id", session_id_.value_or(""))});
             }
         }
-        utils::run_async([this, delay_sec]() {
-            std::this_thread::sleep_for(std::chrono::duration<double>(delay_sec));
-            try {
-                hangup(PJSIP_SC_OK);
-            } catch (const pj::Error&) {
-            }
-        });
+        transfer_hangup_timer_ = utils::timer_service().schedule(
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(delay_sec)),
+            [this, self = weak_from_this()]() {
+                const auto call = self.lock();
+                if (!call) {
+                    return;
+                }
+                transfer_hangup_timer_ = utils::TimerService::kInvalidTimer;
+                try {
+                    app_.run_on_sip_thread([this]() { hangup(PJSIP_SC_OK); });
+                } catch (const pj::Error&) {
+                }
+            });
         return true;
     }
 
@@ -949,6 +1445,15 @@ bool SipCall::start_transfer() {
     return true;
 }
 
+void SipCall::cancel_timers() {
+    auto& timers = utils::timer_service();
+    if (timers.cancel(soft_hangup_timer_.exchange(utils::TimerService::kInvalidTimer))) {
+        soft_hangup_pending_ = false;
+    }
+    timers.cancel(transfer_hangup_timer_.exchange(utils::TimerService::kInvalidTimer));
+    timers.cancel(answer_timer_.exchange(utils::TimerService::kInvalidTimer));
+}
+
 void SipCall::cancel_tts_queue() {
     if (tts_pipeline_) {
         tts_pipeline_->cancel();
@@ -975,9 +1480,10 @@ void SipCall::enqueue_tts_text(const std::string& text, double delay_sec) {
     }
 }
 
-std::optional<std::filesystem::path> SipCall::synthesize_tts_text(
+std::optional<TtsPipeline::Audio> SipCall::synthesize_tts_text(
     const std::string& text,
-    const std::shared_ptr<std::atomic<bool>>& canceled) {
+    const std::shared_ptr<std::atomic<bool>>& canceled,
+    const TtsPipeline::PublishFn& publish) {
     if (!session_id_) {
         return std::nullopt;
     }
@@ -989,11 +1495,21 @@ std::optional<std::filesystem::path> SipCall::synthesize_tts_text(
         std::lock_guard<std::mutex> lock(generation_mutex_);
         response_start = start_response_generation_;
     }
+    if (app_.config().tts_streaming) {
+        return stream_tts_text(text, canceled, publish, response_start);
+    }
     try {
         const auto synth_start = std::chrono::steady_clock::now();
-        const auto blob = app_.synthesize_session_audio(*session_id_, text);
-        const auto synth_elapsed = std::chrono::duration<double>(
-            std::chrono::steady_clock::now() - synth_start).count();
+        mark_turn(TurnTrace::Stage::SynthesisStart, synth_start);
+        // Only the first clause of a response is on the caller's critical
+        // path; later clauses synthesize while earlier ones play.
+        const auto deadline = response_start ? turn_deadline() : std::nullopt;
+        const auto blob = traced_backend("synthesize", [&]() {
+            return app_.synthesize_session_audio(*session_id_, text, deadline);
+        });
+        const auto synth_end = std::chrono::steady_clock::now();
+        mark_turn(TurnTrace::Stage::SynthesisEnd, synth_end);
+        const auto synth_elapsed = std::chrono::duration<double>(synth_end - synth_start).count();
         if (response_start) {
             Metrics::instance().observe_response_time("synthesize", synth_elapsed);
         }
@@ -1007,25 +1523,18 @@ std::optional<std::filesystem::path> SipCall::synthesize_tts_text(
                  kv("session_id", session_id_.value_or(""))});
             return std::nullopt;
         }
-        if (response_start) {
-            const auto response_elapsed = std::chrono::duration<double>(
-                std::chrono::steady_clock::now() - *response_start).count();
-            Metrics::instance().observe_response_time("play_queue", response_elapsed);
-            Metrics::instance().observe_response_summary("play_queue", response_elapsed);
-            logging::debug(
-                "Response ready",
-                {kv("elapsed_sec", response_elapsed),
+        auto audio = std::make_shared<audio::PcmStream>(std::chrono::milliseconds(0));
+        audio->write(blob.data(), blob.size());
+        audio->finish();
+        if (audio->failed()) {
+            logging::error(
+                "TTS audio is not PCM16 mono WAV",
+                {kv("blob_size", static_cast<int>(blob.size())),
                  kv("session_id", session_id_.value_or(""))});
-            std::lock_guard<std::mutex> lock(generation_mutex_);
-            start_response_generation_.reset();
+            return std::nullopt;
         }
-        const auto filename = make_tts_path();
-        std::error_code ec;
-        std::filesystem::create_directories(filename.parent_path(), ec);
-        std::ofstream out(filename, std::ios::binary);
-        out.write(blob.data(), static_cast<std::streamsize>(blob.size()));
-        out.close();
-        return filename;
+        finish_response_generation(response_start);
+        return audio;
     } catch (const std::exception& ex) {
         logging::error(
             "TTS synthesize failed",
@@ -1035,11 +1544,110 @@ std::optional<std::filesystem::path> SipCall::synthesize_tts_text(
     }
 }
 
+std::optional<TtsPipeline::Audio> SipCall::stream_tts_text(
+    const std::string& text,
+    const std::shared_ptr<std::atomic<bool>>& canceled,
+    const TtsPipeline::PublishFn& publish,
+    const std::optional<std::chrono::steady_clock::time_point>& response_start) {
+    auto stream = std::make_shared<audio::PcmStream>(
+        std::chrono::milliseconds(app_.config().tts_prebuffer_ms));
+    const auto synth_start = std::chrono::steady_clock::now();
+    mark_turn(TurnTrace::Stage::SynthesisStart, synth_start);
+    // The download runs on this task and the stream goes to playback once
+    // prebuffered, so no worker ever waits for another to fill it.
+    bool published = false;
+    const auto publish_stream = [&]() {
+        published = true;
+        // A stream is playable once prebuffered, which ends synthesis for the
+        // turn's timeline.
+        mark_turn(TurnTrace::Stage::SynthesisEnd);
+        if (response_start) {
+            Metrics::instance().observe_response_time(
+                "synthesize_first_audio",
+                std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - synth_start).count());
+        }
+        finish_response_generation(response_start);
+        publish(stream);
+    };
+    try {
+        app_.stream_session_audio(*session_id_, text, [&](const char* data, size_t size) {
+            if ((canceled && canceled->load()) || stream->cancelled()) {
+                return false;
+            }
+            stream->write(data, size);
+            if (!published && stream->wait_ready(std::chrono::milliseconds(0))) {
+                publish_stream();
+            }
+            return !stream->failed();
+        });
+        stream->finish();
+    } catch (const std::exception& ex) {
+        logging::error(
+            "TTS stream failed",
+            {kv("error", ex.what()),
+             kv("session_id", session_id_.value_or(""))});
+        stream->fail(ex.what());
+    }
+    if (response_start) {
+        Metrics::instance().observe_response_time(
+            "synthesize",
+            std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - synth_start).count());
+    }
+    if (published) {
+        return stream;
+    }
+    if (canceled && canceled->load()) {
+        stream->cancel();
+        return std::nullopt;
+    }
+    if (!stream->wait_ready(std::chrono::milliseconds(0))) {
+        stream->cancel();
+        logging::error(
+            "TTS stream produced no audio",
+            {kv("failed", stream->failed()),
+             kv("session_id", session_id_.value_or(""))});
+        return std::nullopt;
+    }
+    // Same floor as the buffered path: 364 bytes of WAV is ~160 samples.
+    if (stream->total_samples() < 160) {
+        stream->cancel();
+        logging::info(
+            "TTS audio too short",
+            {kv("samples", static_cast<int>(stream->total_samples())),
+             kv("session_id", session_id_.value_or(""))});
+        return std::nullopt;
+    }
+    publish_stream();
+    return stream;
+}
+
+void SipCall::finish_response_generation(
+    const std::optional<std::chrono::steady_clock::time_point>& response_start) {
+    if (!response_start) {
+        return;
+    }
+    const auto response_elapsed = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - *response_start).count();
+    Metrics::instance().observe_response_time("play_queue", response_elapsed);
+    Metrics::instance().observe_response_summary("play_queue", response_elapsed);
+    logging::debug(
+        "Response ready",
+        {kv("elapsed_sec", response_elapsed),
+         kv("session_id", session_id_.value_or(""))});
+    std::lock_guard<std::mutex> lock(generation_mutex_);
+    start_response_generation_.reset();
+}
+
 void SipCall::try_play_tts() {
     if (!tts_pipeline_) {
         return;
     }
-    tts_pipeline_->try_play(media_active_ && player_);
+    if (answer_pending_ && tts_pipeline_->wait_front_ready(std::chrono::milliseconds(0))) {
+        run_pending_answer(true);
+    }
+    tts_pipeline_->try_play(media_active_ && player());
 }
 
 bool SipCall::has_tts_queue() const {
@@ -1078,17 +1686,6 @@ void SipCall::set_state(CallState state) {
          kv("session_id", session_id_.value_or(""))});
 }
 
-std::filesystem::path SipCall::make_tts_path() const {
-    static std::atomic<uint64_t> counter{0};
-    const auto stamp = std::chrono::duration_cast<std::chrono::microseconds>(
-                           std::chrono::steady_clock::now().time_since_epoch())
-                           .count();
-    const auto id = counter.fetch_add(1, std::memory_order_relaxed);
-    const auto prefix = session_id_.value_or("call");
-    return app_.config().tmp_audio_dir /
-           ("tts-" + prefix + "-" + std::to_string(stamp) + "-" + std::to_string(id) + ".wav");
-}
-
 std::string SipCall::recording_basename() const {
     if (session_id_) {
         return *session_id_;
@@ -1096,4 +1693,56 @@ std::string SipCall::recording_basename() const {
     return "call_" + std::to_string(getId());
 }
 
+void SipCall::begin_turn_trace() {
+    if (!app_.config().turn_trace) {
+        return;
+    }
+    finish_turn_trace(false);
+    std::lock_guard<std::mutex> lock(turn_trace_mutex_);
+    turn_trace_ = std::make_shared<TurnTrace>();
+}
+
+void SipCall::finish_turn_trace(bool barge_in) {
+    std::shared_ptr<TurnTrace> trace;
+    {
+        std::lock_guard<std::mutex> lock(turn_trace_mutex_);
+        trace.swap(turn_trace_);
+    }
+    if (!trace) {
+        return;
+    }
+    // Speech during the bot's reply; speech before it is a continuation.
+    if (barge_in && trace->has(TurnTrace::Stage::FirstFramePlayed)) {
+        trace->mark(TurnTrace::Stage::BargeIn);
+    }
+    trace->finish(session_id_.value_or(""),
+                  static_cast<double>(app_.config().turn_trace_slow_ms) / 1000.0);
+}
+
+void SipCall::mark_turn(TurnTrace::Stage stage, TurnTrace::Clock::time_point at) const {
+    std::lock_guard<std::mutex> lock(turn_trace_mutex_);
+    if (turn_trace_) {
+        turn_trace_->mark(stage, at);
+    }
+}
+
+std::shared_ptr<audio::SmartPlayer> SipCall::player() const {
+    std::lock_guard<std::mutex> lock(player_mutex_);
+    return player_;
+}
+
+std::shared_ptr<CallTraceWriter> SipCall::call_trace() const {
+    if (!app_.config().call_trace) {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(call_trace_mutex_);
+    return call_trace_;
+}
+
+void SipCall::trace_vad(CallTraceRecord::VadEvent event, double start, double duration) const {
+    if (auto trace = call_trace()) {
+        trace->vad(event, start, duration);
+    }
+}
+
 }
@@ -0,0 +1,230 @@
+#include "sip_gateway/sip/call_trace.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace sip_gateway {
+
+namespace {
+
+constexpr char kMagic[] = {'S', 'G', 'T', 'R', 'C', 1};
+constexpr size_t kFlushBytes = 64 * 1024;
+
+void put_varint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+uint64_t to_us(double seconds) {
+    return seconds > 0.0 ? static_cast<uint64_t>(std::llround(seconds * 1e6)) : 0;
+}
+
+uint64_t get_varint(std::ifstream& in) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        const int byte = in.get();
+        if (byte == std::char_traits<char>::eof()) {
+            throw std::runtime_error("Truncated call trace");
+        }
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+    throw std::runtime_error("Malformed call trace varint");
+}
+
+void get_bytes(std::ifstream& in, char* data, size_t size) {
+    if (!in.read(data, static_cast<std::streamsize>(size))) {
+        throw std::runtime_error("Truncated call trace");
+    }
+}
+
+}
+
+const char* CallTraceRecord::vad_event_name(VadEvent event) {
+    switch (event) {
+        case VadEvent::SpeechStart:
+            return "speech_start";
+        case VadEvent::SpeechEnd:
+            return "speech_end";
+        case VadEvent::ShortPause:
+            return "short_pause";
+        case VadEvent::LongPause:
+            return "long_pause";
+        case VadEvent::SilenceTimeout:
+            return "silence_timeout";
+    }
+    return "unknown";
+}
+
+CallTraceWriter::CallTraceWriter(std::filesystem::path path, uint32_t sample_rate)
+    : path_(std::move(path)), last_(Clock::now()) {
+    const auto parent_dir = path_.parent_path();
+    if (!parent_dir.empty()) {
+        std::filesystem::create_directories(parent_dir);
+    }
+    out_.open(path_, std::ios::binary | std::ios::trunc);
+    if (!out_) {
+        throw std::runtime_error("Cannot create call trace " + path_.string());
+    }
+    buffer_.reserve(kFlushBytes + 4096);
+    buffer_.append(kMagic, sizeof(kMagic));
+    for (int i = 0; i < 4; ++i) {
+        buffer_.push_back(static_cast<char>((sample_rate >> (8 * i)) & 0xFF));
+    }
+}
+
+CallTraceWriter::~CallTraceWriter() {
+    close();
+}
+
+const std::filesystem::path& CallTraceWriter::path() const {
+    return path_;
+}
+
+void CallTraceWriter::audio(const int16_t* samples, size_t count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_) {
+        return;
+    }
+    begin(CallTraceRecord::Kind::Audio);
+    put_varint(buffer_, count);
+    for (size_t i = 0; i < count; ++i) {
+        const auto value = static_cast<uint16_t>(samples[i]);
+        buffer_.push_back(static_cast<char>(value & 0xFF));
+        buffer_.push_back(static_cast<char>(value >> 8));
+    }
+    if (buffer_.size() >= kFlushBytes) {
+        flush_locked();
+    }
+}
+
+void CallTraceWriter::ws_message(const std::string& json) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_) {
+        return;
+    }
+    begin(CallTraceRecord::Kind::WsMessage);
+    put_varint(buffer_, json.size());
+    buffer_ += json;
+}
+
+void CallTraceWriter::backend(const std::string& endpoint, Clock::duration duration, bool ok) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_) {
+        return;
+    }
+    begin(CallTraceRecord::Kind::Backend);
+    put_varint(buffer_, endpoint.size());
+    buffer_ += endpoint;
+    put_varint(buffer_, static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(duration).count()));
+    buffer_.push_back(ok ? 1 : 0);
+}
+
+void CallTraceWriter::vad(CallTraceRecord::VadEvent event, double start_sec, double duration_sec) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_) {
+        return;
+    }
+    begin(CallTraceRecord::Kind::Vad);
+    buffer_.push_back(static_cast<char>(event));
+    put_varint(buffer_, to_us(start_sec));
+    put_varint(buffer_, to_us(duration_sec));
+}
+
+void CallTraceWriter::close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_) {
+        return;
+    }
+    closed_ = true;
+    flush_locked();
+    out_.close();
+}
+
+void CallTraceWriter::begin(CallTraceRecord::Kind kind) {
+    // Records from different threads may be stamped out of order by a few
+    // microseconds; the delta then clamps to zero.
+    const auto now = Clock::now();
+    const auto delta = std::chrono::duration_cast<std::chrono::microseconds>(now - last_).count();
+    if (delta > 0) {
+        last_ = now;
+    }
+    buffer_.push_back(static_cast<char>(kind));
+    put_varint(buffer_, delta > 0 ? static_cast<uint64_t>(delta) : 0);
+}
+
+void CallTraceWriter::flush_locked() {
+    out_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+    buffer_.clear();
+}
+
+CallTraceReader::CallTraceReader(const std::filesystem::path& path)
+    : in_(path, std::ios::binary) {
+    char header[sizeof(kMagic) + 4];
+    if (!in_ || !in_.read(header, sizeof(header)) ||
+        std::memcmp(header, kMagic, sizeof(kMagic)) != 0) {
+        throw std::runtime_error("Not a call trace: " + path.string());
+    }
+    for (int i = 0; i < 4; ++i) {
+        sample_rate_ |= static_cast<uint32_t>(static_cast<uint8_t>(header[sizeof(kMagic) + i]))
+                        << (8 * i);
+    }
+}
+
+uint32_t CallTraceReader::sample_rate() const {
+    return sample_rate_;
+}
+
+bool CallTraceReader::next(CallTraceRecord& record) {
+    const int kind = in_.get();
+    if (kind == std::char_traits<char>::eof()) {
+        return false;
+    }
+    wall_us_ += get_varint(in_);
+    record.kind = static_cast<CallTraceRecord::Kind>(kind);
+    record.wall_sec = static_cast<double>(wall_us_) / 1e6;
+    switch (record.kind) {
+        case CallTraceRecord::Kind::Audio: {
+            const auto count = get_varint(in_);
+            std::string bytes(count * 2, '\0');
+            get_bytes(in_, bytes.data(), bytes.size());
+            record.samples.resize(count);
+            for (size_t i = 0; i < count; ++i) {
+                record.samples[i] = static_cast<int16_t>(
+                    static_cast<uint8_t>(bytes[2 * i]) |
+                    static_cast<uint16_t>(static_cast<uint8_t>(bytes[2 * i + 1]) << 8));
+            }
+            return true;
+        }
+        case CallTraceRecord::Kind::WsMessage:
+        case CallTraceRecord::Kind::Backend: {
+            record.text.resize(get_varint(in_));
+            get_bytes(in_, record.text.data(), record.text.size());
+            if (record.kind == CallTraceRecord::Kind::Backend) {
+                record.duration_sec = static_cast<double>(get_varint(in_)) / 1e6;
+                char ok = 0;
+                get_bytes(in_, &ok, 1);
+                record.ok = ok != 0;
+            }
+            return true;
+        }
+        case CallTraceRecord::Kind::Vad: {
+            char event = 0;
+            get_bytes(in_, &event, 1);
+            record.vad = static_cast<CallTraceRecord::VadEvent>(event);
+            record.start_sec = static_cast<double>(get_varint(in_)) / 1e6;
+            record.duration_sec = static_cast<double>(get_varint(in_)) / 1e6;
+            return true;
+        }
+    }
+    throw std::runtime_error("Unknown call trace record " + std::to_string(kind));
+}
+
+}
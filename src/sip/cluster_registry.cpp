@@ -0,0 +1,96 @@
+#include "sip_gateway/sip/cluster_registry.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <iterator>
+#include <utility>
+
+#include "sip_gateway/logging.hpp"
+#include "sip_gateway/metrics.hpp"
+
+namespace sip_gateway {
+
+ClusterRegistry::ClusterRegistry(ClusterOptions options, LookupFn lookup)
+    : options_(std::move(options)),
+      lookup_(std::move(lookup)) {}
+
+const ClusterOptions& ClusterRegistry::options() const {
+    return options_;
+}
+
+nlohmann::json ClusterRegistry::node_record(const std::vector<std::string>& sessions,
+                                            const LoadReport& load) const {
+    return {
+        {"node_id", options_.node_id},
+        {"url", options_.advertise_url},
+        {"sessions", sessions},
+        {"calls", load.sample.live_calls},
+        {"load", load.score},
+        {"accepting", !load.over_budget()},
+        // Three missed heartbeats and the node is gone.
+        {"ttl_sec", options_.heartbeat.count() * 3},
+    };
+}
+
+std::optional<ClusterNode> ClusterRegistry::remote_owner(const std::string& session_id) {
+    const auto now = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const auto it = owners_.find(session_id);
+        if (it != owners_.end() && it->second.expires > now) {
+            return it->second.node;
+        }
+    }
+    std::optional<ClusterNode> owner;
+    try {
+        owner = lookup_(session_id);
+    } catch (const std::exception& ex) {
+        Metrics::instance().increment_counter("cluster_lookups_total", {{"result", "error"}});
+        logging::warn(
+            "Cluster session lookup failed",
+            {kv("session_id", session_id),
+             kv("error", ex.what())});
+        return std::nullopt;
+    }
+    if (!owner || owner->node_id == options_.node_id || owner->url.empty()) {
+        Metrics::instance().increment_counter("cluster_lookups_total", {{"result", "miss"}});
+        return std::nullopt;
+    }
+    auto url = owner->url;
+    while (!url.empty() && url.back() == '/') {
+        url.pop_back();
+    }
+    if (std::find(options_.peers.begin(), options_.peers.end(), url) == options_.peers.end()) {
+        Metrics::instance().increment_counter("cluster_lookups_total", {{"result", "untrusted"}});
+        logging::warn(
+            "Session owner is not a configured peer",
+            {kv("session_id", session_id),
+             kv("node_id", owner->node_id),
+             kv("url", owner->url)});
+        return std::nullopt;
+    }
+    Metrics::instance().increment_counter("cluster_lookups_total", {{"result", "remote"}});
+    std::lock_guard<std::mutex> lock(mutex_);
+    prune_locked(now);
+    owners_[session_id] = {*owner, now + options_.owner_cache_ttl};
+    return owner;
+}
+
+void ClusterRegistry::forget(const std::string& session_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    owners_.erase(session_id);
+}
+
+void ClusterRegistry::prune_locked(std::chrono::steady_clock::time_point now) {
+    if (owners_.size() < options_.max_cached_owners) {
+        return;
+    }
+    for (auto it = owners_.begin(); it != owners_.end();) {
+        it = it->second.expires <= now ? owners_.erase(it) : std::next(it);
+    }
+    if (owners_.size() >= options_.max_cached_owners) {
+        owners_.clear();
+    }
+}
+
+}
@@ -0,0 +1,267 @@
+#include "sip_gateway/sip/dial_queue.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+#include <utility>
+
+#include "sip_gateway/logging.hpp"
+#include "sip_gateway/metrics.hpp"
+
+namespace sip_gateway {
+
+const char* to_string(DialStatus status) {
+    switch (status) {
+        case DialStatus::Queued:
+            return "queued";
+        case DialStatus::Dialing:
+            return "dialing";
+        case DialStatus::Placed:
+            return "placed";
+        case DialStatus::Failed:
+            return "failed";
+    }
+    return "unknown";
+}
+
+nlohmann::json DialAttempt::to_json() const {
+    nlohmann::json payload{
+        {"request_id", id},
+        {"status", to_string(status)},
+        {"to_uri", request.is_object() ? request.value("to_uri", "") : ""},
+        {"session_id", nullptr},
+    };
+    if (session_id) {
+        payload["session_id"] = *session_id;
+    }
+    if (!error.empty()) {
+        payload["error"] = error;
+    }
+    if (started_at) {
+        payload["queue_wait_ms"] =
+            std::chrono::duration_cast<std::chrono::milliseconds>(*started_at - queued_at).count();
+    }
+    return payload;
+}
+
+DialQueue::DialQueue(DialQueueOptions options,
+                     DialFn dial,
+                     CapacityFn has_capacity,
+                     Executor executor,
+                     StatusFn on_status)
+    : options_(options),
+      dial_(std::move(dial)),
+      has_capacity_(std::move(has_capacity)),
+      executor_(std::move(executor)),
+      on_status_(std::move(on_status)),
+      thread_([this]() { dispatch_loop(); }) {}
+
+DialQueue::~DialQueue() {
+    stop();
+}
+
+std::optional<std::vector<std::string>> DialQueue::enqueue(
+    std::vector<nlohmann::json> requests) {
+    std::vector<std::string> ids;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_ || queue_.size() + requests.size() > options_.max_queued) {
+            return std::nullopt;
+        }
+        ids.reserve(requests.size());
+        const auto now = std::chrono::steady_clock::now();
+        for (auto& request : requests) {
+            DialAttempt attempt;
+            attempt.id = next_id_locked();
+            attempt.request = std::move(request);
+            attempt.queued_at = now;
+            queue_.push_back(attempt.id);
+            queue_report_locked(attempt);
+            ids.push_back(attempt.id);
+            attempts_.emplace(attempt.id, std::move(attempt));
+        }
+        publish_locked();
+    }
+    cv_.notify_all();
+    for (const auto& id : ids) {
+        report(id);
+    }
+    return ids;
+}
+
+std::optional<DialAttempt> DialQueue::find(const std::string& id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto it = attempts_.find(id);
+    if (it == attempts_.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+void DialQueue::notify() {
+    cv_.notify_all();
+}
+
+void DialQueue::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+size_t DialQueue::queued() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size();
+}
+
+size_t DialQueue::dialing() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dialing_;
+}
+
+void DialQueue::dispatch_loop() {
+    const auto interval =
+        options_.calls_per_second > 0.0
+            ? std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                  std::chrono::duration<double>(1.0 / options_.calls_per_second))
+            : std::chrono::steady_clock::duration::zero();
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+        if (queue_.empty() || dialing_ >= std::max<size_t>(1, options_.max_dialing)) {
+            cv_.wait(lock);
+            continue;
+        }
+        const auto now = std::chrono::steady_clock::now();
+        if (now < next_start_) {
+            cv_.wait_until(lock, next_start_);
+            continue;
+        }
+        // The check may take other locks (admission control), so it runs
+        // without this one; the front of the queue cannot change meanwhile
+        // because only this thread removes from it.
+        const size_t dialing = dialing_;
+        lock.unlock();
+        const bool admitted = !has_capacity_ || has_capacity_(dialing);
+        lock.lock();
+        if (stopping_) {
+            break;
+        }
+        if (!admitted) {
+            cv_.wait_for(lock, options_.capacity_poll);
+            continue;
+        }
+        const auto id = std::move(queue_.front());
+        queue_.pop_front();
+        auto& attempt = attempts_.at(id);
+        attempt.status = DialStatus::Dialing;
+        attempt.started_at = std::chrono::steady_clock::now();
+        ++dialing_;
+        next_start_ = *attempt.started_at + interval;
+        Metrics::instance().observe_response_time(
+            "dial_queue_wait",
+            std::chrono::duration<double>(*attempt.started_at - attempt.queued_at).count());
+        publish_locked();
+        queue_report_locked(attempt);
+        auto request = attempt.request;
+        lock.unlock();
+        report(id);
+        if (!executor_([this, id, request = std::move(request)]() { run(id, request); })) {
+            finish(id, std::nullopt, "worker pool rejected the attempt");
+        }
+        lock.lock();
+    }
+}
+
+void DialQueue::run(const std::string& id, const nlohmann::json& request) {
+    std::optional<std::string> session_id;
+    std::string error;
+    try {
+        session_id = dial_(request);
+    } catch (const std::exception& ex) {
+        error = ex.what();
+    } catch (...) {
+        error = "unknown error";
+    }
+    finish(id, session_id, error);
+}
+
+void DialQueue::finish(const std::string& id,
+                       const std::optional<std::string>& session_id,
+                       const std::string& error) {
+    DialAttempt finished;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& attempt = attempts_.at(id);
+        attempt.status = session_id ? DialStatus::Placed : DialStatus::Failed;
+        attempt.session_id = session_id;
+        attempt.error = error;
+        finished = attempt;
+        queue_report_locked(attempt);
+        --dialing_;
+        finished_.push_back(id);
+        while (finished_.size() > options_.history) {
+            attempts_.erase(finished_.front());
+            finished_.pop_front();
+        }
+        publish_locked();
+    }
+    cv_.notify_all();
+    Metrics::instance().increment_counter("dial_attempts_total",
+                                          {{"result", to_string(finished.status)}});
+    if (!session_id) {
+        logging::warn(
+            "Queued call attempt failed",
+            {kv("request_id", id),
+             kv("to_uri", finished.request.value("to_uri", "")),
+             kv("error", error)});
+    }
+    report(id);
+}
+
+std::string DialQueue::next_id_locked() {
+    while (true) {
+        char id[17];
+        std::snprintf(id, sizeof(id), "%016llx", static_cast<unsigned long long>(rng_()));
+        if (attempts_.find(id) == attempts_.end()) {
+            return id;
+        }
+    }
+}
+
+void DialQueue::queue_report_locked(const DialAttempt& attempt) {
+    if (on_status_) {
+        reports_[attempt.id].attempts.push_back(attempt);
+    }
+}
+
+void DialQueue::report(const std::string& id) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    const auto it = reports_.find(id);
+    if (it == reports_.end() || it->second.reporting) {
+        return;
+    }
+    // Elements keep their address across rehashing, and only this caller
+    // erases the entry while reporting is set.
+    auto& pending = it->second;
+    pending.reporting = true;
+    while (!pending.attempts.empty()) {
+        const auto attempt = std::move(pending.attempts.front());
+        pending.attempts.pop_front();
+        lock.unlock();
+        on_status_(attempt);
+        lock.lock();
+    }
+    reports_.erase(id);
+}
+
+void DialQueue::publish_locked() const {
+    auto& metrics = Metrics::instance();
+    metrics.set_gauge("dial_queue_depth", static_cast<double>(queue_.size()));
+    metrics.set_gauge("dial_queue_dialing", static_cast<double>(dialing_));
+}
+
+}
@@ -0,0 +1,171 @@
+#include "sip_gateway/sip/job_queue.hpp"
+
+#include <exception>
+
+#include "sip_gateway/logging.hpp"
+#include "sip_gateway/utils/async.hpp"
+
+namespace sip_gateway {
+
+namespace {
+
+thread_local bool running_job = false;
+
+}
+
+SipJobQueue::~SipJobQueue() {
+    stop();
+}
+
+bool SipJobQueue::start() {
+    if (active_) {
+        return true;
+    }
+    auto* ioqueue = pjsip_endpt_get_ioqueue(pjsua_get_pjsip_endpt());
+    if (!ioqueue) {
+        logging::error("SIP job queue: ioqueue unavailable");
+        return false;
+    }
+    pj_status_t status = pj_sock_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0, &sock_);
+    if (status != PJ_SUCCESS) {
+        logging::error("SIP job queue: socket failed", {kv("status", status)});
+        return false;
+    }
+    char loopback[] = "127.0.0.1";
+    const pj_str_t host = pj_str(loopback);
+    pj_sockaddr_in_init(&addr_, &host, 0);
+    int addr_len = sizeof(addr_);
+    status = pj_sock_bind(sock_, &addr_, addr_len);
+    if (status == PJ_SUCCESS) {
+        status = pj_sock_getsockname(sock_, &addr_, &addr_len);
+    }
+    if (status != PJ_SUCCESS) {
+        logging::error("SIP job queue: bind failed", {kv("status", status)});
+        pj_sock_close(sock_);
+        sock_ = PJ_INVALID_SOCKET;
+        return false;
+    }
+
+    pj_ioqueue_callback callback{};
+    callback.on_read_complete = &SipJobQueue::on_read_complete;
+    pool_ = pjsua_pool_create("sipgw_jobs", 512, 512);
+    status = pj_ioqueue_register_sock(pool_, ioqueue, sock_, this, &callback, &key_);
+    if (status != PJ_SUCCESS) {
+        logging::error("SIP job queue: ioqueue register failed", {kv("status", status)});
+        pj_sock_close(sock_);
+        sock_ = PJ_INVALID_SOCKET;
+        pj_pool_release(pool_);
+        pool_ = nullptr;
+        return false;
+    }
+    pj_ioqueue_op_key_init(&read_op_, sizeof(read_op_));
+    active_ = true;
+    arm_read();
+    logging::info("SIP job queue started");
+    return true;
+}
+
+void SipJobQueue::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!active_) {
+            return;
+        }
+        active_ = false;
+    }
+    if (key_) {
+        // Unregistering also closes the socket.
+        pj_ioqueue_unregister(key_);
+        key_ = nullptr;
+        sock_ = PJ_INVALID_SOCKET;
+    }
+    if (pool_) {
+        pj_pool_release(pool_);
+        pool_ = nullptr;
+    }
+    run_pending();
+}
+
+bool SipJobQueue::active() const {
+    return active_;
+}
+
+bool SipJobQueue::post(Job job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!active_) {
+            return false;
+        }
+        jobs_.push_back(std::move(job));
+    }
+    if (!signalled_.exchange(true)) {
+        wake();
+    }
+    return true;
+}
+
+size_t SipJobQueue::run_pending() {
+    signalled_ = false;
+    std::vector<Job> jobs;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs.swap(jobs_);
+    }
+    running_job = true;
+    for (auto& job : jobs) {
+        try {
+            job();
+        } catch (const std::exception& ex) {
+            logging::error("SIP job failed", {kv("error", ex.what())});
+        } catch (...) {
+            logging::error("SIP job failed");
+        }
+    }
+    running_job = false;
+    return jobs.size();
+}
+
+bool SipJobQueue::in_job() {
+    return running_job;
+}
+
+void SipJobQueue::on_read_complete(pj_ioqueue_key_t* key,
+                                   pj_ioqueue_op_key_t* op_key,
+                                   pj_ssize_t bytes_read) {
+    (void)op_key;
+    (void)bytes_read;
+    auto* self = static_cast<SipJobQueue*>(pj_ioqueue_get_user_data(key));
+    if (!self || !self->active_) {
+        return;
+    }
+    self->run_pending();
+    self->arm_read();
+}
+
+void SipJobQueue::arm_read() {
+    while (active_) {
+        pj_ssize_t size = sizeof(read_buf_);
+        const auto status = pj_ioqueue_recv(key_, &read_op_, read_buf_, &size, 0);
+        if (status == PJ_EPENDING) {
+            return;
+        }
+        if (status != PJ_SUCCESS) {
+            logging::error("SIP job queue: recv failed", {kv("status", status)});
+            return;
+        }
+        // Completed synchronously, so no callback will fire for this read.
+        run_pending();
+    }
+}
+
+void SipJobQueue::wake() {
+    utils::ensure_pj_thread_registered("sipgw_post");
+    const char byte = 1;
+    pj_ssize_t size = 1;
+    const auto status = pj_sock_sendto(sock_, &byte, &size, 0, &addr_, sizeof(addr_));
+    if (status != PJ_SUCCESS) {
+        logging::warn("SIP job queue: wakeup failed", {kv("status", status)});
+    }
+}
+
+}
@@ -2,43 +2,142 @@
 
 #include <algorithm>
 #include <chrono>
-#include <thread>
 #include <vector>
 
+#include "sip_gateway/audio/pcm_stream.hpp"
+#include "sip_gateway/metrics.hpp"
+#include "sip_gateway/sip/tts_scheduler.hpp"
 #include "sip_gateway/utils/async.hpp"
+#include "sip_gateway/utils/text.hpp"
+#include "sip_gateway/utils/timer.hpp"
 
 namespace sip_gateway {
 
+namespace {
+
+bool has_audio(const TtsPipeline::Audio& audio) {
+    if (const auto* path = std::get_if<std::filesystem::path>(&audio)) {
+        return !path->empty();
+    }
+    const auto& stream = std::get<std::shared_ptr<audio::PcmStream>>(audio);
+    return stream && !stream->cancelled();
+}
+
+}
+
 TtsPipeline::TtsPipeline(int max_inflight,
                          SynthFn synth_fn,
                          ReadyFn ready_fn,
-                         ReadySignalFn ready_signal_fn)
+                         ReadySignalFn ready_signal_fn,
+                         TtsChunkingOptions chunking)
     : max_inflight_(max_inflight),
+      chunking_(chunking),
       synth_fn_(std::move(synth_fn)),
       ready_fn_(std::move(ready_fn)),
       ready_signal_fn_(std::move(ready_signal_fn)) {}
 
+TtsPipeline::~TtsPipeline() {
+    cancel_delayed();
+}
+
+bool TtsPipeline::OwnerRef::lock(std::shared_ptr<void>& hold) const {
+    if (!owned) {
+        return true;
+    }
+    hold = owner.lock();
+    return hold != nullptr;
+}
+
+void TtsPipeline::set_owner(std::weak_ptr<void> owner) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    owner_ = OwnerRef{std::move(owner), true};
+}
+
+void TtsPipeline::set_scheduler(std::shared_ptr<TtsScheduler> scheduler) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    scheduler_ = std::move(scheduler);
+}
+
+void TtsPipeline::set_max_queued_bytes(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_queued_bytes_ = bytes;
+}
+
 void TtsPipeline::enqueue(const std::string& text, double delay_sec) {
     if (delay_sec > 0.0) {
-        utils::run_async([this, text, delay_sec]() {
-            std::this_thread::sleep_for(std::chrono::duration<double>(delay_sec));
-            enqueue(text, 0.0);
-        });
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Written under the lock before the callback can read it.
+        auto timer_id = std::make_shared<utils::TimerService::TimerId>();
+        const auto id = utils::timer_service().schedule(
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(delay_sec)),
+            [this, text, timer_id, owner = owner_]() {
+                std::shared_ptr<void> hold;
+                if (!owner.lock(hold)) {
+                    return;
+                }
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    delayed_.erase(std::remove(delayed_.begin(), delayed_.end(), *timer_id),
+                                   delayed_.end());
+                }
+                enqueue(text, 0.0);
+            });
+        *timer_id = id;
+        delayed_.push_back(id);
         return;
     }
 
-    auto canceled = std::make_shared<std::atomic<bool>>(false);
-    auto task_ptr = std::make_shared<
-        std::packaged_task<std::optional<std::filesystem::path>()>>(
-        [this, text, canceled]() -> std::optional<std::filesystem::path> {
-            return synth_fn_(text, canceled);
-        });
-    auto future = task_ptr->get_future().share();
-
+    std::vector<std::string> chunks;
+    if (chunking_.enabled) {
+        chunks = utils::split_clauses(text, chunking_.min_chars, chunking_.max_chars);
+    }
+    if (chunks.empty()) {
+        chunks.push_back(text);
+    }
+    const auto now = std::chrono::steady_clock::now();
     {
         std::lock_guard<std::mutex> lock(mutex_);
-        queue_.push_back({text, future, canceled});
-        pending_.push_back({text, task_ptr, canceled});
+        // A turn starts when nothing is left to play.
+        const bool new_turn = queue_.empty();
+        for (size_t i = 0; i < chunks.size(); ++i) {
+            auto canceled = std::make_shared<std::atomic<bool>>(false);
+            auto promise = std::make_shared<std::promise<std::optional<Audio>>>();
+            auto future = promise->get_future().share();
+            // Set once: by publish while synthesis runs, or by its result.
+            auto settled = std::make_shared<std::atomic<bool>>(false);
+            auto run = [this, chunk = chunks[i], canceled, promise, settled]() {
+                const PublishFn publish = [this, promise, settled](const Audio& audio) {
+                    if (settled->exchange(true)) {
+                        return;
+                    }
+                    promise->set_value(audio);
+                    if (ready_signal_fn_) {
+                        ready_signal_fn_();
+                    }
+                };
+                try {
+                    auto audio = synth_fn_(chunk, canceled, publish);
+                    if (!settled->exchange(true)) {
+                        promise->set_value(std::move(audio));
+                    }
+                } catch (...) {
+                    if (!settled->exchange(true)) {
+                        promise->set_exception(std::current_exception());
+                    }
+                }
+            };
+            auto fail = [promise, settled]() {
+                if (!settled->exchange(true)) {
+                    promise->set_value(std::nullopt);
+                }
+            };
+            const bool turn_first = new_turn && i == 0;
+            queue_.push_back({chunks[i], future, canceled,
+                              turn_first ? std::make_optional(now) : std::nullopt});
+            pending_.push_back({chunks[i], std::move(run), std::move(fail), future, canceled,
+                                turn_first});
+        }
     }
 
     maybe_start_synthesis();
@@ -48,6 +147,7 @@ void TtsPipeline::enqueue(const std::string& text, double delay_sec) {
 }
 
 void TtsPipeline::cancel() {
+    cancel_delayed();
     std::lock_guard<std::mutex> lock(mutex_);
     for (auto& task : queue_) {
         if (task.canceled) {
@@ -63,57 +163,129 @@ void TtsPipeline::cancel() {
     pending_.clear();
 }
 
+void TtsPipeline::cancel_delayed() {
+    std::vector<utils::TimerService::TimerId> delayed;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        delayed.swap(delayed_);
+    }
+    for (const auto id : delayed) {
+        utils::timer_service().cancel(id);
+    }
+}
+
 bool TtsPipeline::has_queue() const {
     std::lock_guard<std::mutex> lock(mutex_);
     return !queue_.empty();
 }
 
+bool TtsPipeline::wait_front_ready(std::chrono::milliseconds timeout) const {
+    std::shared_future<std::optional<Audio>> future;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (queue_.empty()) {
+            return false;
+        }
+        future = queue_.front().future;
+    }
+    return future.wait_for(timeout) == std::future_status::ready;
+}
+
+size_t TtsPipeline::queued_bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queued_bytes_locked();
+}
+
+size_t TtsPipeline::queued_bytes_locked() const {
+    size_t bytes = 0;
+    for (const auto& task : queue_) {
+        if (task.future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            continue;
+        }
+        try {
+            const auto& audio = task.future.get();
+            if (!audio) {
+                continue;
+            }
+            if (const auto* stream = std::get_if<std::shared_ptr<audio::PcmStream>>(&*audio);
+                stream && *stream) {
+                bytes += (*stream)->total_samples() * sizeof(int16_t);
+            }
+        } catch (...) {
+        }
+    }
+    return bytes;
+}
+
 void TtsPipeline::try_play(bool can_play) {
     if (!can_play) {
         return;
     }
+    bool played = false;
+    bool budgeted = false;
     while (true) {
         TtsTask task;
         {
             std::lock_guard<std::mutex> lock(mutex_);
+            budgeted = max_queued_bytes_ > 0;
             if (queue_.empty()) {
-                return;
+                break;
             }
             auto& front = queue_.front();
             if (front.future.wait_for(std::chrono::seconds(0)) !=
                 std::future_status::ready) {
-                return;
+                break;
             }
             task = front;
             queue_.pop_front();
+            played = true;
         }
 
         if (task.canceled && task.canceled->load()) {
             continue;
         }
 
-        std::optional<std::filesystem::path> audio_path;
+        std::optional<Audio> audio;
         try {
-            audio_path = task.future.get();
+            audio = task.future.get();
         } catch (...) {
             continue;
         }
-        if (!audio_path || audio_path->empty()) {
+        if (!audio || !has_audio(*audio)) {
             continue;
         }
+        if (task.turn_start) {
+            Metrics::instance().observe_response_time(
+                "tts_first_audio",
+                std::chrono::duration<double>(std::chrono::steady_clock::now() - *task.turn_start)
+                    .count());
+        }
         if (ready_fn_) {
-            ready_fn_(*audio_path, task.text);
+            ready_fn_(*audio, task.text);
         }
     }
+    // Handing audio to the player may bring the queue back under budget.
+    if (played && budgeted) {
+        maybe_start_synthesis();
+    }
 }
 
 void TtsPipeline::maybe_start_synthesis() {
     std::vector<PendingTtsTask> to_start;
+    std::shared_ptr<TtsScheduler> scheduler;
+    OwnerRef owner;
     {
         std::lock_guard<std::mutex> lock(mutex_);
+        scheduler = scheduler_;
+        owner = owner_;
         const auto max_inflight = static_cast<size_t>(
             std::max(1, max_inflight_));
-        while (inflight_ < max_inflight && !pending_.empty()) {
+        // The first chunk of a turn may exceed the caps: the slots can still
+        // be held by syntheses cancelled by the barge-in that began it.
+        while (!pending_.empty() &&
+               (pending_.front().turn_first ||
+                (inflight_ < max_inflight &&
+                 (max_queued_bytes_ == 0 || queued_bytes_locked() < max_queued_bytes_)))) {
             PendingTtsTask task = std::move(pending_.front());
             pending_.pop_front();
             if (task.canceled && task.canceled->load()) {
@@ -125,10 +297,56 @@ void TtsPipeline::maybe_start_synthesis() {
     }
 
     for (auto& task : to_start) {
-        utils::run_async([this, task_ptr = task.task]() {
-            (*task_ptr)();
+        // A task may start after the call has ended; it then does nothing.
+        // A dropped task fails its chunk like a synthesis error, so the
+        // front of the queue still settles.
+        const auto rejected = [this, fail = task.fail, owner]() {
+            std::shared_ptr<void> hold;
+            if (!owner.lock(hold)) {
+                return;
+            }
+            fail();
             on_synthesis_finished();
-        });
+        };
+        if (!scheduler) {
+            if (!utils::run_async([this, run = std::move(task.run), owner]() {
+                    std::shared_ptr<void> hold;
+                    if (!owner.lock(hold)) {
+                        return;
+                    }
+                    run();
+                    on_synthesis_finished();
+                })) {
+                rejected();
+            }
+            continue;
+        }
+        scheduler->submit(
+            task.turn_first ? TtsScheduler::Priority::TurnFirst
+                            : TtsScheduler::Priority::Later,
+            [this, task = std::move(task), owner]() {
+                std::shared_ptr<void> hold;
+                if (!owner.lock(hold)) {
+                    return TtsScheduler::Outcome::Cancelled;
+                }
+                auto outcome = TtsScheduler::Outcome::Cancelled;
+                // A barge-in may have cancelled it while it was queued.
+                if (!task.canceled->load()) {
+                    task.run();
+                    try {
+                        outcome = task.future.get() ? TtsScheduler::Outcome::Done
+                                                    : TtsScheduler::Outcome::Failed;
+                    } catch (...) {
+                        outcome = TtsScheduler::Outcome::Failed;
+                    }
+                    if (task.canceled->load()) {
+                        outcome = TtsScheduler::Outcome::Cancelled;
+                    }
+                }
+                on_synthesis_finished();
+                return outcome;
+            },
+            rejected);
     }
 }
 
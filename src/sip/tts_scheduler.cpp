@@ -0,0 +1,171 @@
+#include "sip_gateway/sip/tts_scheduler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <vector>
+
+#include "sip_gateway/metrics.hpp"
+
+namespace sip_gateway {
+
+namespace {
+
+constexpr double kBaselineDrift = 0.02;
+
+}
+
+AdaptiveLimit::AdaptiveLimit(AdaptiveLimitOptions options) : options_(options) {
+    options_.min_limit = std::max<size_t>(1, options_.min_limit);
+    options_.max_limit = std::max(options_.min_limit, options_.max_limit);
+    limit_ = static_cast<double>(
+        std::clamp(options_.initial_limit, options_.min_limit, options_.max_limit));
+}
+
+size_t AdaptiveLimit::limit() const {
+    return static_cast<size_t>(limit_);
+}
+
+double AdaptiveLimit::baseline() const {
+    return baseline_;
+}
+
+void AdaptiveLimit::on_sample(double seconds, bool saturated) {
+    if (baseline_ <= 0.0 || seconds < baseline_) {
+        baseline_ = seconds;
+    } else {
+        baseline_ += kBaselineDrift * (seconds - baseline_);
+    }
+    if (cooldown_ > 0) {
+        --cooldown_;
+    } else if (seconds > options_.tolerance * baseline_) {
+        decrease();
+        return;
+    }
+    if (!saturated) {
+        return;
+    }
+    if (++on_time_ >= limit()) {
+        on_time_ = 0;
+        limit_ = std::min(static_cast<double>(options_.max_limit), limit_ + 1.0);
+    }
+}
+
+void AdaptiveLimit::on_failure() {
+    if (cooldown_ > 0) {
+        --cooldown_;
+        return;
+    }
+    decrease();
+}
+
+void AdaptiveLimit::decrease() {
+    limit_ = std::max(static_cast<double>(options_.min_limit),
+                      std::floor(limit_ * options_.backoff));
+    on_time_ = 0;
+    cooldown_ = limit();
+}
+
+TtsScheduler::TtsScheduler(AdaptiveLimitOptions options, Executor executor)
+    : executor_(std::move(executor)), limit_(options) {}
+
+void TtsScheduler::submit(Priority priority, Task task, std::function<void()> rejected) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queues_[static_cast<size_t>(priority)].push_back(
+            Entry{std::move(task), std::move(rejected)});
+    }
+    dispatch();
+}
+
+size_t TtsScheduler::limit() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return limit_.limit();
+}
+
+size_t TtsScheduler::inflight() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return inflight_;
+}
+
+size_t TtsScheduler::queue_depth() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queues_[0].size() + queues_[1].size();
+}
+
+void TtsScheduler::dispatch() {
+    std::vector<std::pair<Entry, bool>> to_start;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& queue : queues_) {
+            while (!queue.empty() && inflight_ < limit_.limit()) {
+                ++inflight_;
+                to_start.emplace_back(std::move(queue.front()), inflight_ >= limit_.limit());
+                queue.pop_front();
+            }
+        }
+        publish_locked();
+    }
+    bool released = false;
+    for (auto& [entry, saturated] : to_start) {
+        const bool started = executor_(
+            [this, task = std::move(entry.task), saturated = saturated]() {
+                const auto started = std::chrono::steady_clock::now();
+                Outcome outcome = Outcome::Failed;
+                try {
+                    outcome = task();
+                } catch (...) {
+                }
+                finish(outcome,
+                       std::chrono::duration<double>(std::chrono::steady_clock::now() - started)
+                           .count(),
+                       saturated);
+            });
+        if (started) {
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (inflight_ > 0) {
+                --inflight_;
+            }
+            publish_locked();
+        }
+        released = true;
+        if (entry.rejected) {
+            entry.rejected();
+        }
+    }
+    // Every rejected task left the queue, so this ends.
+    if (released) {
+        dispatch();
+    }
+}
+
+void TtsScheduler::finish(Outcome outcome, double seconds, bool saturated) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (inflight_ > 0) {
+            --inflight_;
+        }
+        // A cancelled request says nothing about the backend.
+        if (outcome == Outcome::Done) {
+            limit_.on_sample(seconds, saturated);
+        } else if (outcome == Outcome::Failed) {
+            limit_.on_failure();
+        }
+    }
+    dispatch();
+}
+
+void TtsScheduler::publish_locked() const {
+    auto& metrics = Metrics::instance();
+    metrics.set_gauge("tts_scheduler_limit", static_cast<double>(limit_.limit()));
+    metrics.set_gauge("tts_scheduler_inflight", static_cast<double>(inflight_));
+    metrics.set_gauge("tts_scheduler_queue_depth", static_cast<double>(queues_[0].size()),
+                      {{"priority", "turn_first"}});
+    metrics.set_gauge("tts_scheduler_queue_depth", static_cast<double>(queues_[1].size()),
+                      {{"priority", "later"}});
+}
+
+}
@@ -0,0 +1,104 @@
+#include "sip_gateway/sip/turn_trace.hpp"
+
+#include <cmath>
+
+#include "sip_gateway/logging.hpp"
+#include "sip_gateway/metrics.hpp"
+
+namespace sip_gateway {
+
+TurnTrace::TurnTrace(Clock::time_point speech_end) : origin_(speech_end) {
+    for (auto& offset : offsets_ns_) {
+        offset.store(kUnset, std::memory_order_relaxed);
+    }
+    offsets_ns_[static_cast<size_t>(Stage::SpeechEnd)].store(0, std::memory_order_relaxed);
+}
+
+void TurnTrace::mark(Stage stage, Clock::time_point at) {
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(at - origin_).count();
+    int64_t expected = kUnset;
+    offsets_ns_[static_cast<size_t>(stage)].compare_exchange_strong(
+        expected, static_cast<int64_t>(ns), std::memory_order_relaxed);
+}
+
+bool TurnTrace::has(Stage stage) const {
+    return offsets_ns_[static_cast<size_t>(stage)].load(std::memory_order_relaxed) != kUnset;
+}
+
+std::optional<double> TurnTrace::offset(Stage stage) const {
+    const auto ns = offsets_ns_[static_cast<size_t>(stage)].load(std::memory_order_relaxed);
+    if (ns == kUnset) {
+        return std::nullopt;
+    }
+    return static_cast<double>(ns) / 1e9;
+}
+
+std::string TurnTrace::summary() const {
+    std::string out;
+    for (size_t i = 1; i < kStageCount; ++i) {
+        const auto stage = static_cast<Stage>(i);
+        const auto seconds = offset(stage);
+        if (!seconds) {
+            continue;
+        }
+        if (!out.empty()) {
+            out += ' ';
+        }
+        out += stage_name(stage);
+        out += '=';
+        out += std::to_string(static_cast<int64_t>(std::llround(*seconds * 1000.0)));
+    }
+    return out;
+}
+
+bool TurnTrace::finish(const std::string& session_id, double slow_threshold_sec) {
+    if (finished_.exchange(true)) {
+        return false;
+    }
+    auto& metrics = Metrics::instance();
+    for (size_t i = 1; i < kStageCount; ++i) {
+        const auto stage = static_cast<Stage>(i);
+        if (const auto seconds = offset(stage)) {
+            metrics.observe_response_time(std::string("turn_") + stage_name(stage), *seconds);
+        }
+    }
+    const auto first_frame = offset(Stage::FirstFramePlayed);
+    if (slow_threshold_sec <= 0.0 || !first_frame || *first_frame <= slow_threshold_sec) {
+        return false;
+    }
+    metrics.increment_counter("turn_slow_total");
+    logging::info(
+        "Slow turn",
+        {kv("first_frame_ms", std::llround(*first_frame * 1000.0)),
+         kv("stages", summary()),
+         kv("session_id", session_id)});
+    return true;
+}
+
+const char* TurnTrace::stage_name(Stage stage) {
+    switch (stage) {
+        case Stage::SpeechEnd:
+            return "speech_end";
+        case Stage::ShortPause:
+            return "short_pause";
+        case Stage::TranscribeSent:
+            return "transcribe_sent";
+        case Stage::TranscribeReceived:
+            return "transcribe_received";
+        case Stage::StartSent:
+            return "start_sent";
+        case Stage::FirstMessage:
+            return "first_message";
+        case Stage::SynthesisStart:
+            return "synthesis_start";
+        case Stage::SynthesisEnd:
+            return "synthesis_end";
+        case Stage::FirstFramePlayed:
+            return "first_frame_played";
+        case Stage::BargeIn:
+            return "barge_in";
+    }
+    return "unknown";
+}
+
+}
@@ -1,7 +1,6 @@
 #include "sip_gateway/utils/async.hpp"
 
 #include <pj/os.h>
-#include <thread>
 
 
 namespace sip_gateway::utils {
@@ -15,12 +14,13 @@ void ensure_pj_thread_registered(const char* name) {
     pj_thread_register(name ? name : "sipgw", desc, &thread);
 }
 
-void run_async(std::function<void()> task) {
-    std::thread worker([task = std::move(task)]() mutable {
-        ensure_pj_thread_registered("sipgw_async");
-        task();
-    });
-    worker.detach();
+bool run_async(std::function<void()> task, TaskLane lane) {
+    // PJSIP-registered threads (SIP and media callbacks, REST handlers, the
+    // audio shards) may hold PJSIP locks, so they never wait for queue space.
+    if (pj_thread_is_registered()) {
+        return worker_pool().post(std::move(task), lane);
+    }
+    return worker_pool().submit(std::move(task), lane);
 }
 
 }
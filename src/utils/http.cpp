@@ -186,6 +186,37 @@ bool download_file(const std::string& url, const std::filesystem::path& path) {
     return false;
 }
 
+std::optional<HttpResponse> post_json(
+    const std::string& url,
+    const std::string& body,
+    std::chrono::seconds timeout,
+    const std::vector<std::pair<std::string, std::string>>& headers,
+    bool verify_certificate,
+    const std::string& ca_file) {
+    std::string scheme;
+    std::string host;
+    std::string path;
+    int port = 0;
+    parse_url(url, scheme, host, port, path);
+    if (host.empty() || (verify_certificate && scheme != "https")) {
+        return std::nullopt;
+    }
+    httplib::Client client(build_url(scheme, host, port, ""));
+    client.enable_server_certificate_verification(verify_certificate);
+    if (verify_certificate && !ca_file.empty()) {
+        client.set_ca_cert_path(ca_file);
+    }
+    client.set_connection_timeout(static_cast<time_t>(timeout.count()));
+    client.set_read_timeout(static_cast<time_t>(timeout.count()));
+    client.set_write_timeout(static_cast<time_t>(timeout.count()));
+    httplib::Headers request_headers(headers.begin(), headers.end());
+    const auto response = client.Post(path, request_headers, body, "application/json");
+    if (!response) {
+        return std::nullopt;
+    }
+    return HttpResponse{response->status, response->body};
+}
+
 std::string url_encode(const std::string& value) {
     std::ostringstream escaped;
     escaped << std::hex << std::uppercase;
@@ -1,7 +1,9 @@
 #include "sip_gateway/utils/text.hpp"
 
+#include <algorithm>
 #include <cstdint>
 #include <cctype>
+#include <utility>
 
 namespace sip_gateway::utils {
 
@@ -64,6 +66,90 @@ bool decode_utf8(const std::string& text, size_t index, uint32_t& codepoint, siz
     return false;
 }
 
+bool is_space(char ch) {
+    return std::isspace(static_cast<unsigned char>(ch)) != 0;
+}
+
+bool is_closer(char ch) {
+    return ch == '"' || ch == '\'' || ch == ')' || ch == ']';
+}
+
+bool is_abbreviation(const std::string& text, size_t dot) {
+    static const char* const kAbbreviations[] = {
+        "mr", "mrs", "ms", "dr", "prof", "sr", "jr", "st", "mt", "vs", "etc", "e.g", "i.e",
+        "no", "nos", "approx", "dept", "fig", "inc", "ltd", "co", "ave", "a.m", "p.m", "u.s"};
+    size_t begin = dot;
+    while (begin > 0 && !is_space(text[begin - 1]) && text[begin - 1] != '(' &&
+           text[begin - 1] != '"') {
+        --begin;
+    }
+    std::string word;
+    for (size_t i = begin; i < dot; ++i) {
+        word.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(text[i]))));
+    }
+    if (word.size() == 1) {
+        return std::isalpha(static_cast<unsigned char>(word[0])) != 0;
+    }
+    return std::find(std::begin(kAbbreviations), std::end(kAbbreviations), word) !=
+           std::end(kAbbreviations);
+}
+
+struct ClauseBoundary {
+    size_t end;
+    bool sentence;
+};
+
+std::vector<ClauseBoundary> find_boundaries(const std::string& text) {
+    std::vector<ClauseBoundary> boundaries;
+    const size_t n = text.size();
+    for (size_t i = 0; i < n; ++i) {
+        const char ch = text[i];
+        const bool ellipsis = text.compare(i, 3, "\xE2\x80\xA6") == 0;
+        const bool sentence = ch == '.' || ch == '!' || ch == '?' || ellipsis;
+        if (!sentence && ch != ',' && ch != ';' && ch != ':') {
+            continue;
+        }
+        size_t end = i + (ellipsis ? 3 : 1);
+        while (end < n && (text[end] == '.' || text[end] == '!' || text[end] == '?')) {
+            ++end;
+        }
+        while (end < n && is_closer(text[end])) {
+            ++end;
+        }
+        if (end < n && !is_space(text[end])) {
+            i = end - 1;
+            continue;
+        }
+        if (sentence) {
+            size_t next = end;
+            while (next < n && is_space(text[next])) {
+                ++next;
+            }
+            // "e.g. apples": a sentence does not go on in lower case.
+            const bool lower_next =
+                next < n && std::islower(static_cast<unsigned char>(text[next])) != 0;
+            const bool single_dot = ch == '.' && end == i + 1;
+            if (lower_next || (single_dot && is_abbreviation(text, i))) {
+                i = end - 1;
+                continue;
+            }
+        }
+        boundaries.push_back({end, sentence});
+        i = end - 1;
+    }
+    return boundaries;
+}
+
+size_t trimmed_size(const std::string& text, size_t begin, size_t end) {
+    while (begin < end && is_space(text[begin])) {
+        ++begin;
+    }
+    while (end > begin && is_space(text[end - 1])) {
+        --end;
+    }
+    return end - begin;
+}
+
 }
 
 std::string remove_emojis(const std::string& text) {
@@ -109,4 +195,90 @@ std::string normalize_text(const std::string& text) {
     return normalized;
 }
 
+std::string base64_encode(const void* data, size_t size) {
+    static constexpr char kAlphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    std::string encoded;
+    encoded.reserve(((size + 2) / 3) * 4);
+    size_t i = 0;
+    for (; i + 2 < size; i += 3) {
+        const uint32_t triple = (static_cast<uint32_t>(bytes[i]) << 16) |
+                                (static_cast<uint32_t>(bytes[i + 1]) << 8) | bytes[i + 2];
+        encoded.push_back(kAlphabet[(triple >> 18) & 0x3F]);
+        encoded.push_back(kAlphabet[(triple >> 12) & 0x3F]);
+        encoded.push_back(kAlphabet[(triple >> 6) & 0x3F]);
+        encoded.push_back(kAlphabet[triple & 0x3F]);
+    }
+    if (i < size) {
+        uint32_t triple = static_cast<uint32_t>(bytes[i]) << 16;
+        if (i + 1 < size) {
+            triple |= static_cast<uint32_t>(bytes[i + 1]) << 8;
+        }
+        encoded.push_back(kAlphabet[(triple >> 18) & 0x3F]);
+        encoded.push_back(kAlphabet[(triple >> 12) & 0x3F]);
+        encoded.push_back(i + 1 < size ? kAlphabet[(triple >> 6) & 0x3F] : '=');
+        encoded.push_back('=');
+    }
+    return encoded;
+}
+
+std::vector<std::string> split_clauses(const std::string& text,
+                                       size_t min_chars,
+                                       size_t max_chars) {
+    const auto boundaries = find_boundaries(text);
+    std::vector<std::pair<size_t, size_t>> sentences;
+    size_t start = 0;
+    for (const auto& boundary : boundaries) {
+        if (boundary.sentence && trimmed_size(text, start, boundary.end) >= min_chars) {
+            sentences.emplace_back(start, boundary.end);
+            start = boundary.end;
+        }
+    }
+    if (trimmed_size(text, start, text.size()) > 0) {
+        if (!sentences.empty() && trimmed_size(text, start, text.size()) < min_chars) {
+            sentences.back().second = text.size();
+        } else {
+            sentences.emplace_back(start, text.size());
+        }
+    }
+
+    std::vector<std::string> chunks;
+    auto emit = [&text, &chunks](size_t begin, size_t end) {
+        while (begin < end && is_space(text[begin])) {
+            ++begin;
+        }
+        while (end > begin && is_space(text[end - 1])) {
+            --end;
+        }
+        if (end > begin) {
+            chunks.push_back(text.substr(begin, end - begin));
+        }
+    };
+    for (auto [begin, end] : sentences) {
+        while (max_chars > 0 && end - begin > max_chars) {
+            const size_t lo = begin + min_chars;
+            const size_t hi = begin + max_chars;
+            size_t cut = 0;
+            for (const auto& boundary : boundaries) {
+                if (boundary.end > lo && boundary.end <= hi) {
+                    cut = boundary.end;
+                }
+            }
+            for (size_t i = hi; cut == 0 && i > lo; --i) {
+                if (is_space(text[i])) {
+                    cut = i;
+                }
+            }
+            if (cut == 0) {
+                break;
+            }
+            emit(begin, cut);
+            begin = cut;
+        }
+        emit(begin, end);
+    }
+    return chunks;
+}
+
 }
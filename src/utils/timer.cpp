@@ -0,0 +1,135 @@
+#include "sip_gateway/utils/timer.hpp"
+
+#include "sip_gateway/logging.hpp"
+#include "sip_gateway/metrics.hpp"
+
+namespace sip_gateway::utils {
+
+TimerService::TimerService()
+    : thread_([this]() { run_loop(); }) {}
+
+TimerService::~TimerService() {
+    shutdown();
+}
+
+TimerService::TimerId TimerService::schedule(
+    std::chrono::steady_clock::duration delay,
+    Task task,
+    TaskLane lane) {
+    if (!task) {
+        return kInvalidTimer;
+    }
+    TimerId id = kInvalidTimer;
+    size_t pending = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) {
+            return kInvalidTimer;
+        }
+        id = next_id_++;
+        entries_.emplace(id, Entry{std::move(task), lane});
+        heap_.push({std::chrono::steady_clock::now() + delay, id});
+        pending = entries_.size();
+    }
+    cv_.notify_one();
+    Metrics::instance().set_gauge("timer_service_pending",
+                                  static_cast<double>(pending));
+    return id;
+}
+
+bool TimerService::cancel(TimerId id) {
+    if (id == kInvalidTimer) {
+        return false;
+    }
+    size_t pending = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // The heap slot is skipped lazily once it expires.
+        if (entries_.erase(id) == 0) {
+            return false;
+        }
+        pending = entries_.size();
+    }
+    Metrics::instance().set_gauge("timer_service_pending",
+                                  static_cast<double>(pending));
+    return true;
+}
+
+void TimerService::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_ && !thread_.joinable()) {
+            return;
+        }
+        stopping_ = true;
+        entries_.clear();
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+size_t TimerService::pending() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+void TimerService::run_loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+        if (heap_.empty()) {
+            cv_.wait(lock);
+            continue;
+        }
+        const auto next = heap_.top();
+        if (entries_.find(next.id) == entries_.end()) {
+            heap_.pop();
+            continue;
+        }
+        if (std::chrono::steady_clock::now() < next.at) {
+            cv_.wait_until(lock, next.at);
+            continue;
+        }
+        heap_.pop();
+        const auto lane = entries_.at(next.id).lane;
+        lock.unlock();
+        // The entry stays registered until a worker picks it up, so cancel()
+        // still wins while the callback is waiting in the pool queue.
+        const bool queued = worker_pool().post([this, id = next.id]() { fire(id); }, lane);
+        lock.lock();
+        if (!queued) {
+            entries_.erase(next.id);
+            logging::warn("Timer callback dropped", {kv("timer_id", next.id)});
+        }
+    }
+}
+
+void TimerService::fire(TimerId id) {
+    Task task;
+    size_t pending = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(id);
+        if (it == entries_.end()) {
+            return;
+        }
+        task = std::move(it->second.task);
+        entries_.erase(it);
+        pending = entries_.size();
+    }
+    Metrics::instance().set_gauge("timer_service_pending",
+                                  static_cast<double>(pending));
+    task();
+}
+
+TimerService& timer_service() {
+    static TimerService instance;
+    return instance;
+}
+
+void shutdown_timer_service() {
+    timer_service().shutdown();
+}
+
+}
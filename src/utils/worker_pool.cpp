@@ -0,0 +1,248 @@
+#include "sip_gateway/utils/worker_pool.hpp"
+
+#include <algorithm>
+#include <memory>
+
+#include "sip_gateway/logging.hpp"
+#include "sip_gateway/metrics.hpp"
+#include "sip_gateway/utils/async.hpp"
+
+namespace sip_gateway::utils {
+
+namespace {
+
+thread_local bool in_worker_pool = false;
+
+const char* lane_name(TaskLane lane) {
+    return lane == TaskLane::Media ? "media" : "backend";
+}
+
+// Every task reports both, so the series are resolved once.
+Metrics::Histogram& wait_histogram(TaskLane lane) {
+    static auto& media = Metrics::instance().named_histogram(
+        "worker_pool_queue_wait_seconds", {{"lane", "media"}});
+    static auto& backend = Metrics::instance().named_histogram(
+        "worker_pool_queue_wait_seconds", {{"lane", "backend"}});
+    return lane == TaskLane::Media ? media : backend;
+}
+
+Metrics::Gauge& depth_gauge(TaskLane lane) {
+    static auto& media =
+        Metrics::instance().gauge("worker_pool_queue_depth", {{"lane", "media"}});
+    static auto& backend =
+        Metrics::instance().gauge("worker_pool_queue_depth", {{"lane", "backend"}});
+    return lane == TaskLane::Media ? media : backend;
+}
+
+Metrics::Gauge& busy_gauge(TaskLane lane) {
+    static auto& media = Metrics::instance().gauge("worker_pool_busy", {{"lane", "media"}});
+    static auto& backend =
+        Metrics::instance().gauge("worker_pool_busy", {{"lane", "backend"}});
+    return lane == TaskLane::Media ? media : backend;
+}
+
+std::mutex pool_mutex;
+std::unique_ptr<WorkerPool> pool_instance;
+
+}
+
+WorkerPool::WorkerPool(WorkerPoolOptions options)
+    : options_(options) {
+    options_.threads = std::max<size_t>(1, options_.threads);
+    options_.queue_capacity = std::max<size_t>(1, options_.queue_capacity);
+    workers_.reserve(options_.threads + options_.media_threads);
+    for (size_t i = 0; i < options_.media_threads; ++i) {
+        workers_.emplace_back([this]() { worker_loop(true); });
+    }
+    for (size_t i = 0; i < options_.threads; ++i) {
+        workers_.emplace_back([this]() { worker_loop(false); });
+    }
+    auto& metrics = Metrics::instance();
+    metrics.set_gauge("worker_pool_threads", static_cast<double>(options_.media_threads),
+                      {{"lane", "media"}});
+    metrics.set_gauge("worker_pool_threads", static_cast<double>(options_.threads),
+                      {{"lane", "backend"}});
+}
+
+WorkerPool::~WorkerPool() {
+    shutdown();
+}
+
+bool WorkerPool::submit(Task task, TaskLane lane) {
+    // Workers never wait here: a worker blocked on a full queue could be the
+    // one that would have drained it.
+    return enqueue(std::move(task), lane, lane == TaskLane::Backend && !in_worker_pool);
+}
+
+bool WorkerPool::post(Task task, TaskLane lane) {
+    return enqueue(std::move(task), lane, false);
+}
+
+bool WorkerPool::enqueue(Task task, TaskLane lane, bool may_block) {
+    if (!task) {
+        return false;
+    }
+    size_t depth = 0;
+    bool overflow = false;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto& queue = lane == TaskLane::Media ? media_queue_ : backend_queue_;
+        if (may_block) {
+            space_cv_.wait(lock, [this, &queue]() {
+                return stopping_ || queue.size() < options_.queue_capacity;
+            });
+        }
+        if (stopping_) {
+            return false;
+        }
+        if (queue.size() >= 2 * options_.queue_capacity) {
+            lock.unlock();
+            Metrics::instance().increment_counter("worker_pool_rejected_total",
+                                                  {{"lane", lane_name(lane)}});
+            logging::error(
+                "Worker pool queue full, task rejected",
+                {kv("lane", lane_name(lane)),
+                 kv("capacity", options_.queue_capacity)});
+            return false;
+        }
+        overflow = queue.size() >= options_.queue_capacity;
+        queue.push_back({std::move(task), std::chrono::steady_clock::now()});
+        depth = queue.size();
+    }
+    if (overflow) {
+        Metrics::instance().increment_counter("worker_pool_overflow_total",
+                                              {{"lane", lane_name(lane)}});
+    }
+    if (lane == TaskLane::Media) {
+        media_cv_.notify_one();
+    }
+    general_cv_.notify_one();
+    publish_depth(lane, depth);
+    return true;
+}
+
+void WorkerPool::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_ && workers_.empty()) {
+            return;
+        }
+        stopping_ = true;
+    }
+    media_cv_.notify_all();
+    general_cv_.notify_all();
+    space_cv_.notify_all();
+    for (auto& worker : workers_) {
+        if (worker.joinable() && worker.get_id() != std::this_thread::get_id()) {
+            worker.join();
+        } else if (worker.joinable()) {
+            worker.detach();
+        }
+    }
+    workers_.clear();
+}
+
+size_t WorkerPool::queue_depth(TaskLane lane) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lane == TaskLane::Media ? media_queue_.size() : backend_queue_.size();
+}
+
+size_t WorkerPool::thread_count() const {
+    return options_.threads + options_.media_threads;
+}
+
+void WorkerPool::worker_loop(bool media_only) {
+    in_worker_pool = true;
+    const char* thread_name = media_only ? "sipgw_media" : "sipgw_async";
+    auto& cv = media_only ? media_cv_ : general_cv_;
+    while (true) {
+        QueuedTask task;
+        TaskLane lane = TaskLane::Media;
+        size_t depth = 0;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv.wait(lock, [this, media_only]() {
+                return stopping_ || !media_queue_.empty() ||
+                       (!media_only && !backend_queue_.empty());
+            });
+            if (!media_queue_.empty()) {
+                task = std::move(media_queue_.front());
+                media_queue_.pop_front();
+                depth = media_queue_.size();
+            } else if (!media_only && !backend_queue_.empty()) {
+                lane = TaskLane::Backend;
+                task = std::move(backend_queue_.front());
+                backend_queue_.pop_front();
+                depth = backend_queue_.size();
+            } else {
+                // Stopping and nothing left to drain for this worker.
+                break;
+            }
+        }
+        if (lane == TaskLane::Backend) {
+            space_cv_.notify_one();
+        }
+        publish_depth(lane, depth);
+        const auto waited = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - task.enqueued_at).count();
+        wait_histogram(lane).observe(waited);
+
+        ensure_pj_thread_registered(thread_name);
+        // The gauge itself counts running tasks, so a scrape reads the live
+        // count rather than whichever worker stored last.
+        busy_gauge(lane).add(1.0);
+        try {
+            task.task();
+        } catch (const std::exception& ex) {
+            logging::error(
+                "Worker pool task failed",
+                {kv("lane", lane_name(lane)),
+                 kv("error", ex.what())});
+        } catch (...) {
+            logging::error(
+                "Worker pool task failed",
+                {kv("lane", lane_name(lane))});
+        }
+        busy_gauge(lane).add(-1.0);
+    }
+}
+
+void WorkerPool::publish_depth(TaskLane lane, size_t depth) const {
+    depth_gauge(lane).set(static_cast<double>(depth));
+}
+
+void init_worker_pool(const WorkerPoolOptions& options) {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    if (pool_instance) {
+        logging::warn("Worker pool already initialized");
+        return;
+    }
+    pool_instance = std::make_unique<WorkerPool>(options);
+    logging::info(
+        "Worker pool started",
+        {kv("threads", options.threads),
+         kv("media_threads", options.media_threads),
+         kv("queue_capacity", options.queue_capacity)});
+}
+
+WorkerPool& worker_pool() {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    if (!pool_instance) {
+        pool_instance = std::make_unique<WorkerPool>(WorkerPoolOptions{});
+    }
+    return *pool_instance;
+}
+
+void shutdown_worker_pool() {
+    WorkerPool* pool = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        pool = pool_instance.get();
+    }
+    // The instance stays alive so late submitters get a clean rejection.
+    if (pool) {
+        pool->shutdown();
+    }
+}
+
+}
@@ -0,0 +1,115 @@
+#include "sip_gateway/vad/batch_scheduler.hpp"
+
+#include <algorithm>
+#include <exception>
+
+#include "sip_gateway/metrics.hpp"
+#include "sip_gateway/vad/model.hpp"
+
+namespace sip_gateway::vad {
+
+VadBatchScheduler::VadBatchScheduler(std::shared_ptr<VadModel> model, VadBatchOptions options)
+    : model_(std::move(model)), options_(options) {
+    options_.max_batch = std::max<size_t>(1, options_.max_batch);
+    pending_.reserve(options_.max_batch);
+}
+
+float VadBatchScheduler::get_speech_prob(const std::vector<float>& audio,
+                                         std::vector<float>* state,
+                                         int sampling_rate) {
+    if (audio.empty()) {
+        return 0.0f;
+    }
+    if (options_.max_batch == 1) {
+        return model_->get_speech_prob(audio, state, sampling_rate);
+    }
+    Request request;
+    request.audio = &audio;
+    request.state = state;
+    request.sampling_rate = sampling_rate;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    pending_.push_back(&request);
+    if (pending_.size() >= options_.max_batch) {
+        cv_.notify_all();
+    }
+    while (!request.done) {
+        if (request.taken || leader_waiting_) {
+            cv_.wait(lock, [this, &request]() {
+                return request.done || (!request.taken && !leader_waiting_);
+            });
+            continue;
+        }
+        leader_waiting_ = true;
+        cv_.wait_for(lock, options_.max_wait, [this]() {
+            return pending_.size() >= options_.max_batch;
+        });
+        leader_waiting_ = false;
+        // Oldest windows first. A window of another size or rate cannot
+        // share the tensor and waits for a later batch.
+        const size_t window_size = pending_.front()->audio->size();
+        const int rate = pending_.front()->sampling_rate;
+        std::vector<Request*> batch;
+        std::vector<Request*> rest;
+        batch.reserve(std::min(pending_.size(), options_.max_batch));
+        for (auto* pending : pending_) {
+            if (batch.size() < options_.max_batch && pending->audio->size() == window_size &&
+                pending->sampling_rate == rate) {
+                pending->taken = true;
+                batch.push_back(pending);
+            } else {
+                rest.push_back(pending);
+            }
+        }
+        pending_.swap(rest);
+        // Whoever is left over leads the next batch.
+        cv_.notify_all();
+        lock.unlock();
+        run_batch(batch);
+        lock.lock();
+        for (auto* done : batch) {
+            done->done = true;
+        }
+        cv_.notify_all();
+    }
+    lock.unlock();
+    if (request.error) {
+        std::rethrow_exception(request.error);
+    }
+    return request.prob;
+}
+
+void VadBatchScheduler::run_batch(std::vector<Request*>& batch) {
+    std::vector<const float*> windows;
+    std::vector<std::vector<float>*> states;
+    std::vector<float> probs(batch.size(), 0.0f);
+    windows.reserve(batch.size());
+    states.reserve(batch.size());
+    for (auto* request : batch) {
+        windows.push_back(request->audio->data());
+        states.push_back(request->state);
+    }
+    const auto started = std::chrono::steady_clock::now();
+    try {
+        model_->get_speech_probs(windows, batch.front()->audio->size(), states, probs.data(),
+                                 batch.front()->sampling_rate);
+    } catch (...) {
+        const auto error = std::current_exception();
+        for (auto* request : batch) {
+            request->error = error;
+        }
+        return;
+    }
+    static auto& batch_time = Metrics::instance().histogram("vad_batch");
+    static auto& batches = Metrics::instance().counter("vad_batches_total");
+    static auto& batch_windows = Metrics::instance().counter("vad_batch_windows_total");
+    batch_time.observe(
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count());
+    batches.increment();
+    batch_windows.increment(batch.size());
+    for (size_t i = 0; i < batch.size(); ++i) {
+        batch[i]->prob = probs[i];
+    }
+}
+
+}
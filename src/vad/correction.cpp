@@ -1,8 +1,8 @@
 #include "sip_gateway/vad/correction.hpp"
 
 #include <algorithm>
+#include <array>
 #include <cmath>
-#include <numeric>
 
 #include "sip_gateway/logging.hpp"
 
@@ -11,49 +11,96 @@ namespace sip_gateway::vad {
 
 namespace {
 
-double mean_value(const std::deque<double>& values) {
-    if (values.empty()) {
+double population_variance(const double* values, size_t count) {
+    if (count < 2) {
         return 0.0;
     }
-    const double sum = std::accumulate(values.begin(), values.end(), 0.0);
-    return sum / static_cast<double>(values.size());
-}
-
-double population_variance(const std::deque<double>& values) {
-    if (values.size() < 2) {
-        return 0.0;
+    double sum = 0.0;
+    for (size_t i = 0; i < count; ++i) {
+        sum += values[i];
     }
-    const double mean = mean_value(values);
+    const double mean = sum / static_cast<double>(count);
     double acc = 0.0;
-    for (double value : values) {
-        const double diff = value - mean;
+    for (size_t i = 0; i < count; ++i) {
+        const double diff = values[i] - mean;
         acc += diff * diff;
     }
-    return acc / static_cast<double>(values.size());
+    return acc / static_cast<double>(count);
 }
 
-double population_variance(const std::vector<double>& values) {
-    if (values.size() < 2) {
-        return 0.0;
+size_t window_capacity(int size) {
+    return static_cast<size_t>(std::max(0, size));
+}
+
+}
+
+void RunningStats::add(double value) {
+    ++count_;
+    const double delta = value - mean_;
+    mean_ += delta / static_cast<double>(count_);
+    m2_ += delta * (value - mean_);
+}
+
+void RunningStats::remove(double value) {
+    if (count_ <= 1) {
+        clear();
+        return;
     }
-    const double sum = std::accumulate(values.begin(), values.end(), 0.0);
-    const double mean = sum / static_cast<double>(values.size());
-    double acc = 0.0;
-    for (double value : values) {
-        const double diff = value - mean;
-        acc += diff * diff;
+    const double delta = value - mean_;
+    mean_ -= delta / static_cast<double>(count_ - 1);
+    m2_ = std::max(0.0, m2_ - delta * (value - mean_));
+    --count_;
+}
+
+void RunningStats::clear() {
+    count_ = 0;
+    mean_ = 0.0;
+    m2_ = 0.0;
+}
+
+size_t RunningStats::count() const {
+    return count_;
+}
+
+double RunningStats::mean() const {
+    return mean_;
+}
+
+double RunningStats::variance() const {
+    return count_ < 2 ? 0.0 : m2_ / static_cast<double>(count_);
+}
+
+RecentValues::RecentValues(size_t capacity) : values_(capacity, 0.0) {}
+
+bool RecentValues::push(double value, double& evicted) {
+    if (values_.empty()) {
+        evicted = value;
+        return true;
+    }
+    const bool full = size_ == values_.size();
+    if (full) {
+        evicted = values_[next_];
+    } else {
+        ++size_;
     }
-    return acc / static_cast<double>(values.size());
+    values_[next_] = value;
+    next_ = (next_ + 1) % values_.size();
+    return full;
 }
 
+size_t RecentValues::size() const {
+    return size_;
+}
+
+double RecentValues::recent(size_t age) const {
+    return values_[(next_ + values_.size() - 1 - age) % values_.size()];
 }
 
 DynamicCorrection::DynamicCorrection(VADCorrectionConfig cfg)
     : cfg_(cfg),
-      score_buf_(),
-      prob_buf_() {
-    score_buf_.clear();
-    prob_buf_.clear();
+      score_buf_(window_capacity(cfg.score_window)),
+      prob_buf_(window_capacity(cfg.prob_window)) {
+    initial_energy_samples_.reserve(window_capacity(cfg_.initial_adapt_frames));
 }
 
 void DynamicCorrection::start_early_detection() {
@@ -75,10 +122,11 @@ void DynamicCorrection::update_energy_profile(double energy, double speech_prob)
     if (static_cast<int>(initial_energy_samples_.size()) < cfg_.initial_adapt_frames) {
         initial_energy_samples_.push_back(energy);
         if (static_cast<int>(initial_energy_samples_.size()) == cfg_.initial_adapt_frames) {
-            auto sorted = initial_energy_samples_;
-            std::sort(sorted.begin(), sorted.end());
-            const size_t idx = sorted.size() / 10;
-            noise_energy_ = sorted[idx];
+            // The samples are not needed afterwards, so select in place.
+            auto& samples = initial_energy_samples_;
+            const auto nth = samples.begin() + static_cast<std::ptrdiff_t>(samples.size() / 10);
+            std::nth_element(samples.begin(), nth, samples.end());
+            noise_energy_ = *nth;
         }
     }
 
@@ -103,46 +151,40 @@ bool DynamicCorrection::is_transition_period() const {
     if (prob_buf_.size() < 4) {
         return false;
     }
-    auto minmax = std::minmax_element(prob_buf_.end() - 4, prob_buf_.end());
-    return (*minmax.second - *minmax.first) > cfg_.transition_threshold;
+    double low = prob_buf_.recent(0);
+    double high = low;
+    for (size_t age = 1; age < 4; ++age) {
+        low = std::min(low, prob_buf_.recent(age));
+        high = std::max(high, prob_buf_.recent(age));
+    }
+    return (high - low) > cfg_.transition_threshold;
 }
 
 std::pair<double, double> DynamicCorrection::calculate_foreground_variance() const {
     if (prob_buf_.size() < 2) {
         return {0.0, 0.0};
     }
-    const double raw_var = population_variance(prob_buf_);
+    const double raw_var = prob_stats_.variance();
 
     if (!state_) {
         return {raw_var, 0.0};
     }
 
-    std::vector<double> speech_probs;
-    speech_probs.reserve(prob_buf_.size());
-    for (double prob : prob_buf_) {
-        if (prob > cfg_.speech_prob_threshold) {
-            speech_probs.push_back(prob);
-        }
-    }
-    if (static_cast<int>(speech_probs.size()) < cfg_.min_speech_frames) {
+    if (static_cast<int>(speech_prob_stats_.count()) < cfg_.min_speech_frames) {
         return {raw_var, 0.0};
     }
 
-    double foreground_var = population_variance(speech_probs);
+    double foreground_var = speech_prob_stats_.variance();
     if (is_transition_period()) {
-        std::vector<double> recent;
-        const int max_count = 6;
-        for (int i = static_cast<int>(prob_buf_.size()) - 1; i >= 0 && static_cast<int>(recent.size()) < max_count; --i) {
-            const double prob = prob_buf_[static_cast<size_t>(i)];
+        std::array<double, 6> recent{};
+        size_t count = 0;
+        for (size_t age = 0; age < prob_buf_.size() && count < recent.size(); ++age) {
+            const double prob = prob_buf_.recent(age);
             if (prob > cfg_.speech_prob_threshold) {
-                recent.push_back(prob);
+                recent[count++] = prob;
             }
         }
-        if (recent.size() >= 3) {
-            foreground_var = population_variance(recent);
-        } else {
-            foreground_var = 0.0;
-        }
+        foreground_var = count >= 3 ? population_variance(recent.data(), count) : 0.0;
     }
     return {raw_var, foreground_var};
 }
@@ -165,9 +207,16 @@ bool DynamicCorrection::process_frame(double speech_prob, double frame_energy) {
     const double snr = frame_energy / (noise_energy_ + 1e-6);
     const double snr_n = clip_norm(snr, cfg_.snr_clip.first, cfg_.snr_clip.second);
 
-    prob_buf_.push_back(adjusted_prob);
-    if (prob_buf_.size() > static_cast<size_t>(cfg_.prob_window)) {
-        prob_buf_.pop_front();
+    double evicted = 0.0;
+    prob_stats_.add(adjusted_prob);
+    if (adjusted_prob > cfg_.speech_prob_threshold) {
+        speech_prob_stats_.add(adjusted_prob);
+    }
+    if (prob_buf_.push(adjusted_prob, evicted)) {
+        prob_stats_.remove(evicted);
+        if (evicted > cfg_.speech_prob_threshold) {
+            speech_prob_stats_.remove(evicted);
+        }
     }
 
     const auto vars = calculate_foreground_variance();
@@ -190,12 +239,12 @@ bool DynamicCorrection::process_frame(double speech_prob, double frame_energy) {
                    cfg_.w_energy * eng_n;
     score /= weight_sum > 0.0 ? weight_sum : 1.0;
 
-    score_buf_.push_back(score);
-    if (score_buf_.size() > static_cast<size_t>(cfg_.score_window)) {
-        score_buf_.pop_front();
+    score_stats_.add(score);
+    if (score_buf_.push(score, evicted)) {
+        score_stats_.remove(evicted);
     }
 
-    const double mean_score = mean_value(score_buf_);
+    const double mean_score = score_stats_.mean();
     const double enter_thres = get_dynamic_threshold();
     if (!state_ && mean_score >= enter_thres) {
         state_ = true;
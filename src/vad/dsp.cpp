@@ -0,0 +1,339 @@
+#include "sip_gateway/vad/dsp.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIPGATEWAY_DSP_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define SIPGATEWAY_DSP_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace sip_gateway::vad {
+
+namespace {
+
+constexpr float kPcm16Scale = 1.0f / 32768.0f;
+
+void pcm16_to_float_scalar(const int16_t* in, float* out, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = static_cast<float>(in[i]) * kPcm16Scale;
+    }
+}
+
+float peak_abs_scalar(const float* data, size_t count) {
+    float peak = 0.0f;
+    for (size_t i = 0; i < count; ++i) {
+        peak = std::max(peak, std::abs(data[i]));
+    }
+    return peak;
+}
+
+void divide_scalar(float* data, size_t count, float divisor) {
+    for (size_t i = 0; i < count; ++i) {
+        data[i] /= divisor;
+    }
+}
+
+double sum_squares_scalar(const float* data, size_t count) {
+    double sum = 0.0;
+    for (size_t i = 0; i < count; ++i) {
+        sum += static_cast<double>(data[i] * data[i]);
+    }
+    return sum;
+}
+
+constexpr DspKernels kScalarKernels{
+    pcm16_to_float_scalar, peak_abs_scalar, divide_scalar, sum_squares_scalar};
+
+#if defined(SIPGATEWAY_DSP_X86)
+
+// SSE2 is part of x86-64, so these need no runtime check there.
+__attribute__((target("sse2")))
+void pcm16_to_float_sse2(const int16_t* in, float* out, size_t count) {
+    const __m128 scale = _mm_set1_ps(kPcm16Scale);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i pcm = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        // Duplicate each sample into both halves of a 32-bit lane, then
+        // shift arithmetically to sign-extend it.
+        const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(pcm, pcm), 16);
+        const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(pcm, pcm), 16);
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+    pcm16_to_float_scalar(in + i, out + i, count - i);
+}
+
+__attribute__((target("sse2")))
+float peak_abs_sse2(const float* data, size_t count) {
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 peak = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        peak = _mm_max_ps(peak, _mm_andnot_ps(sign, _mm_loadu_ps(data + i)));
+    }
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, peak);
+    const float vector_peak = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+    return std::max(vector_peak, peak_abs_scalar(data + i, count - i));
+}
+
+__attribute__((target("sse2")))
+void divide_sse2(float* data, size_t count, float divisor) {
+    const __m128 d = _mm_set1_ps(divisor);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(data + i, _mm_div_ps(_mm_loadu_ps(data + i), d));
+    }
+    divide_scalar(data + i, count - i, divisor);
+}
+
+__attribute__((target("sse2")))
+double sum_squares_sse2(const float* data, size_t count) {
+    __m128d lo_sum = _mm_setzero_pd();
+    __m128d hi_sum = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128 v = _mm_loadu_ps(data + i);
+        const __m128 squares = _mm_mul_ps(v, v);
+        lo_sum = _mm_add_pd(lo_sum, _mm_cvtps_pd(squares));
+        hi_sum = _mm_add_pd(hi_sum, _mm_cvtps_pd(_mm_movehl_ps(squares, squares)));
+    }
+    alignas(16) double lanes[2];
+    _mm_store_pd(lanes, _mm_add_pd(lo_sum, hi_sum));
+    return lanes[0] + lanes[1] + sum_squares_scalar(data + i, count - i);
+}
+
+__attribute__((target("avx2")))
+void pcm16_to_float_avx2(const int16_t* in, float* out, size_t count) {
+    const __m256 scale = _mm256_set1_ps(kPcm16Scale);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i pcm = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        const __m256 samples = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(pcm));
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(samples, scale));
+    }
+    pcm16_to_float_scalar(in + i, out + i, count - i);
+}
+
+__attribute__((target("avx2")))
+float peak_abs_avx2(const float* data, size_t count) {
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    __m256 peak = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        peak = _mm256_max_ps(peak, _mm256_andnot_ps(sign, _mm256_loadu_ps(data + i)));
+    }
+    __m128 half = _mm_max_ps(_mm256_castps256_ps128(peak), _mm256_extractf128_ps(peak, 1));
+    half = _mm_max_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_max_ss(half, _mm_shuffle_ps(half, half, 1));
+    return std::max(_mm_cvtss_f32(half), peak_abs_scalar(data + i, count - i));
+}
+
+__attribute__((target("avx2")))
+void divide_avx2(float* data, size_t count, float divisor) {
+    const __m256 d = _mm256_set1_ps(divisor);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_ps(data + i, _mm256_div_ps(_mm256_loadu_ps(data + i), d));
+    }
+    divide_scalar(data + i, count - i, divisor);
+}
+
+__attribute__((target("avx2")))
+double sum_squares_avx2(const float* data, size_t count) {
+    __m256d lo_sum = _mm256_setzero_pd();
+    __m256d hi_sum = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256 v = _mm256_loadu_ps(data + i);
+        const __m256 squares = _mm256_mul_ps(v, v);
+        lo_sum = _mm256_add_pd(lo_sum, _mm256_cvtps_pd(_mm256_castps256_ps128(squares)));
+        hi_sum = _mm256_add_pd(hi_sum, _mm256_cvtps_pd(_mm256_extractf128_ps(squares, 1)));
+    }
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, _mm256_add_pd(lo_sum, hi_sum));
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) +
+           sum_squares_scalar(data + i, count - i);
+}
+
+constexpr DspKernels kSse2Kernels{
+    pcm16_to_float_sse2, peak_abs_sse2, divide_sse2, sum_squares_sse2};
+constexpr DspKernels kAvx2Kernels{
+    pcm16_to_float_avx2, peak_abs_avx2, divide_avx2, sum_squares_avx2};
+
+bool cpu_has_sse2() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+}
+
+bool cpu_has_avx2() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+#elif defined(SIPGATEWAY_DSP_NEON)
+
+// NEON is part of AArch64, so these need no runtime check.
+void pcm16_to_float_neon(const int16_t* in, float* out, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const int16x8_t pcm = vld1q_s16(in + i);
+        const float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(pcm)));
+        const float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(pcm)));
+        vst1q_f32(out + i, vmulq_n_f32(lo, kPcm16Scale));
+        vst1q_f32(out + i + 4, vmulq_n_f32(hi, kPcm16Scale));
+    }
+    pcm16_to_float_scalar(in + i, out + i, count - i);
+}
+
+float peak_abs_neon(const float* data, size_t count) {
+    float32x4_t peak = vdupq_n_f32(0.0f);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        peak = vmaxq_f32(peak, vabsq_f32(vld1q_f32(data + i)));
+    }
+    return std::max(vmaxvq_f32(peak), peak_abs_scalar(data + i, count - i));
+}
+
+void divide_neon(float* data, size_t count, float divisor) {
+    const float32x4_t d = vdupq_n_f32(divisor);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        vst1q_f32(data + i, vdivq_f32(vld1q_f32(data + i), d));
+    }
+    divide_scalar(data + i, count - i, divisor);
+}
+
+double sum_squares_neon(const float* data, size_t count) {
+    float64x2_t lo_sum = vdupq_n_f64(0.0);
+    float64x2_t hi_sum = vdupq_n_f64(0.0);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const float32x4_t v = vld1q_f32(data + i);
+        const float32x4_t squares = vmulq_f32(v, v);
+        lo_sum = vaddq_f64(lo_sum, vcvt_f64_f32(vget_low_f32(squares)));
+        hi_sum = vaddq_f64(hi_sum, vcvt_high_f64_f32(squares));
+    }
+    return vaddvq_f64(vaddq_f64(lo_sum, hi_sum)) + sum_squares_scalar(data + i, count - i);
+}
+
+constexpr DspKernels kNeonKernels{
+    pcm16_to_float_neon, peak_abs_neon, divide_neon, sum_squares_neon};
+
+#endif
+
+SimdLevel detect_simd_level() {
+#if defined(SIPGATEWAY_DSP_X86)
+    if (cpu_has_avx2()) {
+        return SimdLevel::Avx2;
+    }
+    if (cpu_has_sse2()) {
+        return SimdLevel::Sse2;
+    }
+#elif defined(SIPGATEWAY_DSP_NEON)
+    return SimdLevel::Neon;
+#endif
+    return SimdLevel::Scalar;
+}
+
+// Linear interpolation between 1024 intervals stays within 3e-7 of std::sin.
+constexpr size_t kFadeIntervals = 1024;
+
+const std::array<float, kFadeIntervals + 1>& fade_table() {
+    static const auto table = []() {
+        std::array<float, kFadeIntervals + 1> values{};
+        for (size_t i = 0; i <= kFadeIntervals; ++i) {
+            values[i] = static_cast<float>(
+                std::sin(static_cast<double>(i) / kFadeIntervals * 1.57079632679489661923));
+        }
+        return values;
+    }();
+    return table;
+}
+
+}
+
+const char* simd_level_name(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::Sse2:
+            return "sse2";
+        case SimdLevel::Avx2:
+            return "avx2";
+        case SimdLevel::Neon:
+            return "neon";
+        case SimdLevel::Scalar:
+            break;
+    }
+    return "scalar";
+}
+
+std::vector<SimdLevel> supported_simd_levels() {
+    std::vector<SimdLevel> levels{SimdLevel::Scalar};
+#if defined(SIPGATEWAY_DSP_X86)
+    if (cpu_has_sse2()) {
+        levels.push_back(SimdLevel::Sse2);
+    }
+    if (cpu_has_avx2()) {
+        levels.push_back(SimdLevel::Avx2);
+    }
+#elif defined(SIPGATEWAY_DSP_NEON)
+    levels.push_back(SimdLevel::Neon);
+#endif
+    return levels;
+}
+
+const DspKernels& dsp_kernels(SimdLevel level) {
+    switch (level) {
+#if defined(SIPGATEWAY_DSP_X86)
+        case SimdLevel::Sse2:
+            return kSse2Kernels;
+        case SimdLevel::Avx2:
+            return kAvx2Kernels;
+#elif defined(SIPGATEWAY_DSP_NEON)
+        case SimdLevel::Neon:
+            return kNeonKernels;
+#endif
+        default:
+            break;
+    }
+    return kScalarKernels;
+}
+
+SimdLevel active_simd_level() {
+    static const SimdLevel level = detect_simd_level();
+    return level;
+}
+
+const DspKernels& dsp_kernels() {
+    static const DspKernels& kernels = dsp_kernels(active_simd_level());
+    return kernels;
+}
+
+void apply_fade(const float* in, float* out, size_t count, bool fade_in) {
+    if (count == 0) {
+        return;
+    }
+    if (count == 1) {
+        out[0] = in[0];
+        return;
+    }
+    const auto& table = fade_table();
+    const float step = static_cast<float>(kFadeIntervals) / static_cast<float>(count - 1);
+    for (size_t i = 0; i < count; ++i) {
+        const float position = static_cast<float>(i) * step;
+        const size_t index = std::min(static_cast<size_t>(position), kFadeIntervals - 1);
+        const float fraction = position - static_cast<float>(index);
+        float curve = table[index] + (table[index + 1] - table[index]) * fraction;
+        if (!fade_in) {
+            curve = 1.0f - curve;
+        }
+        out[i] = in[i] * curve;
+    }
+}
+
+}
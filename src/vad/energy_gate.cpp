@@ -0,0 +1,43 @@
+#include "sip_gateway/vad/energy_gate.hpp"
+
+#include <algorithm>
+
+namespace sip_gateway::vad {
+
+namespace {
+
+// About -80 dBFS; keeps a digitally silent line from pinning the floor at 0.
+constexpr double kMinFloor = 1e-4;
+constexpr double kSpeechProb = 0.3;
+
+}
+
+EnergyGate::EnergyGate(EnergyGateConfig cfg) : cfg_(cfg) {}
+
+bool EnergyGate::should_skip(double rms, double last_prob) {
+    if (floor_ < 0.0 || rms < floor_) {
+        floor_ = rms;
+    } else if (last_prob < kSpeechProb) {
+        floor_ += cfg_.noise_alpha * (rms - floor_);
+    }
+    const double threshold = std::min(cfg_.max_rms, std::max(floor_, kMinFloor) * cfg_.floor_ratio);
+    if (rms > threshold) {
+        quiet_windows_ = 0;
+        return false;
+    }
+    if (quiet_windows_ < cfg_.hold_windows) {
+        ++quiet_windows_;
+        return false;
+    }
+    return true;
+}
+
+double EnergyGate::noise_floor() const {
+    return std::max(floor_, 0.0);
+}
+
+const EnergyGateConfig& EnergyGate::config() const {
+    return cfg_;
+}
+
+}
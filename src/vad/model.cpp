@@ -2,20 +2,164 @@
 
 #include <algorithm>
 #include <array>
+#include <chrono>
 #include <stdexcept>
+#include <string>
+#include <type_traits>
 
 #include <onnxruntime_cxx_api.h>
 
+#include "sip_gateway/metrics.hpp"
+
 
 namespace sip_gateway::vad {
 
 namespace {
 
-Ort::Env& ort_env() {
-    static Ort::Env env(ORT_LOGGING_LEVEL_WARNING, "sip_gateway_vad");
+Ort::Env make_env(const VadModelOptions& options) {
+    if (!options.global_thread_pool) {
+        return Ort::Env(ORT_LOGGING_LEVEL_WARNING, "sip_gateway_vad");
+    }
+    Ort::ThreadingOptions threading;
+    threading.SetGlobalIntraOpNumThreads(options.intra_op_threads);
+    threading.SetGlobalInterOpNumThreads(options.inter_op_threads);
+    threading.SetGlobalSpinControl(options.allow_spinning ? 1 : 0);
+    return Ort::Env(threading, ORT_LOGGING_LEVEL_WARNING, "sip_gateway_vad");
+}
+
+// The first model created decides whether the process uses global threads.
+Ort::Env& ort_env(const VadModelOptions& options) {
+    static Ort::Env env = make_env(options);
     return env;
 }
 
+GraphOptimizationLevel to_ort_level(GraphOptimization level) {
+    switch (level) {
+        case GraphOptimization::Disabled:
+            return ORT_DISABLE_ALL;
+        case GraphOptimization::Basic:
+            return ORT_ENABLE_BASIC;
+        case GraphOptimization::Extended:
+            return ORT_ENABLE_EXTENDED;
+        case GraphOptimization::All:
+            break;
+    }
+    return ORT_ENABLE_ALL;
+}
+
+Ort::SessionOptions make_session_options(const VadModelOptions& options) {
+    Ort::SessionOptions session_options;
+    session_options.SetGraphOptimizationLevel(to_ort_level(options.graph_optimization));
+    if (options.global_thread_pool) {
+        session_options.DisablePerSessionThreads();
+        return session_options;
+    }
+    const char* spinning = options.allow_spinning ? "1" : "0";
+    session_options.SetIntraOpNumThreads(options.intra_op_threads);
+    session_options.SetInterOpNumThreads(options.inter_op_threads);
+    session_options.AddConfigEntry("session.intra_op.allow_spinning", spinning);
+    session_options.AddConfigEntry("session.inter_op.allow_spinning", spinning);
+    if (options.inter_op_threads > 1) {
+        session_options.SetExecutionMode(ORT_PARALLEL);
+    }
+    return session_options;
+}
+
+const char* graph_optimization_name(GraphOptimization level) {
+    switch (level) {
+        case GraphOptimization::Disabled:
+            return "disabled";
+        case GraphOptimization::Basic:
+            return "basic";
+        case GraphOptimization::Extended:
+            return "extended";
+        case GraphOptimization::All:
+            break;
+    }
+    return "all";
+}
+
+bool newer_or_same(const std::filesystem::path& path, const std::filesystem::path& than) {
+    std::error_code ec;
+    const auto time = std::filesystem::last_write_time(path, ec);
+    if (ec) {
+        return false;
+    }
+    const auto other = std::filesystem::last_write_time(than, ec);
+    return !ec && time >= other;
+}
+
+// Optimizations at the All level are specific to the ORT build, the
+// execution provider and the CPU features it found (layout transforms,
+// fused kernels), so the cache file is keyed by all three.
+std::string optimized_cache_tag() {
+    std::string tag = std::string("ort") + OrtGetApiBase()->GetVersionString() + "-cpu-";
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx512f")) {
+        tag += "avx512";
+    } else if (__builtin_cpu_supports("avx2")) {
+        tag += "avx2";
+    } else if (__builtin_cpu_supports("avx")) {
+        tag += "avx";
+    } else {
+        tag += "sse";
+    }
+#elif defined(__aarch64__)
+    tag += "arm64";
+#else
+    tag += "generic";
+#endif
+    return tag;
+}
+
+// Loads the cached optimized model when it is fresh, otherwise the source
+// model, saving the optimized graph to the cache on the way. The cache is
+// written under a temporary name and renamed, so a concurrent loader never
+// sees a partial file.
+Ort::Session open_session(const std::filesystem::path& model_path,
+                          const VadModelOptions& options,
+                          bool& from_cache) {
+    std::filesystem::path cache_path;
+    if (!options.optimized_cache_dir.empty()) {
+        cache_path = options.optimized_cache_dir /
+                     (model_path.stem().string() + "." +
+                      graph_optimization_name(options.graph_optimization) + "." +
+                      optimized_cache_tag() + ".optimized.onnx");
+    }
+    if (!cache_path.empty() && newer_or_same(cache_path, model_path)) {
+        try {
+            // Already optimized; running the passes again is the cost the
+            // cache avoids.
+            auto session_options = make_session_options(options);
+            session_options.SetGraphOptimizationLevel(ORT_DISABLE_ALL);
+            Ort::Session session(ort_env(options), cache_path.string().c_str(), session_options);
+            from_cache = true;
+            return session;
+        } catch (const Ort::Exception&) {
+            // Unreadable or from another ORT build; rebuilt below.
+        }
+    }
+    auto session_options = make_session_options(options);
+    std::filesystem::path partial_path;
+    if (!cache_path.empty()) {
+        std::error_code ec;
+        std::filesystem::create_directories(cache_path.parent_path(), ec);
+        partial_path = cache_path;
+        partial_path += ".partial." + std::to_string(
+            std::chrono::steady_clock::now().time_since_epoch().count());
+        session_options.SetOptimizedModelFilePath(partial_path.string().c_str());
+    }
+    Ort::Session session(ort_env(options), model_path.string().c_str(), session_options);
+    if (!partial_path.empty()) {
+        std::error_code ec;
+        std::filesystem::rename(partial_path, cache_path, ec);
+        if (ec) {
+            std::filesystem::remove(partial_path, ec);
+        }
+    }
+    return session;
+}
+
 std::vector<std::string> get_input_names(const Ort::Session& session) {
     Ort::AllocatorWithDefaultOptions allocator;
     const size_t count = session.GetInputCount();
@@ -44,9 +188,72 @@ bool has_name(const std::vector<std::string>& names, const std::string& needle)
     return std::find(names.begin(), names.end(), needle) != names.end();
 }
 
+struct NodeInfo {
+    ONNXTensorElementDataType type = ONNX_TENSOR_ELEMENT_DATA_TYPE_UNDEFINED;
+    std::vector<int64_t> shape;
+};
+
+NodeInfo node_info(const Ort::Session& session,
+                   const std::vector<std::string>& names,
+                   const std::string& name,
+                   bool output) {
+    const auto it = std::find(names.begin(), names.end(), name);
+    if (it == names.end()) {
+        return {};
+    }
+    const auto index = static_cast<size_t>(it - names.begin());
+    const auto type_info = output ? session.GetOutputTypeInfo(index)
+                                  : session.GetInputTypeInfo(index);
+    const auto tensor_info = type_info.GetTensorTypeAndShapeInfo();
+    return {tensor_info.GetElementType(), tensor_info.GetShape()};
+}
+
+// Dynamic dimensions are reported as -1 and match anything.
+bool dim_matches(const std::vector<int64_t>& shape, size_t index, int64_t expected) {
+    return index < shape.size() && (shape[index] < 0 || shape[index] == expected);
+}
+
+template <typename T>
+T from_float(float value);
+
+template <>
+float from_float<float>(float value) {
+    return value;
+}
+
+template <>
+Ort::Float16_t from_float<Ort::Float16_t>(float value) {
+    return Ort::Float16_t(value);
+}
+
+float to_float(float value) {
+    return value;
+}
+
+float to_float(Ort::Float16_t value) {
+    return value.ToFloat();
+}
+
+}
+
+GraphOptimization parse_graph_optimization(const std::string& name) {
+    if (name == "disabled") {
+        return GraphOptimization::Disabled;
+    }
+    if (name == "basic") {
+        return GraphOptimization::Basic;
+    }
+    if (name == "extended") {
+        return GraphOptimization::Extended;
+    }
+    if (name == "all") {
+        return GraphOptimization::All;
+    }
+    throw std::runtime_error("Unknown graph optimization level: " + name);
 }
 
 struct VadModel::Impl {
+    bool from_cache = false;
     Ort::Session session;
     std::vector<std::string> input_names;
     std::vector<std::string> output_names;
@@ -54,9 +261,13 @@ struct VadModel::Impl {
     bool has_sr;
     bool has_state;
     bool has_state_out;
+    bool half = false;
+    size_t prob_rank = 2;
 
-    Impl(const std::filesystem::path& model_path, int sampling_rate_in)
-        : session(ort_env(), model_path.string().c_str(), Ort::SessionOptions{}),
+    Impl(const std::filesystem::path& model_path,
+         int sampling_rate_in,
+         const VadModelOptions& options)
+        : session(open_session(model_path, options, from_cache)),
           input_names(get_input_names(session)),
           output_names(get_output_names(session)),
           sampling_rate(sampling_rate_in),
@@ -69,39 +280,286 @@ struct VadModel::Impl {
         if (!has_name(output_names, "output")) {
             throw std::runtime_error("VAD model missing output node 'output'");
         }
+        if (!has_state && has_name(input_names, "h") && has_name(input_names, "c")) {
+            throw std::runtime_error("VAD model has Silero v4 'h'/'c' state; a v5 model is required");
+        }
+        // Quantized (int8) exports keep float32 I/O; fp16 exports switch every
+        // float tensor to float16, which is converted at the boundary.
+        const auto input = node_info(session, input_names, "input", false);
+        if (input.type != ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT &&
+            input.type != ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16) {
+            throw std::runtime_error("VAD model input must be float32 or float16");
+        }
+        half = input.type == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16;
+        const auto output = node_info(session, output_names, "output", true);
+        if (output.type != input.type) {
+            throw std::runtime_error("VAD model output precision differs from its input");
+        }
+        prob_rank = output.shape.size() == 1 ? 1 : 2;
+        if (has_state) {
+            const auto state = node_info(session, input_names, "state", false);
+            if (state.type != input.type || state.shape.size() != 3 ||
+                !dim_matches(state.shape, 0, 2) ||
+                !dim_matches(state.shape, 2, static_cast<int64_t>(kStateSize))) {
+                throw std::runtime_error("VAD model state must be [2, N, 128] of the input precision");
+            }
+        }
+        if (has_state_out &&
+            node_info(session, output_names, "stateN", true).type != input.type) {
+            throw std::runtime_error("VAD model stateN precision differs from its input");
+        }
+        if (has_sr &&
+            node_info(session, input_names, "sr", false).type != ONNX_TENSOR_ELEMENT_DATA_TYPE_INT64) {
+            throw std::runtime_error("VAD model sr must be int64");
+        }
     }
 };
 
-VadModel::VadModel(const std::filesystem::path& model_path, int sampling_rate)
-    : impl_(std::make_unique<Impl>(model_path, sampling_rate)) {}
+struct VadModel::Stream::Impl {
+    Ort::Session* session = nullptr;
+    Ort::MemoryInfo mem_info = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+    bool half = false;
+    size_t window_size = 0;
+    // Only the buffers of the model's precision are allocated.
+    std::vector<float> input;
+    std::vector<Ort::Float16_t> input_half;
+    std::array<int64_t, 1> sr{};
+    std::array<std::vector<float>, 2> state;
+    std::array<std::vector<Ort::Float16_t>, 2> state_half;
+    float prob = 0.0f;
+    Ort::Float16_t prob_half;
+    std::vector<Ort::Value> tensors;
+    // bindings[i] reads state[i] and writes stateN into state[1 - i].
+    std::vector<Ort::IoBinding> bindings;
+    size_t current = 0;
+};
+
+VadModel::Stream::Stream(std::unique_ptr<Impl> impl) : impl_(std::move(impl)) {}
+
+VadModel::Stream::~Stream() = default;
+
+size_t VadModel::Stream::window_size() const {
+    return impl_->window_size;
+}
+
+float VadModel::Stream::get_speech_prob(const float* audio, size_t count) {
+    auto& impl = *impl_;
+    if (count != impl.window_size) {
+        throw std::invalid_argument("VAD window size does not match the stream");
+    }
+    if (impl.half) {
+        std::transform(audio, audio + count, impl.input_half.begin(),
+                       [](float value) { return Ort::Float16_t(value); });
+    } else {
+        std::copy(audio, audio + count, impl.input.begin());
+    }
+    static auto& inference = Metrics::instance().histogram("vad_inference");
+    const auto started = std::chrono::steady_clock::now();
+    impl.session->Run(Ort::RunOptions{nullptr}, impl.bindings[impl.current]);
+    inference.observe(
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count());
+    if (impl.bindings.size() > 1) {
+        impl.current = 1 - impl.current;
+    }
+    return impl.half ? impl.prob_half.ToFloat() : impl.prob;
+}
+
+void VadModel::Stream::reset() {
+    for (auto& state : impl_->state) {
+        std::fill(state.begin(), state.end(), 0.0f);
+    }
+    for (auto& state : impl_->state_half) {
+        std::fill(state.begin(), state.end(), Ort::Float16_t(0.0f));
+    }
+    impl_->current = 0;
+}
+
+VadModel::VadModel(const std::filesystem::path& model_path,
+                   int sampling_rate,
+                   const VadModelOptions& options)
+    : impl_(std::make_unique<Impl>(model_path, sampling_rate, options)) {}
 
 VadModel::~VadModel() = default;
 
+bool VadModel::supports_sampling_rate(int sampling_rate) {
+    return sampling_rate == 8000 || sampling_rate == 16000;
+}
+
+size_t VadModel::window_size_for(int sampling_rate) {
+    return sampling_rate == 8000 ? 256 : 512;
+}
+
+int64_t VadModel::resolve_rate(int sampling_rate) const {
+    const int rate = sampling_rate > 0 ? sampling_rate : impl_->sampling_rate;
+    if (impl_->has_sr && !supports_sampling_rate(rate)) {
+        throw std::invalid_argument("Unsupported VAD sampling rate: " + std::to_string(rate));
+    }
+    return rate;
+}
+
 int VadModel::sampling_rate() const {
     return impl_->sampling_rate;
 }
 
+bool VadModel::half_precision() const {
+    return impl_->half;
+}
+
+bool VadModel::loaded_from_cache() const {
+    return impl_->from_cache;
+}
+
+void VadModel::warm_up(size_t batch_size) const {
+    const size_t window_size = window_size_for(impl_->sampling_rate);
+    const std::vector<float> silence(window_size, 0.0f);
+    auto stream = create_stream(window_size);
+    for (int i = 0; i < 3; ++i) {
+        stream->get_speech_prob(silence.data(), silence.size());
+    }
+    if (batch_size > 1) {
+        const std::vector<const float*> windows(batch_size, silence.data());
+        const std::vector<std::vector<float>*> states(batch_size, nullptr);
+        std::vector<float> probs(batch_size);
+        get_speech_probs(windows, window_size, states, probs.data());
+    }
+}
+
+std::unique_ptr<VadModel::Stream> VadModel::create_stream(size_t window_size,
+                                                          int sampling_rate) const {
+    auto stream = std::make_unique<Stream::Impl>();
+    auto& impl = *stream;
+    impl.session = &impl_->session;
+    impl.half = impl_->half;
+    impl.window_size = window_size;
+    impl.sr[0] = resolve_rate(sampling_rate);
+
+    const std::array<int64_t, 2> input_shape{1, static_cast<int64_t>(window_size)};
+    const std::array<int64_t, 1> sr_shape{1};
+    const std::array<int64_t, 3> state_shape{2, 1, static_cast<int64_t>(kStateSize)};
+    // "output" is [N, 1] in Silero v5; a rank-1 variant gets [N].
+    const std::vector<int64_t> prob_shape(impl_->prob_rank, 1);
+    auto add_tensor = [&impl](auto* data, size_t count, const int64_t* shape, size_t rank) {
+        impl.tensors.push_back(Ort::Value::CreateTensor(impl.mem_info, data, count, shape, rank));
+    };
+    impl.tensors.reserve(5);
+    if (impl.half) {
+        impl.input_half.assign(window_size, Ort::Float16_t(0.0f));
+        add_tensor(impl.input_half.data(), window_size, input_shape.data(), input_shape.size());
+    } else {
+        impl.input.assign(window_size, 0.0f);
+        add_tensor(impl.input.data(), window_size, input_shape.data(), input_shape.size());
+    }
+    add_tensor(impl.sr.data(), impl.sr.size(), sr_shape.data(), sr_shape.size());
+    if (impl.half) {
+        add_tensor(&impl.prob_half, 1, prob_shape.data(), prob_shape.size());
+    } else {
+        add_tensor(&impl.prob, 1, prob_shape.data(), prob_shape.size());
+    }
+    for (size_t i = 0; i < 2; ++i) {
+        if (impl.half) {
+            impl.state_half[i].assign(2 * kStateSize, Ort::Float16_t(0.0f));
+            add_tensor(impl.state_half[i].data(), impl.state_half[i].size(),
+                       state_shape.data(), state_shape.size());
+        } else {
+            impl.state[i].assign(2 * kStateSize, 0.0f);
+            add_tensor(impl.state[i].data(), impl.state[i].size(),
+                       state_shape.data(), state_shape.size());
+        }
+    }
+    const auto& input_tensor = impl.tensors[0];
+    const auto& sr_tensor = impl.tensors[1];
+    const auto& prob_tensor = impl.tensors[2];
+
+    const bool ping_pong = impl_->has_state && impl_->has_state_out;
+    const size_t binding_count = ping_pong ? 2 : 1;
+    impl.bindings.reserve(binding_count);
+    for (size_t i = 0; i < binding_count; ++i) {
+        impl.bindings.emplace_back(impl_->session);
+        auto& binding = impl.bindings.back();
+        binding.BindInput("input", input_tensor);
+        if (impl_->has_sr) {
+            binding.BindInput("sr", sr_tensor);
+        }
+        if (impl_->has_state) {
+            binding.BindInput("state", impl.tensors[3 + i]);
+        }
+        binding.BindOutput("output", prob_tensor);
+        if (impl_->has_state_out) {
+            binding.BindOutput("stateN", impl.tensors[3 + (1 - i)]);
+        }
+    }
+    return std::unique_ptr<Stream>(new Stream(std::move(stream)));
+}
+
 std::vector<float> VadModel::initialize_state() const {
     if (!impl_->has_state) {
         return {};
     }
-    return std::vector<float>(2 * 1 * 128, 0.0f);
+    return std::vector<float>(2 * kStateSize, 0.0f);
 }
 
 float VadModel::get_speech_prob(const std::vector<float>& audio,
-                                std::vector<float>* state) const {
+                                std::vector<float>* state,
+                                int sampling_rate) const {
     if (audio.empty()) {
         return 0.0f;
     }
+    float prob = 0.0f;
+    get_speech_probs({audio.data()}, audio.size(), {state}, &prob, sampling_rate);
+    return prob;
+}
+
+void VadModel::get_speech_probs(const std::vector<const float*>& windows,
+                                size_t window_size,
+                                const std::vector<std::vector<float>*>& states,
+                                float* probs,
+                                int sampling_rate) const {
+    const int64_t rate = resolve_rate(sampling_rate);
+    static auto& inference = Metrics::instance().histogram("vad_inference");
+    const auto started = std::chrono::steady_clock::now();
+    if (impl_->half) {
+        run_batch<Ort::Float16_t>(windows, window_size, states, probs, rate);
+    } else {
+        run_batch<float>(windows, window_size, states, probs, rate);
+    }
+    inference.observe(
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count());
+}
+
+template <typename T>
+void VadModel::run_batch(const std::vector<const float*>& windows,
+                         size_t window_size,
+                         const std::vector<std::vector<float>*>& states,
+                         float* probs,
+                         int64_t sampling_rate) const {
+    const size_t batch = windows.size();
+    if (batch == 0 || window_size == 0) {
+        return;
+    }
 
-    Ort::AllocatorWithDefaultOptions allocator;
     Ort::MemoryInfo mem_info = Ort::MemoryInfo::CreateCpu(
         OrtArenaAllocator, OrtMemTypeDefault);
 
-    std::vector<int64_t> input_shape{1, static_cast<int64_t>(audio.size())};
-    Ort::Value input_tensor = Ort::Value::CreateTensor<float>(
-        mem_info, const_cast<float*>(audio.data()),
-        audio.size(), input_shape.data(), input_shape.size());
+    std::vector<T> input;
+    std::vector<int64_t> input_shape{static_cast<int64_t>(batch),
+                                     static_cast<int64_t>(window_size)};
+    T* input_data = nullptr;
+    if constexpr (std::is_same_v<T, float>) {
+        if (batch == 1) {
+            input_data = const_cast<float*>(windows[0]);
+        }
+    }
+    if (!input_data) {
+        input.resize(batch * window_size);
+        for (size_t i = 0; i < batch; ++i) {
+            std::transform(windows[i], windows[i] + window_size, input.begin() + i * window_size,
+                           from_float<T>);
+        }
+        input_data = input.data();
+    }
+    Ort::Value input_tensor = Ort::Value::CreateTensor<T>(
+        mem_info, input_data, batch * window_size,
+        input_shape.data(), input_shape.size());
 
     std::vector<Ort::Value> inputs;
     std::vector<const char*> input_names;
@@ -111,7 +569,7 @@ float VadModel::get_speech_prob(const std::vector<float>& audio,
     inputs.emplace_back(std::move(input_tensor));
 
     std::vector<int64_t> sr_shape{1};
-    std::array<int64_t, 1> sr_value{impl_->sampling_rate};
+    std::array<int64_t, 1> sr_value{sampling_rate};
     Ort::Value sr_tensor(nullptr);
     if (impl_->has_sr) {
         sr_tensor = Ort::Value::CreateTensor<int64_t>(
@@ -121,15 +579,24 @@ float VadModel::get_speech_prob(const std::vector<float>& audio,
         inputs.emplace_back(std::move(sr_tensor));
     }
 
-    std::vector<int64_t> state_shape{2, 1, 128};
-    std::vector<float> local_state;
+    // Batched state is [2, N, 128]: layer k of window i sits at (k * N + i).
+    std::vector<int64_t> state_shape{2, static_cast<int64_t>(batch), kStateSize};
+    std::vector<T> local_state;
     if (impl_->has_state) {
-        if (state && !state->empty()) {
-            local_state = *state;
-        } else {
-            local_state = initialize_state();
+        local_state.assign(2 * batch * kStateSize, from_float<T>(0.0f));
+        for (size_t i = 0; i < batch; ++i) {
+            const auto* state = i < states.size() ? states[i] : nullptr;
+            if (!state || state->size() != 2 * kStateSize) {
+                continue;
+            }
+            for (size_t k = 0; k < 2; ++k) {
+                std::transform(state->begin() + k * kStateSize,
+                               state->begin() + (k + 1) * kStateSize,
+                               local_state.begin() + (k * batch + i) * kStateSize,
+                               from_float<T>);
+            }
         }
-        Ort::Value state_tensor = Ort::Value::CreateTensor<float>(
+        Ort::Value state_tensor = Ort::Value::CreateTensor<T>(
             mem_info, local_state.data(), local_state.size(),
             state_shape.data(), state_shape.size());
         input_names.push_back("state");
@@ -148,22 +615,35 @@ float VadModel::get_speech_prob(const std::vector<float>& audio,
         input_names.data(), inputs.data(), inputs.size(),
         output_names.data(), output_names.size());
 
-    float prob = 0.0f;
+    const T* prob_data = nullptr;
+    size_t prob_count = 0;
     if (!outputs.empty() && outputs[0].IsTensor()) {
-        auto* data = outputs[0].GetTensorMutableData<float>();
-        prob = data ? data[0] : 0.0f;
+        prob_data = outputs[0].GetTensorMutableData<T>();
+        prob_count = outputs[0].GetTensorTypeAndShapeInfo().GetElementCount();
+    }
+    for (size_t i = 0; i < batch; ++i) {
+        probs[i] = prob_data && i < prob_count ? to_float(prob_data[i]) : 0.0f;
     }
 
     if (impl_->has_state_out && outputs.size() > 1 && outputs[1].IsTensor()) {
-        auto* data = outputs[1].GetTensorMutableData<float>();
+        const auto* data = outputs[1].GetTensorMutableData<T>();
         const auto count = outputs[1].GetTensorTypeAndShapeInfo().GetElementCount();
-        if (state && data && count > 0) {
-            state->assign(data, data + count);
+        if (!data || count != 2 * batch * kStateSize) {
+            return;
+        }
+        for (size_t i = 0; i < batch && i < states.size(); ++i) {
+            auto* state = states[i];
+            if (!state) {
+                continue;
+            }
+            state->resize(2 * kStateSize);
+            for (size_t k = 0; k < 2; ++k) {
+                const auto* slice = data + (k * batch + i) * kStateSize;
+                std::transform(slice, slice + kStateSize, state->begin() + k * kStateSize,
+                               [](T value) { return to_float(value); });
+            }
         }
     }
-
-    return prob;
 }
 
 }
-
@@ -5,12 +5,16 @@
 #include <stdexcept>
 #include <vector>
 
+#include "sip_gateway/metrics.hpp"
+#include "sip_gateway/vad/batch_scheduler.hpp"
+#include "sip_gateway/vad/dsp.hpp"
 #include "sip_gateway/vad/model.hpp"
 
 
 namespace sip_gateway::vad {
 
 StreamingVadProcessor::StreamingVadProcessor(std::shared_ptr<VadModel> model,
+                                             int sampling_rate,
                                              float threshold,
                                              int min_speech_duration_ms,
                                              int min_silence_duration_ms,
@@ -18,6 +22,7 @@ StreamingVadProcessor::StreamingVadProcessor(std::shared_ptr<VadModel> model,
                                              int short_pause_ms,
                                              int long_pause_ms,
                                              int user_silence_duration_ms,
+                                             int max_utterance_ms,
                                              int speech_prob_window,
                                              bool use_dynamic_corrections,
                                              bool correction_debug,
@@ -25,16 +30,23 @@ StreamingVadProcessor::StreamingVadProcessor(std::shared_ptr<VadModel> model,
                                              double correction_exit_thres)
     : model_(std::move(model)),
       threshold_(threshold),
-      sampling_rate_(model_ ? model_->sampling_rate() : 16000),
-      speech_prob_window_(std::max(1, speech_prob_window)) {
+      sampling_rate_(sampling_rate > 0 ? sampling_rate
+                                       : model_ ? model_->sampling_rate() : 16000),
+      window_size_samples_(static_cast<int>(VadModel::window_size_for(sampling_rate_))),
+      speech_prob_window_(std::max(1, speech_prob_window)),
+      speech_buffer_(static_cast<size_t>(sampling_rate_) *
+                     static_cast<size_t>(std::max(0, max_utterance_ms)) / 1000),
+      // Silence beyond twice the padding or the minimum silence is dropped.
+      silence_buffer_(static_cast<size_t>(sampling_rate_) *
+                      static_cast<size_t>(std::max(
+                          0, std::max(speech_pad_ms * 2, min_silence_duration_ms))) / 1000) {
     min_speech_samples_ = sampling_rate_ * min_speech_duration_ms / 1000;
     min_silence_samples_ = sampling_rate_ * min_silence_duration_ms / 1000;
     speech_pad_samples_ = sampling_rate_ * speech_pad_ms / 1000;
     short_pause_samples_ = min_silence_samples_ + sampling_rate_ * short_pause_ms / 1000;
     long_pause_samples_ = short_pause_samples_ + sampling_rate_ * long_pause_ms / 1000;
     user_silence_samples_ = sampling_rate_ * user_silence_duration_ms / 1000;
-    const int max_silence_ms = std::max(speech_pad_ms * 2, min_silence_duration_ms);
-    max_silence_samples_ = sampling_rate_ * max_silence_ms / 1000;
+    window_.assign(static_cast<size_t>(window_size_samples_), 0.0f);
     if (model_) {
         state_ = model_->initialize_state();
     }
@@ -68,26 +80,59 @@ void StreamingVadProcessor::set_on_user_silence_timeout(SilenceCallback cb) {
     on_user_silence_timeout_ = std::move(cb);
 }
 
+void StreamingVadProcessor::set_batch_scheduler(std::shared_ptr<VadBatchScheduler> scheduler) {
+    batch_scheduler_ = std::move(scheduler);
+}
+
+void StreamingVadProcessor::set_energy_gate(const EnergyGateConfig& config) {
+    energy_gate_ = std::make_unique<EnergyGate>(config);
+}
+
+void StreamingVadProcessor::set_segment_pool(std::shared_ptr<SegmentPool> pool) {
+    segment_pool_ = std::move(pool);
+}
+
+const PauseInfo& StreamingVadProcessor::last_pause() const {
+    return last_pause_;
+}
+
+uint64_t StreamingVadProcessor::skipped_windows() const {
+    return skipped_windows_;
+}
+
+size_t StreamingVadProcessor::memory_bytes() const {
+    const size_t samples = speech_buffer_.allocated() + silence_buffer_.allocated() +
+                           window_.capacity() + normalized_.capacity();
+    return samples * sizeof(float);
+}
+
 void StreamingVadProcessor::process_samples(const std::vector<int16_t>& samples) {
-    if (!model_ || samples.empty()) {
+    process_samples(samples.data(), samples.size());
+}
+
+void StreamingVadProcessor::process_samples(const int16_t* samples, size_t count) {
+    if (!model_ || count == 0) {
         return;
     }
-    std::vector<float> audio;
-    audio.reserve(samples.size());
-    for (auto sample : samples) {
-        audio.push_back(static_cast<float>(sample) / 32768.0f);
-    }
-    buffer_.insert(buffer_.end(), audio.begin(), audio.end());
-    while (buffer_.size() >= static_cast<size_t>(window_size_samples_)) {
-        std::vector<float> window(buffer_.begin(),
-                                  buffer_.begin() + window_size_samples_);
-        buffer_.erase(buffer_.begin(),
-                      buffer_.begin() + window_size_samples_);
-        process_window(window);
+    const auto& kernels = dsp_kernels();
+    while (count > 0) {
+        const size_t take = std::min(count, window_.size() - window_fill_);
+        kernels.pcm16_to_float(samples, window_.data() + window_fill_, take);
+        window_fill_ += take;
+        samples += take;
+        count -= take;
+        if (window_fill_ == window_.size()) {
+            window_fill_ = 0;
+            process_window(window_);
+        }
     }
 }
 
 void StreamingVadProcessor::finalize() {
+    if (gated_windows_ > 0) {
+        Metrics::instance().increment_counter("vad_inferences_skipped_total", {}, gated_windows_);
+        gated_windows_ = 0;
+    }
     if (speech_buffer_.size() >= static_cast<size_t>(min_speech_samples_)) {
         fire_long_pause();
     }
@@ -115,19 +160,29 @@ void StreamingVadProcessor::set_long_pause_suspended(bool suspended) {
 }
 
 float StreamingVadProcessor::get_smoothed_prob(const std::vector<float>& window) {
-    std::vector<float> normalized = window;
-    float max_amp = 0.0f;
-    for (auto val : normalized) {
-        max_amp = std::max(max_amp, std::abs(val));
-    }
+    auto& normalized = normalized_;
+    const auto& kernels = dsp_kernels();
+    normalized.assign(window.begin(), window.end());
+    const float max_amp = kernels.peak_abs(normalized.data(), normalized.size());
     if (max_amp > 1.0f || max_amp < 0.01f) {
         if (max_amp > 0.0f) {
-            for (auto& val : normalized) {
-                val /= max_amp;
-            }
+            kernels.divide(normalized.data(), normalized.size(), max_amp);
+        }
+    }
+    float prob = 0.0f;
+    if (batch_scheduler_) {
+        prob = batch_scheduler_->get_speech_prob(normalized, &state_, sampling_rate_);
+    } else {
+        if (!stream_) {
+            stream_ = model_->create_stream(normalized.size(), sampling_rate_);
         }
+        prob = stream_->get_speech_prob(normalized.data(), normalized.size());
     }
-    float prob = model_->get_speech_prob(normalized, &state_);
+    last_prob_ = prob;
+    return smooth_prob(prob);
+}
+
+float StreamingVadProcessor::smooth_prob(float prob) {
     prob_history_.push_back(prob);
     if (prob_history_.size() > static_cast<size_t>(speech_prob_window_)) {
         prob_history_.pop_front();
@@ -146,41 +201,65 @@ float StreamingVadProcessor::get_smoothed_prob(const std::vector<float>& window)
     return weighted_sum / weight_total;
 }
 
+void StreamingVadProcessor::resume_inference() {
+    // The counter is bumped once per skipped run, not per window.
+    Metrics::instance().increment_counter("vad_inferences_skipped_total", {}, gated_windows_);
+    gated_windows_ = 0;
+    if (!energy_gate_->config().reset_on_resume) {
+        return;
+    }
+    if (stream_) {
+        stream_->reset();
+    }
+    state_ = model_->initialize_state();
+}
+
 void StreamingVadProcessor::process_window(const std::vector<float>& window) {
-    const float speech_prob = get_smoothed_prob(window);
-    bool is_speech_frame = speech_prob > threshold_;
-    if (use_dynamic_corrections_ && correction_) {
-        double energy_acc = 0.0;
-        for (float value : window) {
-            energy_acc += static_cast<double>(value * value);
+    const bool use_correction = use_dynamic_corrections_ && correction_;
+    double frame_energy = 0.0;
+    if (use_correction || energy_gate_) {
+        const double energy_acc = dsp_kernels().sum_squares(window.data(), window.size());
+        frame_energy = std::sqrt(energy_acc / window.size());
+    }
+    float speech_prob = 0.0f;
+    if (energy_gate_ && energy_gate_->should_skip(frame_energy, last_prob_)) {
+        ++gated_windows_;
+        ++skipped_windows_;
+        last_prob_ = 0.0f;
+        speech_prob = smooth_prob(0.0f);
+    } else {
+        if (gated_windows_ > 0) {
+            resume_inference();
         }
-        const double frame_energy = std::sqrt(energy_acc / window.size());
+        speech_prob = get_smoothed_prob(window);
+    }
+    bool is_speech_frame = speech_prob > threshold_;
+    if (use_correction) {
         is_speech_frame = correction_->process_frame(speech_prob, frame_energy);
     }
     current_sample_ += static_cast<int64_t>(window.size());
 
     if (active_long_speech_) {
-        speech_buffer_.insert(speech_buffer_.end(), window.begin(), window.end());
+        speech_buffer_.push(window.data(), window.size());
         if (is_speech_frame) {
-            if (!silence_buffer_.empty()) {
-                silence_buffer_.clear();
-            }
+            silence_buffer_.clear();
         } else {
-            grow_silence_buffer(window);
+            silence_buffer_.push(window.data(), window.size());
         }
     } else {
         if (is_speech_frame) {
-            speech_buffer_.insert(speech_buffer_.end(), window.begin(), window.end());
+            speech_buffer_.push(window.data(), window.size());
         } else {
             if (!speech_buffer_.empty()) {
-                grow_silence_buffer(speech_buffer_);
+                silence_buffer_.push(speech_buffer_);
                 speech_buffer_.clear();
             }
-            grow_silence_buffer(window);
+            silence_buffer_.push(window.data(), window.size());
         }
     }
 
     if (is_speech_frame) {
+        last_speech_sample_ = current_sample_;
         if (!active_speech_) {
             speech_start_ = current_sample_ - static_cast<int64_t>(window.size());
             if (speech_buffer_.size() >= static_cast<size_t>(min_speech_samples_)) {
@@ -209,32 +288,25 @@ void StreamingVadProcessor::process_window(const std::vector<float>& window) {
     }
 }
 
-void StreamingVadProcessor::grow_silence_buffer(const std::vector<float>& window) {
-    silence_buffer_.insert(silence_buffer_.end(), window.begin(), window.end());
-    if (silence_buffer_.size() > static_cast<size_t>(max_silence_samples_)) {
-        silence_buffer_.erase(
-            silence_buffer_.begin(),
-            silence_buffer_.begin() + (silence_buffer_.size() - max_silence_samples_));
-    }
-}
-
 void StreamingVadProcessor::fire_speech_start() {
     active_speech_ = true;
     if (!active_long_speech_) {
         active_long_speech_ = true;
+        ++utterance_id_;
+        utterance_start_ = speech_start_;
         const size_t start_padding = std::min(
             static_cast<size_t>(speech_pad_samples_), silence_buffer_.size());
-        silence_pad_buffer_ = apply_fade(
-            std::vector<float>(silence_buffer_.end() - start_padding,
-                               silence_buffer_.end()),
-            true);
+        auto padding = take_buffer(start_padding);
+        silence_buffer_.copy_to(silence_buffer_.size() - start_padding, start_padding, padding);
+        apply_fade(padding.data(), padding.data(), padding.size(), true);
+        silence_pad_ = make_segment(std::move(padding));
     }
     silence_buffer_.clear();
     if (on_speech_start_) {
         double start = 0.0;
         double duration = 0.0;
-        times_sec(silence_pad_buffer_, start, duration);
-        on_speech_start_(silence_pad_buffer_, start, duration);
+        times_sec(silence_pad_.size(), start, duration);
+        on_speech_start_(silence_pad_, start, duration);
     }
 }
 
@@ -252,53 +324,72 @@ void StreamingVadProcessor::fire_speech_end() {
         std::max<int64_t>(0, static_cast<int64_t>(speech_buffer_.size()) + start_offset);
     const int64_t end_index =
         std::max<int64_t>(0, static_cast<int64_t>(speech_buffer_.size()) + end_offset);
-    std::vector<float> buffer;
-    if (end_index > start_index) {
-        buffer.assign(speech_buffer_.begin() + start_index,
-                      speech_buffer_.begin() + end_index);
-    }
     if (on_speech_end_) {
+        auto buffer = take_buffer(
+            static_cast<size_t>(std::max<int64_t>(0, end_index - start_index)));
+        if (end_index > start_index) {
+            speech_buffer_.copy_to(static_cast<size_t>(start_index),
+                                   static_cast<size_t>(end_index - start_index), buffer);
+        }
         double start = 0.0;
         double duration = 0.0;
-        times_sec(buffer, start, duration);
-        on_speech_end_(buffer, start, duration);
+        times_sec(buffer.size(), start, duration);
+        on_speech_end_(make_segment(std::move(buffer)), start, duration);
     }
 }
 
-void StreamingVadProcessor::fire_short_pause() {
+audio::AudioSegment StreamingVadProcessor::pause_segment() const {
     const size_t silence_length = silence_buffer_.size();
-    auto silence_postfix = apply_fade(silence_buffer_, false);
-    std::vector<float> buffer = silence_pad_buffer_;
-    if (speech_buffer_.size() > silence_length) {
-        buffer.insert(buffer.end(),
-                      speech_buffer_.begin(),
-                      speech_buffer_.end() - silence_length);
+    const size_t speech_length =
+        speech_buffer_.size() > silence_length ? speech_buffer_.size() - silence_length : 0;
+    auto buffer = take_buffer(silence_pad_.size() + speech_length + silence_length);
+    buffer.insert(buffer.end(), silence_pad_.samples().begin(), silence_pad_.samples().end());
+    speech_buffer_.copy_to(0, speech_length, buffer);
+    const size_t postfix = buffer.size();
+    silence_buffer_.copy_to(0, silence_length, buffer);
+    apply_fade(buffer.data() + postfix, buffer.data() + postfix, buffer.size() - postfix, false);
+    return make_segment(std::move(buffer));
+}
+
+std::vector<float> StreamingVadProcessor::take_buffer(size_t capacity) const {
+    if (segment_pool_) {
+        return segment_pool_->take(capacity);
     }
-    buffer.insert(buffer.end(), silence_postfix.begin(), silence_postfix.end());
+    std::vector<float> buffer;
+    buffer.reserve(capacity);
+    return buffer;
+}
+
+audio::AudioSegment StreamingVadProcessor::make_segment(std::vector<float> samples) const {
+    if (segment_pool_) {
+        return audio::AudioSegment(segment_pool_->share(std::move(samples)));
+    }
+    return audio::AudioSegment(std::move(samples));
+}
+
+void StreamingVadProcessor::fire_short_pause() {
+    last_pause_ = {utterance_id_, utterance_start_, last_speech_sample_};
     if (on_short_pause_) {
+        const auto segment = pause_segment();
         double start = 0.0;
         double duration = 0.0;
-        times_sec(buffer, start, duration);
-        on_short_pause_(buffer, start, duration);
+        times_sec(segment.size(), start, duration);
+        on_short_pause_(segment, start, duration);
     }
     short_pause_fired_ = true;
 }
 
 void StreamingVadProcessor::fire_long_pause() {
-    const size_t silence_length = silence_buffer_.size();
-    auto silence_postfix = apply_fade(silence_buffer_, false);
-    std::vector<float> buffer = silence_pad_buffer_;
-    if (speech_buffer_.size() > silence_length) {
-        buffer.insert(buffer.end(),
-                      speech_buffer_.begin(),
-                      speech_buffer_.end() - silence_length);
+    last_pause_ = {utterance_id_, utterance_start_, last_speech_sample_};
+    if (speech_buffer_.dropped() > 0) {
+        Metrics::instance().increment_counter("vad_utterance_truncated_total");
     }
-    buffer.insert(buffer.end(), silence_postfix.begin(), silence_postfix.end());
     if (on_long_pause_) {
+        const auto segment = pause_segment();
         double start = 0.0;
         double duration = 0.0;
-        times_sec(buffer, start, duration);
-        on_long_pause_(buffer, start, duration);
+        times_sec(segment.size(), start, duration);
+        on_long_pause_(segment, start, duration);
     }
     short_pause_fired_ = false;
     active_long_speech_ = false;
@@ -312,40 +403,17 @@ void StreamingVadProcessor::fire_user_silence_timeout() {
     user_silence_timeout_fired_ = true;
 }
 
-std::vector<float> StreamingVadProcessor::apply_fade(const std::vector<float>& audio,
-                                                     bool fade_in) const {
-    std::vector<float> result;
-    const size_t length = audio.size();
-    if (length == 0) {
-        return result;
-    }
-    result.reserve(length);
-    if (length == 1) {
-        result.push_back(audio.front());
-        return result;
-    }
-    for (size_t i = 0; i < length; ++i) {
-        const float ratio = static_cast<float>(i) / static_cast<float>(length - 1);
-        float curve = std::sin(ratio * 1.57079632679f);
-        if (!fade_in) {
-            curve = 1.0f - curve;
-        }
-        result.push_back(audio[i] * curve);
-    }
-    return result;
-}
-
 double StreamingVadProcessor::current_time_sec() const {
     return static_cast<double>(current_sample_) /
            static_cast<double>(sampling_rate_);
 }
 
-void StreamingVadProcessor::times_sec(const std::vector<float>& audio,
+void StreamingVadProcessor::times_sec(size_t samples,
                                       double& start,
                                       double& duration) const {
-    start = static_cast<double>(current_sample_ - audio.size()) /
+    start = static_cast<double>(current_sample_ - static_cast<int64_t>(samples)) /
             static_cast<double>(sampling_rate_);
-    duration = static_cast<double>(audio.size()) /
+    duration = static_cast<double>(samples) /
                static_cast<double>(sampling_rate_);
 }
 
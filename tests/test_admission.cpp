@@ -0,0 +1,131 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+
+#include "sip_gateway/metrics.hpp"
+#include "sip_gateway/sip/admission.hpp"
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+using sip_gateway::AdmissionController;
+using sip_gateway::AdmissionOptions;
+using sip_gateway::LoadSample;
+using sip_gateway::Metrics;
+
+namespace {
+
+// Samples every interval for duration, running work before each sample.
+template <typename Fn>
+void sample_for(AdmissionController& controller,
+                std::chrono::milliseconds interval,
+                std::chrono::milliseconds duration,
+                Fn&& work) {
+    const auto until = std::chrono::steady_clock::now() + duration;
+    while (std::chrono::steady_clock::now() < until) {
+        work();
+        controller.sample();
+        std::this_thread::sleep_for(interval);
+    }
+}
+
+}
+
+TEST_CASE("AdmissionController scores the most loaded signal") {
+    AdmissionOptions options;
+    options.max_calls = 10;
+    options.vad_cpu_cores = 2.0;
+    options.max_backlog = 100;
+    options.backend_p95_sec = 2.0;
+    AdmissionController controller(options);
+
+    LoadSample sample;
+    sample.live_calls = 5;
+    sample.vad_cpu_cores = 0.5;
+    sample.backlog = 10;
+    auto report = controller.assess(sample);
+    REQUIRE(report.calls == Catch::Approx(0.5));
+    REQUIRE(report.vad_cpu == Catch::Approx(0.25));
+    REQUIRE(report.backlog == Catch::Approx(0.1));
+    REQUIRE(report.backend_latency == 0.0);
+    REQUIRE(std::string(report.limiting) == "calls");
+    REQUIRE_FALSE(report.over_budget());
+
+    sample.backend_p95_sec = 2.5;
+    report = controller.assess(sample);
+    REQUIRE(std::string(report.limiting) == "backend_latency");
+    REQUIRE(report.score == Catch::Approx(1.25));
+    REQUIRE(report.over_budget());
+
+    sample.backend_p95_sec.reset();
+    sample.live_calls = 10;
+    REQUIRE(controller.assess(sample).over_budget());
+}
+
+TEST_CASE("Histogram fine count differences give windowed quantiles") {
+    auto& histogram = Metrics::instance().histogram("test_admission_window");
+    for (int i = 0; i < 100; ++i) {
+        histogram.observe(0.01);
+    }
+    const auto before = histogram.fine_counts();
+    for (int i = 0; i < 100; ++i) {
+        histogram.observe(1.0);
+    }
+    auto window = histogram.fine_counts();
+    for (size_t i = 0; i < window.size(); ++i) {
+        window[i] -= before[i];
+    }
+    const auto p95 = Metrics::Histogram::quantile_of(window, 0.95);
+    REQUIRE(p95);
+    REQUIRE(*p95 >= 1.0);
+    REQUIRE(*p95 < 1.13); // Within 1.0's log-linear bucket.
+    REQUIRE(*histogram.quantile(0.25) < 0.02);
+    REQUIRE_FALSE(Metrics::Histogram::quantile_of({}, 0.5));
+}
+
+TEST_CASE("AdmissionController measures its window however rarely it is polled") {
+    AdmissionOptions options;
+    options.vad_cpu_cores = 1.0;
+    options.window = std::chrono::milliseconds(200);
+    options.sample_interval = std::chrono::milliseconds(10);
+    AdmissionController controller(options);
+    auto& vad = Metrics::instance().histogram("vad_inference");
+    auto& backend = Metrics::instance().histogram("backend_request_reused_conn");
+
+    // Half a core of inference and slow backend requests, sampled on the
+    // tick for twice the window with no evaluate() in between.
+    controller.sample();
+    sample_for(controller, std::chrono::milliseconds(10), std::chrono::milliseconds(400), [&]() {
+        vad.observe(0.005);
+        backend.observe(0.5);
+        backend.observe(0.5);
+    });
+    auto report = controller.evaluate(0, 0);
+    REQUIRE(report.sample.vad_cpu_cores > 0.05);
+    REQUIRE(report.sample.vad_cpu_cores < 0.6);
+    REQUIRE(report.sample.backend_p95_sec);
+    REQUIRE(*report.sample.backend_p95_sec >= 0.5);
+    REQUIRE(*report.sample.backend_p95_sec < 0.57); // Within 0.5's bucket.
+
+    // An idle window later the earlier load has left it.
+    sample_for(controller, std::chrono::milliseconds(10), std::chrono::milliseconds(300), []() {});
+    report = controller.evaluate(0, 0);
+    REQUIRE(report.sample.vad_cpu_cores == 0.0);
+    REQUIRE_FALSE(report.sample.backend_p95_sec);
+
+    // Sparse polling: a single evaluate() long after load still sees the
+    // load the ticks recorded inside the window.
+    sample_for(controller, std::chrono::milliseconds(10), std::chrono::milliseconds(150), [&]() {
+        vad.observe(0.005);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    REQUIRE(controller.evaluate(0, 0).sample.vad_cpu_cores > 0.05);
+}
+
+TEST_CASE("AdmissionController reports no rates before its first sample") {
+    AdmissionController controller(AdmissionOptions{});
+    Metrics::instance().histogram("vad_inference").observe(1.0);
+    const auto report = controller.evaluate(1, 0);
+    REQUIRE(report.sample.vad_cpu_cores == 0.0);
+    REQUIRE_FALSE(report.sample.backend_p95_sec);
+}
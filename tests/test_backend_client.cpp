@@ -0,0 +1,127 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "sip_gateway/backend/client.hpp"
+#include "sip_gateway/metrics.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+
+using sip_gateway::BackendCallPolicy;
+using sip_gateway::BackendClient;
+using sip_gateway::BackendDeadlineError;
+using sip_gateway::BackendRequestOptions;
+using sip_gateway::Metrics;
+
+namespace {
+
+// Answers GET /audio with the number of the request; the first one waits
+// first_delay before answering.
+class AudioServer {
+public:
+    explicit AudioServer(std::chrono::milliseconds first_delay) {
+        server_.Get("/audio", [this, first_delay](const httplib::Request&, httplib::Response& res) {
+            const int number = ++requests_;
+            if (number == 1) {
+                std::this_thread::sleep_for(first_delay);
+            }
+            res.set_content("response " + std::to_string(number), "application/octet-stream");
+        });
+        port_ = server_.bind_to_any_port("127.0.0.1");
+        thread_ = std::thread([this]() { server_.listen_after_bind(); });
+        server_.wait_until_ready();
+    }
+
+    ~AudioServer() {
+        server_.stop();
+        thread_.join();
+    }
+
+    std::string url() const { return "http://127.0.0.1:" + std::to_string(port_); }
+    int requests() const { return requests_; }
+
+private:
+    httplib::Server server_;
+    int port_ = 0;
+    std::atomic<int> requests_{0};
+    std::thread thread_;
+};
+
+void run_detached(std::function<void()> task) {
+    std::thread(std::move(task)).detach();
+}
+
+// Hedges after about min_delay once the method has a latency sample.
+BackendRequestOptions hedged_options(const std::string& method) {
+    Metrics::instance().observe_response_time(method, 0.001);
+    BackendRequestOptions options;
+    options.hedge.enabled = true;
+    options.hedge.min_samples = 1;
+    options.hedge.min_delay = std::chrono::milliseconds(20);
+    options.executor = run_detached;
+    return options;
+}
+
+uint64_t hedges(const std::string& method, const std::string& result) {
+    return Metrics::instance()
+        .counter("backend_hedges_total", {{"method", method}, {"result", result}})
+        .value();
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+TEST_CASE("A slow request is hedged and the first response wins") {
+    const std::string method = "test_hedge_wins";
+    AudioServer server(std::chrono::seconds(2));
+    BackendClient client(server.url(), std::nullopt, hedged_options(method));
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto body = client.get_binary("/audio", "text=hi", {method, std::nullopt});
+
+    REQUIRE(body == "response 2");
+    REQUIRE(seconds_since(start) < 1.0);
+    REQUIRE(server.requests() == 2);
+    REQUIRE(hedges(method, "won") == 1);
+}
+
+TEST_CASE("A request answered before the hedge delay is not hedged") {
+    const std::string method = "test_hedge_not_needed";
+    AudioServer server(std::chrono::milliseconds(0));
+    BackendClient client(server.url(), std::nullopt, hedged_options(method));
+
+    REQUIRE(client.get_binary("/audio", "text=hi", {method, std::nullopt}) == "response 1");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    REQUIRE(server.requests() == 1);
+    REQUIRE(hedges(method, "won") == 0);
+    REQUIRE(hedges(method, "lost") == 0);
+}
+
+TEST_CASE("A request past its deadline is aborted") {
+    AudioServer server(std::chrono::seconds(2));
+    BackendRequestOptions options;
+    options.executor = run_detached;
+    BackendClient client(server.url(), std::nullopt, options);
+
+    BackendCallPolicy policy;
+    policy.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+    const auto start = std::chrono::steady_clock::now();
+    REQUIRE_THROWS_AS(client.get_binary("/audio", "text=hi", policy), BackendDeadlineError);
+    REQUIRE(seconds_since(start) < 1.0);
+}
+
+TEST_CASE("A deadline bounds the socket timeouts without an executor") {
+    AudioServer server(std::chrono::seconds(2));
+    BackendClient client(server.url(), std::nullopt, BackendRequestOptions{});
+
+    BackendCallPolicy policy;
+    policy.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+    const auto start = std::chrono::steady_clock::now();
+    REQUIRE_THROWS_AS(client.get_binary("/audio", "text=hi", policy), BackendDeadlineError);
+    REQUIRE(seconds_since(start) < 1.0);
+}
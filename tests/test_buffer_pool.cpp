@@ -0,0 +1,76 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "sip_gateway/utils/buffer_pool.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+using sip_gateway::utils::BufferPool;
+
+TEST_CASE("BufferPool reuses storage given back") {
+    BufferPool<std::vector<float>> pool(2);
+    auto buffer = pool.take(256);
+    REQUIRE(buffer.empty());
+    REQUIRE(buffer.capacity() >= 256);
+    buffer.assign(100, 1.0f);
+    const float* storage = buffer.data();
+    pool.give(std::move(buffer));
+    REQUIRE(pool.idle_bytes() >= 256 * sizeof(float));
+
+    auto again = pool.take(128);
+    REQUIRE(again.empty());
+    REQUIRE(again.data() == storage);
+    REQUIRE(pool.idle_bytes() == 0);
+}
+
+TEST_CASE("BufferPool prefers the smallest idle buffer that fits") {
+    BufferPool<std::string> pool(4);
+    auto small = pool.take(16);
+    auto large = pool.take(1024);
+    const char* large_storage = large.data();
+    pool.give(std::move(small));
+    pool.give(std::move(large));
+
+    REQUIRE(pool.take(512).data() == large_storage);
+}
+
+TEST_CASE("BufferPool keeps at most max_idle buffers") {
+    BufferPool<std::vector<float>> pool(1);
+    auto first = pool.take(64);
+    auto second = pool.take(64);
+    pool.give(std::move(first));
+    const auto kept = pool.idle_bytes();
+    pool.give(std::move(second));
+    REQUIRE(pool.idle_bytes() == kept);
+
+    pool.release();
+    REQUIRE(pool.idle_bytes() == 0);
+}
+
+TEST_CASE("BufferPool takes shared buffers back when the last holder drops them") {
+    auto pool = std::make_shared<BufferPool<std::vector<float>>>();
+    auto buffer = pool->take(32);
+    buffer.assign(32, 0.5f);
+    const float* storage = buffer.data();
+
+    auto shared = pool->share(std::move(buffer));
+    auto copy = shared;
+    REQUIRE(shared->size() == 32);
+    REQUIRE(pool->shared_bytes() >= 32 * sizeof(float));
+    REQUIRE(pool->idle_bytes() == 0);
+
+    shared.reset();
+    REQUIRE(pool->idle_bytes() == 0);
+    copy.reset();
+    REQUIRE(pool->shared_bytes() == 0);
+    REQUIRE(pool->take(32).data() == storage);
+}
+
+TEST_CASE("BufferPool shared buffers outlive the pool") {
+    auto pool = std::make_shared<BufferPool<std::vector<float>>>();
+    auto shared = pool->share(std::vector<float>(8, 1.0f));
+    pool.reset();
+    REQUIRE(shared->size() == 8);
+    REQUIRE((*shared)[7] == 1.0f);
+}
@@ -0,0 +1,100 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "sip_gateway/sip/call_registry.hpp"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
+using sip_gateway::CallRegistry;
+
+namespace {
+
+struct FakeCall {
+    int id;
+};
+
+}
+
+TEST_CASE("CallRegistry finds calls by id and by session") {
+    CallRegistry<FakeCall> registry;
+    auto first = std::make_shared<FakeCall>(FakeCall{1});
+    registry.insert(1, first);
+    REQUIRE(registry.find(1) == first);
+    REQUIRE_FALSE(registry.find_session("s1"));
+
+    // Binding a session later keeps the call; re-registering without one
+    // keeps the binding.
+    registry.insert(1, first, std::string("s1"));
+    registry.insert(1, first);
+    REQUIRE(registry.find_session("s1") == first);
+
+    auto second = std::make_shared<FakeCall>(FakeCall{2});
+    registry.insert(2, second, std::string("s2"));
+    REQUIRE(registry.size() == 2);
+
+    const auto before = registry.snapshot();
+    REQUIRE(registry.erase(1) == first);
+    REQUIRE_FALSE(registry.erase(1));
+    REQUIRE_FALSE(registry.find_session("s1"));
+    REQUIRE(registry.find_session("s2") == second);
+    // Earlier snapshots are unchanged.
+    REQUIRE(before->calls.size() == 2);
+    REQUIRE(before->sessions.count("s1") == 1);
+
+    const auto cleared = registry.clear();
+    REQUIRE(cleared->calls.size() == 1);
+    REQUIRE(registry.size() == 0);
+}
+
+TEST_CASE("CallRegistry rebinding a session leaves the new call bound") {
+    CallRegistry<FakeCall> registry;
+    registry.insert(1, std::make_shared<FakeCall>(FakeCall{1}), std::string("s"));
+    auto replacement = std::make_shared<FakeCall>(FakeCall{2});
+    registry.insert(2, replacement, std::string("s"));
+    registry.erase(1);
+    REQUIRE(registry.find_session("s") == replacement);
+}
+
+TEST_CASE("CallRegistry erasing a stale call keeps the call that reused its id") {
+    CallRegistry<FakeCall> registry;
+    auto stale = std::make_shared<FakeCall>(FakeCall{1});
+    registry.insert(1, stale, std::string("old"));
+    registry.erase(1);
+    auto reused = std::make_shared<FakeCall>(FakeCall{1});
+    registry.insert(1, reused, std::string("new"));
+
+    REQUIRE_FALSE(registry.erase(1, stale));
+    REQUIRE(registry.find(1) == reused);
+    REQUIRE(registry.find_session("new") == reused);
+    REQUIRE(registry.erase(1, reused));
+    REQUIRE(registry.size() == 0);
+}
+
+TEST_CASE("CallRegistry readers run alongside writers") {
+    CallRegistry<FakeCall> registry;
+    std::atomic<bool> done{false};
+    std::atomic<int> mismatches{0};
+    std::thread reader([&]() {
+        while (!done.load()) {
+            const auto snapshot = registry.snapshot();
+            for (const auto& [id, entry] : snapshot->calls) {
+                if (entry.call->id != id) {
+                    ++mismatches;
+                }
+            }
+        }
+    });
+    for (int i = 0; i < 2000; ++i) {
+        registry.insert(i % 32, std::make_shared<FakeCall>(FakeCall{i % 32}),
+                        "s" + std::to_string(i % 32));
+        if (i % 3 == 0) {
+            registry.erase((i + 7) % 32);
+        }
+    }
+    done = true;
+    reader.join();
+    REQUIRE(mismatches == 0);
+    REQUIRE(registry.size() <= 32);
+}
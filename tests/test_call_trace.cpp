@@ -0,0 +1,84 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "sip_gateway/sip/call_trace.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using sip_gateway::CallTraceReader;
+using sip_gateway::CallTraceRecord;
+using sip_gateway::CallTraceWriter;
+
+TEST_CASE("CallTrace round-trips every record kind in order") {
+    const auto dir = std::filesystem::temp_directory_path() / "sip_gateway_call_trace_test";
+    std::filesystem::remove_all(dir);
+    const auto path = dir / "call.sgtrace";
+    {
+        CallTraceWriter writer(path, 8000);
+        const std::vector<int16_t> frame = {0, 1, -1, 32767, -32768, 300};
+        writer.audio(frame.data(), frame.size());
+        writer.ws_message(R"({"type":"message","message":"hi"})");
+        writer.backend("transcribe", std::chrono::milliseconds(250), true);
+        writer.vad(CallTraceRecord::VadEvent::LongPause, 1.5, 0.75);
+        writer.backend("start", std::chrono::microseconds(1), false);
+        writer.close();
+        // Records after close are dropped.
+        writer.ws_message("{}");
+    }
+
+    CallTraceReader reader(path);
+    REQUIRE(reader.sample_rate() == 8000);
+    CallTraceRecord record;
+    REQUIRE(reader.next(record));
+    REQUIRE(record.kind == CallTraceRecord::Kind::Audio);
+    REQUIRE(record.samples == std::vector<int16_t>{0, 1, -1, 32767, -32768, 300});
+    double last_wall = record.wall_sec;
+
+    REQUIRE(reader.next(record));
+    REQUIRE(record.kind == CallTraceRecord::Kind::WsMessage);
+    REQUIRE(record.text == R"({"type":"message","message":"hi"})");
+    REQUIRE(record.wall_sec >= last_wall);
+    last_wall = record.wall_sec;
+
+    REQUIRE(reader.next(record));
+    REQUIRE(record.kind == CallTraceRecord::Kind::Backend);
+    REQUIRE(record.text == "transcribe");
+    REQUIRE(record.duration_sec == 0.25);
+    REQUIRE(record.ok);
+    REQUIRE(record.wall_sec >= last_wall);
+
+    REQUIRE(reader.next(record));
+    REQUIRE(record.kind == CallTraceRecord::Kind::Vad);
+    REQUIRE(record.vad == CallTraceRecord::VadEvent::LongPause);
+    REQUIRE(record.start_sec == 1.5);
+    REQUIRE(record.duration_sec == 0.75);
+
+    REQUIRE(reader.next(record));
+    REQUIRE(record.text == "start");
+    REQUIRE_FALSE(record.ok);
+    REQUIRE_FALSE(reader.next(record));
+}
+
+TEST_CASE("CallTraceReader rejects foreign and truncated files") {
+    const auto dir = std::filesystem::temp_directory_path() / "sip_gateway_call_trace_test";
+    std::filesystem::create_directories(dir);
+    const auto foreign = dir / "foreign.sgtrace";
+    std::ofstream(foreign, std::ios::binary) << "RIFF0000WAVE";
+    REQUIRE_THROWS_AS(CallTraceReader(foreign), std::runtime_error);
+
+    const auto path = dir / "truncated.sgtrace";
+    {
+        CallTraceWriter writer(path, 16000);
+        const std::vector<int16_t> frame(320, 7);
+        writer.audio(frame.data(), frame.size());
+    }
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+    CallTraceReader reader(path);
+    CallTraceRecord record;
+    REQUIRE_THROWS_AS(reader.next(record), std::runtime_error);
+}
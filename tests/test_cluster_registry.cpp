@@ -0,0 +1,99 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "sip_gateway/sip/cluster_registry.hpp"
+
+#include <chrono>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using sip_gateway::ClusterNode;
+using sip_gateway::ClusterOptions;
+using sip_gateway::ClusterRegistry;
+
+namespace {
+
+ClusterOptions node_a() {
+    ClusterOptions options;
+    options.node_id = "a";
+    options.advertise_url = "https://10.0.0.1:8000";
+    options.heartbeat = std::chrono::seconds(5);
+    options.peers = {"https://10.0.0.2:8000"};
+    return options;
+}
+
+}
+
+TEST_CASE("ClusterRegistry publishes sessions and load") {
+    ClusterRegistry registry(node_a(), [](const std::string&) { return std::nullopt; });
+    sip_gateway::LoadReport load;
+    load.sample.live_calls = 2;
+    load.score = 0.25;
+
+    const auto record = registry.node_record({"s1", "s2"}, load);
+    REQUIRE(record["node_id"] == "a");
+    REQUIRE(record["url"] == "https://10.0.0.1:8000");
+    REQUIRE(record["sessions"] == nlohmann::json::array({"s1", "s2"}));
+    REQUIRE(record["calls"] == 2);
+    REQUIRE(record["accepting"] == true);
+    REQUIRE(record["ttl_sec"] == 15);
+}
+
+TEST_CASE("ClusterRegistry caches remote owners") {
+    int lookups = 0;
+    ClusterRegistry registry(node_a(), [&](const std::string&) {
+        ++lookups;
+        return std::optional<ClusterNode>(ClusterNode{"b", "https://10.0.0.2:8000/"});
+    });
+
+    const auto owner = registry.remote_owner("s1");
+    REQUIRE(owner);
+    REQUIRE(owner->node_id == "b");
+    REQUIRE(registry.remote_owner("s1")->url == "https://10.0.0.2:8000/");
+    REQUIRE(lookups == 1);
+
+    registry.forget("s1");
+    REQUIRE(registry.remote_owner("s1"));
+    REQUIRE(lookups == 2);
+}
+
+TEST_CASE("ClusterRegistry ignores its own, unknown and failed lookups") {
+    int lookups = 0;
+    ClusterRegistry registry(node_a(), [&](const std::string& session_id)
+                                           -> std::optional<ClusterNode> {
+        ++lookups;
+        if (session_id == "mine") {
+            return ClusterNode{"a", "https://10.0.0.1:8000"};
+        }
+        if (session_id == "broken") {
+            throw std::runtime_error("registry down");
+        }
+        return std::nullopt;
+    });
+
+    REQUIRE_FALSE(registry.remote_owner("mine"));
+    REQUIRE_FALSE(registry.remote_owner("unknown"));
+    REQUIRE_FALSE(registry.remote_owner("broken"));
+    // Misses are not cached: the session may be published a moment later.
+    REQUIRE_FALSE(registry.remote_owner("unknown"));
+    REQUIRE(lookups == 4);
+}
+
+TEST_CASE("ClusterRegistry refuses owners that are not configured peers") {
+    int lookups = 0;
+    ClusterRegistry registry(node_a(), [&](const std::string& session_id)
+                                           -> std::optional<ClusterNode> {
+        ++lookups;
+        if (session_id == "plain") {
+            return ClusterNode{"b", "http://10.0.0.2:8000"};
+        }
+        return ClusterNode{"c", "https://attacker.example"};
+    });
+
+    REQUIRE_FALSE(registry.remote_owner("elsewhere"));
+    REQUIRE_FALSE(registry.remote_owner("plain"));
+    // Refusals are not cached, so a fixed registry entry is picked up.
+    REQUIRE_FALSE(registry.remote_owner("elsewhere"));
+    REQUIRE(lookups == 3);
+}
@@ -0,0 +1,137 @@
+#include <catch2/catch_approx.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "sip_gateway/vad/correction.hpp"
+
+#include <cstdint>
+#include <vector>
+
+using namespace sip_gateway::vad;
+
+namespace {
+
+struct Trace {
+    std::vector<double> probs;
+    std::vector<double> energies;
+};
+
+// Alternating silence and speech runs with jittered probability and
+// energy, from a fixed LCG so the trace is identical everywhere.
+Trace make_trace(uint32_t seed, size_t frames) {
+    auto next = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return static_cast<double>(seed >> 8) / 16777216.0;
+    };
+    Trace trace;
+    bool speech = false;
+    size_t remaining = 0;
+    while (trace.probs.size() < frames) {
+        if (remaining == 0) {
+            speech = !speech;
+            remaining = speech ? 20 + static_cast<size_t>(next() * 130)
+                               : 40 + static_cast<size_t>(next() * 160);
+        }
+        --remaining;
+        double prob = speech ? 0.55 + 0.45 * next() : 0.3 * next();
+        if (next() < 0.05) {
+            prob = 1.0 - prob;
+        }
+        const double energy = speech ? 0.04 + 0.12 * next() : 0.004 + 0.004 * next();
+        trace.probs.push_back(prob);
+        trace.energies.push_back(energy);
+    }
+    return trace;
+}
+
+// Frames where the decision flips, starting from silence.
+std::vector<size_t> run_trace(DynamicCorrection& correction, const Trace& trace, size_t early_at) {
+    std::vector<size_t> flips;
+    bool state = false;
+    for (size_t i = 0; i < trace.probs.size(); ++i) {
+        if (i == early_at) {
+            correction.start_early_detection();
+        }
+        if (correction.process_frame(trace.probs[i], trace.energies[i]) != state) {
+            state = !state;
+            flips.push_back(i);
+        }
+    }
+    return flips;
+}
+
+}
+
+TEST_CASE("RunningStats matches a two-pass mean and variance") {
+    RunningStats stats;
+    const std::vector<double> values{0.2, 0.9, 0.4, 0.7, 0.1};
+    for (double value : values) {
+        stats.add(value);
+    }
+    REQUIRE(stats.count() == 5);
+    REQUIRE(stats.mean() == Catch::Approx(0.46));
+    REQUIRE(stats.variance() == Catch::Approx(0.0904));
+
+    stats.remove(0.2);
+    stats.remove(0.1);
+    REQUIRE(stats.mean() == Catch::Approx(2.0 / 3.0));
+    REQUIRE(stats.variance() == Catch::Approx(0.04222222));
+
+    stats.remove(0.9);
+    stats.remove(0.4);
+    REQUIRE(stats.variance() == 0.0);
+    stats.remove(0.7);
+    REQUIRE(stats.count() == 0);
+    REQUIRE(stats.mean() == 0.0);
+}
+
+TEST_CASE("RecentValues evicts the oldest value once full") {
+    RecentValues values(3);
+    double evicted = 0.0;
+    REQUIRE_FALSE(values.push(1.0, evicted));
+    REQUIRE_FALSE(values.push(2.0, evicted));
+    REQUIRE_FALSE(values.push(3.0, evicted));
+    REQUIRE(values.push(4.0, evicted));
+    REQUIRE(evicted == 1.0);
+    REQUIRE(values.size() == 3);
+    REQUIRE(values.recent(0) == 4.0);
+    REQUIRE(values.recent(2) == 2.0);
+
+    RecentValues none(0);
+    REQUIRE(none.push(5.0, evicted));
+    REQUIRE(evicted == 5.0);
+    REQUIRE(none.size() == 0);
+}
+
+// The flip frames were recorded from the deque-based implementation that
+// rescanned its windows every frame; the running statistics must not move
+// a single decision.
+TEST_CASE("DynamicCorrection decisions match the recorded traces") {
+    SECTION("default config") {
+        DynamicCorrection correction;
+        const std::vector<size_t> expected{
+            0, 54, 213, 341, 494, 599, 726, 836, 982, 1061, 1196, 1220, 1330, 1382, 1466,
+            1553, 1671, 1739, 1840, 1918, 2087, 2121, 2189, 2333, 2493, 2557, 2600, 2749,
+            2819, 2901};
+        REQUIRE(run_trace(correction, make_trace(7, 3000), 3000) == expected);
+    }
+    SECTION("gateway thresholds with early detection") {
+        VADCorrectionConfig cfg;
+        cfg.enter_thres = 0.6;
+        cfg.exit_thres = 0.4;
+        DynamicCorrection correction(cfg);
+        const std::vector<size_t> expected{
+            2, 53, 209, 266, 415, 437, 585, 668, 758, 895, 1021, 1161, 1215, 1216, 1280,
+            1397, 1529, 1569, 1690, 1748, 1890, 1986, 2183, 2288, 2432, 2562, 2674, 2770,
+            2942, 2980};
+        REQUIRE(run_trace(correction, make_trace(11, 3000), 1200) == expected);
+    }
+    SECTION("a long trace does not drift") {
+        VADCorrectionConfig cfg;
+        cfg.enter_thres = 0.6;
+        cfg.exit_thres = 0.4;
+        DynamicCorrection correction(cfg);
+        const auto flips = run_trace(correction, make_trace(19, 100000), 500);
+        REQUIRE(flips.size() == 978);
+        REQUIRE(flips.back() == 99878);
+    }
+}
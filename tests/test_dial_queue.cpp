@@ -0,0 +1,296 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "sip_gateway/sip/dial_queue.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using sip_gateway::DialAttempt;
+using sip_gateway::DialQueue;
+using sip_gateway::DialQueueOptions;
+using sip_gateway::DialStatus;
+
+namespace {
+
+nlohmann::json call_to(const std::string& uri) {
+    return {{"to_uri", uri}};
+}
+
+bool wait_for(const std::function<bool()>& done,
+              std::chrono::milliseconds timeout = std::chrono::seconds(2)) {
+    const auto until = std::chrono::steady_clock::now() + timeout;
+    while (!done()) {
+        if (std::chrono::steady_clock::now() > until) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+bool run_inline(std::function<void()> task) {
+    task();
+    return true;
+}
+
+DialQueueOptions unpaced() {
+    DialQueueOptions options;
+    options.calls_per_second = 0.0;
+    return options;
+}
+
+}
+
+TEST_CASE("DialQueue places queued calls in order") {
+    std::mutex mutex;
+    std::vector<std::string> dialed;
+    DialQueue queue(
+        unpaced(),
+        [&](const nlohmann::json& request) {
+            std::lock_guard<std::mutex> lock(mutex);
+            dialed.push_back(request.at("to_uri").get<std::string>());
+            return "session-" + std::to_string(dialed.size());
+        },
+        {}, run_inline);
+
+    const auto ids = queue.enqueue({call_to("sip:a@x"), call_to("sip:b@x")});
+    REQUIRE(ids);
+    REQUIRE(ids->size() == 2);
+    REQUIRE((*ids)[0] != (*ids)[1]);
+    REQUIRE(wait_for([&]() {
+        const auto last = queue.find((*ids)[1]);
+        return last && last->finished();
+    }));
+
+    const auto first = queue.find((*ids)[0]);
+    REQUIRE(first->status == DialStatus::Placed);
+    REQUIRE(first->session_id == std::string("session-1"));
+    std::lock_guard<std::mutex> lock(mutex);
+    REQUIRE(dialed == std::vector<std::string>{"sip:a@x", "sip:b@x"});
+
+    const auto payload = first->to_json();
+    REQUIRE(payload["status"] == "placed");
+    REQUIRE(payload["to_uri"] == "sip:a@x");
+    REQUIRE(payload["session_id"] == "session-1");
+}
+
+TEST_CASE("DialQueue reports failed attempts") {
+    std::mutex mutex;
+    std::vector<DialStatus> seen;
+    DialQueue queue(
+        unpaced(),
+        [](const nlohmann::json&) -> std::string { throw std::runtime_error("busy"); },
+        {}, run_inline,
+        [&](const DialAttempt& attempt) {
+            std::lock_guard<std::mutex> lock(mutex);
+            seen.push_back(attempt.status);
+        });
+
+    const auto ids = queue.enqueue({call_to("sip:a@x")});
+    REQUIRE(wait_for([&]() { return queue.find(ids->front())->finished(); }));
+    const auto attempt = queue.find(ids->front());
+    REQUIRE(attempt->status == DialStatus::Failed);
+    REQUIRE(attempt->error == "busy");
+    REQUIRE_FALSE(attempt->session_id);
+    std::lock_guard<std::mutex> lock(mutex);
+    REQUIRE(seen == std::vector<DialStatus>{DialStatus::Queued, DialStatus::Dialing,
+                                            DialStatus::Failed});
+}
+
+TEST_CASE("DialQueue reports each attempt's changes in order") {
+    std::mutex mutex;
+    std::map<std::string, std::vector<DialStatus>> seen;
+    std::vector<std::thread> threads;
+    std::mutex threads_mutex;
+    DialQueue queue(
+        unpaced(),
+        [](const nlohmann::json&) { return std::string("s"); },
+        {},
+        [&](std::function<void()> task) {
+            std::lock_guard<std::mutex> lock(threads_mutex);
+            threads.emplace_back(std::move(task));
+            return true;
+        },
+        [&](const DialAttempt& attempt) {
+            // A slow report for the first change gives the later ones, made
+            // on other threads, every chance to overtake it.
+            if (attempt.status == DialStatus::Queued) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            seen[attempt.id].push_back(attempt.status);
+        });
+
+    const auto ids = queue.enqueue({call_to("sip:a@x"), call_to("sip:b@x"), call_to("sip:c@x")});
+    REQUIRE(wait_for([&]() {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& id : *ids) {
+            if (seen[id].size() < 3) {
+                return false;
+            }
+        }
+        return true;
+    }));
+    queue.stop();
+    {
+        std::lock_guard<std::mutex> lock(threads_mutex);
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& id : *ids) {
+        REQUIRE(seen[id] == std::vector<DialStatus>{DialStatus::Queued, DialStatus::Dialing,
+                                                    DialStatus::Placed});
+    }
+}
+
+TEST_CASE("DialQueue paces call starts") {
+    DialQueueOptions options;
+    options.calls_per_second = 20.0;
+    std::atomic<int> placed{0};
+    DialQueue queue(
+        options,
+        [&](const nlohmann::json&) {
+            ++placed;
+            return std::string("s");
+        },
+        {}, run_inline);
+
+    const auto start = std::chrono::steady_clock::now();
+    queue.enqueue({call_to("sip:a@x"), call_to("sip:b@x"), call_to("sip:c@x")});
+    REQUIRE(wait_for([&]() { return placed.load() == 3; }));
+    // Three starts are two intervals of 50 ms apart.
+    REQUIRE(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(95));
+}
+
+TEST_CASE("DialQueue bounds attempts setting up at once") {
+    DialQueueOptions options = unpaced();
+    options.max_dialing = 1;
+    std::atomic<bool> release{false};
+    std::atomic<int> running{0};
+    std::atomic<int> max_running{0};
+    std::vector<std::thread> threads;
+    std::mutex threads_mutex;
+    DialQueue queue(
+        options,
+        [&](const nlohmann::json&) {
+            const int now = ++running;
+            int seen = max_running.load();
+            while (now > seen && !max_running.compare_exchange_weak(seen, now)) {
+            }
+            while (!release.load()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            --running;
+            return std::string("s");
+        },
+        {},
+        [&](std::function<void()> task) {
+            std::lock_guard<std::mutex> lock(threads_mutex);
+            threads.emplace_back(std::move(task));
+            return true;
+        });
+
+    const auto ids = queue.enqueue({call_to("sip:a@x"), call_to("sip:b@x")});
+    REQUIRE(wait_for([&]() { return queue.dialing() == 1; }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    REQUIRE(queue.queued() == 1);
+    release = true;
+    REQUIRE(wait_for([&]() { return queue.find(ids->back())->finished(); }));
+    REQUIRE(max_running.load() == 1);
+    queue.stop();
+    std::lock_guard<std::mutex> lock(threads_mutex);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+TEST_CASE("DialQueue waits for capacity") {
+    std::atomic<bool> capacity{false};
+    std::atomic<int> placed{0};
+    DialQueue queue(
+        unpaced(),
+        [&](const nlohmann::json&) {
+            ++placed;
+            return std::string("s");
+        },
+        [&](size_t) { return capacity.load(); },
+        run_inline);
+
+    const auto ids = queue.enqueue({call_to("sip:a@x")});
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    REQUIRE(placed.load() == 0);
+    REQUIRE(queue.find(ids->front())->status == DialStatus::Queued);
+
+    capacity = true;
+    queue.notify();
+    REQUIRE(wait_for([&]() { return placed.load() == 1; }));
+}
+
+TEST_CASE("DialQueue refuses batches past its limit and forgets old results") {
+    DialQueueOptions options = unpaced();
+    options.max_queued = 2;
+    options.history = 1;
+    std::atomic<bool> capacity{false};
+    DialQueue queue(
+        options,
+        [](const nlohmann::json&) { return std::string("s"); },
+        [&](size_t) { return capacity.load(); },
+        run_inline);
+
+    REQUIRE_FALSE(queue.enqueue({call_to("a"), call_to("b"), call_to("c")}));
+    REQUIRE(queue.queued() == 0);
+    const auto ids = queue.enqueue({call_to("a"), call_to("b")});
+    REQUIRE(ids);
+    REQUIRE_FALSE(queue.enqueue({call_to("c")}));
+
+    capacity = true;
+    queue.notify();
+    REQUIRE(wait_for([&]() {
+        const auto last = queue.find(ids->back());
+        return last && last->finished();
+    }));
+    REQUIRE_FALSE(queue.find(ids->front()));
+    REQUIRE_FALSE(queue.find("unknown"));
+}
+
+TEST_CASE("DialQueue fails attempts the executor drops") {
+    std::atomic<bool> reject{true};
+    std::atomic<int> placed{0};
+    DialQueue queue(
+        unpaced(),
+        [&](const nlohmann::json&) {
+            ++placed;
+            return std::string("s");
+        },
+        {},
+        [&](std::function<void()> task) {
+            if (reject) {
+                return false;
+            }
+            task();
+            return true;
+        });
+
+    const auto dropped = queue.enqueue({call_to("sip:a@x")});
+    REQUIRE(wait_for([&]() { return queue.find(dropped->front())->finished(); }));
+    const auto attempt = queue.find(dropped->front());
+    REQUIRE(attempt->status == DialStatus::Failed);
+    REQUIRE(attempt->error == "worker pool rejected the attempt");
+    REQUIRE(queue.dialing() == 0);
+
+    // The dropped attempt gave its dialing slot back.
+    reject = false;
+    const auto ids = queue.enqueue({call_to("sip:b@x")});
+    REQUIRE(wait_for([&]() { return queue.find(ids->front())->finished(); }));
+    REQUIRE(queue.find(ids->front())->status == DialStatus::Placed);
+    REQUIRE(placed == 1);
+}
@@ -0,0 +1,105 @@
+#include <catch2/catch_approx.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "sip_gateway/vad/dsp.hpp"
+
+using namespace sip_gateway::vad;
+
+namespace {
+
+// Odd lengths leave a scalar tail after every vector width.
+const std::vector<size_t> kLengths{0, 1, 3, 7, 8, 15, 17, 256, 512, 523};
+
+std::vector<float> make_signal(size_t count, float amplitude) {
+    std::vector<float> signal(count);
+    uint32_t seed = 12345;
+    for (auto& value : signal) {
+        seed = seed * 1664525u + 1013904223u;
+        value = amplitude * (static_cast<float>(seed >> 8) / 8388608.0f - 1.0f);
+    }
+    return signal;
+}
+
+}
+
+TEST_CASE("pcm16_to_float matches the scalar kernel at every SIMD level") {
+    const auto& scalar = dsp_kernels(SimdLevel::Scalar);
+    std::vector<int16_t> pcm(523);
+    for (size_t i = 0; i < pcm.size(); ++i) {
+        pcm[i] = static_cast<int16_t>(static_cast<int32_t>(i * 2654435761u) & 0xFFFF);
+    }
+    pcm[0] = -32768;
+    pcm[1] = 32767;
+    for (const auto level : supported_simd_levels()) {
+        const auto& kernels = dsp_kernels(level);
+        for (const auto count : kLengths) {
+            std::vector<float> expected(count);
+            std::vector<float> actual(count);
+            scalar.pcm16_to_float(pcm.data(), expected.data(), count);
+            kernels.pcm16_to_float(pcm.data(), actual.data(), count);
+            REQUIRE(actual == expected);
+        }
+    }
+    float first = 0.0f;
+    scalar.pcm16_to_float(pcm.data(), &first, 1);
+    REQUIRE(first == -1.0f);
+}
+
+TEST_CASE("peak_abs and divide match the scalar kernel at every SIMD level") {
+    const auto& scalar = dsp_kernels(SimdLevel::Scalar);
+    for (const auto level : supported_simd_levels()) {
+        const auto& kernels = dsp_kernels(level);
+        for (const auto count : kLengths) {
+            auto signal = make_signal(count, 3.0f);
+            if (count > 2) {
+                // Negative peak in the scalar tail.
+                signal[count - 1] = -7.5f;
+            }
+            const float peak = scalar.peak_abs(signal.data(), signal.size());
+            REQUIRE(kernels.peak_abs(signal.data(), signal.size()) == peak);
+
+            auto expected = signal;
+            auto actual = signal;
+            scalar.divide(expected.data(), expected.size(), 3.0f);
+            kernels.divide(actual.data(), actual.size(), 3.0f);
+            REQUIRE(actual == expected);
+        }
+    }
+}
+
+TEST_CASE("sum_squares matches the scalar kernel at every SIMD level") {
+    const auto& scalar = dsp_kernels(SimdLevel::Scalar);
+    for (const auto level : supported_simd_levels()) {
+        const auto& kernels = dsp_kernels(level);
+        for (const auto count : kLengths) {
+            const auto signal = make_signal(count, 0.8f);
+            const double expected = scalar.sum_squares(signal.data(), signal.size());
+            REQUIRE(kernels.sum_squares(signal.data(), signal.size()) ==
+                    Catch::Approx(expected).epsilon(1e-12));
+        }
+    }
+}
+
+TEST_CASE("apply_fade follows the quarter-sine curve") {
+    const auto signal = make_signal(523, 1.0f);
+    std::vector<float> faded_in(signal.size());
+    std::vector<float> faded_out(signal.size());
+    apply_fade(signal.data(), faded_in.data(), signal.size(), true);
+    apply_fade(signal.data(), faded_out.data(), signal.size(), false);
+    for (size_t i = 0; i < signal.size(); ++i) {
+        const double ratio = static_cast<double>(i) / static_cast<double>(signal.size() - 1);
+        const double curve = std::sin(ratio * 1.57079632679489661923);
+        REQUIRE(std::abs(faded_in[i] - signal[i] * curve) < 1e-6);
+        REQUIRE(std::abs(faded_out[i] - signal[i] * (1.0 - curve)) < 1e-6);
+    }
+    REQUIRE(faded_in.front() == 0.0f);
+    REQUIRE(faded_in.back() == signal.back());
+
+    float single = 0.25f;
+    apply_fade(&single, &single, 1, false);
+    REQUIRE(single == 0.25f);
+}
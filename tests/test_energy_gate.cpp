@@ -0,0 +1,52 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "sip_gateway/vad/energy_gate.hpp"
+
+using sip_gateway::vad::EnergyGate;
+using sip_gateway::vad::EnergyGateConfig;
+
+TEST_CASE("EnergyGate skips only after the hold windows") {
+    EnergyGateConfig cfg;
+    cfg.hold_windows = 3;
+    EnergyGate gate(cfg);
+    for (int i = 0; i < 3; ++i) {
+        REQUIRE_FALSE(gate.should_skip(0.001, 0.0));
+    }
+    REQUIRE(gate.should_skip(0.001, 0.0));
+    REQUIRE(gate.should_skip(0.0015, 0.0));
+
+    // Energy well above the floor reopens the gate and restarts the hold.
+    REQUIRE_FALSE(gate.should_skip(0.05, 0.0));
+    REQUIRE_FALSE(gate.should_skip(0.001, 0.9));
+    REQUIRE_FALSE(gate.should_skip(0.001, 0.0));
+    REQUIRE_FALSE(gate.should_skip(0.001, 0.0));
+    REQUIRE(gate.should_skip(0.001, 0.0));
+}
+
+TEST_CASE("EnergyGate never skips above max_rms") {
+    EnergyGateConfig cfg;
+    cfg.hold_windows = 0;
+    cfg.max_rms = 0.01;
+    cfg.floor_ratio = 100.0;
+    EnergyGate gate(cfg);
+    REQUIRE(gate.should_skip(0.005, 0.0));
+    REQUIRE_FALSE(gate.should_skip(0.02, 0.0));
+}
+
+TEST_CASE("EnergyGate floor rises only while probability is low") {
+    EnergyGateConfig cfg;
+    cfg.noise_alpha = 0.5;
+    EnergyGate gate(cfg);
+    gate.should_skip(0.001, 0.0);
+    REQUIRE(gate.noise_floor() == 0.001);
+
+    gate.should_skip(0.009, 0.9);
+    REQUIRE(gate.noise_floor() == 0.001);
+
+    gate.should_skip(0.003, 0.0);
+    REQUIRE(gate.noise_floor() == 0.002);
+
+    // Quieter windows pull the floor straight down.
+    gate.should_skip(0.0005, 0.9);
+    REQUIRE(gate.noise_floor() == 0.0005);
+}
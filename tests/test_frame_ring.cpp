@@ -0,0 +1,76 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "sip_gateway/audio/frame_ring.hpp"
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+using sip_gateway::audio::FrameRing;
+
+TEST_CASE("FrameRing returns frames in push order") {
+    FrameRing ring(4, 3);
+    const int16_t first[] = {1, 2, 3};
+    const int16_t second[] = {4, 5};
+    REQUIRE(ring.push(first, 3));
+    REQUIRE(ring.push(second, 2));
+    REQUIRE(ring.size() == 2);
+
+    const int16_t* samples = nullptr;
+    size_t count = 0;
+    REQUIRE(ring.front(samples, count));
+    REQUIRE(count == 3);
+    REQUIRE(samples[0] == 1);
+    REQUIRE(samples[2] == 3);
+    ring.pop();
+
+    REQUIRE(ring.front(samples, count));
+    REQUIRE(count == 2);
+    REQUIRE(samples[1] == 5);
+    ring.pop();
+    REQUIRE_FALSE(ring.front(samples, count));
+}
+
+TEST_CASE("FrameRing rejects pushes when full or oversized") {
+    FrameRing ring(2, 2);
+    const int16_t frame[] = {7, 8, 9};
+    REQUIRE_FALSE(ring.push(frame, 3));
+    REQUIRE(ring.push(frame, 2));
+    REQUIRE(ring.push(frame, 2));
+    REQUIRE_FALSE(ring.push(frame, 2));
+    ring.pop();
+    REQUIRE(ring.push(frame, 1));
+    REQUIRE(ring.size() == 2);
+}
+
+TEST_CASE("FrameRing hands frames across threads without loss") {
+    FrameRing ring(8, 1);
+    constexpr int16_t kFrames = 10000;
+    std::thread producer([&ring]() {
+        for (int16_t i = 0; i < kFrames; ++i) {
+            while (!ring.push(&i, 1)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    std::vector<int16_t> received;
+    received.reserve(kFrames);
+    while (received.size() < static_cast<size_t>(kFrames)) {
+        const int16_t* samples = nullptr;
+        size_t count = 0;
+        if (!ring.front(samples, count)) {
+            std::this_thread::yield();
+            continue;
+        }
+        received.push_back(samples[0]);
+        ring.pop();
+    }
+    producer.join();
+
+    std::vector<int16_t> expected;
+    for (int16_t i = 0; i < kFrames; ++i) {
+        expected.push_back(i);
+    }
+    REQUIRE(received == expected);
+}
@@ -0,0 +1,54 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "sip_gateway/logging.hpp"
+
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <string>
+
+#include "spdlog/sinks/ostream_sink.h"
+#include "spdlog/spdlog.h"
+
+namespace {
+
+struct Counted {
+    int* formatted;
+};
+
+std::ostream& operator<<(std::ostream& os, const Counted& value) {
+    ++*value.formatted;
+    return os << "counted value";
+}
+
+}
+
+TEST_CASE("Log fields are formatted only for enabled levels") {
+    std::ostringstream captured;
+    auto sink = std::make_shared<spdlog::sinks::ostream_sink_st>(captured);
+    auto logger = std::make_shared<spdlog::logger>("logging_test", sink);
+    logger->set_pattern("%v");
+    logger->set_level(spdlog::level::info);
+    const auto previous = spdlog::default_logger();
+    spdlog::set_default_logger(logger);
+
+    int formatted = 0;
+    sip_gateway::debug("Hidden", {sip_gateway::kv("value", Counted{&formatted})});
+    REQUIRE(formatted == 0);
+    REQUIRE(captured.str().empty());
+
+    sip_gateway::info("Shown", {sip_gateway::kv("value", Counted{&formatted}),
+                                sip_gateway::kv("count", 42),
+                                sip_gateway::kv("id", std::string("abc"))});
+    REQUIRE(formatted == 1);
+    sip_gateway::info("Bare");
+
+    spdlog::set_default_logger(previous);
+    std::string first;
+    std::string second;
+    std::istringstream lines(captured.str());
+    std::getline(lines, first);
+    std::getline(lines, second);
+    REQUIRE(first == R"(Shown [value="counted value" count=42 id=abc])");
+    REQUIRE(second == "Bare");
+}
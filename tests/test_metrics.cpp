@@ -0,0 +1,133 @@
+#include <catch2/catch_approx.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "sip_gateway/metrics.hpp"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+using sip_gateway::Metrics;
+
+TEST_CASE("response_time_quantile needs min_count observations") {
+    auto& metrics = Metrics::instance();
+    REQUIRE_FALSE(metrics.response_time_quantile("test_quantile_empty", 0.9));
+
+    metrics.observe_response_time("test_quantile_sparse", 0.2);
+    REQUIRE_FALSE(metrics.response_time_quantile("test_quantile_sparse", 0.9, 2));
+    REQUIRE(metrics.response_time_quantile("test_quantile_sparse", 0.9, 1));
+}
+
+TEST_CASE("response_time_quantile interpolates within a bucket") {
+    auto& metrics = Metrics::instance();
+    // Nine observations in (0.1, 0.25] and one in (0.5, 0.75].
+    for (int i = 0; i < 9; ++i) {
+        metrics.observe_response_time("test_quantile_interp", 0.2);
+    }
+    metrics.observe_response_time("test_quantile_interp", 0.6);
+
+    const auto p50 = metrics.response_time_quantile("test_quantile_interp", 0.5);
+    REQUIRE(p50);
+    REQUIRE(*p50 == Catch::Approx(0.1 + (5.0 / 9.0) * 0.15));
+
+    const auto p95 = metrics.response_time_quantile("test_quantile_interp", 0.95);
+    REQUIRE(p95);
+    REQUIRE(*p95 == Catch::Approx(0.5 + 0.5 * 0.25));
+}
+
+TEST_CASE("response_time_quantile gives up past the last finite bucket") {
+    auto& metrics = Metrics::instance();
+    metrics.observe_response_time("test_quantile_overflow", 30.0);
+    REQUIRE_FALSE(metrics.response_time_quantile("test_quantile_overflow", 0.9));
+}
+
+TEST_CASE("Histogram buckets include their upper bound") {
+    auto& histogram = Metrics::instance().histogram("test_histogram_edges");
+    histogram.observe(0.005);
+    histogram.observe(0.0051);
+    histogram.observe(20.0);
+    const auto buckets = histogram.cumulative_buckets();
+    REQUIRE(buckets[0] == 1);
+    REQUIRE(buckets[1] == 2);
+    REQUIRE(buckets[Metrics::Histogram::kBounds.size() - 1] == 2);
+    REQUIRE(buckets.back() == 3);
+    REQUIRE(histogram.count() == 3);
+    REQUIRE(histogram.sum() == Catch::Approx(20.0101));
+}
+
+TEST_CASE("Histogram quantiles stay within the log bucket error") {
+    auto& histogram = Metrics::instance().histogram("test_histogram_quantile");
+    REQUIRE_FALSE(histogram.quantile(0.5));
+    // 1 ms .. 1000 ms, evenly.
+    for (int i = 1; i <= 1000; ++i) {
+        histogram.observe(i / 1000.0);
+    }
+    REQUIRE(*histogram.quantile(0.5) == Catch::Approx(0.5).epsilon(0.07));
+    REQUIRE(*histogram.quantile(0.95) == Catch::Approx(0.95).epsilon(0.07));
+    REQUIRE(*histogram.quantile(0.99) == Catch::Approx(0.99).epsilon(0.07));
+
+    const auto output = Metrics::instance().render_prometheus();
+    REQUIRE(output.find("response_time_seconds{method=\"test_histogram_quantile\","
+                        "quantile=\"0.99\"}") != std::string::npos);
+}
+
+TEST_CASE("Striped series add up across threads") {
+    auto& metrics = Metrics::instance();
+    auto& histogram = metrics.histogram("test_histogram_threads");
+    auto& counter = metrics.counter("test_counter_threads", {{"lane", "x"}});
+    REQUIRE(&counter == &metrics.counter("test_counter_threads", {{"lane", "x"}}));
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&]() {
+            for (int i = 0; i < 1000; ++i) {
+                histogram.observe(0.01);
+                counter.increment();
+                metrics.increment_counter("test_counter_threads", {{"lane", "x"}}, 2);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    REQUIRE(histogram.count() == 8000);
+    REQUIRE(counter.value() == 24000);
+    REQUIRE(metrics.render_prometheus().find("test_counter_threads{lane=\"x\"} 24000") !=
+            std::string::npos);
+}
+
+TEST_CASE("Named histograms render as their own family") {
+    auto& metrics = Metrics::instance();
+    auto& histogram = metrics.named_histogram("test_named_seconds", {{"lane", "x"}});
+    histogram.observe(0.02);
+    histogram.observe(3.0);
+    REQUIRE(&metrics.named_histogram("test_named_seconds", {{"lane", "x"}}) == &histogram);
+
+    const auto output = metrics.render_prometheus();
+    REQUIRE(output.find("# TYPE test_named_seconds histogram") != std::string::npos);
+    REQUIRE(output.find("test_named_seconds_bucket{lane=\"x\",le=\"0.025000\"} 1") !=
+            std::string::npos);
+    REQUIRE(output.find("test_named_seconds_bucket{lane=\"x\",le=\"+Inf\"} 2") !=
+            std::string::npos);
+    REQUIRE(output.find("test_named_seconds_count{lane=\"x\"} 2") != std::string::npos);
+    REQUIRE(output.find("response_time_milliseconds_count{method=\"test_named_seconds\"") ==
+            std::string::npos);
+}
+
+TEST_CASE("Concurrent gauge adds are not lost") {
+    auto& gauge = Metrics::instance().gauge("test_gauge_add", {});
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&gauge]() {
+            for (int i = 0; i < 10000; ++i) {
+                gauge.add(1.0);
+                gauge.add(-1.0);
+            }
+            gauge.add(1.0);
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    REQUIRE(gauge.value() == 4.0);
+}
@@ -0,0 +1,189 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "sip_gateway/audio/ogg_opus.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using sip_gateway::audio::OggOpusEncoder;
+
+#ifdef SIPGATEWAY_HAVE_OPUS
+
+namespace {
+
+struct OggPage {
+    uint8_t flags = 0;
+    uint64_t granule = 0;
+    uint32_t serial = 0;
+    uint32_t sequence = 0;
+    // Packets that end on this page; a packet continued from the previous
+    // page is completed here.
+    std::vector<std::string> packets;
+};
+
+uint64_t read_le(const std::string& data, size_t offset, int bytes) {
+    uint64_t value = 0;
+    for (int i = bytes - 1; i >= 0; --i) {
+        value = (value << 8) | static_cast<unsigned char>(data.at(offset + i));
+    }
+    return value;
+}
+
+// The Ogg CRC-32 (polynomial 0x04c11db7, no reflection, zero init),
+// computed independently of the encoder's.
+uint32_t ogg_crc(const std::string& data) {
+    uint32_t crc = 0;
+    for (const unsigned char ch : data) {
+        crc ^= static_cast<uint32_t>(ch) << 24;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 0x80000000u) ? (crc << 1) ^ 0x04c11db7u : (crc << 1);
+        }
+    }
+    return crc;
+}
+
+// Splits a stream into pages, checking each page's structure and CRC.
+std::vector<OggPage> parse_pages(const std::string& stream) {
+    std::vector<OggPage> pages;
+    std::string partial;
+    size_t offset = 0;
+    while (offset < stream.size()) {
+        REQUIRE(stream.size() - offset >= 27);
+        REQUIRE(stream.compare(offset, 4, "OggS") == 0);
+        REQUIRE(stream[offset + 4] == 0);
+        OggPage page;
+        page.flags = static_cast<uint8_t>(stream[offset + 5]);
+        page.granule = read_le(stream, offset + 6, 8);
+        page.serial = static_cast<uint32_t>(read_le(stream, offset + 14, 4));
+        page.sequence = static_cast<uint32_t>(read_le(stream, offset + 18, 4));
+        const auto crc = static_cast<uint32_t>(read_le(stream, offset + 22, 4));
+        const auto segments = static_cast<unsigned char>(stream[offset + 26]);
+        REQUIRE(stream.size() - offset >= 27u + segments);
+        size_t body_size = 0;
+        for (size_t i = 0; i < segments; ++i) {
+            body_size += static_cast<unsigned char>(stream[offset + 27 + i]);
+        }
+        const size_t page_size = 27 + segments + body_size;
+        REQUIRE(stream.size() - offset >= page_size);
+
+        auto unsigned_page = stream.substr(offset, page_size);
+        unsigned_page.replace(22, 4, 4, '\0');
+        REQUIRE(ogg_crc(unsigned_page) == crc);
+
+        REQUIRE(((page.flags & 0x01) != 0) == !partial.empty());
+        size_t body = offset + 27 + segments;
+        for (size_t i = 0; i < segments; ++i) {
+            const auto lacing = static_cast<unsigned char>(stream[offset + 27 + i]);
+            partial.append(stream, body, lacing);
+            body += lacing;
+            if (lacing < 255) {
+                page.packets.push_back(std::move(partial));
+                partial.clear();
+            }
+        }
+        pages.push_back(std::move(page));
+        offset += page_size;
+    }
+    REQUIRE(partial.empty());
+    return pages;
+}
+
+std::vector<int16_t> tone(size_t frames, unsigned channels, uint32_t sample_rate) {
+    std::vector<int16_t> samples(frames * channels);
+    for (size_t i = 0; i < frames; ++i) {
+        const auto value = static_cast<int16_t>(
+            8000.0 * std::sin(2.0 * 3.14159265358979 * 440.0 * i / sample_rate));
+        for (unsigned c = 0; c < channels; ++c) {
+            samples[i * channels + c] = value;
+        }
+    }
+    return samples;
+}
+
+void check_stream(uint32_t sample_rate, unsigned channels) {
+    INFO("sample_rate=" << sample_rate << " channels=" << channels);
+    auto encoder = OggOpusEncoder::create(sample_rate, channels, 24000);
+    REQUIRE(encoder);
+    // A second and a half packet, written in uneven pieces and taken midway,
+    // so the last packet is padded and take() hands out pages as they fill.
+    const size_t packet_frames = sample_rate / 50;
+    const size_t frames = sample_rate + packet_frames / 2;
+    const auto samples = tone(frames, channels, sample_rate);
+    std::string stream;
+    size_t written = 0;
+    while (written < frames) {
+        const auto count = std::min<size_t>(frames - written, 333);
+        REQUIRE(encoder->write(samples.data() + written * channels, count));
+        written += count;
+        stream += encoder->take();
+    }
+    REQUIRE(encoder->finish());
+    stream += encoder->take();
+    REQUIRE_FALSE(encoder->write(samples.data(), 1));
+
+    const auto pages = parse_pages(stream);
+    REQUIRE(pages.size() >= 3);
+    for (size_t i = 0; i < pages.size(); ++i) {
+        REQUIRE(pages[i].serial == pages[0].serial);
+        REQUIRE(pages[i].sequence == i);
+        REQUIRE(((pages[i].flags & 0x02) != 0) == (i == 0));
+        REQUIRE(((pages[i].flags & 0x04) != 0) == (i + 1 == pages.size()));
+    }
+
+    // RFC 7845 5.1: the identification header alone on the first page.
+    REQUIRE(pages[0].packets.size() == 1);
+    REQUIRE(pages[0].granule == 0);
+    const auto& head = pages[0].packets[0];
+    REQUIRE(head.size() == 19);
+    REQUIRE(head.compare(0, 8, "OpusHead") == 0);
+    REQUIRE(head[8] == 1);
+    REQUIRE(static_cast<unsigned char>(head[9]) == channels);
+    const auto pre_skip = read_le(head, 10, 2);
+    REQUIRE(read_le(head, 12, 4) == sample_rate);
+    REQUIRE(read_le(head, 16, 2) == 0);
+    REQUIRE(head[18] == 0);
+
+    // RFC 7845 5.2: the comment header alone on the second page.
+    REQUIRE(pages[1].packets.size() == 1);
+    REQUIRE(pages[1].granule == 0);
+    const auto& tags = pages[1].packets[0];
+    REQUIRE(tags.compare(0, 8, "OpusTags") == 0);
+    const auto vendor_size = read_le(tags, 8, 4);
+    REQUIRE(tags.size() == 12 + vendor_size + 4);
+    REQUIRE(read_le(tags, 12 + vendor_size, 4) == 0);
+
+    // Audio pages: granule positions count 48 kHz samples and grow with
+    // every page; the last one marks the end of the real input.
+    size_t packets = 0;
+    uint64_t previous = 0;
+    for (size_t i = 2; i < pages.size(); ++i) {
+        REQUIRE_FALSE(pages[i].packets.empty());
+        REQUIRE(pages[i].granule > previous);
+        previous = pages[i].granule;
+        for (const auto& packet : pages[i].packets) {
+            REQUIRE_FALSE(packet.empty());
+        }
+        packets += pages[i].packets.size();
+    }
+    REQUIRE(packets == (frames + packet_frames - 1) / packet_frames);
+    REQUIRE(pages.back().granule == pre_skip + frames * (48000 / sample_rate));
+}
+
+}
+
+TEST_CASE("OggOpusEncoder writes valid Ogg/Opus pages") {
+    check_stream(16000, 1);
+    check_stream(8000, 2);
+    check_stream(48000, 1);
+}
+
+#endif
+
+TEST_CASE("OggOpusEncoder refuses rates Opus does not take") {
+    REQUIRE_FALSE(OggOpusEncoder::supported(11025));
+    REQUIRE_FALSE(OggOpusEncoder::create(11025, 1, 24000));
+    REQUIRE_FALSE(OggOpusEncoder::create(16000, 3, 24000));
+}
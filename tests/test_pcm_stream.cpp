@@ -0,0 +1,121 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "sip_gateway/audio/pcm_stream.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+using sip_gateway::audio::PcmStream;
+
+namespace {
+
+void put_le32(std::string& out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+    }
+}
+
+void put_le16(std::string& out, uint16_t value) {
+    out.push_back(static_cast<char>(value & 0xff));
+    out.push_back(static_cast<char>((value >> 8) & 0xff));
+}
+
+// Streaming backends do not know the final size, so the data size is bogus.
+std::string wav_header(uint32_t sample_rate, uint16_t channels = 1) {
+    std::string out = "RIFF";
+    put_le32(out, 0xffffffff);
+    out += "WAVE";
+    out += "fmt ";
+    put_le32(out, 16);
+    put_le16(out, 1);
+    put_le16(out, channels);
+    put_le32(out, sample_rate);
+    put_le32(out, sample_rate * 2 * channels);
+    put_le16(out, static_cast<uint16_t>(2 * channels));
+    put_le16(out, 16);
+    out += "LIST";
+    put_le32(out, 3);
+    out += "abc";
+    out.push_back('\0');
+    out += "data";
+    put_le32(out, 0xffffffff);
+    return out;
+}
+
+std::string pcm_bytes(const std::vector<int16_t>& samples) {
+    std::string out;
+    for (const auto sample : samples) {
+        put_le16(out, static_cast<uint16_t>(sample));
+    }
+    return out;
+}
+
+}
+
+TEST_CASE("PcmStream parses a header split across writes") {
+    PcmStream stream(std::chrono::milliseconds(1));
+    const auto bytes = wav_header(16000) + pcm_bytes({1, -2, 300, -400});
+    // One byte at a time also splits every sample across writes.
+    for (const char ch : bytes) {
+        stream.write(&ch, 1);
+    }
+    stream.finish();
+    REQUIRE(stream.sample_rate() == 16000);
+    REQUIRE(stream.wait_ready(std::chrono::milliseconds(0)));
+
+    std::vector<int16_t> out(8, 0);
+    REQUIRE(stream.read(out.data(), out.size()) == 4);
+    out.resize(4);
+    REQUIRE(out == std::vector<int16_t>({1, -2, 300, -400}));
+    REQUIRE(stream.drained());
+}
+
+TEST_CASE("PcmStream is not ready until the prebuffer is filled") {
+    PcmStream stream(std::chrono::milliseconds(10));
+    stream.write(wav_header(8000).data(), wav_header(8000).size());
+    const auto half = pcm_bytes(std::vector<int16_t>(40, 7));
+    stream.write(half.data(), half.size());
+    REQUIRE_FALSE(stream.wait_ready(std::chrono::milliseconds(0)));
+    stream.write(half.data(), half.size());
+    REQUIRE(stream.wait_ready(std::chrono::milliseconds(0)));
+    REQUIRE_FALSE(stream.drained());
+}
+
+TEST_CASE("PcmStream wakes a waiting reader from the producer thread") {
+    PcmStream stream(std::chrono::milliseconds(5));
+    std::thread producer([&stream]() {
+        const auto bytes = wav_header(8000) + pcm_bytes(std::vector<int16_t>(80, 1));
+        stream.write(bytes.data(), bytes.size());
+    });
+    REQUIRE(stream.wait_ready(std::chrono::seconds(5)));
+    producer.join();
+}
+
+TEST_CASE("PcmStream rejects formats it cannot play") {
+    PcmStream stereo(std::chrono::milliseconds(1));
+    const auto header = wav_header(16000, 2);
+    stereo.write(header.data(), header.size());
+    REQUIRE(stereo.failed());
+    REQUIRE_FALSE(stereo.wait_ready(std::chrono::milliseconds(0)));
+
+    PcmStream garbage(std::chrono::milliseconds(1));
+    const std::string body = "{\"error\": \"nope\"}";
+    garbage.write(body.data(), body.size());
+    REQUIRE(garbage.failed());
+
+    PcmStream truncated(std::chrono::milliseconds(1));
+    truncated.write("RIFF", 4);
+    truncated.finish();
+    REQUIRE(truncated.failed());
+}
+
+TEST_CASE("PcmStream cancel releases a waiting reader") {
+    PcmStream stream(std::chrono::milliseconds(100));
+    std::thread canceller([&stream]() { stream.cancel(); });
+    REQUIRE_FALSE(stream.wait_ready(std::chrono::seconds(5)));
+    canceller.join();
+    REQUIRE(stream.cancelled());
+}
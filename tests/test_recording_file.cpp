@@ -0,0 +1,71 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "sip_gateway/audio/recording_file.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+using sip_gateway::audio::RecordingFile;
+using sip_gateway::audio::RecordingFormat;
+
+namespace {
+
+std::string read_file(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+uint32_t read_u32(const std::string& bytes, size_t offset) {
+    uint32_t value = 0;
+    for (size_t i = 0; i < 4; ++i) {
+        value |= static_cast<uint32_t>(static_cast<uint8_t>(bytes[offset + i])) << (8 * i);
+    }
+    return value;
+}
+
+}
+
+TEST_CASE("RecordingFile patches WAV sizes on close") {
+    const auto dir = std::filesystem::temp_directory_path() / "sip_gateway_recording_test";
+    std::filesystem::remove_all(dir);
+
+    std::filesystem::path path;
+    {
+        RecordingFile file(dir / "call.wav", RecordingFormat::Wav, 8000, 2);
+        path = file.path();
+        const int16_t first[] = {1, -1, 2, -2};
+        const int16_t second[] = {3, -3};
+        REQUIRE(file.write(first, 2));
+        REQUIRE(file.write(second, 1));
+        REQUIRE(file.bytes_written() == 44 + 12);
+    }
+    REQUIRE(path.extension() == ".wav");
+    const auto bytes = read_file(path);
+    REQUIRE(bytes.size() == 44 + 12);
+    REQUIRE(read_u32(bytes, 4) == 36 + 12);
+    REQUIRE(static_cast<uint8_t>(bytes[22]) == 2);
+    REQUIRE(read_u32(bytes, 24) == 8000);
+    REQUIRE(read_u32(bytes, 28) == 8000 * 4);
+    REQUIRE(read_u32(bytes, 40) == 12);
+    REQUIRE(static_cast<uint8_t>(bytes[44 + 8]) == 3);
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("RecordingFile names the file after the format written") {
+    const auto dir = std::filesystem::temp_directory_path() / "sip_gateway_recording_test";
+    std::filesystem::remove_all(dir);
+    {
+        // 11025 Hz is not an Opus rate, so this always falls back to WAV.
+        RecordingFile file(dir / "call.wav", RecordingFormat::Opus, 11025, 1);
+        REQUIRE(file.format() == RecordingFormat::Wav);
+        REQUIRE(file.path().extension() == ".wav");
+    }
+    REQUIRE(sip_gateway::audio::parse_recording_format("opus") == RecordingFormat::Opus);
+    REQUIRE_THROWS_AS(sip_gateway::audio::parse_recording_format("flac"), std::runtime_error);
+    std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,89 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "sip_gateway/audio/sample_ring.hpp"
+#include "sip_gateway/audio/segment.hpp"
+
+#include <vector>
+
+using sip_gateway::audio::AudioSegment;
+using sip_gateway::audio::SampleRing;
+
+namespace {
+
+std::vector<float> contents(const SampleRing& ring) {
+    std::vector<float> out;
+    ring.copy_to(0, ring.size(), out);
+    return out;
+}
+
+}
+
+TEST_CASE("SampleRing keeps samples in push order below capacity") {
+    SampleRing ring(8);
+    const float first[] = {1, 2, 3};
+    const float second[] = {4, 5};
+    ring.push(first, 3);
+    ring.push(second, 2);
+    REQUIRE(ring.size() == 5);
+    REQUIRE(ring.dropped() == 0);
+    REQUIRE(contents(ring) == std::vector<float>{1, 2, 3, 4, 5});
+
+    std::vector<float> middle;
+    ring.copy_to(1, 3, middle);
+    REQUIRE(middle == std::vector<float>{2, 3, 4});
+}
+
+TEST_CASE("SampleRing overwrites the oldest samples once full") {
+    SampleRing ring(4);
+    const float samples[] = {1, 2, 3, 4, 5, 6};
+    ring.push(samples, 3);
+    ring.push(samples + 3, 3);
+    REQUIRE(ring.size() == 4);
+    REQUIRE(ring.dropped() == 2);
+    REQUIRE(contents(ring) == std::vector<float>{3, 4, 5, 6});
+
+    // The wrapped contents come back as two spans.
+    const auto spans = ring.view(0, 4);
+    REQUIRE(spans[0].size + spans[1].size == 4);
+    REQUIRE(spans[1].size > 0);
+
+    const float large[] = {7, 8, 9, 10, 11};
+    ring.push(large, 5);
+    REQUIRE(contents(ring) == std::vector<float>{8, 9, 10, 11});
+    REQUIRE(ring.dropped() == 7);
+
+    ring.clear();
+    REQUIRE(ring.empty());
+    REQUIRE(ring.dropped() == 0);
+    ring.push(samples, 2);
+    REQUIRE(contents(ring) == std::vector<float>{1, 2});
+}
+
+TEST_CASE("SampleRing appends another ring") {
+    SampleRing source(3);
+    const float samples[] = {1, 2, 3, 4};
+    source.push(samples, 4);
+
+    SampleRing target(4);
+    const float head[] = {9};
+    target.push(head, 1);
+    target.push(source);
+    REQUIRE(contents(target) == std::vector<float>{9, 2, 3, 4});
+
+    SampleRing none(0);
+    none.push(samples, 4);
+    REQUIRE(none.empty());
+    REQUIRE(none.dropped() == 4);
+}
+
+TEST_CASE("AudioSegment shares its samples") {
+    AudioSegment empty;
+    REQUIRE(empty.empty());
+    REQUIRE(empty.samples().empty());
+
+    AudioSegment segment(std::vector<float>{0.5f, -0.5f});
+    const AudioSegment copy = segment;
+    REQUIRE(copy.size() == 2);
+    REQUIRE(copy.data() == segment.data());
+    REQUIRE(copy.samples()[1] == -0.5f);
+}
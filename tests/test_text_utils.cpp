@@ -3,6 +3,7 @@
 #include "sip_gateway/utils/text.hpp"
 
 #include <string>
+#include <vector>
 
 TEST_CASE("remove_emojis strips emoji codepoints") {
     const std::string emoji = "\xF0\x9F\x98\x80";
@@ -21,3 +22,47 @@ TEST_CASE("normalize_text lowercases and trims whitespace") {
     const std::string expected = "hello world";
     REQUIRE(sip_gateway::utils::normalize_text(input) == expected);
 }
+
+TEST_CASE("base64_encode pads partial groups") {
+    using sip_gateway::utils::base64_encode;
+    REQUIRE(base64_encode("", 0).empty());
+    REQUIRE(base64_encode("f", 1) == "Zg==");
+    REQUIRE(base64_encode("fo", 2) == "Zm8=");
+    REQUIRE(base64_encode("foo", 3) == "Zm9v");
+    REQUIRE(base64_encode("foobar", 6) == "Zm9vYmFy");
+    const unsigned char binary[] = {0x00, 0xFF, 0x10};
+    REQUIRE(base64_encode(binary, sizeof(binary)) == "AP8Q");
+}
+
+TEST_CASE("split_clauses splits sentences but not abbreviations or numbers") {
+    using sip_gateway::utils::split_clauses;
+    const auto chunks = split_clauses(
+        "Dr. Smith will call at 3.30 p.m. tomorrow. Is that OK? \"Yes,\" she said.", 0, 0);
+    REQUIRE(chunks.size() == 3);
+    REQUIRE(chunks[0] == "Dr. Smith will call at 3.30 p.m. tomorrow.");
+    REQUIRE(chunks[1] == "Is that OK?");
+    REQUIRE(chunks[2] == "\"Yes,\" she said.");
+
+    REQUIRE(split_clauses("See e.g. the manual. J. R. Tolkien wrote it.", 0, 0) ==
+            std::vector<std::string>{"See e.g. the manual.", "J. R. Tolkien wrote it."});
+    REQUIRE(split_clauses("  No punctuation here  ", 10, 100) ==
+            std::vector<std::string>{"No punctuation here"});
+    REQUIRE(split_clauses("", 10, 100).empty());
+}
+
+TEST_CASE("split_clauses joins short sentences and cuts long ones") {
+    using sip_gateway::utils::split_clauses;
+    REQUIRE(split_clauses("Hi. Thanks for calling our support line. Bye.", 10, 0) ==
+            std::vector<std::string>{"Hi. Thanks for calling our support line. Bye."});
+
+    const auto chunks = split_clauses(
+        "Your order has shipped, it should arrive on Monday, and you will get a text", 10, 40);
+    REQUIRE(chunks == std::vector<std::string>{
+                          "Your order has shipped,",
+                          "it should arrive on Monday,",
+                          "and you will get a text"});
+
+    for (const auto& chunk : split_clauses(std::string(30, 'a') + " " + std::string(30, 'b'), 5, 40)) {
+        REQUIRE(chunk.size() == 30);
+    }
+}
@@ -0,0 +1,71 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "sip_gateway/audio/tts_cache.hpp"
+
+#include <filesystem>
+#include <string>
+
+using sip_gateway::audio::TtsCache;
+using sip_gateway::audio::TtsCacheOptions;
+
+namespace {
+
+TtsCacheOptions memory_only(size_t max_bytes) {
+    TtsCacheOptions options;
+    options.max_bytes = max_bytes;
+    options.max_entry_bytes = max_bytes;
+    return options;
+}
+
+}
+
+TEST_CASE("TtsCache keys ignore case and spacing but not voice") {
+    REQUIRE(TtsCache::make_key("  Are you  still there?", "inbound") ==
+            TtsCache::make_key("are you still there?", "inbound"));
+    REQUIRE(TtsCache::make_key("Hello", "inbound") !=
+            TtsCache::make_key("Hello", "outbound"));
+}
+
+TEST_CASE("TtsCache evicts the least recently used entry") {
+    TtsCache cache(memory_only(10));
+    cache.put("a", "1111");
+    cache.put("b", "2222");
+    REQUIRE(cache.get("a"));
+    cache.put("c", "3333");
+
+    REQUIRE(cache.get("a"));
+    REQUIRE_FALSE(cache.get("b"));
+    REQUIRE(*cache.get("c") == "3333");
+    REQUIRE(cache.size_bytes() == 8);
+    REQUIRE(cache.entries() == 2);
+}
+
+TEST_CASE("TtsCache skips oversized entries and can be disabled") {
+    auto options = memory_only(100);
+    options.max_entry_bytes = 4;
+    TtsCache cache(options);
+    cache.put("big", "12345");
+    REQUIRE_FALSE(cache.get("big"));
+
+    TtsCache disabled(memory_only(0));
+    disabled.put("a", "1");
+    REQUIRE_FALSE(disabled.enabled());
+    REQUIRE_FALSE(disabled.get("a"));
+}
+
+TEST_CASE("TtsCache disk tier survives a new instance") {
+    const auto dir = std::filesystem::temp_directory_path() / "sip_gateway_tts_cache_test";
+    std::filesystem::remove_all(dir);
+    auto options = memory_only(1024);
+    options.disk_dir = dir;
+    {
+        TtsCache cache(options);
+        cache.put("greeting", std::string("RIFF\0data", 9));
+    }
+    TtsCache restarted(options);
+    const auto audio = restarted.get("greeting");
+    REQUIRE(audio);
+    REQUIRE(*audio == std::string("RIFF\0data", 9));
+    REQUIRE_FALSE(restarted.get("other"));
+    std::filesystem::remove_all(dir);
+}
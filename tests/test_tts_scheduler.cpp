@@ -0,0 +1,154 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "sip_gateway/sip/tts_scheduler.hpp"
+
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+using sip_gateway::AdaptiveLimit;
+using sip_gateway::AdaptiveLimitOptions;
+using sip_gateway::TtsScheduler;
+
+namespace {
+
+// Holds dispatched tasks until the test runs them.
+struct ManualExecutor {
+    std::deque<std::function<void()>> tasks;
+    bool reject = false;
+
+    TtsScheduler::Executor executor() {
+        return [this](std::function<void()> task) {
+            if (reject) {
+                return false;
+            }
+            tasks.push_back(std::move(task));
+            return true;
+        };
+    }
+
+    void run_one() {
+        auto task = std::move(tasks.front());
+        tasks.pop_front();
+        task();
+    }
+};
+
+AdaptiveLimitOptions options(size_t min_limit, size_t max_limit, size_t initial) {
+    AdaptiveLimitOptions out;
+    out.min_limit = min_limit;
+    out.max_limit = max_limit;
+    out.initial_limit = initial;
+    return out;
+}
+
+}
+
+TEST_CASE("AdaptiveLimit grows on on-time saturated samples") {
+    AdaptiveLimit limit(options(1, 4, 2));
+    for (int i = 0; i < 2; ++i) {
+        limit.on_sample(0.1, true);
+    }
+    REQUIRE(limit.limit() == 3);
+    // Unsaturated samples say nothing about more headroom.
+    for (int i = 0; i < 10; ++i) {
+        limit.on_sample(0.1, false);
+    }
+    REQUIRE(limit.limit() == 3);
+    for (int i = 0; i < 20; ++i) {
+        limit.on_sample(0.1, true);
+    }
+    REQUIRE(limit.limit() == 4);
+}
+
+TEST_CASE("AdaptiveLimit backs off on slow samples and failures") {
+    AdaptiveLimit limit(options(2, 64, 16));
+    limit.on_sample(0.1, true);
+    REQUIRE(limit.baseline() == 0.1);
+    limit.on_sample(1.0, true);
+    REQUIRE(limit.limit() == 12);
+    // Requests started under the old limit cannot cut it again at once.
+    for (int i = 0; i < 12; ++i) {
+        limit.on_failure();
+    }
+    REQUIRE(limit.limit() == 12);
+    limit.on_failure();
+    REQUIRE(limit.limit() == 9);
+
+    AdaptiveLimit floor(options(2, 64, 2));
+    floor.on_failure();
+    REQUIRE(floor.limit() == 2);
+}
+
+TEST_CASE("TtsScheduler starts turn-first tasks before later ones") {
+    ManualExecutor manual;
+    TtsScheduler scheduler(options(1, 1, 1), manual.executor());
+    std::vector<std::string> order;
+    auto task = [&order](std::string name) {
+        return [&order, name]() {
+            order.push_back(name);
+            return TtsScheduler::Outcome::Done;
+        };
+    };
+
+    scheduler.submit(TtsScheduler::Priority::Later, task("a"));
+    scheduler.submit(TtsScheduler::Priority::Later, task("b"));
+    scheduler.submit(TtsScheduler::Priority::TurnFirst, task("c"));
+    REQUIRE(scheduler.inflight() == 1);
+    REQUIRE(scheduler.queue_depth() == 2);
+
+    while (!manual.tasks.empty()) {
+        manual.run_one();
+    }
+    REQUIRE(order == std::vector<std::string>{"a", "c", "b"});
+    REQUIRE(scheduler.inflight() == 0);
+    REQUIRE(scheduler.queue_depth() == 0);
+}
+
+TEST_CASE("TtsScheduler ignores cancelled tasks when adapting") {
+    ManualExecutor manual;
+    TtsScheduler scheduler(options(1, 8, 4), manual.executor());
+    for (int i = 0; i < 8; ++i) {
+        scheduler.submit(TtsScheduler::Priority::Later,
+                         []() { return TtsScheduler::Outcome::Cancelled; });
+    }
+    REQUIRE(scheduler.inflight() == 4);
+    while (!manual.tasks.empty()) {
+        manual.run_one();
+    }
+    REQUIRE(scheduler.limit() == 4);
+
+    scheduler.submit(TtsScheduler::Priority::Later,
+                     []() { return TtsScheduler::Outcome::Failed; });
+    manual.run_one();
+    REQUIRE(scheduler.limit() == 3);
+}
+
+TEST_CASE("TtsScheduler releases the slot of a dropped task") {
+    ManualExecutor manual;
+    TtsScheduler scheduler(options(1, 1, 1), manual.executor());
+    int rejected = 0;
+    manual.reject = true;
+    scheduler.submit(TtsScheduler::Priority::Later,
+                     []() { return TtsScheduler::Outcome::Done; },
+                     [&rejected]() { ++rejected; });
+    scheduler.submit(TtsScheduler::Priority::Later,
+                     []() { return TtsScheduler::Outcome::Done; },
+                     [&rejected]() { ++rejected; });
+    REQUIRE(rejected == 2);
+    REQUIRE(scheduler.inflight() == 0);
+    REQUIRE(scheduler.queue_depth() == 0);
+    REQUIRE(scheduler.limit() == 1);
+
+    manual.reject = false;
+    bool ran = false;
+    scheduler.submit(TtsScheduler::Priority::Later, [&ran]() {
+        ran = true;
+        return TtsScheduler::Outcome::Done;
+    });
+    REQUIRE(scheduler.inflight() == 1);
+    manual.run_one();
+    REQUIRE(ran);
+    REQUIRE(scheduler.inflight() == 0);
+}
@@ -0,0 +1,47 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "sip_gateway/metrics.hpp"
+#include "sip_gateway/sip/turn_trace.hpp"
+
+#include <chrono>
+#include <string>
+
+using sip_gateway::TurnTrace;
+using Stage = sip_gateway::TurnTrace::Stage;
+
+TEST_CASE("TurnTrace keeps the first mark of each stage") {
+    const auto origin = TurnTrace::Clock::now();
+    TurnTrace trace(origin);
+    REQUIRE(trace.has(Stage::SpeechEnd));
+    REQUIRE_FALSE(trace.has(Stage::ShortPause));
+    REQUIRE_FALSE(trace.offset(Stage::ShortPause));
+
+    trace.mark(Stage::ShortPause, origin + std::chrono::milliseconds(200));
+    trace.mark(Stage::ShortPause, origin + std::chrono::milliseconds(900));
+    trace.mark(Stage::TranscribeSent, origin + std::chrono::milliseconds(205));
+    REQUIRE(*trace.offset(Stage::ShortPause) == 0.2);
+    REQUIRE(trace.summary() == "short_pause=200 transcribe_sent=205");
+}
+
+TEST_CASE("TurnTrace exports stages and flags slow turns once") {
+    const auto origin = TurnTrace::Clock::now();
+    TurnTrace trace(origin);
+    trace.mark(Stage::StartSent, origin + std::chrono::milliseconds(300));
+    trace.mark(Stage::FirstFramePlayed, origin + std::chrono::milliseconds(1200));
+
+    REQUIRE(trace.finish("session-1", 1.0));
+    REQUIRE_FALSE(trace.finish("session-1", 1.0));
+
+    const auto output = sip_gateway::Metrics::instance().render_prometheus();
+    REQUIRE(output.find("method=\"turn_start_sent\"") != std::string::npos);
+    REQUIRE(output.find("method=\"turn_first_frame_played\"") != std::string::npos);
+    REQUIRE(output.find("turn_slow_total") != std::string::npos);
+
+    TurnTrace fast(origin);
+    fast.mark(Stage::FirstFramePlayed, origin + std::chrono::milliseconds(400));
+    REQUIRE_FALSE(fast.finish("session-2", 1.0));
+    // Without a played frame there is no end-to-end latency to judge.
+    TurnTrace abandoned(origin);
+    abandoned.mark(Stage::ShortPause, origin + std::chrono::seconds(5));
+    REQUIRE_FALSE(abandoned.finish("session-3", 1.0));
+}
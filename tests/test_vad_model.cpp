@@ -0,0 +1,202 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "sip_gateway/vad/model.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+using sip_gateway::vad::VadModel;
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+// Batched and single runs may pick different GEMM kernels.
+constexpr float kTolerance = 1e-4f;
+
+std::unique_ptr<VadModel> load_model(int sampling_rate) {
+    const char* path = std::getenv("VAD_MODEL_PATH");
+    INFO("VAD_MODEL_PATH must name a Silero VAD model");
+    REQUIRE(path);
+    REQUIRE(*path);
+    return std::make_unique<VadModel>(path, sampling_rate);
+}
+
+// Each session hears its own signal so their states drift apart: a tone,
+// noise, silence, a chirp.
+std::vector<std::vector<float>> session_audio(size_t session,
+                                              size_t windows,
+                                              size_t window_size,
+                                              int sampling_rate) {
+    std::mt19937 random(static_cast<unsigned>(session + 1));
+    std::normal_distribution<float> noise(0.0f, 0.1f);
+    std::vector<std::vector<float>> audio(windows, std::vector<float>(window_size));
+    for (size_t w = 0; w < windows; ++w) {
+        for (size_t i = 0; i < window_size; ++i) {
+            const double t = static_cast<double>(w * window_size + i) / sampling_rate;
+            float sample = 0.0f;
+            switch (session % 4) {
+            case 0:
+                sample = static_cast<float>(0.3 * std::sin(2.0 * kPi * 220.0 * t));
+                break;
+            case 1:
+                sample = noise(random);
+                break;
+            case 2:
+                break;
+            default:
+                sample = static_cast<float>(0.3 * std::sin(2.0 * kPi * (150.0 + 400.0 * t) * t));
+                break;
+            }
+            audio[w][i] = sample;
+        }
+    }
+    return audio;
+}
+
+struct Reference {
+    std::vector<float> probs;
+    // State after each window.
+    std::vector<std::vector<float>> states;
+};
+
+// Runs one session's windows alone, one call per window.
+Reference run_alone(const VadModel& model, const std::vector<std::vector<float>>& audio) {
+    Reference reference;
+    auto state = model.initialize_state();
+    for (const auto& window : audio) {
+        reference.probs.push_back(model.get_speech_prob(window, &state));
+        reference.states.push_back(state);
+    }
+    return reference;
+}
+
+void require_close(const std::vector<float>& actual, const std::vector<float>& expected) {
+    REQUIRE(actual.size() == expected.size());
+    for (size_t i = 0; i < actual.size(); ++i) {
+        INFO("index " << i);
+        REQUIRE(std::fabs(actual[i] - expected[i]) <= kTolerance);
+    }
+}
+
+void check_lockstep(int sampling_rate) {
+    INFO("sampling_rate=" << sampling_rate);
+    const auto model = load_model(sampling_rate);
+    const size_t window_size = VadModel::window_size_for(sampling_rate);
+    constexpr size_t kSessions = 4;
+    constexpr size_t kWindows = 12;
+
+    std::vector<std::vector<std::vector<float>>> audio;
+    std::vector<Reference> references;
+    for (size_t s = 0; s < kSessions; ++s) {
+        audio.push_back(session_audio(s, kWindows, window_size, sampling_rate));
+        references.push_back(run_alone(*model, audio.back()));
+    }
+
+    std::vector<std::vector<float>> states(kSessions, model->initialize_state());
+    for (size_t w = 0; w < kWindows; ++w) {
+        INFO("window " << w);
+        std::vector<const float*> windows;
+        std::vector<std::vector<float>*> state_ptrs;
+        for (size_t s = 0; s < kSessions; ++s) {
+            windows.push_back(audio[s][w].data());
+            state_ptrs.push_back(&states[s]);
+        }
+        std::vector<float> probs(kSessions);
+        model->get_speech_probs(windows, window_size, state_ptrs, probs.data());
+        for (size_t s = 0; s < kSessions; ++s) {
+            INFO("session " << s);
+            REQUIRE(std::fabs(probs[s] - references[s].probs[w]) <= kTolerance);
+            require_close(states[s], references[s].states[w]);
+        }
+    }
+}
+
+}
+
+TEST_CASE("Batched VAD windows match running each session alone") {
+    check_lockstep(16000);
+    check_lockstep(8000);
+}
+
+TEST_CASE("Mixed VAD batches keep each session's state apart") {
+    const int sampling_rate = 16000;
+    const auto model = load_model(sampling_rate);
+    const size_t window_size = VadModel::window_size_for(sampling_rate);
+    constexpr size_t kSessions = 5;
+    constexpr size_t kWindows = 10;
+
+    std::vector<std::vector<std::vector<float>>> audio;
+    std::vector<Reference> references;
+    for (size_t s = 0; s < kSessions; ++s) {
+        audio.push_back(session_audio(s, kWindows, window_size, sampling_rate));
+        references.push_back(run_alone(*model, audio.back()));
+    }
+
+    // Sessions join at different times and sit out some rounds, so every
+    // batch mixes sessions at different positions, in a different order,
+    // with different sizes; a joining session passes an empty state.
+    std::vector<std::vector<float>> states(kSessions);
+    std::vector<size_t> next(kSessions, 0);
+    std::mt19937 random(7);
+    size_t round = 0;
+    for (;;) {
+        std::vector<size_t> members;
+        for (size_t s = 0; s < kSessions; ++s) {
+            const bool joined = round >= s;
+            const bool sits_out = (round + s) % 3 == 2;
+            if (joined && !sits_out && next[s] < kWindows) {
+                members.push_back(s);
+            }
+        }
+        const bool done = std::all_of(next.begin(), next.end(),
+                                      [](size_t n) { return n == kWindows; });
+        if (done) {
+            break;
+        }
+        ++round;
+        if (members.empty()) {
+            continue;
+        }
+        std::shuffle(members.begin(), members.end(), random);
+
+        std::vector<const float*> windows;
+        std::vector<std::vector<float>*> state_ptrs;
+        for (const auto s : members) {
+            windows.push_back(audio[s][next[s]].data());
+            state_ptrs.push_back(&states[s]);
+        }
+        std::vector<float> probs(members.size());
+        model->get_speech_probs(windows, window_size, state_ptrs, probs.data());
+        for (size_t i = 0; i < members.size(); ++i) {
+            const auto s = members[i];
+            INFO("round " << round << " session " << s << " window " << next[s]);
+            REQUIRE(std::fabs(probs[i] - references[s].probs[next[s]]) <= kTolerance);
+            require_close(states[s], references[s].states[next[s]]);
+            ++next[s];
+        }
+    }
+}
+
+TEST_CASE("Batched VAD windows match the preallocated stream") {
+    const int sampling_rate = 16000;
+    const auto model = load_model(sampling_rate);
+    const size_t window_size = VadModel::window_size_for(sampling_rate);
+    const auto audio = session_audio(0, 8, window_size, sampling_rate);
+    const auto silent = session_audio(2, 8, window_size, sampling_rate);
+
+    auto stream = model->create_stream(window_size);
+    std::vector<float> state;
+    std::vector<float> other;
+    for (size_t w = 0; w < audio.size(); ++w) {
+        INFO("window " << w);
+        const float alone = stream->get_speech_prob(audio[w].data(), window_size);
+        float probs[2] = {};
+        model->get_speech_probs({silent[w].data(), audio[w].data()}, window_size,
+                                {&other, &state}, probs);
+        REQUIRE(std::fabs(probs[1] - alone) <= kTolerance);
+    }
+}
@@ -0,0 +1,76 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "sip_gateway/audio/upload_encoder.hpp"
+#include "sip_gateway/audio/wav.hpp"
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using sip_gateway::audio::UploadCodec;
+using sip_gateway::audio::UploadEncoderOptions;
+
+namespace {
+
+uint32_t read_u32(const std::string& bytes, size_t offset) {
+    uint32_t value = 0;
+    for (size_t i = 0; i < 4; ++i) {
+        value |= static_cast<uint32_t>(static_cast<uint8_t>(bytes[offset + i])) << (8 * i);
+    }
+    return value;
+}
+
+int16_t read_i16(const std::string& bytes, size_t offset) {
+    const auto lo = static_cast<uint8_t>(bytes[offset]);
+    const auto hi = static_cast<uint8_t>(bytes[offset + 1]);
+    return static_cast<int16_t>(static_cast<uint16_t>(lo | (hi << 8)));
+}
+
+}
+
+TEST_CASE("encode_wav writes a mono 16-bit header") {
+    const auto wav = sip_gateway::audio::encode_wav({0.0f, 0.5f, -0.5f}, 16000);
+
+    REQUIRE(wav.size() == 44 + 6);
+    REQUIRE(wav.compare(0, 4, "RIFF") == 0);
+    REQUIRE(read_u32(wav, 4) == 36 + 6);
+    REQUIRE(wav.compare(8, 8, "WAVEfmt ") == 0);
+    REQUIRE(read_u32(wav, 24) == 16000);
+    REQUIRE(read_u32(wav, 28) == 32000);
+    REQUIRE(wav.compare(36, 4, "data") == 0);
+    REQUIRE(read_u32(wav, 40) == 6);
+}
+
+TEST_CASE("encode_wav clamps samples outside [-1, 1]") {
+    const auto wav = sip_gateway::audio::encode_wav({2.0f, -2.0f, 1.0f}, 8000);
+
+    REQUIRE(read_i16(wav, 44) == 32767);
+    REQUIRE(read_i16(wav, 46) == -32767);
+    REQUIRE(read_i16(wav, 48) == 32767);
+}
+
+TEST_CASE("encode_wav reuses the output buffer") {
+    std::string out;
+    sip_gateway::audio::encode_wav(std::vector<float>(64, 0.25f), 16000, out);
+    const char* storage = out.data();
+    sip_gateway::audio::encode_wav({0.5f}, 16000, out);
+
+    REQUIRE(out.data() == storage);
+    REQUIRE(out == sip_gateway::audio::encode_wav({0.5f}, 16000));
+}
+
+TEST_CASE("encode_upload keeps the legacy WAV content type") {
+    const std::vector<float> audio(160, 0.25f);
+    const auto encoded = sip_gateway::audio::encode_upload(audio, 16000, UploadEncoderOptions{});
+
+    REQUIRE(encoded.codec == UploadCodec::Wav);
+    REQUIRE(encoded.content_type == "wav");
+    REQUIRE(encoded.bytes == sip_gateway::audio::encode_wav(audio, 16000));
+}
+
+TEST_CASE("parse_upload_codec rejects unknown names") {
+    REQUIRE(sip_gateway::audio::parse_upload_codec("opus") == UploadCodec::Opus);
+    REQUIRE(sip_gateway::audio::parse_upload_codec("wav") == UploadCodec::Wav);
+    REQUIRE_THROWS_AS(sip_gateway::audio::parse_upload_codec("flac"), std::runtime_error);
+}